@@ -25,8 +25,49 @@ layout (location = 13) uniform int  uPointLightEnabled[3];  // 13, 14, 15
 layout (location = 16) uniform int  uDirectionalEnabled;    // 16
 layout (location = 17) uniform int  uUseTexture;            // 0 = use materials, 1 = use texture
 
+// Virtual texture (see virtual_texture.hpp); used instead of uTexture if set
+layout (location = 19) uniform int  uVirtual;
+layout (location = 20) uniform usampler2D uVtPageTable;
+layout (location = 21) uniform sampler2D  uVtPhysical;
+layout (location = 22) uniform vec4 uVtSize;   // width, height, page size, border
+layout (location = 23) uniform vec4 uVtCache;  // physical size, stored page size, max level, lod bias
+layout (location = 24) uniform int  uVtRows[16]; // first page table row of each level
+
 out vec4 oColor;
 
+// Level selection must match vt_feedback.frag
+vec3 sampleVirtual(vec2 uv)
+{
+    float pageSize = uVtSize.z;
+    float border = uVtSize.w;
+
+    vec2 dx = dFdx(uv * uVtSize.xy);
+    vec2 dy = dFdy(uv * uVtSize.xy);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + uVtCache.w;
+    int level = int(clamp(floor(lod), 0.0, uVtCache.z));
+
+    uv = clamp(uv, 0.0, 1.0);
+    vec2 levelSize = max(floor(uVtSize.xy / exp2(float(level))), vec2(1.0));
+    ivec2 page = min(ivec2(uv * levelSize / pageSize), ivec2(ceil(levelSize / pageSize)) - 1);
+
+    // The entry names the slot of the page, or of its nearest resident
+    // ancestor if the page isn't loaded yet
+    uvec4 entry = texelFetch(uVtPageTable, ivec2(page.x, uVtRows[level] + page.y), 0);
+    int resident = int(entry.b);
+
+    vec2 residentSize = max(floor(uVtSize.xy / exp2(float(resident))), vec2(1.0));
+    ivec2 residentPages = ivec2(ceil(residentSize / pageSize));
+    ivec2 residentPage = min(page >> (resident - level), residentPages - 1);
+
+    // Stay within the page's border, so that filtering doesn't pick up
+    // texels from the neighbouring slot
+    vec2 inPage = uv * residentSize - vec2(residentPage) * pageSize;
+    inPage = clamp(inPage, vec2(0.5 - border), vec2(pageSize + border - 0.5));
+
+    vec2 physical = vec2(entry.rg) * uVtCache.y + border + inPage;
+    return textureLod(uVtPhysical, physical / uVtCache.x, 0.0).rgb;
+}
+
 void main()
 {
     vec3 N = normalize(vNormal);
@@ -39,7 +80,7 @@ void main()
     if (uUseTexture != 0)
     {
         // Terrain mode: use texture
-        vec3 texColor = texture(uTexture, vTexCoord).rgb;
+        vec3 texColor = uVirtual != 0 ? sampleVirtual(vTexCoord) : texture(uTexture, vTexCoord).rgb;
         Ka = uAmbientColor;
         Kd = texColor * uBaseColor;
         Ks = vec3(0.05);
@@ -38,23 +38,53 @@
 
 // Matches the locations used in main.cpp
 layout(location = 2) uniform vec3 uColor;        // tint for the exhaust
-layout(location = 3) uniform sampler2D uTexture; // particle texture
+layout(location = 3) uniform sampler2DArray uTexture; // small texture atlas
+layout(location = 5) uniform vec4 uUvTransform;       // atlas region: scale (xy), offset (zw)
+layout(location = 6) uniform float uLayer;            // atlas layer
+layout(location = 10) uniform bool uWeighted;         // weighted blended transparency (see particle_target.hpp)
 
-out vec4 outColor;
+in float vLife;             // seconds left
+flat in vec2 vRotation;     // cos, sin
+in float vDistance;         // from the camera
+
+layout(location = 0) out vec4 outColor;      // colour, or accumulation when uWeighted
+layout(location = 1) out float outRevealage; // only when uWeighted
 
 void main()
 {
-    // Normalised coords inside the point sprite
-    vec2 uv = gl_PointCoord;
+    // Normalised coords inside the point sprite, rotated around its center.
+    // The corners turn outside of the sprite.
+    vec2 p = gl_PointCoord - 0.5;
+    vec2 rotated = vec2(vRotation.x * p.x - vRotation.y * p.y, vRotation.y * p.x + vRotation.x * p.y) + 0.5;
+    if (any(lessThan(rotated, vec2(0.0))) || any(greaterThan(rotated, vec2(1.0))))
+        discard;
+
+    vec2 uv = rotated * uUvTransform.xy + uUvTransform.zw;
 
     // Sample smoke/exhaust texture (must have alpha)
-    vec4 tex = texture(uTexture, uv);
+    vec4 tex = texture(uTexture, vec3(uv, uLayer));
 
     // Kill almost-transparent pixels so we don't see a square
     if (tex.a < 0.01)
         discard;
 
-    // Tint the RGB by uColor, keep alpha from texture
-    outColor = vec4(tex.rgb * uColor, tex.a);
+    // Tint the RGB by uColor, keep alpha from texture, and fade out over
+    // the last quarter second
+    vec4 color = vec4(tex.rgb * uColor, tex.a * clamp(vLife * 4.0, 0.0, 1.0));
+
+    if (uWeighted)
+    {
+        // Order independent: premultiplied colour, weighted up for
+        // particles near the camera (McGuire and Bavoil 2013, eq. 7), and
+        // the product of (1 - alpha) via the blending
+        float d = vDistance;
+        float weight = color.a * clamp(10.0 / (1e-5 + pow(d / 5.0, 2.0) + pow(d / 200.0, 6.0)), 1e-2, 3e3);
+        outColor = vec4(color.rgb * color.a, color.a) * weight;
+        outRevealage = color.a;
+    }
+    else
+    {
+        outColor = color;
+    }
 }
 
@@ -28,15 +28,36 @@
 
 #version 430 core
 
-layout(location = 0) in vec3 aPosition;
+// Packed vertices (see packParticleVertices() in particle_sim.hpp). The
+// positions are unsigned normalized 16-bit values, i.e., fractions of the
+// bounds in uBoundsMin/uBoundsExtent.
+layout(location = 0) in float aPositionX;
+layout(location = 1) in float aPositionY;
+layout(location = 2) in float aPositionZ;
+layout(location = 3) in uint aPacked;           // emitter, life, size, rotation
 
 // Matches your C++ bindings:
 layout(location = 0) uniform mat4 uViewProj;
 layout(location = 1) uniform float uBaseSize;   // C++ still sets this with location 1
 layout(location = 4) uniform vec3 uCameraPos;   // you already upload this in C++
+layout(location = 7) uniform vec3 uBoundsMin;
+layout(location = 8) uniform vec3 uBoundsExtent;
+layout(location = 9) uniform float uResolutionScale; // < 1 in a low resolution pass (particle_target.hpp)
+
+out float vLife;            // seconds left
+flat out vec2 vRotation;    // cos, sin
+out float vDistance;        // from the camera
 
 void main()
 {
+    vec3 aPosition = uBoundsMin + vec3(aPositionX, aPositionY, aPositionZ) * uBoundsExtent;
+
+    // Unpack (bits 0-3 are the emitter id, unused here)
+    vLife = float(bitfieldExtract(aPacked, 4, 12)) / 1024.0;
+    float sizeScale = float(bitfieldExtract(aPacked, 16, 8)) / 64.0;
+    float angle = float(bitfieldExtract(aPacked, 24, 8)) * (6.28318531 / 256.0);
+    vRotation = vec2(cos(angle), sin(angle));
+
     // Transform to clip space
     gl_Position = uViewProj * vec4(aPosition, 1.0);
 
@@ -45,12 +66,13 @@ void main()
 
     // Protect against divide-by-zero
     dist = max(dist, 0.001);
+    vDistance = dist;
 
     // Inversely scale size with distance
-    float size = 10.0 * uBaseSize / dist;
+    float size = 10.0 * uBaseSize * sizeScale / dist;
 
     // Clamp so they’re never microscopic or gigantic
     float minSize = 0.0;
     float maxSize = 400.0;
-    gl_PointSize = clamp(size, minSize, maxSize);
+    gl_PointSize = clamp(size, minSize, maxSize) * uResolutionScale;
 }
@@ -0,0 +1,72 @@
+#version 430 core
+
+// Blends the particle pass (see particle_target.hpp) over the scene. This
+// is drawn with glBlendFunc(GL_ONE, GL_SRC_ALPHA): the output is the
+// premultiplied colour of the particles and, in alpha, the fraction of the
+// background that shows through. With uWeighted, that comes from the
+// accumulation and revealage targets of weighted blended transparency.
+//
+// Bilateral upsample: of the four low resolution texels around a pixel,
+// those whose depth is close to the pixel's own are weighted up. Pixels at
+// the edge of a nearer object then take their particles from the texels on
+// the same side of the edge, instead of blurring across it.
+
+layout(location = 0) uniform sampler2D uParticles;       // colour or accumulation
+layout(location = 1) uniform sampler2D uParticleDepth;
+layout(location = 2) uniform sampler2D uSceneDepth;
+layout(location = 3) uniform int uDivisor;
+layout(location = 4) uniform ivec2 uLowMax;         // last texel of the low resolution viewport
+layout(location = 5) uniform ivec2 uViewportOrigin;
+layout(location = 6) uniform vec2 uDepthRange;      // near, far
+layout(location = 7) uniform bool uWeighted;
+layout(location = 8) uniform sampler2D uRevealage;  // only when uWeighted
+
+out vec4 outColor;
+
+float linearDepth(float depth)
+{
+    float n = uDepthRange.x, f = uDepthRange.y;
+    return n * f / (f - depth * (f - n));
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy) - uViewportOrigin;
+    float z = linearDepth(texelFetch(uSceneDepth, pixel, 0).r);
+
+    // Position among the low resolution texel centres
+    vec2 pos = (vec2(pixel) + 0.5) / float(uDivisor) - 0.5;
+    ivec2 base = ivec2(floor(pos));
+    vec2 f = pos - vec2(base);
+
+    vec4 sum = vec4(0.0);
+    float revealage = 0.0;
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), uLowMax);
+
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float zLow = linearDepth(texelFetch(uParticleDepth, texel, 0).r);
+        float weight = bilinear.x * bilinear.y / (1e-3 + abs(zLow - z) / z);
+
+        sum += weight * texelFetch(uParticles, texel, 0);
+        if (uWeighted)
+            revealage += weight * texelFetch(uRevealage, texel, 0).r;
+        weightSum += weight;
+    }
+    sum /= weightSum;
+
+    if (uWeighted)
+    {
+        // Weighted average of the colours, covering 1 - revealage
+        revealage /= weightSum;
+        vec3 average = sum.rgb / clamp(sum.a, 1e-4, 5e4);
+        outColor = vec4(average * (1.0 - revealage), revealage);
+    }
+    else
+    {
+        outColor = sum;
+    }
+}
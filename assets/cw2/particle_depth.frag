@@ -0,0 +1,27 @@
+#version 430 core
+
+// Depth for the low resolution particle pass (see particle_target.hpp): the
+// nearest scene depth in each uDivisor x uDivisor block of pixels, so that
+// particles behind any part of a block are hidden there. The upsample in
+// particle_composite.frag fills in the pixels of the block that are farther.
+
+layout(location = 0) uniform sampler2D uSceneDepth;
+layout(location = 1) uniform int uDivisor;
+layout(location = 2) uniform ivec2 uSceneMax;   // last pixel of the viewport
+
+void main()
+{
+    ivec2 first = ivec2(gl_FragCoord.xy) * uDivisor;
+
+    float depth = 1.0;
+    for (int y = 0; y < uDivisor; ++y)
+    {
+        for (int x = 0; x < uDivisor; ++x)
+        {
+            ivec2 p = min(first + ivec2(x, y), uSceneMax);
+            depth = min(depth, texelFetch(uSceneDepth, p, 0).r);
+        }
+    }
+
+    gl_FragDepth = depth;
+}
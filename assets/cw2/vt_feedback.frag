@@ -0,0 +1,25 @@
+#version 430 core
+
+// Writes the virtual texture page that sampleVirtual() in default.frag would
+// want for this fragment: level << 24 | y << 12 | x
+
+in vec2 vTexCoord;
+
+layout(location = 22) uniform vec4 uVtSize;   // width, height, page size, border
+layout(location = 23) uniform vec4 uVtCache;  // physical size, stored page size, max level, lod bias
+
+layout(location = 0) out uint oPage;
+
+void main()
+{
+    vec2 dx = dFdx(vTexCoord * uVtSize.xy);
+    vec2 dy = dFdy(vTexCoord * uVtSize.xy);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + uVtCache.w;
+    int level = int(clamp(floor(lod), 0.0, uVtCache.z));
+
+    vec2 levelSize = max(floor(uVtSize.xy / exp2(float(level))), vec2(1.0));
+    ivec2 pages = ivec2(ceil(levelSize / uVtSize.z));
+    ivec2 page = min(ivec2(clamp(vTexCoord, 0.0, 1.0) * levelSize / uVtSize.z), pages - 1);
+
+    oPage = (uint(level) << 24) | (uint(page.y) << 12) | uint(page.x);
+}
@@ -0,0 +1,16 @@
+#version 430 core
+
+// Feedback pass of the virtual texture (see virtual_texture.hpp)
+
+layout(location = 0) in vec3 iPosition;
+layout(location = 3) in vec2 iTexCoord;
+
+layout(location = 0) uniform mat4 uMvp;
+
+out vec2 vTexCoord;
+
+void main()
+{
+    vTexCoord = iTexCoord;
+    gl_Position = uMvp * vec4(iPosition, 1.0);
+}
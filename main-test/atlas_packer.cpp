@@ -0,0 +1,129 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+#include <algorithm>
+
+#include "../support/error.hpp"
+
+#include "../main/atlas_packer.hpp"
+
+namespace
+{
+    bool overlap( AtlasItemSize aSa, AtlasPlacement aPa, AtlasItemSize aSb, AtlasPlacement aPb, std::uint32_t aPad )
+    {
+        if( aPa.layer != aPb.layer )
+            return false;
+
+        // Compare the padded rectangles
+        return aPa.x - aPad < aPb.x + aSb.width + aPad && aPb.x - aPad < aPa.x + aSa.width + aPad
+            && aPa.y - aPad < aPb.y + aSb.height + aPad && aPb.y - aPad < aPa.y + aSa.height + aPad;
+    }
+}
+
+TEST_CASE( "Shelf packing", "[texture][atlas]" )
+{
+    SECTION( "Empty input" )
+    {
+        REQUIRE( pack_shelves( {}, 256, 4 ).empty() );
+    }
+
+    SECTION( "Single item is placed at the padding offset" )
+    {
+        AtlasItemSize const sizes[] = { { 8, 8 } };
+        auto const placements = pack_shelves( sizes, 256, 4 );
+
+        REQUIRE( 1 == placements.size() );
+        REQUIRE( 0 == placements[0].layer );
+        REQUIRE( 4 == placements[0].x );
+        REQUIRE( 4 == placements[0].y );
+    }
+
+    SECTION( "Items stay inside their layer and don't overlap" )
+    {
+        std::uint32_t const layerSize = 128, pad = 2;
+
+        std::vector<AtlasItemSize> sizes;
+        for( std::uint32_t i = 0; i < 60; ++i )
+            sizes.push_back( { 4 + (i * 7) % 29, 4 + (i * 13) % 37 } );
+
+        auto const placements = pack_shelves( sizes, layerSize, pad );
+        REQUIRE( sizes.size() == placements.size() );
+
+        std::uint32_t layers = 0, area = 0;
+        for( std::size_t i = 0; i < sizes.size(); ++i )
+        {
+            REQUIRE( placements[i].x >= pad );
+            REQUIRE( placements[i].y >= pad );
+            REQUIRE( placements[i].x + sizes[i].width + pad <= layerSize );
+            REQUIRE( placements[i].y + sizes[i].height + pad <= layerSize );
+            layers = std::max( layers, placements[i].layer + 1 );
+            area += (sizes[i].width + 2 * pad) * (sizes[i].height + 2 * pad);
+
+            for( std::size_t j = 0; j < i; ++j )
+                REQUIRE( !overlap( sizes[i], placements[i], sizes[j], placements[j], pad ) );
+        }
+
+        // Shelves waste some space, but not a whole layer
+        REQUIRE( layers <= area / (layerSize * layerSize) + 2 );
+    }
+
+    SECTION( "Cells are aligned for the mip levels" )
+    {
+        // As in texture_atlas.cpp: 4 texels of padding, 3 levels
+        std::uint32_t const layerSize = 256, pad = 4, levels = 3;
+
+        std::vector<AtlasItemSize> sizes;
+        for( std::uint32_t i = 0; i < 40; ++i )
+            sizes.push_back( { 1 + (i * 11) % 23, 1 + (i * 5) % 19 } );
+
+        auto const placements = pack_shelves( sizes, layerSize, pad, 1u << (levels - 1) );
+        REQUIRE( sizes.size() == placements.size() );
+
+        for( std::size_t i = 0; i < sizes.size(); ++i )
+        {
+            auto const& p = placements[i];
+            std::uint32_t const cellX = p.x - pad, cellY = p.y - pad;
+            REQUIRE( p.cellWidth >= sizes[i].width + 2 * pad );
+            REQUIRE( p.cellHeight >= sizes[i].height + 2 * pad );
+            REQUIRE( cellX + p.cellWidth <= layerSize );
+            REQUIRE( cellY + p.cellHeight <= layerSize );
+
+            for( std::uint32_t level = 0; level < levels; ++level )
+            {
+                // Level texels of size s; the cell covers whole texels
+                std::uint32_t const s = 1u << level;
+                REQUIRE( 0 == cellX % s );
+                REQUIRE( 0 == cellY % s );
+                REQUIRE( 0 == p.cellWidth % s );
+                REQUIRE( 0 == p.cellHeight % s );
+
+                // Texels that bilinear filtering reads for UVs inside the
+                // item: from floor(u/s - 1/2) to one past floor(u/s - 1/2),
+                // with u the item's edges in level 0 texels.
+                auto const first = [s] ( std::uint32_t aU ) { return (2 * aU - s) / (2 * s); };
+                std::uint32_t const x0 = first( p.x ) * s, x1 = (first( p.x + sizes[i].width ) + 2) * s;
+                std::uint32_t const y0 = first( p.y ) * s, y1 = (first( p.y + sizes[i].height ) + 2) * s;
+
+                REQUIRE( x0 >= cellX );
+                REQUIRE( y0 >= cellY );
+                REQUIRE( x1 <= cellX + p.cellWidth );
+                REQUIRE( y1 <= cellY + p.cellHeight );
+            }
+
+            for( std::size_t j = 0; j < i; ++j )
+            {
+                auto const& q = placements[j];
+                bool const apart = p.layer != q.layer
+                    || cellX + p.cellWidth <= q.x - pad || q.x - pad + q.cellWidth <= cellX
+                    || cellY + p.cellHeight <= q.y - pad || q.y - pad + q.cellHeight <= cellY;
+                REQUIRE( apart );
+            }
+        }
+    }
+
+    SECTION( "Oversized items are rejected" )
+    {
+        AtlasItemSize const sizes[] = { { 8, 8 }, { 254, 10 } };
+        REQUIRE_THROWS_AS( pack_shelves( sizes, 256, 2 ), Error );
+    }
+}
@@ -0,0 +1,64 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <limits>
+
+#include <cmath>
+
+#include "../support/fixed_timestep.hpp"
+
+TEST_CASE( "Fixed timestep", "[timestep]" )
+{
+    FixedTimestep clock( 0.01, 4 );
+
+    SECTION( "Steps do not depend on how time is split into frames" )
+    {
+        FixedTimestep fast( 0.01, 4 ), slow( 0.01, 4 );
+
+        int fastSteps = 0, slowSteps = 0;
+        for( int i = 0; i < 300; ++i )
+            fastSteps += fast.advance( 1.0 / 300.0 ); // 300 Hz
+        for( int i = 0; i < 30; ++i )
+            slowSteps += slow.advance( 1.0 / 30.0 );  // 30 Hz
+
+        // One second either way (give or take rounding of the last step)
+        REQUIRE( std::abs( fastSteps - 100 ) <= 1 );
+        REQUIRE( std::abs( slowSteps - 100 ) <= 1 );
+
+        // Most fast frames run no step
+        REQUIRE( fast.stats().frames == 300 );
+        REQUIRE( fast.stats().steps == std::size_t(fastSteps) );
+    }
+
+    SECTION( "The remainder is carried over and gives the interpolation" )
+    {
+        REQUIRE( 0 == clock.advance( 0.004 ) );
+        REQUIRE( std::abs( clock.alpha() - 0.4f ) < 1e-5f );
+
+        REQUIRE( 1 == clock.advance( 0.008 ) );
+        REQUIRE( std::abs( clock.alpha() - 0.2f ) < 1e-5f );
+
+        REQUIRE( 2 == clock.advance( 0.02 ) );
+        REQUIRE( std::abs( clock.alpha() - 0.2f ) < 1e-5f );
+
+        clock.reset();
+        REQUIRE( 0.f == clock.alpha() );
+    }
+
+    SECTION( "Hitches are clamped to the maximum number of steps" )
+    {
+        REQUIRE( 4 == clock.advance( 0.5 ) );
+        REQUIRE( 1 == clock.stats().clampedFrames );
+        REQUIRE( std::abs( clock.stats().droppedSeconds - 0.46 ) < 1e-9 );
+
+        // The dropped time is gone
+        REQUIRE( 1 == clock.advance( 0.01 ) );
+    }
+
+    SECTION( "Negative and invalid times count as zero" )
+    {
+        REQUIRE( 0 == clock.advance( -1.0 ) );
+        REQUIRE( 0 == clock.advance( std::numeric_limits<double>::quiet_NaN() ) );
+        REQUIRE( 0.f == clock.alpha() );
+        REQUIRE( 1 == clock.advance( 0.01 ) );
+    }
+}
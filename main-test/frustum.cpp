@@ -0,0 +1,103 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <numbers>
+
+#include <cmath>
+
+#include "../main/frustum.hpp"
+
+namespace
+{
+    // At the origin, looking along -z
+    Frustum test_frustum()
+    {
+        float const fov = 60.f * std::numbers::pi_v<float> / 180.f;
+        return makeFrustum( make_perspective_projection( fov, 16.f / 9.f, 0.1f, 100.f ) );
+    }
+
+    Aabb box_at( Vec3f aCenter, float aHalf = 0.5f )
+    {
+        Vec3f const half{ aHalf, aHalf, aHalf };
+        return Aabb{ aCenter - half, aCenter + half };
+    }
+}
+
+TEST_CASE( "Frustum culling", "[frustum]" )
+{
+    auto const frustum = test_frustum();
+
+    SECTION( "Boxes in view are kept" )
+    {
+        REQUIRE( intersects( frustum, box_at( { 0.f, 0.f, -10.f } ) ) );
+        REQUIRE( intersects( frustum, box_at( { 5.f, 2.f, -20.f } ) ) );
+        REQUIRE( intersects( frustum, box_at( { 0.f, 0.f, -99.f } ) ) );
+    }
+
+    SECTION( "Boxes outside one plane are culled" )
+    {
+        REQUIRE( !intersects( frustum, box_at( { 0.f, 0.f, 10.f } ) ) );    // behind
+        REQUIRE( !intersects( frustum, box_at( { -30.f, 0.f, -10.f } ) ) ); // left
+        REQUIRE( !intersects( frustum, box_at( { 30.f, 0.f, -10.f } ) ) );  // right
+        REQUIRE( !intersects( frustum, box_at( { 0.f, 20.f, -10.f } ) ) );  // above
+        REQUIRE( !intersects( frustum, box_at( { 0.f, -20.f, -10.f } ) ) ); // below
+        REQUIRE( !intersects( frustum, box_at( { 0.f, 0.f, -110.f } ) ) );  // beyond far
+    }
+
+    SECTION( "Boxes across a plane are kept" )
+    {
+        REQUIRE( intersects( frustum, box_at( { 0.f, 0.f, 0.f } ) ) );     // around the camera
+        REQUIRE( intersects( frustum, box_at( { 0.f, 0.f, -100.f } ) ) );  // across the far plane
+        REQUIRE( intersects( frustum, box_at( { -11.f, 0.f, -10.f }, 2.f ) ) );  // across the left plane (x = -10.3)
+    }
+
+    SECTION( "Large boxes around the frustum are kept" )
+    {
+        REQUIRE( intersects( frustum, box_at( { 0.f, 0.f, 0.f }, 1000.f ) ) );
+    }
+}
+
+TEST_CASE( "Bounds", "[frustum]" )
+{
+    SECTION( "Bounds of points" )
+    {
+        Vec3f const points[] = { { 1.f, -2.f, 3.f }, { -4.f, 5.f, 0.f }, { 2.f, 0.f, -1.f } };
+        auto const box = boundsOf( points );
+        REQUIRE( box.min.x == -4.f );
+        REQUIRE( box.min.y == -2.f );
+        REQUIRE( box.min.z == -1.f );
+        REQUIRE( box.max.x == 2.f );
+        REQUIRE( box.max.y == 5.f );
+        REQUIRE( box.max.z == 3.f );
+    }
+
+    SECTION( "Transformed bounds contain the transformed corners" )
+    {
+        Aabb const box{ { -1.f, -2.f, -0.5f }, { 3.f, 1.f, 2.f } };
+        Mat44f const m = make_translation( { 10.f, -5.f, 2.f } ) * make_rotation_y( 0.7f ) * make_rotation_x( -0.3f ) * make_scaling( 0.5f, 2.f, 1.f );
+        auto const world = transformBounds( box, m );
+
+        for( int i = 0; i < 8; ++i )
+        {
+            Vec4f const corner{
+                (i & 1) ? box.max.x : box.min.x,
+                (i & 2) ? box.max.y : box.min.y,
+                (i & 4) ? box.max.z : box.min.z,
+                1.f
+            };
+            Vec4f const p = m * corner;
+            REQUIRE( p.x >= world.min.x - 1e-5f );
+            REQUIRE( p.y >= world.min.y - 1e-5f );
+            REQUIRE( p.z >= world.min.z - 1e-5f );
+            REQUIRE( p.x <= world.max.x + 1e-5f );
+            REQUIRE( p.y <= world.max.y + 1e-5f );
+            REQUIRE( p.z <= world.max.z + 1e-5f );
+        }
+    }
+
+    SECTION( "Translation only moves the box" )
+    {
+        auto const box = transformBounds( box_at( { 0.f, 0.f, 0.f } ), make_translation( { 1.f, 2.f, 3.f } ) );
+        REQUIRE( std::abs( box.min.x - 0.5f ) < 1e-6f );
+        REQUIRE( std::abs( box.max.z - 3.5f ) < 1e-6f );
+    }
+}
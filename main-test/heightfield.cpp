@@ -0,0 +1,185 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+#include <cmath>
+#include <cstring>
+
+#include "../main/heightfield.hpp"
+#include "../support/random.hpp"
+
+namespace
+{
+    // y = 1 + 0.5 x + 0.25 z over [0,10] x [0,20], as two triangles
+    float slope_height( float aX, float aZ )
+    {
+        return 1.f + 0.5f * aX + 0.25f * aZ;
+    }
+
+    std::vector<Vec3f> slope_mesh()
+    {
+        auto p = [] (float x, float z) { return Vec3f{ x, slope_height( x, z ), z }; };
+        return {
+            p( 0.f, 0.f ), p( 10.f, 0.f ), p( 10.f, 20.f ),
+            p( 0.f, 0.f ), p( 10.f, 20.f ), p( 0.f, 20.f )
+        };
+    }
+
+    std::filesystem::path temp_file( char const* aName )
+    {
+        return std::filesystem::temp_directory_path() / aName;
+    }
+}
+
+TEST_CASE( "Heightfield baking", "[heightfield]" )
+{
+    auto const mesh = slope_mesh();
+
+    SECTION( "The longer side gets the requested resolution" )
+    {
+        auto const hf = bakeHeightfield( mesh, 11 );
+        REQUIRE( hf.cellSize == 2.f );
+        REQUIRE( hf.width == 6 );
+        REQUIRE( hf.depth == 11 );
+        REQUIRE( hf.heights.size() == 66 );
+        REQUIRE( hf.originX == 0.f );
+        REQUIRE( hf.originZ == 0.f );
+        REQUIRE( std::abs( hf.minHeight - 1.f ) < 1e-5f );
+        REQUIRE( std::abs( hf.maxHeight - 11.f ) < 1e-5f );
+    }
+
+    SECTION( "Bilinear lookups reproduce a plane" )
+    {
+        auto const hf = bakeHeightfield( mesh, 11 );
+
+        float const x[] = { 0.f, 3.3f, 9.99f, 5.f, 1.f };
+        float const z[] = { 0.f, 7.1f, 19.9f, 10.f, 18.5f };
+        float height[5], slopeX[5], slopeZ[5];
+        sampleHeights( hf, x, z, 5, height, slopeX, slopeZ );
+
+        for( int i = 0; i < 5; ++i )
+        {
+            REQUIRE( std::abs( height[i] - slope_height( x[i], z[i] ) ) < 1e-4f );
+            REQUIRE( std::abs( sampleHeight( hf, x[i], z[i] ) - height[i] ) < 1e-6f );
+            REQUIRE( std::abs( slopeX[i] - 0.5f ) < 1e-4f );
+            REQUIRE( std::abs( slopeZ[i] - 0.25f ) < 1e-4f );
+        }
+    }
+
+    SECTION( "Points outside use the nearest edge" )
+    {
+        auto const hf = bakeHeightfield( mesh, 11 );
+        REQUIRE( std::abs( sampleHeight( hf, -5.f, -5.f ) - slope_height( 0.f, 0.f ) ) < 1e-4f );
+        REQUIRE( std::abs( sampleHeight( hf, 50.f, 50.f ) - slope_height( 10.f, 20.f ) ) < 1e-4f );
+        REQUIRE( std::abs( sampleHeight( hf, 4.f, 30.f ) - slope_height( 4.f, 20.f ) ) < 1e-4f );
+    }
+
+    SECTION( "The highest triangle wins" )
+    {
+        auto twoLayers = mesh;
+        Vec3f const roof[] = { { 0.f, 50.f, 0.f }, { 10.f, 50.f, 0.f }, { 0.f, 50.f, 10.f } };
+        twoLayers.insert( twoLayers.end(), std::begin( roof ), std::end( roof ) );
+
+        auto const hf = bakeHeightfield( twoLayers, 11 );
+        REQUIRE( sampleHeight( hf, 2.f, 2.f ) == 50.f );
+        REQUIRE( std::abs( sampleHeight( hf, 8.f, 16.f ) - slope_height( 8.f, 16.f ) ) < 1e-4f );
+    }
+
+    SECTION( "Uncovered samples get the lowest height" )
+    {
+        // Only the first triangle (below the diagonal x = z / 2)
+        auto const hf = bakeHeightfield( std::span( mesh ).first( 3 ), 11 );
+        REQUIRE( std::abs( sampleHeight( hf, 0.f, 20.f ) - 1.f ) < 1e-5f );
+        REQUIRE( std::abs( sampleHeight( hf, 10.f, 0.f ) - slope_height( 10.f, 0.f ) ) < 1e-4f );
+    }
+
+    SECTION( "No triangles, no heightfield" )
+    {
+        REQUIRE( bakeHeightfield( {} ).heights.empty() );
+    }
+}
+
+TEST_CASE( "SIMD heightfield lookup", "[heightfield]" )
+{
+    // Bumpy terrain, so that slopes differ from cell to cell
+    std::vector<Vec3f> mesh;
+    for( int j = 0; j < 16; ++j )
+    {
+        for( int i = 0; i < 16; ++i )
+        {
+            auto p = [] (int x, int z) {
+                return Vec3f{ float(x), std::sin( 0.7f * float(x) ) * std::cos( 0.4f * float(z) ), float(z) };
+            };
+            Vec3f const quad[] = { p( i, j ), p( i + 1, j ), p( i + 1, j + 1 ), p( i, j ), p( i + 1, j + 1 ), p( i, j + 1 ) };
+            mesh.insert( mesh.end(), std::begin( quad ), std::end( quad ) );
+        }
+    }
+    auto const hf = bakeHeightfield( mesh, 40 );
+
+    // Odd count for the scalar tail, some points outside the grid
+    int const count = 1001;
+    std::vector<float> x( count ), z( count );
+    RandomStream rng( 7 );
+    rng.uniform( std::span( x ) );
+    rng.uniform( std::span( z ) );
+    for( int i = 0; i < count; ++i )
+    {
+        x[i] = x[i] * 20.f - 2.f;
+        z[i] = z[i] * 20.f - 2.f;
+    }
+
+    std::vector<float> h1( count ), sx1( count ), sz1( count );
+    std::vector<float> h2( count ), sx2( count ), sz2( count );
+    sampleHeights( hf, x.data(), z.data(), count, h1.data(), sx1.data(), sz1.data() );
+    sampleHeightsScalar( hf, x.data(), z.data(), count, h2.data(), sx2.data(), sz2.data() );
+
+    std::size_t const bytes = count * sizeof(float);
+    REQUIRE( 0 == std::memcmp( h1.data(), h2.data(), bytes ) );
+    REQUIRE( 0 == std::memcmp( sx1.data(), sx2.data(), bytes ) );
+    REQUIRE( 0 == std::memcmp( sz1.data(), sz2.data(), bytes ) );
+
+    for( int i = 0; i < count; ++i )
+    {
+        REQUIRE( h1[i] >= hf.minHeight );
+        REQUIRE( h1[i] <= hf.maxHeight );
+    }
+}
+
+TEST_CASE( "Heightfield cache", "[heightfield]" )
+{
+    auto const hf = bakeHeightfield( slope_mesh(), 11 );
+    auto const path = temp_file( "main-test-heightfield.bin" );
+
+    REQUIRE( writeHeightfield( path.string().c_str(), hf ) );
+
+    SECTION( "Round trip" )
+    {
+        auto const loaded = readHeightfield( path.string().c_str(), 11 );
+        REQUIRE( loaded );
+        REQUIRE( loaded->width == hf.width );
+        REQUIRE( loaded->depth == hf.depth );
+        REQUIRE( loaded->cellSize == hf.cellSize );
+        REQUIRE( loaded->originX == hf.originX );
+        REQUIRE( loaded->minHeight == hf.minHeight );
+        REQUIRE( loaded->maxHeight == hf.maxHeight );
+        REQUIRE( loaded->heights == hf.heights );
+    }
+
+    SECTION( "A different resolution is rebaked" )
+    {
+        REQUIRE( !readHeightfield( path.string().c_str(), 12 ) );
+    }
+
+    SECTION( "Truncated and missing files are rejected" )
+    {
+        std::filesystem::resize_file( path, std::filesystem::file_size( path ) - 4 );
+        REQUIRE( !readHeightfield( path.string().c_str(), 11 ) );
+
+        std::filesystem::remove( path );
+        REQUIRE( !readHeightfield( path.string().c_str(), 11 ) );
+    }
+
+    std::filesystem::remove( path );
+}
@@ -0,0 +1,116 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <cmath>
+#include <cstdlib>
+
+#include "../support/thread_pool.hpp"
+
+#include "../main/mipmap.hpp"
+
+namespace
+{
+    double srgb_encode_exact( double aLinear )
+    {
+        return aLinear <= 0.0031308 ? 12.92 * aLinear : 1.055 * std::pow( aLinear, 1.0 / 2.4 ) - 0.055;
+    }
+
+    RgbaImage solid( std::uint32_t aW, std::uint32_t aH, std::uint8_t aR, std::uint8_t aG, std::uint8_t aB, std::uint8_t aA )
+    {
+        RgbaImage ret{ aW, aH, {} };
+        for( std::uint32_t i = 0; i < aW * aH; ++i )
+            ret.texels.insert( ret.texels.end(), { aR, aG, aB, aA } );
+        return ret;
+    }
+}
+
+TEST_CASE( "sRGB conversion", "[texture][mipmap]" )
+{
+    SECTION( "Round trip is exact" )
+    {
+        for( int i = 0; i < 256; ++i )
+            REQUIRE( i == linear_to_srgb8( srgb8_to_linear( std::uint8_t(i) ) ) );
+    }
+
+    SECTION( "Within one step of the exact conversion" )
+    {
+        for( int i = 0; i <= 100000; ++i )
+        {
+            double const linear = i / 100000.0;
+            double const exact = 255.0 * srgb_encode_exact( linear );
+            REQUIRE( std::abs( linear_to_srgb8( float(linear) ) - exact ) <= 1.0 );
+        }
+    }
+
+    SECTION( "Out of range values are clamped" )
+    {
+        REQUIRE( 0 == linear_to_srgb8( -1.f ) );
+        REQUIRE( 0 == linear_to_srgb8( std::nanf( "" ) ) );
+        REQUIRE( 255 == linear_to_srgb8( 2.f ) );
+    }
+}
+
+TEST_CASE( "sRGB mip chain", "[texture][mipmap]" )
+{
+    ThreadPool pool( 3 );
+
+    SECTION( "Averages in linear space" )
+    {
+        // Black/white checkerboard averages to 50% linear grey, which is
+        // ~188 in sRGB (and not 128).
+        RgbaImage checker = solid( 2, 2, 0, 0, 0, 255 );
+        for( int i : { 0, 3 } )
+        {
+            for( int c = 0; c < 3; ++c )
+                checker.texels[4*i+c] = 255;
+        }
+
+        auto const mips = build_srgb_mip_chain( checker, pool );
+        REQUIRE( 2 == mips.size() );
+        REQUIRE( mips[0].texels == checker.texels );
+        REQUIRE( 1 == mips[1].width );
+        REQUIRE( 1 == mips[1].height );
+        REQUIRE( 188 == mips[1].texels[0] );
+        REQUIRE( 255 == mips[1].texels[3] );
+    }
+
+    SECTION( "Transparent texels don't contribute colour" )
+    {
+        RgbaImage image = solid( 2, 2, 0, 255, 0, 0 );
+        image.texels[0] = 255;
+        image.texels[1] = 0;
+        image.texels[3] = 255;
+
+        auto const mips = build_srgb_mip_chain( image, pool );
+        REQUIRE( 255 == mips[1].texels[0] );
+        REQUIRE( 0 == mips[1].texels[1] );
+        REQUIRE( 64 == mips[1].texels[3] );
+    }
+
+    SECTION( "Fully transparent texels keep their colour" )
+    {
+        auto const mips = build_srgb_mip_chain( solid( 4, 4, 10, 20, 30, 0 ), pool );
+        REQUIRE( 3 == mips.size() );
+        REQUIRE( mips[2].texels == solid( 1, 1, 10, 20, 30, 0 ).texels );
+    }
+
+    SECTION( "Odd sizes and results independent of thread count" )
+    {
+        RgbaImage image{ 301, 77, {} };
+        for( std::uint32_t i = 0; i < image.width * image.height * 4; ++i )
+            image.texels.push_back( std::uint8_t( (i * 2654435761u) >> 24 ) );
+
+        ThreadPool single( 1 );
+        auto const a = build_srgb_mip_chain( image, pool );
+        auto const b = build_srgb_mip_chain( image, single );
+
+        REQUIRE( 9 == a.size() );
+        REQUIRE( 150 == a[1].width );
+        REQUIRE( 38 == a[1].height );
+        REQUIRE( 1 == a.back().width );
+        REQUIRE( 1 == a.back().height );
+
+        REQUIRE( a.size() == b.size() );
+        for( std::size_t i = 0; i < a.size(); ++i )
+            REQUIRE( a[i].texels == b[i].texels );
+    }
+}
@@ -0,0 +1,803 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <cmath>
+#include <cstring>
+
+#include "../main/particle_sim.hpp"
+#include "../main/particle_budget.hpp"
+#include "../main/heightfield.hpp"
+#include "../support/thread_pool.hpp"
+
+namespace
+{
+    // Engine exhaust moving upwards
+    ParticleEmitter exhaust_emitter( int aBudget )
+    {
+        ParticleEmitter ret;
+        ret.rate = 15000.f;
+        ret.budget = aBudget;
+        ret.prevPos = { 0.f, 10.f, 0.f };
+        ret.pos = { 0.f, 10.5f, 0.f };
+        ret.velocity = { 0.f, -7.f, 0.f };
+        return ret;
+    }
+
+    // With one emitter (id 0) that may fill the whole pool
+    std::unique_ptr<ParticleSim> make_sim( int aCapacity = kMaxParticles )
+    {
+        auto ret = std::make_unique<ParticleSim>( aCapacity );
+        addEmitter( *ret, exhaust_emitter( aCapacity ) );
+        resetParticles( *ret );
+        return ret;
+    }
+
+    int count_emitter( ParticleSim const& aSim, int aEmitter )
+    {
+        int ret = 0;
+        for( int i = 0; i < aSim.aliveCount; ++i )
+            ret += aEmitter == aSim.emitterOf[i];
+        return ret;
+    }
+
+    // Emitter that stays at one point
+    ParticleEmitter point_emitter( Vec3f aPos, int aPriority = 0 )
+    {
+        ParticleEmitter ret = exhaust_emitter( 18000 );
+        ret.prevPos = aPos;
+        ret.pos = aPos;
+        ret.velocity = { 0.f, 0.f, 0.f };
+        ret.priority = aPriority;
+        return ret;
+    }
+
+    // At the origin, looking along -z, 720 pixels high
+    ParticleView test_view()
+    {
+        ParticleView ret;
+        ret.viewProj = make_perspective_projection( 1.f, 16.f / 9.f, 0.1f, 1000.f );
+        ret.cameraPos = { 0.f, 0.f, 0.f };
+        ret.projScaleY = ret.viewProj[1,1];
+        ret.viewportHeight = 720.f;
+        return ret;
+    }
+
+    // Valley along z, floor at y = -3 (below the fixed ground plane), sides
+    // rising with slope 0.5
+    Heightfield valley_heightfield()
+    {
+        std::vector<Vec3f> mesh;
+        for( int j = -20; j < 20; j += 2 )
+        {
+            for( int i = -20; i < 20; i += 2 )
+            {
+                auto p = [] (int x, int z) {
+                    return Vec3f{ float(x), 0.5f * float(std::abs( x )) - 3.f, float(z) };
+                };
+                Vec3f const quad[] = { p( i, j ), p( i + 2, j ), p( i + 2, j + 2 ), p( i, j ), p( i + 2, j + 2 ), p( i, j + 2 ) };
+                mesh.insert( mesh.end(), std::begin( quad ), std::end( quad ) );
+            }
+        }
+        return bakeHeightfield( mesh, 161 );
+    }
+
+    // Alive lifetimes, sorted (for comparing updates that order particles
+    // differently)
+    std::vector<float> sorted_life( ParticleSim const& aSim )
+    {
+        std::vector<float> ret( aSim.life.begin(), aSim.life.begin() + aSim.aliveCount );
+        std::sort( ret.begin(), ret.end() );
+        return ret;
+    }
+}
+
+TEST_CASE( "Particle storage", "[particles]" )
+{
+    auto sim = make_sim();
+    REQUIRE( 0 == sim->aliveCount );
+
+    SECTION( "Emission appends exactly the particles it needs" )
+    {
+        sim->emitters[0].rate = 1000.f;
+        emitParticles( *sim, 0.1f );
+        REQUIRE( 100 == sim->aliveCount );
+
+        emitParticles( *sim, 0.05f );
+        REQUIRE( 150 == sim->aliveCount );
+
+        for( int i = 0; i < sim->aliveCount; ++i )
+            REQUIRE( sim->life[i] > 0.f );
+    }
+
+    SECTION( "Dead particles are removed, the rest stay dense" )
+    {
+        sim->emitters[0].rate = 1000.f;
+        emitParticles( *sim, 0.1f );
+
+        // Kill every other particle through the ground test; remember the
+        // survivors by their velocity
+        std::vector<float> survivors;
+        for( int i = 0; i < 100; ++i )
+        {
+            if( i % 2 )
+                sim->py[i] = -100.f;
+            else
+                survivors.push_back( sim->vx[i] );
+        }
+
+        updateParticles( *sim, 0.001f );
+        REQUIRE( 50 == sim->aliveCount );
+
+        std::vector<float> alive;
+        for( int i = 0; i < sim->aliveCount; ++i )
+        {
+            REQUIRE( sim->py[i] > -0.98f );
+            alive.push_back( sim->vx[i] );
+        }
+
+        std::sort( survivors.begin(), survivors.end() );
+        std::sort( alive.begin(), alive.end() );
+        REQUIRE( survivors == alive );
+
+        // Lifetimes are at most 1.2 s
+        updateParticles( *sim, 2.f );
+        REQUIRE( 0 == sim->aliveCount );
+    }
+
+    SECTION( "A full pool drops new particles" )
+    {
+        sim->emitters[0].rate = float(kMaxParticles) + 500.f;
+        emitParticles( *sim, 1.f );
+        REQUIRE( kMaxParticles == sim->aliveCount );
+
+        emitParticles( *sim, 1.f );
+        REQUIRE( kMaxParticles == sim->aliveCount );
+    }
+}
+
+TEST_CASE( "Particle emitters", "[particles]" )
+{
+    ParticleSim sim( 1000 );
+
+    auto low = exhaust_emitter( 800 );
+    low.rate = 600.f;
+    low.priority = 0;
+    auto high = exhaust_emitter( 800 );
+    high.rate = 600.f;
+    high.priority = 1;
+    high.lifeMin = high.lifeMax = 0.5f;
+
+    int const lowId = addEmitter( sim, low );
+    int const highId = addEmitter( sim, high );
+    REQUIRE( 0 == lowId );
+    REQUIRE( 1 == highId );
+    REQUIRE( 1600 == particleCapacityFor( sim ) );
+
+    SECTION( "Higher priority is served first, lower is throttled" )
+    {
+        emitParticles( sim, 1.f );
+        REQUIRE( 1000 == sim.aliveCount );
+        REQUIRE( 600 == sim.emitters[highId].alive );
+        REQUIRE( 400 == sim.emitters[lowId].alive );
+        REQUIRE( 0 == sim.emitters[highId].throttled );
+        REQUIRE( 200 == sim.emitters[lowId].throttled );
+
+        REQUIRE( 600 == count_emitter( sim, highId ) );
+        REQUIRE( 400 == count_emitter( sim, lowId ) );
+
+        // Per-emitter lifetimes
+        for( int i = 0; i < sim.aliveCount; ++i )
+        {
+            if( highId == sim.emitterOf[i] )
+                REQUIRE( 0.5f == sim.life[i] );
+            else
+                REQUIRE( (sim.life[i] >= 0.6f && sim.life[i] <= 1.2f) );
+        }
+
+        // High priority particles die first; their slots go to them again
+        updateParticles( sim, 0.55f );
+        REQUIRE( 0 == sim.emitters[highId].alive );
+        REQUIRE( 400 == sim.emitters[lowId].alive );
+
+        emitParticles( sim, 1.f );
+        REQUIRE( 600 == sim.emitters[highId].alive );
+        REQUIRE( 400 == sim.emitters[lowId].alive );
+        REQUIRE( 800 == sim.emitters[lowId].throttled );
+    }
+
+    SECTION( "Budgets limit each emitter" )
+    {
+        sim.emitters[highId].budget = 100;
+        emitParticles( sim, 1.f );
+        REQUIRE( 100 == sim.emitters[highId].alive );
+        REQUIRE( 600 == sim.emitters[lowId].alive );
+        REQUIRE( 700 == sim.aliveCount );
+        REQUIRE( 500 == sim.emitters[highId].throttled );
+    }
+
+    SECTION( "Inactive emitters don't emit" )
+    {
+        sim.emitters[lowId].active = false;
+        emitParticles( sim, 1.f );
+        REQUIRE( 600 == sim.aliveCount );
+        REQUIRE( 0 == sim.emitters[lowId].alive );
+    }
+
+    SECTION( "Resizing keeps the counts consistent" )
+    {
+        emitParticles( sim, 1.f );
+        resizeParticles( sim, 700 );
+        REQUIRE( 700 == sim.capacity );
+        REQUIRE( 700 == sim.aliveCount );
+        REQUIRE( sim.emitters[highId].alive == count_emitter( sim, highId ) );
+        REQUIRE( sim.emitters[lowId].alive == count_emitter( sim, lowId ) );
+
+        // 600 + 100 alive; both emitters up to their budget
+        resizeParticles( sim, particleCapacityFor( sim ) );
+        emitParticles( sim, 1.f );
+        REQUIRE( 800 == sim.emitters[highId].alive );
+        REQUIRE( 700 == sim.emitters[lowId].alive );
+        REQUIRE( 1500 == sim.aliveCount );
+    }
+}
+
+TEST_CASE( "Particle emission is reproducible", "[particles]" )
+{
+    auto a = make_sim(), b = make_sim();
+    seedParticles( *a, 99 );
+    seedParticles( *b, 99 );
+
+    for( int frame = 0; frame < 10; ++frame )
+    {
+        emitParticles( *a, 1.f / 60.f );
+        emitParticles( *b, 1.f / 60.f );
+        updateParticles( *a, 1.f / 60.f );
+        updateParticles( *b, 1.f / 60.f );
+    }
+
+    REQUIRE( a->aliveCount > 0 );
+    REQUIRE( a->aliveCount == b->aliveCount );
+
+    std::size_t const bytes = std::size_t(a->aliveCount) * sizeof(float);
+    REQUIRE( 0 == std::memcmp( a->px.data(), b->px.data(), bytes ) );
+    REQUIRE( 0 == std::memcmp( a->vz.data(), b->vz.data(), bytes ) );
+    REQUIRE( 0 == std::memcmp( a->life.data(), b->life.data(), bytes ) );
+
+    // Different stream, different particles
+    auto c = make_sim();
+    seedParticles( *c, 99, 1 );
+    emitParticles( *c, 1.f / 60.f );
+    REQUIRE( c->px[0] != a->px[0] );
+}
+
+TEST_CASE( "SIMD particle update", "[particles]" )
+{
+    auto simd = make_sim();
+    simd->emitters[0].rate = 30000.f;
+
+    // Some particles start close to the ground, so that both ways of dying
+    // are covered. Odd counts exercise the scalar tail.
+    emitParticles( *simd, 1.f / 3.f );
+    for( int i = 0; i < simd->aliveCount; i += 3 )
+        simd->py[i] = -0.95f;
+    simd->aliveCount -= 3;
+
+    auto scalar = std::make_unique<ParticleSim>( *simd );
+
+    for( int frame = 0; frame < 90; ++frame )
+    {
+        updateParticles( *simd, 1.f / 60.f );
+        updateParticlesScalar( *scalar, 1.f / 60.f );
+
+        REQUIRE( scalar->aliveCount == simd->aliveCount );
+
+        std::size_t const bytes = std::size_t(simd->aliveCount) * sizeof(float);
+        REQUIRE( 0 == std::memcmp( simd->px.data(), scalar->px.data(), bytes ) );
+        REQUIRE( 0 == std::memcmp( simd->py.data(), scalar->py.data(), bytes ) );
+        REQUIRE( 0 == std::memcmp( simd->pz.data(), scalar->pz.data(), bytes ) );
+        REQUIRE( 0 == std::memcmp( simd->vy.data(), scalar->vy.data(), bytes ) );
+        REQUIRE( 0 == std::memcmp( simd->life.data(), scalar->life.data(), bytes ) );
+    }
+
+    // Everything has died by now
+    REQUIRE( 0 == simd->aliveCount );
+}
+
+TEST_CASE( "Parallel particle update", "[particles]" )
+{
+    // Several chunks, the last one partial
+    int const capacity = 3 * kParticleChunk + 1000;
+
+    auto serial = make_sim( capacity );
+    serial->emitters[0].rate = float(capacity);
+    emitParticles( *serial, 1.f );
+    REQUIRE( capacity == serial->aliveCount );
+
+    // Some particles die on the ground in the first frame
+    for( int i = 0; i < serial->aliveCount; i += 7 )
+        serial->py[i] = -0.975f;
+
+    auto one = std::make_unique<ParticleSim>( *serial );
+    auto many = std::make_unique<ParticleSim>( *serial );
+
+    ThreadPool onePool( 1 ), manyPool( 3 );
+
+    for( int frame = 0; frame < 80; ++frame )
+    {
+        updateParticles( *serial, 1.f / 60.f );
+        updateParticlesParallel( *one, 1.f / 60.f, onePool );
+        updateParticlesParallel( *many, 1.f / 60.f, manyPool );
+
+        // Same particles as the serial update, in a different order
+        REQUIRE( serial->aliveCount == many->aliveCount );
+        REQUIRE( sorted_life( *serial ) == sorted_life( *many ) );
+
+        // The order does not depend on the number of threads
+        REQUIRE( one->aliveCount == many->aliveCount );
+        std::size_t const bytes = std::size_t(many->aliveCount) * sizeof(float);
+        REQUIRE( 0 == std::memcmp( one->px.data(), many->px.data(), bytes ) );
+        REQUIRE( 0 == std::memcmp( one->vy.data(), many->vy.data(), bytes ) );
+        REQUIRE( 0 == std::memcmp( one->life.data(), many->life.data(), bytes ) );
+
+        for( int i = 0; i < many->aliveCount; ++i )
+            REQUIRE( many->life[i] > 0.f );
+
+        REQUIRE( serial->emitters[0].alive == serial->aliveCount );
+        REQUIRE( many->emitters[0].alive == many->aliveCount );
+    }
+
+    // Everything has died by now
+    REQUIRE( 0 == many->aliveCount );
+}
+
+TEST_CASE( "Particle ground collision", "[particles]" )
+{
+    auto const ground = valley_heightfield();
+
+    // Exhaust blowing down into the valley, living long enough to land
+    auto simd = make_sim( 2 * kParticleChunk + 100 );
+    simd->ground.heightfield = &ground;
+    simd->emitters[0].prevPos = { -4.f, 0.f, 0.f };
+    simd->emitters[0].pos = { 4.f, 0.f, 0.f };
+    simd->emitters[0].lifeMin = 2.f;
+    simd->emitters[0].lifeMax = 3.f;
+    simd->emitters[0].rate = 30000.f;
+
+    auto scalar = std::make_unique<ParticleSim>( *simd );
+    auto parallel = std::make_unique<ParticleSim>( *simd );
+    ThreadPool pool( 3 );
+
+    bool bounced = false, belowPlane = false;
+    for( int frame = 0; frame < 120; ++frame )
+    {
+        emitParticles( *simd, 1.f / 60.f );
+        emitParticles( *scalar, 1.f / 60.f );
+        emitParticles( *parallel, 1.f / 60.f );
+
+        updateParticles( *simd, 1.f / 60.f );
+        updateParticlesScalar( *scalar, 1.f / 60.f );
+        updateParticlesParallel( *parallel, 1.f / 60.f, pool );
+
+        REQUIRE( scalar->aliveCount == simd->aliveCount );
+
+        std::size_t const bytes = std::size_t(simd->aliveCount) * sizeof(float);
+        REQUIRE( 0 == std::memcmp( simd->px.data(), scalar->px.data(), bytes ) );
+        REQUIRE( 0 == std::memcmp( simd->py.data(), scalar->py.data(), bytes ) );
+        REQUIRE( 0 == std::memcmp( simd->pz.data(), scalar->pz.data(), bytes ) );
+        REQUIRE( 0 == std::memcmp( simd->vx.data(), scalar->vx.data(), bytes ) );
+        REQUIRE( 0 == std::memcmp( simd->vy.data(), scalar->vy.data(), bytes ) );
+        REQUIRE( 0 == std::memcmp( simd->vz.data(), scalar->vz.data(), bytes ) );
+
+        REQUIRE( sorted_life( *simd ) == sorted_life( *parallel ) );
+
+        // Nothing ends up inside the terrain
+        for( int i = 0; i < simd->aliveCount; ++i )
+        {
+            REQUIRE( simd->py[i] >= sampleHeight( ground, simd->px[i], simd->pz[i] ) );
+            bounced = bounced || simd->vy[i] > 0.f;
+            belowPlane = belowPlane || simd->py[i] < -0.98f;
+        }
+    }
+
+    // Particles bounce instead of dying, and the fixed plane is gone
+    REQUIRE( bounced );
+    REQUIRE( belowPlane );
+    REQUIRE( simd->aliveCount > kParticleChunk );
+}
+
+TEST_CASE( "Particle depth sort", "[particles]" )
+{
+    auto sim = make_sim( 3 * kParticleChunk );
+    sim->emitters[0].rate = float(sim->capacity);
+    emitParticles( *sim, 1.f );
+    REQUIRE( sim->capacity == sim->aliveCount );
+
+    ThreadPool pool( 2 );
+
+    // Looking along -z from z = 20: depth is 20 - z (computed like in the
+    // sort, so that rounding is the same)
+    Vec4f depthRow{ 0.f, 0.f, -1.f, 20.f };
+    auto depth = [&] ( std::uint32_t aI ) {
+        return depthRow.x * sim->px[aI] + depthRow.y * sim->py[aI] + depthRow.z * sim->pz[aI] + depthRow.w;
+    };
+
+    auto order = sortParticlesBackToFront( *sim, sim->aliveCount, depthRow, pool );
+    REQUIRE( std::size_t(sim->aliveCount) == order.size() );
+
+    std::vector<bool> seen( order.size() );
+    for( std::size_t i = 0; i < order.size(); ++i )
+    {
+        REQUIRE( !seen[order[i]] );
+        seen[order[i]] = true;
+
+        if( i > 0 )
+            REQUIRE( depth( order[i-1] ) >= depth( order[i] ) ); // farthest first
+    }
+
+    // A subset, seen from the other side
+    depthRow = { 0.f, 0.f, 1.f, 20.f };
+    order = sortParticlesBackToFront( *sim, 1000, depthRow, pool );
+    REQUIRE( 1000 == order.size() );
+    for( std::size_t i = 1; i < order.size(); ++i )
+    {
+        REQUIRE( order[i] < 1000 );
+        REQUIRE( depth( order[i-1] ) >= depth( order[i] ) );
+    }
+
+    SECTION( "A time offset sorts the moved particles" )
+    {
+        float const offset = -0.01f;
+
+        // Same as moving them first (computed the same way)
+        auto moved = std::make_unique<ParticleSim>( *sim );
+        for( int i = 0; i < sim->aliveCount; ++i )
+        {
+            moved->px[i] = sim->px[i] + sim->vx[i] * offset;
+            moved->py[i] = sim->py[i] + sim->vy[i] * offset;
+            moved->pz[i] = sim->pz[i] + sim->vz[i] * offset;
+        }
+
+        auto const expected = sortParticlesBackToFront( *moved, moved->aliveCount, depthRow, pool );
+        auto const offsetOrder = sortParticlesBackToFront( *sim, sim->aliveCount, depthRow, pool, offset );
+        REQUIRE( std::equal( expected.begin(), expected.end(), offsetOrder.begin(), offsetOrder.end() ) );
+        REQUIRE( !std::equal( expected.begin(), expected.end(), sortParticlesBackToFront( *sim, sim->aliveCount, depthRow, pool ).begin() ) );
+    }
+}
+
+TEST_CASE( "Packed particle vertices", "[particles]" )
+{
+    // Not a multiple of the SIMD width
+    int const count = 3 * kParticleChunk + 5;
+
+    auto sim = make_sim( count );
+    addEmitter( *sim, exhaust_emitter( count ) );
+    sim->emitters[0].rate = float(count / 2);
+    sim->emitters[1].rate = float(count - count / 2);
+    sim->emitters[1].pos = { 5.f, -3.f, 2.f };
+    sim->emitters[1].sizeScale = 1.5f;
+    emitParticles( *sim, 1.f );
+    REQUIRE( count == sim->aliveCount );
+
+    auto bounds = particleVertexBounds( *sim, count );
+    for( int i = 0; i < count; ++i )
+    {
+        // Like in the packing, relative to the minimum
+        REQUIRE( sim->px[i] - bounds.min.x >= 0.f );
+        REQUIRE( sim->px[i] - bounds.min.x <= bounds.extent.x );
+        REQUIRE( sim->py[i] - bounds.min.y >= 0.f );
+        REQUIRE( sim->py[i] - bounds.min.y <= bounds.extent.y );
+        REQUIRE( sim->pz[i] - bounds.min.z >= 0.f );
+        REQUIRE( sim->pz[i] - bounds.min.z <= bounds.extent.z );
+    }
+
+    std::vector<std::uint16_t> x( count ), y( count ), z( count );
+    std::vector<std::uint32_t> words( count );
+    packParticleVertices( *sim, count, bounds, x.data(), y.data(), z.data(), words.data() );
+
+    SECTION( "SIMD and scalar packing agree" )
+    {
+        std::vector<std::uint16_t> sx( count ), sy( count ), sz( count );
+        std::vector<std::uint32_t> swords( count );
+        packParticleVerticesScalar( *sim, count, bounds, sx.data(), sy.data(), sz.data(), swords.data() );
+
+        REQUIRE( x == sx );
+        REQUIRE( y == sy );
+        REQUIRE( z == sz );
+        REQUIRE( words == swords );
+    }
+
+    SECTION( "A time offset moves particles along their velocity" )
+    {
+        float const offset = -0.01f;
+
+        auto bounds2 = particleVertexBounds( *sim, count, offset );
+        std::vector<std::uint16_t> ox( count ), oy( count ), oz( count );
+        std::vector<std::uint32_t> owords( count );
+        packParticleVertices( *sim, count, bounds2, ox.data(), oy.data(), oz.data(), owords.data(), offset );
+
+        // Same as moving them first (computed the same way)
+        ParticleSim moved = *sim;
+        for( int i = 0; i < count; ++i )
+        {
+            moved.px[i] = sim->px[i] + sim->vx[i] * offset;
+            moved.py[i] = sim->py[i] + sim->vy[i] * offset;
+            moved.pz[i] = sim->pz[i] + sim->vz[i] * offset;
+        }
+        auto movedBounds = particleVertexBounds( moved, count );
+        REQUIRE( movedBounds.min.x == bounds2.min.x );
+        REQUIRE( movedBounds.extent.z == bounds2.extent.z );
+
+        packParticleVertices( moved, count, movedBounds, x.data(), y.data(), z.data(), words.data() );
+        REQUIRE( x == ox );
+        REQUIRE( y == oy );
+        REQUIRE( z == oz );
+        REQUIRE( words == owords );
+    }
+
+    SECTION( "Positions are rounded to the nearest step" )
+    {
+        // In steps of extent / 65535 from the minimum (plus float rounding)
+        auto error = [] ( std::uint16_t aQ, float aP, float aMin, float aExtent ) {
+            return std::abs( float(aQ) - (aP - aMin) / aExtent * 65535.f );
+        };
+
+        for( int i = 0; i < count; ++i )
+        {
+            REQUIRE( error( x[i], sim->px[i], bounds.min.x, bounds.extent.x ) <= 0.51f );
+            REQUIRE( error( y[i], sim->py[i], bounds.min.y, bounds.extent.y ) <= 0.51f );
+            REQUIRE( error( z[i], sim->pz[i], bounds.min.z, bounds.extent.z ) <= 0.51f );
+        }
+    }
+
+    SECTION( "Words hold the emitter, life, size and rotation" )
+    {
+        for( int i = 0; i < count; ++i )
+        {
+            std::uint32_t const w = words[i];
+            REQUIRE( sim->emitterOf[i] == (w & 0xf) );
+
+            float life = float((w >> 4) & 0xfff) / kPackedLifeScale;
+            REQUIRE( life <= sim->life[i] );
+            REQUIRE( life > sim->life[i] - 1.f / kPackedLifeScale );
+
+            std::uint32_t size = (w >> 16) & 0xff;
+            REQUIRE( size == (0 == sim->emitterOf[i] ? 64u : 96u) );
+
+            std::uint32_t rotation = w >> 24;
+            REQUIRE( rotation == (std::uint32_t(sim->life[i] * 256.f * kParticleSpin) & 0xff) );
+        }
+    }
+}
+
+TEST_CASE( "Particle budget", "[particles]" )
+{
+    ParticleView const views[] = { test_view() };
+    ParticleView const& view = views[0];
+
+    SECTION( "Projected size" )
+    {
+        float expected = 5.f * view.projScaleY / 100.f * 360.f;
+        REQUIRE( std::abs( projectedRadiusPx( view, { { 0.f, 0.f, -100.f }, 5.f } ) - expected ) < 1e-3f * expected );
+
+        // Partly visible at the side
+        REQUIRE( projectedRadiusPx( view, { { 105.f, 0.f, -100.f }, 10.f } ) > 0.f );
+
+        // Behind the camera, beyond the side or the far plane
+        REQUIRE( 0.f == projectedRadiusPx( view, { { 0.f, 0.f, 100.f }, 5.f } ) );
+        REQUIRE( 0.f == projectedRadiusPx( view, { { 500.f, 0.f, -100.f }, 5.f } ) );
+        REQUIRE( 0.f == projectedRadiusPx( view, { { 0.f, 0.f, -2000.f }, 5.f } ) );
+
+        // Camera inside
+        REQUIRE( std::isinf( projectedRadiusPx( view, { { 0.f, 0.f, -10.f }, 20.f } ) ) );
+    }
+
+    SECTION( "Distant emitters emit less, with larger points" )
+    {
+        ParticleSim sim( 0 );
+        int near = addEmitter( sim, point_emitter( { 0.f, 0.f, -20.f } ) );
+        int far  = addEmitter( sim, point_emitter( { 0.f, 0.f, -400.f } ) );
+
+        ParticleBudgetConfig config;
+        config.maxFillPixels = 1e12;
+        ParticleBudgetStats stats = applyParticleBudget( sim, views, config );
+        REQUIRE( 0 == stats.limited );
+        REQUIRE( stats.fill == stats.requestedFill );
+
+        ParticleEmitter& n = sim.emitters[near];
+        ParticleEmitter& f = sim.emitters[far];
+        REQUIRE( 1.f == n.lod );
+        REQUIRE( 1.f == n.sizeScale );
+        REQUIRE( f.lod < 1.f );
+        REQUIRE( f.lod >= config.minLod );
+        REQUIRE( f.sizeScale > 1.f );
+        REQUIRE( f.sizeScale <= config.maxSizeScale );
+
+        // The rate is scaled
+        int count = takeEmissionCount( f, 1.f );
+        REQUIRE( std::abs( float(count) - f.rate * f.lod ) <= 1.f );
+    }
+
+    SECTION( "Emitters outside all views run at the minimum" )
+    {
+        ParticleSim sim( 0 );
+        addEmitter( sim, point_emitter( { 0.f, 0.f, 100.f } ) );
+
+        ParticleBudgetConfig config;
+        ParticleBudgetStats stats = applyParticleBudget( sim, views, config );
+        REQUIRE( config.minLod == sim.emitters[0].lod );
+        REQUIRE( 0.0 == stats.fill );
+
+        // Without views, everything is back at full detail
+        applyParticleBudget( sim, {}, config );
+        REQUIRE( 1.f == sim.emitters[0].lod );
+        REQUIRE( 1.f == sim.emitters[0].sizeScale );
+    }
+
+    SECTION( "Over the fill budget, lower priorities are cut first" )
+    {
+        ParticleSim sim( 0 );
+        int high = addEmitter( sim, point_emitter( { 0.f, 0.f, -20.f }, 1 ) );
+        int low  = addEmitter( sim, point_emitter( { 1.f, 0.f, -20.f }, 0 ) );
+
+        ParticleBudgetConfig config;
+        config.maxFillPixels = 1e12;
+        double requested = applyParticleBudget( sim, views, config ).requestedFill;
+
+        config.maxFillPixels = 0.75 * requested;
+        ParticleBudgetStats stats = applyParticleBudget( sim, views, config );
+        REQUIRE( 1 == stats.limited );
+        REQUIRE( stats.requestedFill == requested );
+        REQUIRE( std::abs( stats.fill - config.maxFillPixels ) < 1e-3 * config.maxFillPixels );
+
+        REQUIRE( 1.f == sim.emitters[high].lod );
+        REQUIRE( sim.emitters[low].lod < 1.f );
+        REQUIRE( 1.f == sim.emitters[low].sizeScale );
+
+        // Both at the minimum is not enough: points get smaller
+        config.maxFillPixels = 0.01 * requested;
+        stats = applyParticleBudget( sim, views, config );
+        REQUIRE( 2 == stats.limited );
+        REQUIRE( config.minLod == sim.emitters[high].lod );
+        REQUIRE( config.minLod == sim.emitters[low].lod );
+        REQUIRE( sim.emitters[high].sizeScale < 1.f );
+        REQUIRE( stats.fill <= 1.001 * config.maxFillPixels );
+    }
+}
+
+TEST_CASE( "Particle emission benchmark", "[particles][benchmark]" )
+{
+    auto sim = make_sim();
+
+    // Pool filled up; every allocation fails
+    sim->emitters[0].rate = float(kMaxParticles);
+    emitParticles( *sim, 1.f );
+    REQUIRE( kMaxParticles == sim->aliveCount );
+
+    sim->emitters[0].rate = 15000.f;
+    BENCHMARK( "emitParticles, full pool" )
+    {
+        emitParticles( *sim, 1.f / 60.f );
+        return sim->aliveCount;
+    };
+
+    // Saturated steady state: particles die and are replaced every frame
+    sim->emitters[0].rate = 200000.f;
+    for( int i = 0; i < 120; ++i )
+    {
+        updateParticles( *sim, 1.f / 60.f );
+        emitParticles( *sim, 1.f / 60.f );
+    }
+
+    BENCHMARK( "updateParticles + emitParticles, saturated pool" )
+    {
+        updateParticles( *sim, 1.f / 60.f );
+        emitParticles( *sim, 1.f / 60.f );
+        return sim->aliveCount;
+    };
+
+    // Update throughput with a full pool (nothing dies)
+    for( int i = 0; i < sim->aliveCount; ++i )
+        sim->life[i] = 1e6f;
+
+    BENCHMARK( "updateParticles, full pool" )
+    {
+        updateParticles( *sim, 1e-6f );
+        return sim->aliveCount;
+    };
+    BENCHMARK( "updateParticlesScalar, full pool" )
+    {
+        updateParticlesScalar( *sim, 1e-6f );
+        return sim->aliveCount;
+    };
+
+    // With heightfield collisions (same cost whether particles touch the
+    // ground or not)
+    auto const ground = valley_heightfield();
+    sim->ground.heightfield = &ground;
+    BENCHMARK( "updateParticles, full pool, heightfield" )
+    {
+        updateParticles( *sim, 1e-6f );
+        return sim->aliveCount;
+    };
+    sim->ground.heightfield = nullptr;
+
+    // Vertex packing for the upload (10 bytes per particle)
+    std::vector<std::uint16_t> positions( 3 * kMaxParticles );
+    std::vector<std::uint32_t> words( kMaxParticles );
+    BENCHMARK( "particleVertexBounds + packParticleVertices, full pool" )
+    {
+        auto bounds = particleVertexBounds( *sim, sim->aliveCount );
+        packParticleVertices( *sim, sim->aliveCount, bounds, positions.data(), positions.data() + kMaxParticles, positions.data() + 2 * kMaxParticles, words.data() );
+        return words[0];
+    };
+    BENCHMARK( "packParticleVerticesScalar, full pool" )
+    {
+        auto bounds = particleVertexBounds( *sim, sim->aliveCount );
+        packParticleVerticesScalar( *sim, sim->aliveCount, bounds, positions.data(), positions.data() + kMaxParticles, positions.data() + 2 * kMaxParticles, words.data() );
+        return words[0];
+    };
+    BENCHMARK( "memcpy of unpacked positions, full pool" )
+    {
+        std::vector<float> copy( 3 * kMaxParticles );
+        std::memcpy( copy.data(), sim->px.data(), kMaxParticles * sizeof(float) );
+        std::memcpy( copy.data() + kMaxParticles, sim->py.data(), kMaxParticles * sizeof(float) );
+        std::memcpy( copy.data() + 2 * kMaxParticles, sim->pz.data(), kMaxParticles * sizeof(float) );
+        return copy[0];
+    };
+
+    // Few particles: the cost should not depend on the pool's capacity
+    resetParticles( *sim );
+    sim->emitters[0].rate = 500.f;
+    for( int i = 0; i < 120; ++i )
+    {
+        updateParticles( *sim, 1.f / 60.f );
+        emitParticles( *sim, 1.f / 60.f );
+    }
+
+    BENCHMARK( "updateParticles + emitParticles, ~500 alive" )
+    {
+        updateParticles( *sim, 1.f / 60.f );
+        emitParticles( *sim, 1.f / 60.f );
+        return sim->aliveCount;
+    };
+}
+
+// Not run by default (allocates ~250 MB). Run with "[particles][scaling]".
+TEST_CASE( "Parallel particle update scaling", "[.][particles][scaling]" )
+{
+    int const capacity = 4'000'000;
+
+    auto sim = make_sim( capacity );
+    sim->emitters[0].rate = float(capacity);
+    emitParticles( *sim, 1.f );
+    REQUIRE( capacity == sim->aliveCount );
+
+    // Nothing dies after the first frame
+    for( int i = 0; i < sim->aliveCount; ++i )
+        sim->life[i] = 1e6f;
+    for( int i = 0; i < sim->aliveCount; i += 1000 )
+        sim->life[i] = 0.f;
+
+    // 1 thread: the serial (SIMD) update
+    BENCHMARK( "updateParticles, 4M particles" )
+    {
+        updateParticles( *sim, 1e-6f );
+        return sim->aliveCount;
+    };
+
+    // The calling thread takes part in parallel_for(), so N threads need a
+    // pool with N-1 workers.
+    for( std::size_t threads : { 2, 4, 8, 16 } )
+    {
+        ThreadPool pool( threads - 1 );
+        BENCHMARK( "updateParticlesParallel, 4M particles, " + std::to_string( threads ) + " threads" )
+        {
+            updateParticlesParallel( *sim, 1e-6f, pool );
+            return sim->aliveCount;
+        };
+    }
+}
@@ -0,0 +1,119 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <bit>
+#include <limits>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include <cstdint>
+
+#include "../support/random.hpp"
+#include "../support/radix_sort.hpp"
+#include "../support/thread_pool.hpp"
+
+namespace
+{
+    std::vector<std::uint32_t> random_keys( std::size_t aCount, std::uint32_t aMask )
+    {
+        Xoshiro128Plus gen( aCount );
+        std::vector<std::uint32_t> ret( aCount );
+        for( auto& key : ret )
+            key = gen.next() & aMask;
+        return ret;
+    }
+
+    // Sorts and checks against std::stable_sort
+    void check_sort( std::vector<std::uint32_t> aKeys, ThreadPool& aPool )
+    {
+        std::vector<std::uint32_t> values( aKeys.size() );
+        std::iota( values.begin(), values.end(), 0u );
+
+        std::vector<std::uint32_t> expected = values;
+        std::stable_sort( expected.begin(), expected.end(), [&] (std::uint32_t aA, std::uint32_t aB) {
+            return aKeys[aA] < aKeys[aB];
+        } );
+
+        std::vector<std::uint32_t> keyScratch( aKeys.size() ), valueScratch( aKeys.size() );
+        auto const original = aKeys;
+        radix_sort( aKeys, values, keyScratch, valueScratch, aPool );
+
+        REQUIRE( std::is_sorted( aKeys.begin(), aKeys.end() ) );
+        REQUIRE( values == expected ); // stable
+        for( std::size_t i = 0; i < aKeys.size(); ++i )
+            REQUIRE( aKeys[i] == original[values[i]] );
+    }
+}
+
+TEST_CASE( "Radix sort", "[radix_sort]" )
+{
+    ThreadPool pool( 3 );
+
+    SECTION( "Empty and single element" )
+    {
+        check_sort( {}, pool );
+        check_sort( { 42u }, pool );
+    }
+
+    SECTION( "Random keys, several blocks" )
+    {
+        check_sort( random_keys( 100'003, ~0u ), pool );
+    }
+
+    SECTION( "Many equal keys (stability)" )
+    {
+        check_sort( random_keys( 70'000, 0xf ), pool );
+    }
+
+    SECTION( "Skipped passes" )
+    {
+        // Only the second byte differs: three of the four passes are
+        // skipped, so the result ends up in the scratch buffers first
+        auto keys = random_keys( 5'000, 0xff00 );
+        for( auto& key : keys )
+            key |= 0xab0000cd;
+        check_sort( keys, pool );
+
+        check_sort( std::vector<std::uint32_t>( 1000, 7u ), pool );
+    }
+
+    SECTION( "Float keys" )
+    {
+        float const values[] = { 3.f, -1.f, 0.f, -0.f, -1e30f, 1e30f, 0.5f,
+            std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+
+        std::vector<std::uint32_t> keys;
+        for( float v : values )
+            keys.push_back( radix_key_from_float( std::bit_cast<std::uint32_t>( v ) ) );
+
+        std::vector<std::uint32_t> order( keys.size() );
+        std::iota( order.begin(), order.end(), 0u );
+        std::vector<std::uint32_t> keyScratch( keys.size() ), valueScratch( keys.size() );
+        radix_sort( keys, order, keyScratch, valueScratch, pool );
+
+        for( std::size_t i = 1; i < order.size(); ++i )
+            REQUIRE( values[order[i-1]] <= values[order[i]] );
+    }
+}
+
+TEST_CASE( "Radix sort benchmark", "[radix_sort][benchmark]" )
+{
+    auto const keys = random_keys( 250'000, ~0u );
+    std::vector<std::uint32_t> k, v, ks( keys.size() ), vs( keys.size() );
+
+    ThreadPool pool( 3 );
+    BENCHMARK( "radix_sort, 250K keys" )
+    {
+        k = keys;
+        v.assign( keys.size(), 0u );
+        radix_sort( k, v, ks, vs, pool );
+        return k[0];
+    };
+
+    BENCHMARK( "std::sort, 250K keys" )
+    {
+        k = keys;
+        std::sort( k.begin(), k.end() );
+        return k[0];
+    };
+}
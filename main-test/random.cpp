@@ -0,0 +1,76 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <span>
+#include <vector>
+
+#include <cstdlib>
+
+#include "../support/random.hpp"
+
+TEST_CASE( "Xoshiro128Plus", "[random]" )
+{
+    SECTION( "Same seed, same sequence" )
+    {
+        Xoshiro128Plus a( 42 ), b( 42 ), c( 43 );
+
+        bool differs = false;
+        for( int i = 0; i < 100; ++i )
+        {
+            auto const x = a.next();
+            REQUIRE( x == b.next() );
+            differs = differs || x != c.next();
+        }
+        REQUIRE( differs );
+    }
+
+    SECTION( "Floats are in [0, 1) and roughly uniform" )
+    {
+        Xoshiro128Plus gen( 7 );
+
+        constexpr int kCount = 100000;
+        int buckets[10] = {};
+        for( int i = 0; i < kCount; ++i )
+        {
+            float const u = gen.uniform();
+            REQUIRE( u >= 0.f );
+            REQUIRE( u < 1.f );
+            ++buckets[int(u * 10.f)];
+        }
+
+        for( int b : buckets )
+            REQUIRE( std::abs( b - kCount / 10 ) < kCount / 100 );
+    }
+}
+
+TEST_CASE( "RandomStream", "[random]" )
+{
+    SECTION( "Lanes and streams are jumped generators" )
+    {
+        std::vector<float> values( 2 * RandomStream::kLanes );
+        RandomStream( 1234, 1 ).uniform( values );
+
+        Xoshiro128Plus gen( 1234 );
+        for( std::size_t i = 0; i < RandomStream::kLanes; ++i )
+            gen.jump();
+
+        for( std::size_t lane = 0; lane < RandomStream::kLanes; ++lane )
+        {
+            Xoshiro128Plus laneGen = gen;
+            REQUIRE( laneGen.uniform() == values[lane] );
+            REQUIRE( laneGen.uniform() == values[RandomStream::kLanes + lane] );
+            gen.jump();
+        }
+    }
+
+    SECTION( "Results don't depend on how the output is split" )
+    {
+        std::vector<float> whole( 64 ), parts( 64 );
+        RandomStream( 5 ).uniform( whole );
+
+        RandomStream split( 5 );
+        split.uniform( std::span( parts ).first( 16 ) );
+        split.uniform( std::span( parts ).subspan( 16 ) );
+
+        REQUIRE( whole == parts );
+    }
+}
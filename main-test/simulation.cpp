@@ -0,0 +1,157 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+#include "../main/simulation.hpp"
+#include "../main/particle_sim.hpp"
+#include "../support/thread_pool.hpp"
+
+namespace
+{
+    constexpr Vec3f kPad{ -11.5f, -0.96f, -54.f };
+    constexpr float kStep = 1.f / 60.f;
+
+    // Launch, then run for aSteps steps
+    std::uint64_t run_launch( int aSteps, ThreadPool& aPool )
+    {
+        ParticleSim particles( 0 );
+        SimulationState sim;
+        initSimulation( sim, particles, kPad );
+        sim.ufoAnim.active = true;
+        sim.camera.moveForward = true;
+
+        for( int i = 0; i < aSteps; ++i )
+            stepSimulation( sim, kStep, aPool );
+
+        return simulationChecksum( sim );
+    }
+}
+
+TEST_CASE( "Simulation", "[simulation]" )
+{
+    ThreadPool pool( 1 );
+
+    ParticleSim particles( 0 );
+    SimulationState sim;
+    initSimulation( sim, particles, kPad );
+
+    REQUIRE( particles.emitters.size() == 2 );
+    REQUIRE( particles.capacity == particleCapacityFor( particles ) );
+
+    SECTION( "Nothing moves before the launch" )
+    {
+        for( int i = 0; i < 30; ++i )
+        {
+            auto const step = stepSimulation( sim, kStep, pool );
+            REQUIRE( step.pose.position.y == ufoStartPosition( kPad ).y );
+        }
+        REQUIRE( 0 == particles.aliveCount );
+        REQUIRE( 0.f == sim.ufoAnim.time );
+    }
+
+    SECTION( "The launch emits exhaust and dust" )
+    {
+        sim.ufoAnim.active = true;
+
+        SimulationStep step;
+        for( int i = 0; i < 60; ++i )
+            step = stepSimulation( sim, kStep, pool );
+
+        REQUIRE( std::abs( sim.ufoAnim.time - 1.f ) < 1e-4f );
+        REQUIRE( step.pose.position.y > ufoStartPosition( kPad ).y );
+        REQUIRE( particles.emitters[sim.exhaustEmitter].alive > 0 );
+        REQUIRE( particles.emitters[sim.dustEmitter].alive > 0 );
+
+        // Far from the pad, no more dust
+        for( int i = 0; i < 6 * 60; ++i )
+            step = stepSimulation( sim, kStep, pool );
+        REQUIRE( step.pose.position.y - kPad.y > kDustHeight );
+        REQUIRE( !particles.emitters[sim.dustEmitter].active );
+        REQUIRE( 0 == particles.emitters[sim.dustEmitter].alive );
+
+        // The pool has room for both budgets
+        REQUIRE( 0 == particles.emitters[sim.exhaustEmitter].throttled );
+        REQUIRE( 0 == particles.emitters[sim.dustEmitter].throttled );
+    }
+
+    SECTION( "In a smaller pool, the dust is throttled first" )
+    {
+        ParticleSim small( 0 );
+        SimulationState smallSim;
+        initSimulation( smallSim, small, kPad, 12 * 1024 );
+        REQUIRE( 12 * 1024 == small.capacity );
+
+        smallSim.ufoAnim.active = true;
+
+        auto const& exhaust = small.emitters[smallSim.exhaustEmitter];
+        auto const& dust = small.emitters[smallSim.dustEmitter];
+
+        // Until the pool is full: the exhaust builds up while the dust is
+        // still kicked up
+        int peak = 0;
+        for( int i = 0; i < 4 * 60 && 0 == dust.throttled; ++i )
+        {
+            stepSimulation( smallSim, kStep, pool );
+            peak = std::max( peak, small.aliveCount );
+        }
+
+        REQUIRE( peak <= small.capacity );
+        REQUIRE( dust.throttled > 0 );
+        REQUIRE( dust.throttled > exhaust.throttled );
+    }
+
+    SECTION( "Pausing stops the animation and the particles" )
+    {
+        sim.ufoAnim.active = true;
+        for( int i = 0; i < 30; ++i )
+            stepSimulation( sim, kStep, pool );
+
+        sim.ufoAnim.paused = true;
+        auto const before = simulationChecksum( sim );
+        auto const step = stepSimulation( sim, kStep, pool );
+
+        REQUIRE( !step.advanceParticles );
+        REQUIRE( before == simulationChecksum( sim ) );
+    }
+
+    SECTION( "With GPU particles, only the emission count is taken" )
+    {
+        sim.ufoAnim.active = true;
+
+        std::uint32_t spawned = 0;
+        for( int i = 0; i < 60; ++i )
+        {
+            auto const step = stepSimulation( sim, kStep, pool, true );
+            REQUIRE( step.advanceParticles );
+            spawned += step.gpuSpawnCount;
+        }
+
+        REQUIRE( 0 == particles.aliveCount );
+        REQUIRE( std::abs( float(spawned) - 15000.f ) < 2.f ); // one second of exhaust
+    }
+
+    SECTION( "Stage timings are collected" )
+    {
+        sim.ufoAnim.active = true;
+
+        SimulationTimings timings;
+        for( int i = 0; i < 10; ++i )
+            stepSimulation( sim, kStep, pool, false, &timings );
+
+        REQUIRE( 10 == timings.steps );
+        REQUIRE( timings.update >= 0.0 );
+        REQUIRE( timings.emission > 0.0 );
+    }
+}
+
+TEST_CASE( "Simulation checksum", "[simulation]" )
+{
+    ThreadPool one( 1 ), many( 3 );
+
+    // Long enough for a busy pool
+    auto const a = run_launch( 240, one );
+    REQUIRE( a == run_launch( 240, one ) );
+    REQUIRE( a == run_launch( 240, many ) );
+    REQUIRE( a != run_launch( 239, one ) );
+}
@@ -0,0 +1,344 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+#include "../support/mapped_file.hpp"
+#include "../support/thread_pool.hpp"
+
+#include "../main/ktx2.hpp"
+#include "../main/texture_compress.hpp"
+
+// The encoders are checked against reference decoders written directly from
+// the format specifications (Khronos Data Format spec, sections "S3TC" and
+// "BPTC"). The decoders are deliberately independent of the encoder code.
+
+namespace
+{
+    using Block = std::array<std::uint8_t,64>; // 16 RGBA8 texels
+
+    Block decode_bc1_reference( std::uint8_t const* aBlock )
+    {
+        unsigned const c0 = aBlock[0] | (aBlock[1] << 8);
+        unsigned const c1 = aBlock[2] | (aBlock[3] << 8);
+
+        int pal[4][4];
+        auto const expand = [] ( unsigned aC, int* aOut ) {
+            aOut[0] = int(((aC >> 11) & 31) * 255 + 15) / 31;
+            aOut[1] = int(((aC >> 5) & 63) * 255 + 31) / 63;
+            aOut[2] = int((aC & 31) * 255 + 15) / 31;
+            aOut[3] = 255;
+        };
+        expand( c0, pal[0] );
+        expand( c1, pal[1] );
+
+        for( int c = 0; c < 3; ++c )
+        {
+            if( c0 > c1 )
+            {
+                pal[2][c] = (2*pal[0][c] + pal[1][c]) / 3;
+                pal[3][c] = (pal[0][c] + 2*pal[1][c]) / 3;
+            }
+            else
+            {
+                pal[2][c] = (pal[0][c] + pal[1][c]) / 2;
+                pal[3][c] = 0;
+            }
+        }
+        pal[2][3] = 255;
+        pal[3][3] = c0 > c1 ? 255 : 0;
+
+        Block ret{};
+        for( int i = 0; i < 16; ++i )
+        {
+            int const idx = (aBlock[4 + i/4] >> (2*(i%4))) & 3;
+            for( int c = 0; c < 4; ++c )
+                ret[4*i+c] = std::uint8_t(pal[idx][c]);
+        }
+        return ret;
+    }
+
+    struct BitReader
+    {
+        std::uint8_t const* bits;
+        unsigned pos = 0;
+
+        unsigned get( unsigned aCount )
+        {
+            unsigned ret = 0;
+            for( unsigned i = 0; i < aCount; ++i, ++pos )
+                ret |= unsigned((bits[pos/8] >> (pos%8)) & 1) << i;
+            return ret;
+        }
+    };
+
+    // Only mode 6 is implemented; anything else fails the test.
+    Block decode_bc7_reference( std::uint8_t const* aBlock )
+    {
+        BitReader br{ aBlock };
+
+        unsigned mode = 0;
+        while( mode < 8 && 0 == br.get( 1 ) )
+            ++mode;
+        REQUIRE( 6 == mode );
+
+        unsigned e[2][4];
+        for( int c = 0; c < 4; ++c )
+        {
+            e[0][c] = br.get( 7 );
+            e[1][c] = br.get( 7 );
+        }
+        unsigned const p0 = br.get( 1 ), p1 = br.get( 1 );
+        for( int c = 0; c < 4; ++c )
+        {
+            e[0][c] = (e[0][c] << 1) | p0;
+            e[1][c] = (e[1][c] << 1) | p1;
+        }
+
+        static constexpr unsigned kWeights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        Block ret{};
+        for( int i = 0; i < 16; ++i )
+        {
+            unsigned const idx = br.get( 0 == i ? 3 : 4 );
+            for( int c = 0; c < 4; ++c )
+                ret[4*i+c] = std::uint8_t( ((64 - kWeights[idx]) * e[0][c] + kWeights[idx] * e[1][c] + 32) >> 6 );
+        }
+
+        REQUIRE( 128 == br.pos );
+        return ret;
+    }
+
+    int max_error( Block const& aA, Block const& aB, int aChannels )
+    {
+        int ret = 0;
+        for( int i = 0; i < 16; ++i )
+        {
+            for( int c = 0; c < aChannels; ++c )
+                ret = std::max( ret, std::abs( int(aA[4*i+c]) - int(aB[4*i+c]) ) );
+        }
+        return ret;
+    }
+
+    // Smooth, "photo-like" test image with some detail in all channels
+    RgbaImage make_test_image( std::uint32_t aW, std::uint32_t aH, bool aAlpha )
+    {
+        RgbaImage ret{ aW, aH, std::vector<std::uint8_t>( std::size_t(aW) * aH * 4 ) };
+        for( std::uint32_t y = 0; y < aH; ++y )
+        {
+            for( std::uint32_t x = 0; x < aW; ++x )
+            {
+                auto* t = ret.texels.data() + 4*(std::size_t(y)*aW + x);
+                t[0] = std::uint8_t( 127.5 + 127.5 * std::sin( x * 0.11 + y * 0.03 ) );
+                t[1] = std::uint8_t( 127.5 + 100.0 * std::cos( y * 0.07 ) );
+                t[2] = std::uint8_t( (x * 3 + y * 5) % 256 < 128 ? 40 + (x+y) % 32 : 200 - (x*y) % 32 );
+                t[3] = aAlpha ? std::uint8_t( 255.0 * (0.5 + 0.5 * std::sin( (x + y) * 0.05 )) ) : 255;
+            }
+        }
+        return ret;
+    }
+
+    double psnr( RgbaImage const& aImage, std::vector<std::uint8_t> const& aBlocks, BlockFormat aFormat )
+    {
+        int const channels = BlockFormat::bc1 == aFormat ? 3 : 4;
+        std::uint32_t const bw = (aImage.width + 3) / 4;
+
+        double sse = 0.0;
+        std::size_t count = 0;
+        for( std::uint32_t y = 0; y < aImage.height; ++y )
+        {
+            for( std::uint32_t x = 0; x < aImage.width; ++x )
+            {
+                std::size_t const block = std::size_t(y/4) * bw + x/4;
+                auto const* data = aBlocks.data() + block * block_bytes( aFormat );
+                Block const decoded = BlockFormat::bc1 == aFormat ? decode_bc1_reference( data ) : decode_bc7_reference( data );
+
+                int const i = int((y%4) * 4 + x%4);
+                for( int c = 0; c < channels; ++c )
+                {
+                    double const d = double(decoded[4*i+c]) - aImage.texels[4*(std::size_t(y)*aImage.width + x) + c];
+                    sse += d * d;
+                    ++count;
+                }
+            }
+        }
+
+        return 10.0 * std::log10( 255.0 * 255.0 / (sse / double(count)) );
+    }
+}
+
+TEST_CASE( "BC1 encoder", "[texture][bc1]" )
+{
+    Block texels{};
+    std::uint8_t block[8];
+
+    SECTION( "Colours representable in RGB565 are exact" )
+    {
+        for( int i = 0; i < 16; ++i )
+        {
+            bool const red = (i * 7) % 3 == 0;
+            texels[4*i+0] = red ? 255 : 0;
+            texels[4*i+1] = 0;
+            texels[4*i+2] = red ? 0 : 255;
+            texels[4*i+3] = 255;
+        }
+
+        encode_bc1_block( texels.data(), block );
+        REQUIRE( 0 == max_error( texels, decode_bc1_reference( block ), 4 ) );
+    }
+
+    SECTION( "Solid block" )
+    {
+        for( int i = 0; i < 16; ++i )
+        {
+            texels[4*i+0] = 90;
+            texels[4*i+1] = 150;
+            texels[4*i+2] = 33;
+            texels[4*i+3] = 255;
+        }
+
+        encode_bc1_block( texels.data(), block );
+        REQUIRE( max_error( texels, decode_bc1_reference( block ), 3 ) <= 4 );
+    }
+
+    SECTION( "Gradient uses the four-colour mode" )
+    {
+        for( int i = 0; i < 16; ++i )
+        {
+            texels[4*i+0] = std::uint8_t( 16 * i );
+            texels[4*i+1] = std::uint8_t( 255 - 12 * i );
+            texels[4*i+2] = std::uint8_t( 64 + 4 * i );
+            texels[4*i+3] = 255;
+        }
+
+        encode_bc1_block( texels.data(), block );
+
+        unsigned const c0 = block[0] | (block[1] << 8);
+        unsigned const c1 = block[2] | (block[3] << 8);
+        REQUIRE( c0 > c1 );
+        REQUIRE( max_error( texels, decode_bc1_reference( block ), 3 ) <= 32 );
+    }
+}
+
+TEST_CASE( "BC7 encoder", "[texture][bc7]" )
+{
+    Block texels{};
+    std::uint8_t block[16];
+
+    SECTION( "Two colours with alpha are exact" )
+    {
+        for( int i = 0; i < 16; ++i )
+        {
+            bool const on = (i % 5) < 2;
+            texels[4*i+0] = on ? 254 : 0;
+            texels[4*i+1] = on ? 128 : 2;
+            texels[4*i+2] = on ? 36 : 200;
+            texels[4*i+3] = on ? 254 : 0;
+        }
+
+        encode_bc7_block( texels.data(), block );
+        REQUIRE( 0 == max_error( texels, decode_bc7_reference( block ), 4 ) );
+    }
+
+    SECTION( "Solid block is within one step" )
+    {
+        for( int i = 0; i < 16; ++i )
+        {
+            texels[4*i+0] = 10;
+            texels[4*i+1] = 11;
+            texels[4*i+2] = 200;
+            texels[4*i+3] = 77;
+        }
+
+        encode_bc7_block( texels.data(), block );
+        REQUIRE( max_error( texels, decode_bc7_reference( block ), 4 ) <= 1 );
+    }
+
+    SECTION( "Anchor index is encoded correctly" )
+    {
+        // Texel 0 lies at the "far" end, so the encoder has to swap the end
+        // points to make the implicit index bit zero.
+        for( int i = 0; i < 16; ++i )
+        {
+            std::uint8_t const v = std::uint8_t( 255 - 17 * i );
+            texels[4*i+0] = v;
+            texels[4*i+1] = v;
+            texels[4*i+2] = v;
+            texels[4*i+3] = std::uint8_t( 17 * i );
+        }
+
+        encode_bc7_block( texels.data(), block );
+        REQUIRE( max_error( texels, decode_bc7_reference( block ), 4 ) <= 4 );
+    }
+}
+
+TEST_CASE( "Whole image compression quality", "[texture]" )
+{
+    RgbaImage const opaque = make_test_image( 67, 45, false );
+    RgbaImage const alpha = make_test_image( 67, 45, true );
+
+    REQUIRE( !has_alpha( opaque ) );
+    REQUIRE( has_alpha( alpha ) );
+
+    auto const bc1 = compress_image( BlockFormat::bc1, opaque );
+    REQUIRE( bc1.size() == 17 * 12 * 8 );
+    CHECK( psnr( opaque, bc1, BlockFormat::bc1 ) > 32.0 );
+
+    auto const bc7 = compress_image( BlockFormat::bc7, alpha );
+    REQUIRE( bc7.size() == 17 * 12 * 16 );
+    CHECK( psnr( alpha, bc7, BlockFormat::bc7 ) > 34.0 );
+}
+
+TEST_CASE( "Mip chain", "[texture]" )
+{
+    REQUIRE( 1 == mip_level_count( 1, 1 ) );
+    REQUIRE( 4 == mip_level_count( 8, 8 ) );
+    REQUIRE( 7 == mip_level_count( 67, 45 ) );
+
+    CompressedImage const image = compress_with_mips( BlockFormat::bc7, make_test_image( 67, 45, true ), shared_thread_pool() );
+    REQUIRE( 7 == image.levels.size() );
+    for( std::uint32_t i = 0; i < image.levels.size(); ++i )
+    {
+        std::uint32_t const w = std::max( 67u >> i, 1u ), h = std::max( 45u >> i, 1u );
+        REQUIRE( image.levels[i].size() == compressed_size( BlockFormat::bc7, w, h ) );
+    }
+}
+
+TEST_CASE( "KTX2 round trip", "[texture][ktx2]" )
+{
+    auto const path = std::filesystem::temp_directory_path() / "comp3811-main-test.ktx2";
+    auto const pathStr = path.string();
+
+    for( auto const format : { BlockFormat::bc1, BlockFormat::bc7 } )
+    {
+        CompressedImage const image = compress_with_mips( format, make_test_image( 33, 17, BlockFormat::bc7 == format ), shared_thread_pool() );
+        REQUIRE( write_ktx2( pathStr.c_str(), image, "writer A" ) );
+
+        auto const loaded = read_ktx2( pathStr.c_str(), "writer A" );
+        REQUIRE( loaded );
+        REQUIRE( loaded->format == image.format );
+        REQUIRE( loaded->width == image.width );
+        REQUIRE( loaded->height == image.height );
+        REQUIRE( loaded->levels == image.levels );
+
+        // Memory mapped
+        {
+            MappedFile const file( pathStr.c_str() );
+            auto const view = parse_ktx2( file.bytes(), "writer A" );
+            REQUIRE( view );
+            REQUIRE( view->levels.size() == image.levels.size() );
+            for( std::size_t i = 0; i < image.levels.size(); ++i )
+                REQUIRE( std::ranges::equal( view->levels[i], image.levels[i] ) );
+        }
+
+        // Stale writer => cache miss
+        REQUIRE( !read_ktx2( pathStr.c_str(), "writer B" ) );
+    }
+
+    std::filesystem::remove( path );
+    REQUIRE( !read_ktx2( pathStr.c_str(), "writer A" ) );
+}
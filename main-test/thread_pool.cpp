@@ -0,0 +1,54 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <atomic>
+#include <vector>
+#include <stdexcept>
+
+#include "../support/thread_pool.hpp"
+
+TEST_CASE( "ThreadPool::parallel_for", "[thread_pool]" )
+{
+    ThreadPool pool( 4 );
+
+    SECTION( "Covers every index exactly once" )
+    {
+        for( std::size_t count : { 0u, 1u, 7u, 1000u } )
+        {
+            for( std::size_t grain : { 1u, 3u, 64u, 5000u } )
+            {
+                // (Catch2 assertions must not be used on the worker threads)
+                std::vector<std::atomic<int>> hits( count );
+                std::atomic<bool> oversized{ false };
+                pool.parallel_for( count, grain, [&] ( std::size_t aBegin, std::size_t aEnd ) {
+                    if( aEnd - aBegin > grain )
+                        oversized = true;
+                    for( std::size_t i = aBegin; i < aEnd; ++i )
+                        ++hits[i];
+                } );
+
+                REQUIRE( !oversized );
+                for( auto const& h : hits )
+                    REQUIRE( 1 == h.load() );
+            }
+        }
+    }
+
+    SECTION( "Nested calls don't deadlock" )
+    {
+        std::atomic<int> sum{ 0 };
+        pool.parallel_for( 16, 1, [&] ( std::size_t, std::size_t ) {
+            pool.parallel_for( 16, 1, [&] ( std::size_t, std::size_t ) {
+                ++sum;
+            } );
+        } );
+        REQUIRE( 256 == sum.load() );
+    }
+
+    SECTION( "Exceptions are rethrown" )
+    {
+        REQUIRE_THROWS_AS( pool.parallel_for( 100, 1, [] ( std::size_t aBegin, std::size_t ) {
+            if( 42 == aBegin )
+                throw std::runtime_error( "42" );
+        } ), std::runtime_error );
+    }
+}
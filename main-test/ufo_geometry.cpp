@@ -0,0 +1,44 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+#include <cstring>
+
+#include "../main/ufo_geometry.hpp"
+
+// kUfoVertices is generated entirely at compile time. Building the same mesh
+// at runtime must give exactly the same bits, otherwise the compile-time and
+// runtime code paths have drifted apart (e.g., a libm call snuck back in).
+
+TEST_CASE("Compile-time UFO mesh matches runtime build", "[ufo][mesh]")
+{
+    for( int lod = 0; lod < kUfoLodCount; ++lod )
+    {
+        SimpleMeshData const mesh = build_ufo_mesh_data( kUfoLodDetail[lod] );
+
+        REQUIRE( mesh.positions.size() == kUfoLodRanges[lod].count );
+        REQUIRE( mesh.positions.size() == ufo_vertex_count( kUfoLodDetail[lod] ) );
+
+        std::vector<UfoVertex> runtime( mesh.positions.size() );
+        interleave_ufo_vertices( mesh, runtime.data() );
+
+        auto const* embedded = kUfoVertices.data() + kUfoLodRanges[lod].first;
+        REQUIRE( 0 == std::memcmp( runtime.data(), embedded, runtime.size() * sizeof(UfoVertex) ) );
+    }
+}
+
+TEST_CASE("UFO LOD ranges cover the embedded mesh", "[ufo][mesh]")
+{
+    std::size_t next = 0;
+    for( int lod = 0; lod < kUfoLodCount; ++lod )
+    {
+        REQUIRE( kUfoLodRanges[lod].first == next );
+        next += kUfoLodRanges[lod].count;
+
+        // Coarser levels must be cheaper
+        if( lod > 0 )
+            REQUIRE( kUfoLodRanges[lod].count < kUfoLodRanges[lod-1].count );
+    }
+
+    REQUIRE( next == kUfoVertexCount );
+    REQUIRE( kUfoBounds.radius > 0.f );
+}
@@ -0,0 +1,193 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+#include <utility>
+#include <filesystem>
+
+#include "../support/thread_pool.hpp"
+#include "../support/mapped_file.hpp"
+
+#include "../main/mipmap.hpp"
+#include "../main/vt_cache.hpp"
+#include "../main/vt_pagefile.hpp"
+
+namespace
+{
+    RgbaImage gradient( std::uint32_t aW, std::uint32_t aH )
+    {
+        RgbaImage ret{ aW, aH, {} };
+        for( std::uint32_t y = 0; y < aH; ++y )
+        {
+            for( std::uint32_t x = 0; x < aW; ++x )
+                ret.texels.insert( ret.texels.end(), { std::uint8_t(x), std::uint8_t(y), std::uint8_t(x ^ y), 255 } );
+        }
+        return ret;
+    }
+}
+
+TEST_CASE( "Virtual texture layout", "[texture][vt]" )
+{
+    SECTION( "Levels go down to a single page" )
+    {
+        auto const layout = make_vt_layout( 1000, 300, 128, 4, BlockFormat::bc1 );
+
+        REQUIRE( 4 == layout.levelCount );
+        REQUIRE( 8 == layout.pages_x( 0 ) );
+        REQUIRE( 3 == layout.pages_y( 0 ) );
+        REQUIRE( 4 == layout.pages_x( 1 ) );
+        REQUIRE( 2 == layout.pages_y( 1 ) );
+        REQUIRE( 1 == layout.pages_x( 3 ) );
+        REQUIRE( 1 == layout.pages_y( 3 ) );
+
+        REQUIRE( 136 == layout.stored_page_size() );
+        REQUIRE( 34 * 34 * 8 == layout.page_bytes() );
+        REQUIRE( 24 + 8 + 2 + 1 == layout.page_count() );
+    }
+
+    SECTION( "Page indices are dense" )
+    {
+        auto const layout = make_vt_layout( 700, 500, 64, 2, BlockFormat::bc7 );
+
+        std::size_t expected = 0;
+        for( std::uint32_t level = 0; level < layout.levelCount; ++level )
+        {
+            for( std::uint32_t y = 0; y < layout.pages_y( level ); ++y )
+            {
+                for( std::uint32_t x = 0; x < layout.pages_x( level ); ++x )
+                    REQUIRE( expected++ == layout.page_index( level, x, y ) );
+            }
+        }
+        REQUIRE( expected == layout.page_count() );
+    }
+
+    SECTION( "Pages include a border, clamped at the image edges" )
+    {
+        auto const layout = make_vt_layout( 20, 20, 12, 2, BlockFormat::bc1 );
+        auto const image = gradient( 20, 20 );
+
+        auto const first = extract_vt_page( layout, image, 0, 0 );
+        REQUIRE( 16 == first.width );
+        REQUIRE( 0 == first.texels[0] );                 // clamped: texel (0,0)
+        REQUIRE( 0 == first.texels[(2*16 + 2)*4] );      // texel (0,0)
+        REQUIRE( 13 == first.texels[(2*16 + 15)*4] );    // texel (13,0), from the next page
+
+        auto const last = extract_vt_page( layout, image, 1, 1 );
+        REQUIRE( 10 == last.texels[0] );                 // texel (10,10)
+        REQUIRE( 19 == last.texels[(15*16 + 15)*4] );    // clamped: texel (19,19)
+        REQUIRE( 19 == last.texels[(15*16 + 15)*4 + 1] );
+    }
+}
+
+TEST_CASE( "Virtual texture page file", "[texture][vt]" )
+{
+    ThreadPool pool( 2 );
+
+    auto const image = gradient( 300, 200 );
+    auto const mips = build_srgb_mip_chain( image, pool );
+    auto const layout = make_vt_layout( 300, 200, 60, 2, BlockFormat::bc1 );
+
+    auto const path = std::filesystem::temp_directory_path() / "main-test-vt.vtpages";
+    REQUIRE( write_vt_pagefile( path.string().c_str(), layout, mips, pool, "test writer" ) );
+
+    {
+        MappedFile const file( path.string().c_str() );
+
+        REQUIRE( !parse_vt_pagefile( file.bytes(), "other writer" ) );
+        REQUIRE( !parse_vt_pagefile( file.bytes().first( file.bytes().size() - 1 ), "test writer" ) );
+
+        auto const parsed = parse_vt_pagefile( file.bytes(), "test writer" );
+        REQUIRE( parsed );
+        REQUIRE( layout.width == parsed->width );
+        REQUIRE( layout.height == parsed->height );
+        REQUIRE( layout.levelCount == parsed->levelCount );
+        REQUIRE( layout.format == parsed->format );
+
+        // Spot-check some pages against direct compression
+        for( std::uint32_t level = 0; level < layout.levelCount; ++level )
+        {
+            std::uint32_t const x = layout.pages_x( level ) - 1;
+            std::uint32_t const y = layout.pages_y( level ) / 2;
+
+            auto const expected = compress_image( layout.format, extract_vt_page( layout, mips[level], x, y ) );
+            auto const stored = vt_page_data( file.bytes(), *parsed, layout.page_index( level, x, y ) );
+            REQUIRE( std::vector<std::uint8_t>( stored.begin(), stored.end() ) == expected );
+        }
+    }
+
+    std::filesystem::remove( path );
+}
+
+TEST_CASE( "Virtual texture cache", "[texture][vt]" )
+{
+    // 4x4 pages on level 0, 2x2 on level 1, 1 on level 2
+    auto const layout = make_vt_layout( 256, 256, 64, 0, BlockFormat::bc1 );
+    REQUIRE( 3 == layout.levelCount );
+
+    VtCache cache( layout, 2, 2 );
+    REQUIRE( 4 == cache.page_table_columns() );
+    REQUIRE( 4 + 2 + 1 == cache.page_table_rows() );
+
+    auto const entry = [&] ( std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aY ) {
+        return cache.page_table()[(cache.row_offset( aLevel ) + aY) * cache.page_table_columns() + aX];
+    };
+
+    std::size_t const root = layout.page_index( 2, 0, 0 );
+    REQUIRE( 0 == *cache.insert( root, 1, true ) );
+
+    SECTION( "Missing pages fall back to resident ancestors" )
+    {
+        std::size_t const mid = layout.page_index( 1, 1, 0 );
+        REQUIRE( 1 == *cache.insert( mid, 1 ) );
+
+        REQUIRE( cache.update_page_table() );
+        REQUIRE( !cache.update_page_table() );
+
+        // Level 0 pages below the level 1 page
+        for( auto [x, y] : { std::pair{ 2u, 0u }, { 3u, 1u } } )
+        {
+            auto const e = entry( 0, x, y );
+            REQUIRE( 1 == e.slotX );
+            REQUIRE( 0 == e.slotY );
+            REQUIRE( 1 == e.level );
+        }
+
+        // Everything else goes to the root
+        for( auto [x, y] : { std::pair{ 0u, 0u }, { 1u, 3u }, { 3u, 3u } } )
+        {
+            auto const e = entry( 0, x, y );
+            REQUIRE( 0 == e.slotX );
+            REQUIRE( 2 == e.level );
+        }
+    }
+
+    SECTION( "Least recently used pages are replaced, pinned ones aren't" )
+    {
+        std::size_t const a = layout.page_index( 0, 0, 0 );
+        std::size_t const b = layout.page_index( 0, 1, 0 );
+        std::size_t const c = layout.page_index( 0, 2, 0 );
+        std::size_t const d = layout.page_index( 0, 3, 0 );
+        std::size_t const e = layout.page_index( 0, 0, 1 );
+
+        REQUIRE( cache.insert( a, 2 ) );
+        REQUIRE( cache.insert( b, 3 ) );
+        REQUIRE( cache.insert( c, 4 ) );
+        REQUIRE( 4 == cache.resident_count() );
+
+        // a is the oldest, but it is used again
+        cache.touch( 0, 0, 0, 5 );
+        auto const slotD = cache.insert( d, 5 );
+        REQUIRE( slotD );
+        REQUIRE( !cache.resident( b ) );
+        REQUIRE( cache.resident( a ) );
+        REQUIRE( 1 == cache.eviction_count() );
+
+        // Touching marks the ancestors too, so the root stays
+        REQUIRE( 5 == cache.last_used( root ) );
+
+        // All unpinned pages were used in frame 5
+        cache.touch( 0, 2, 0, 5 );
+        REQUIRE( !cache.insert( e, 5 ) );
+        REQUIRE( cache.insert( e, 6 ) );
+        REQUIRE( cache.resident( root ) );
+    }
+}
@@ -0,0 +1,68 @@
+#include "atlas_packer.hpp"
+
+#include <bit>
+#include <numeric>
+#include <algorithm>
+
+#include <cassert>
+
+#include "../support/error.hpp"
+
+std::vector<AtlasPlacement> pack_shelves( std::span<AtlasItemSize const> aSizes, std::uint32_t aLayerSize, std::uint32_t aPadding, std::uint32_t aAlignment )
+{
+    assert( std::has_single_bit( aAlignment ) );
+    auto const align = [aAlignment] ( std::uint32_t aValue ) {
+        return (aValue + aAlignment - 1) & ~(aAlignment - 1);
+    };
+
+    std::vector<std::size_t> order( aSizes.size() );
+    std::iota( order.begin(), order.end(), std::size_t(0) );
+
+    // Tallest first; ties by width keep the result deterministic
+    std::stable_sort( order.begin(), order.end(), [&] ( std::size_t aA, std::size_t aB ) {
+        if( aSizes[aA].height != aSizes[aB].height )
+            return aSizes[aA].height > aSizes[aB].height;
+        return aSizes[aA].width > aSizes[aB].width;
+    } );
+
+    std::vector<AtlasPlacement> ret( aSizes.size() );
+
+    std::uint32_t layer = 0;
+    std::uint32_t shelfY = 0, shelfHeight = 0; // current shelf
+    std::uint32_t cursorX = 0;
+
+    for( std::size_t const i : order )
+    {
+        // Cursors and shelf heights stay multiples of the alignment, since
+        // all cell sizes are
+        std::uint32_t const w = align( aSizes[i].width + 2 * aPadding );
+        std::uint32_t const h = align( aSizes[i].height + 2 * aPadding );
+        if( w > aLayerSize || h > aLayerSize )
+            throw Error( "Atlas item {} ({}x{}) does not fit into a {}x{} layer", i, aSizes[i].width, aSizes[i].height, aLayerSize, aLayerSize );
+
+        // Next shelf if the row is full
+        if( cursorX + w > aLayerSize )
+        {
+            shelfY += shelfHeight;
+            shelfHeight = 0;
+            cursorX = 0;
+        }
+
+        // Next layer if the shelf doesn't fit. Items are sorted by height,
+        // so a new shelf is never taller than the previous one.
+        if( shelfY + h > aLayerSize )
+        {
+            ++layer;
+            shelfY = 0;
+            shelfHeight = 0;
+            cursorX = 0;
+        }
+
+        ret[i] = AtlasPlacement{ layer, cursorX + aPadding, shelfY + aPadding, w, h };
+
+        cursorX += w;
+        shelfHeight = std::max( shelfHeight, h );
+    }
+
+    return ret;
+}
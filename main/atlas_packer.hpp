@@ -0,0 +1,42 @@
+#ifndef ATLAS_PACKER_HPP_6B2E9D41_7F03_4C58_A1D6_2E8F5B90C37A
+#define ATLAS_PACKER_HPP_6B2E9D41_7F03_4C58_A1D6_2E8F5B90C37A
+
+#include <span>
+#include <vector>
+#include <cstdint>
+
+// Rectangle packing for texture atlases (see texture_atlas.hpp).
+//
+// Shelf packing: items are sorted by decreasing height and placed left to
+// right into horizontal shelves. A shelf is as tall as its first (tallest)
+// item; a new shelf starts below once a row is full, and a new layer once a
+// layer is full. This wastes some space compared to smarter packers, but the
+// atlas only holds a handful of small textures.
+//
+// A texel of mip level n averages 2^n x 2^n texels of level 0. When the cells
+// (item and padding) start and end on multiples of 2^n, none of these
+// straddles two cells, and the padding keeps working at that level. Cells
+// are aligned to 2^(levels - 1) for a texture with that many levels.
+//
+// This file does not depend on OpenGL (it's tested in main-test).
+
+struct AtlasItemSize
+{
+    std::uint32_t width = 0, height = 0;
+};
+
+struct AtlasPlacement
+{
+    std::uint32_t layer = 0;
+    std::uint32_t x = 0, y = 0; // top left texel of the item (inside the padding)
+    std::uint32_t cellWidth = 0, cellHeight = 0; // padded and aligned, from (x, y) - padding
+};
+
+// Returns one placement per item, in the order of aSizes. aPadding texels are
+// reserved on each side of every item; the cells (item and padding) start
+// on multiples of aAlignment, a power of two, and are rounded up to them.
+// The right and bottom padding grow by that rounding. Throws Error if a cell
+// does not fit into an aLayerSize x aLayerSize layer.
+std::vector<AtlasPlacement> pack_shelves( std::span<AtlasItemSize const> aSizes, std::uint32_t aLayerSize, std::uint32_t aPadding, std::uint32_t aAlignment = 1 );
+
+#endif // ATLAS_PACKER_HPP_6B2E9D41_7F03_4C58_A1D6_2E8F5B90C37A
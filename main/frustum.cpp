@@ -0,0 +1,76 @@
+#include "frustum.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+
+Aabb boundsOf(std::span<Vec3f const> points)
+{
+    if (points.empty())
+        return {};
+
+    Aabb ret{ points[0], points[0] };
+    for (Vec3f const& p : points.subspan(1))
+    {
+        ret.min = Vec3f{ std::min(ret.min.x, p.x), std::min(ret.min.y, p.y), std::min(ret.min.z, p.z) };
+        ret.max = Vec3f{ std::max(ret.max.x, p.x), std::max(ret.max.y, p.y), std::max(ret.max.z, p.z) };
+    }
+    return ret;
+}
+
+Aabb transformBounds(Aabb const& box, Mat44f const& m)
+{
+    // Center moves with the matrix; the half extent along each world axis
+    // is the sum of the absolute contributions of the local axes (Arvo)
+    Vec3f center = (box.min + box.max) * 0.5f;
+    Vec3f half = (box.max - box.min) * 0.5f;
+
+    Vec4f c = m * Vec4f{ center.x, center.y, center.z, 1.f };
+    float h[3];
+    for (int row = 0; row < 3; ++row)
+        h[row] = std::abs(m[row, 0]) * half.x + std::abs(m[row, 1]) * half.y + std::abs(m[row, 2]) * half.z;
+
+    Vec3f newCenter{ c.x, c.y, c.z };
+    Vec3f newHalf{ h[0], h[1], h[2] };
+    return Aabb{ newCenter - newHalf, newCenter + newHalf };
+}
+
+Aabb expandBounds(Aabb const& box, float margin)
+{
+    Vec3f grow{ margin, margin, margin };
+    return Aabb{ box.min - grow, box.max + grow };
+}
+
+Frustum makeFrustum(Mat44f const& m)
+{
+    // w + x >= 0, w - x >= 0, and so on for y and z
+    Frustum ret;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (int side = 0; side < 2; ++side)
+        {
+            float sign = side == 0 ? 1.f : -1.f;
+            ret.planes[2 * axis + side] = Vec4f{
+                m[3, 0] + sign * m[axis, 0],
+                m[3, 1] + sign * m[axis, 1],
+                m[3, 2] + sign * m[axis, 2],
+                m[3, 3] + sign * m[axis, 3]
+            };
+        }
+    }
+    return ret;
+}
+
+bool intersects(Frustum const& frustum, Aabb const& box)
+{
+    for (Vec4f const& plane : frustum.planes)
+    {
+        // Corner farthest along the plane normal
+        float x = plane.x >= 0.f ? box.max.x : box.min.x;
+        float y = plane.y >= 0.f ? box.max.y : box.min.y;
+        float z = plane.z >= 0.f ? box.max.z : box.min.z;
+        if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.f)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include <span>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+
+// View frustum culling on the CPU.
+//
+// Each drawable has world space bounds (an axis aligned box). A view builds
+// a Frustum from its view-projection matrix once, and skips the draws whose
+// bounds are outside of it. The test is conservative: boxes near a corner
+// of the frustum may pass although they are not visible, but nothing
+// visible is ever culled.
+//
+// This file does not depend on OpenGL (it's tested in main-test).
+
+struct Aabb
+{
+    Vec3f min{ 0.f, 0.f, 0.f };
+    Vec3f max{ 0.f, 0.f, 0.f };
+};
+
+// Six planes (left, right, bottom, top, near, far) as (normal, distance),
+// with the normals pointing inwards: dot(normal, p) + distance >= 0 inside
+struct Frustum
+{
+    Vec4f planes[6];
+};
+
+// Smallest box containing the points; empty input gives an empty box at
+// the origin
+Aabb boundsOf(std::span<Vec3f const> points);
+
+// Box around a box transformed by an affine matrix (e.g. a model matrix)
+Aabb transformBounds(Aabb const& box, Mat44f const& m);
+
+// Box grown by margin in all directions
+Aabb expandBounds(Aabb const& box, float margin);
+
+// Drawables of one view that were kept and skipped
+struct CullStats
+{
+    int drawn = 0;
+    int culled = 0;
+};
+
+// Planes from the rows of the view-projection matrix (Gribb & Hartmann)
+Frustum makeFrustum(Mat44f const& viewProj);
+
+// False only if the box is entirely outside one of the planes
+bool intersects(Frustum const& frustum, Aabb const& box);
+
+#endif // FRUSTUM_HPP
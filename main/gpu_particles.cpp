@@ -0,0 +1,146 @@
+#include "gpu_particles.hpp"
+
+#include <cstddef>
+
+namespace
+{
+    // Layout of the control buffer (see gpu_particles_prepare.comp)
+    constexpr GLintptr kDrawOffset = 0;           // 2 DrawArraysIndirectCommands
+    constexpr GLintptr kEmitGroupsOffset = 32;    // DispatchIndirectCommand
+    constexpr GLintptr kUpdateGroupsOffset = 44;  // DispatchIndirectCommand
+    constexpr GLsizeiptr kControlBytes = 64;
+
+    constexpr GLsizeiptr kDrawCommandBytes = 4 * sizeof(GLuint);
+
+    // Components per particle: px, py, pz, vx, vy, vz, life
+    constexpr GLsizeiptr kFloatsPerParticle = 7;
+
+    // Storage buffer bindings
+    constexpr GLuint kSourceBinding = 0;
+    constexpr GLuint kDestinationBinding = 1;
+    constexpr GLuint kControlBinding = 2;
+
+    // Uniform locations (shared by the three compute shaders)
+    constexpr GLint kSourceLocation = 0;
+    constexpr GLint kRequestedLocation = 1;
+    constexpr GLint kCapacityLocation = 2;
+    constexpr GLint kSeedLocation = 3;
+    constexpr GLint kDtLocation = 4;
+    constexpr GLint kEnginePrevLocation = 5;
+    constexpr GLint kEngineCurrLocation = 6;
+    constexpr GLint kForwardLocation = 7;
+    constexpr GLint kRightLocation = 8;
+    constexpr GLint kUpLocation = 9;
+}
+
+GpuParticles::GpuParticles( std::uint32_t aCapacity )
+    : mCapacity( aCapacity )
+    , mPrepare( { { GL_COMPUTE_SHADER, "assets/cw2/gpu_particles_prepare.comp" } } )
+    , mEmit( { { GL_COMPUTE_SHADER, "assets/cw2/gpu_particles_emit.comp" } } )
+    , mUpdate( { { GL_COMPUTE_SHADER, "assets/cw2/gpu_particles_update.comp" } } )
+{
+    GLsizeiptr const bytes = kFloatsPerParticle * GLsizeiptr(mCapacity) * GLsizeiptr(sizeof(float));
+
+    glGenBuffers( 2, mState );
+    glGenVertexArrays( 2, mVao );
+    for( int i = 0; i < 2; ++i )
+    {
+        glBindBuffer( GL_SHADER_STORAGE_BUFFER, mState[i] );
+        glBufferData( GL_SHADER_STORAGE_BUFFER, bytes, nullptr, GL_DYNAMIC_COPY );
+
+        // Positions are the first three arrays, like in particles.cpp
+        glBindVertexArray( mVao[i] );
+        for( GLuint axis = 0; axis < 3; ++axis )
+        {
+            glEnableVertexAttribArray( axis );
+            glVertexAttribFormat( axis, 1, GL_FLOAT, GL_FALSE, 0 );
+            glVertexAttribBinding( axis, axis );
+            glBindVertexBuffer( axis, mState[i], GLintptr(axis) * mCapacity * sizeof(float), sizeof(float) );
+        }
+    }
+    glBindVertexArray( 0 );
+
+    glGenBuffers( 1, &mControl );
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, mControl );
+    glBufferData( GL_SHADER_STORAGE_BUFFER, kControlBytes, nullptr, GL_DYNAMIC_COPY );
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+    reset();
+}
+
+GpuParticles::~GpuParticles()
+{
+    glDeleteVertexArrays( 2, mVao );
+    glDeleteBuffers( 2, mState );
+    glDeleteBuffers( 1, &mControl );
+}
+
+void GpuParticles::reset()
+{
+    // Zero counts; nothing is drawn until the next simulate()
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, mControl );
+    glClearBufferData( GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr );
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+}
+
+void GpuParticles::simulate( float aDt, std::uint32_t aSpawnCount, Vec3f const& aEnginePrev, Vec3f const& aEngineCurr, Vec3f const& aForward, Vec3f const& aRight, Vec3f const& aUp )
+{
+    std::uint32_t const source = mCurrent;
+    std::uint32_t const destination = 1 - mCurrent;
+
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kSourceBinding, mState[source] );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kDestinationBinding, mState[destination] );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kControlBinding, mControl );
+    glBindBuffer( GL_DISPATCH_INDIRECT_BUFFER, mControl );
+
+    // 1) Counts and dispatch sizes
+    glUseProgram( mPrepare.programId() );
+    glUniform1ui( kSourceLocation, source );
+    glUniform1ui( kRequestedLocation, aSpawnCount );
+    glUniform1ui( kCapacityLocation, mCapacity );
+    glDispatchCompute( 1, 1, 1 );
+    glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT );
+
+    // 2) Emission
+    glUseProgram( mEmit.programId() );
+    glUniform1ui( kCapacityLocation, mCapacity );
+    glUniform1ui( kSeedLocation, mFrame++ );
+    glUniform1f( kDtLocation, aDt );
+    glUniform3fv( kEnginePrevLocation, 1, &aEnginePrev.x );
+    glUniform3fv( kEngineCurrLocation, 1, &aEngineCurr.x );
+    glUniform3fv( kForwardLocation, 1, &aForward.x );
+    glUniform3fv( kRightLocation, 1, &aRight.x );
+    glUniform3fv( kUpLocation, 1, &aUp.x );
+    glDispatchComputeIndirect( kEmitGroupsOffset );
+    glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT );
+
+    // 3) Integration and compaction into the other buffer
+    glUseProgram( mUpdate.programId() );
+    glUniform1ui( kSourceLocation, source );
+    glUniform1ui( kCapacityLocation, mCapacity );
+    glUniform1f( kDtLocation, aDt );
+    glDispatchComputeIndirect( kUpdateGroupsOffset );
+
+    // The results are drawn (vertex attributes and indirect count) and read
+    // by the next simulate()
+    glMemoryBarrier( GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT );
+
+    glBindBuffer( GL_DISPATCH_INDIRECT_BUFFER, 0 );
+    glUseProgram( 0 );
+
+    mCurrent = destination;
+}
+
+void GpuParticles::draw() const
+{
+    glBindVertexArray( mVao[mCurrent] );
+    glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mControl );
+    glDrawArraysIndirect( GL_POINTS, reinterpret_cast<void const*>(kDrawOffset + mCurrent * kDrawCommandBytes) );
+    glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+    glBindVertexArray( 0 );
+}
+
+std::uint32_t GpuParticles::capacity() const noexcept
+{
+    return mCapacity;
+}
@@ -0,0 +1,80 @@
+#ifndef GPU_PARTICLES_HPP_3E8C1F57_0B6D_4A29_B47E_9D25C6A0F813
+#define GPU_PARTICLES_HPP_3E8C1F57_0B6D_4A29_B47E_9D25C6A0F813
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+#include "../vmlib/vec3.hpp"
+#include "../support/program.hpp"
+
+// Particle simulation with compute shaders.
+//
+// Particles live in two shader storage buffers with the same layout as
+// ParticleSim (one float array per component, capacity entries each). Each
+// simulate() reads one and writes the survivors to the other:
+//
+//  1. gpu_particles_prepare.comp clamps the number of new particles to the
+//     free space and writes the dispatch sizes for the next two passes;
+//  2. gpu_particles_emit.comp appends new particles after the alive ones,
+//     using the same distribution as emitParticles();
+//  3. gpu_particles_update.comp integrates them and appends the survivors
+//     to the other buffer. Each workgroup reserves space for its survivors
+//     with one atomic add on the output count.
+//
+// The output count is the vertex count of a draw command, so draw() uses
+// glDrawArraysIndirect() and the CPU never reads the count back. The
+// particles end up in a different order every frame, which does not matter
+// for additive/alpha-blended points.
+//
+// Particles die below a fixed ground plane; heightfield collisions (see
+// particle_sim.hpp) are only done on the CPU.
+//
+// Requires OpenGL 4.3 (compute shaders, storage buffers, indirect draws).
+// Use from the GL thread only.
+
+class GpuParticles final
+{
+    public:
+        explicit GpuParticles( std::uint32_t aCapacity );
+        ~GpuParticles();
+
+        GpuParticles( GpuParticles const& ) = delete;
+        GpuParticles& operator= (GpuParticles const&) = delete;
+
+    public:
+        // Removes all particles
+        void reset();
+
+        // Emits up to aSpawnCount particles along the engine path from
+        // aEnginePrev to aEngineCurr, then advances all particles by aDt.
+        void simulate(
+            float aDt,
+            std::uint32_t aSpawnCount,
+            Vec3f const& aEnginePrev,
+            Vec3f const& aEngineCurr,
+            Vec3f const& aForward,
+            Vec3f const& aRight,
+            Vec3f const& aUp
+        );
+
+        // Draws the particles as GL_POINTS with the current program (see
+        // particle.vert)
+        void draw() const;
+
+        std::uint32_t capacity() const noexcept;
+
+    private:
+        std::uint32_t mCapacity;
+
+        ShaderProgram mPrepare, mEmit, mUpdate;
+
+        GLuint mState[2]{};     // particle arrays
+        GLuint mVao[2]{};       // positions from mState[i]
+        GLuint mControl = 0;    // counts and indirect commands
+        std::uint32_t mCurrent = 0; // mState[mCurrent] holds the particles
+
+        std::uint32_t mFrame = 0; // seeds the random numbers
+};
+
+#endif // GPU_PARTICLES_HPP_3E8C1F57_0B6D_4A29_B47E_9D25C6A0F813
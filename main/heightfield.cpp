@@ -0,0 +1,416 @@
+#include "heightfield.hpp"
+
+#include <limits>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <filesystem>
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__AVX__)
+#   define HEIGHTFIELD_AVX_ 1
+#   include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#   define HEIGHTFIELD_SSE2_ 1
+#   include <emmintrin.h>
+#endif
+
+// Cache file: header, then the heights. Values are stored in the machine's
+// byte order (the cache is not meant to be shared between machines).
+static constexpr char kMagic[4] = { 'H', 'G', 'T', 'F' };
+static constexpr std::uint32_t kVersion = 1;
+static constexpr std::size_t kHeaderBytes = 40;
+
+// Sample indices are computed in float, which is exact below 2^24
+static constexpr int kMaxResolution = 4096;
+
+template< typename tType >
+static void put(std::vector<std::uint8_t>& out, std::size_t offset, tType value)
+{
+    std::memcpy(out.data() + offset, &value, sizeof(value));
+}
+
+template< typename tType >
+static tType get(std::vector<std::uint8_t> const& in, std::size_t offset)
+{
+    tType ret;
+    std::memcpy(&ret, in.data() + offset, sizeof(ret));
+    return ret;
+}
+
+// Constants shared by the scalar and SIMD lookups
+namespace
+{
+    struct Lookup
+    {
+        float invCell;
+        float maxU, maxV;   // just below the last sample, so that there is always a next one
+        float rowStride;
+    };
+}
+
+static Lookup makeLookup(Heightfield const& hf)
+{
+    Lookup ret;
+    ret.invCell = 1.0f / hf.cellSize;
+    ret.maxU = std::nextafter(float(hf.width - 1), 0.0f);
+    ret.maxV = std::nextafter(float(hf.depth - 1), 0.0f);
+    ret.rowStride = float(hf.width);
+    return ret;
+}
+
+static void sampleRangeScalar(
+    Heightfield const& hf, Lookup const& lk,
+    float const* x, float const* z, int begin, int end,
+    float* height, float* slopeX, float* slopeZ
+)
+{
+    float const* h = hf.heights.data();
+    int const row = hf.width;
+
+    for (int i = begin; i < end; ++i)
+    {
+        // Same operations as the SIMD version (max/min order included, for
+        // NaN)
+        float u = (x[i] - hf.originX) * lk.invCell;
+        float v = (z[i] - hf.originZ) * lk.invCell;
+        u = u > 0.0f ? u : 0.0f;
+        v = v > 0.0f ? v : 0.0f;
+        u = u < lk.maxU ? u : lk.maxU;
+        v = v < lk.maxV ? v : lk.maxV;
+
+        float iu = float(int(u));
+        float iv = float(int(v));
+        float fx = u - iu;
+        float fz = v - iv;
+        int idx = int(iv * lk.rowStride + iu);
+
+        float h00 = h[idx], h10 = h[idx + 1];
+        float h01 = h[idx + row], h11 = h[idx + row + 1];
+
+        float dx0 = h10 - h00;
+        float dx1 = h11 - h01;
+        float h0 = h00 + dx0 * fx;
+        float h1 = h01 + dx1 * fx;
+
+        height[i] = h0 + (h1 - h0) * fz;
+        slopeX[i] = (dx0 + (dx1 - dx0) * fz) * lk.invCell;
+        slopeZ[i] = (h1 - h0) * lk.invCell;
+    }
+}
+
+#if HEIGHTFIELD_AVX_
+static __m256 gather8(float const* base, __m256i idx)
+{
+#   if defined(__AVX2__)
+    return _mm256_i32gather_ps(base, idx, 4);
+#   else
+    alignas(32) std::int32_t i[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(i), idx);
+    return _mm256_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]], base[i[4]], base[i[5]], base[i[6]], base[i[7]]);
+#   endif
+}
+
+static int sampleSimd(
+    Heightfield const& hf, Lookup const& lk,
+    float const* x, float const* z, int count,
+    float* height, float* slopeX, float* slopeZ
+)
+{
+    __m256 const zero     = _mm256_setzero_ps();
+    __m256 const invCell  = _mm256_set1_ps(lk.invCell);
+    __m256 const originX  = _mm256_set1_ps(hf.originX);
+    __m256 const originZ  = _mm256_set1_ps(hf.originZ);
+    __m256 const maxU     = _mm256_set1_ps(lk.maxU);
+    __m256 const maxV     = _mm256_set1_ps(lk.maxV);
+    __m256 const stride   = _mm256_set1_ps(lk.rowStride);
+
+    float const* h = hf.heights.data();
+    int const row = hf.width;
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 u = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x + i), originX), invCell);
+        __m256 v = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(z + i), originZ), invCell);
+        u = _mm256_min_ps(_mm256_max_ps(u, zero), maxU);
+        v = _mm256_min_ps(_mm256_max_ps(v, zero), maxV);
+
+        __m256 iu = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(u));
+        __m256 iv = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(v));
+        __m256 fx = _mm256_sub_ps(u, iu);
+        __m256 fz = _mm256_sub_ps(v, iv);
+        __m256i idx = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(iv, stride), iu));
+
+        __m256 h00 = gather8(h, idx);
+        __m256 h10 = gather8(h + 1, idx);
+        __m256 h01 = gather8(h + row, idx);
+        __m256 h11 = gather8(h + row + 1, idx);
+
+        __m256 dx0 = _mm256_sub_ps(h10, h00);
+        __m256 dx1 = _mm256_sub_ps(h11, h01);
+        __m256 h0 = _mm256_add_ps(h00, _mm256_mul_ps(dx0, fx));
+        __m256 h1 = _mm256_add_ps(h01, _mm256_mul_ps(dx1, fx));
+        __m256 dz = _mm256_sub_ps(h1, h0);
+
+        _mm256_storeu_ps(height + i, _mm256_add_ps(h0, _mm256_mul_ps(dz, fz)));
+        _mm256_storeu_ps(slopeX + i, _mm256_mul_ps(_mm256_add_ps(dx0, _mm256_mul_ps(_mm256_sub_ps(dx1, dx0), fz)), invCell));
+        _mm256_storeu_ps(slopeZ + i, _mm256_mul_ps(dz, invCell));
+    }
+    return i;
+}
+#elif HEIGHTFIELD_SSE2_
+static __m128 gather4(float const* base, __m128i idx)
+{
+    alignas(16) std::int32_t i[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(i), idx);
+    return _mm_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]]);
+}
+
+static int sampleSimd(
+    Heightfield const& hf, Lookup const& lk,
+    float const* x, float const* z, int count,
+    float* height, float* slopeX, float* slopeZ
+)
+{
+    __m128 const zero     = _mm_setzero_ps();
+    __m128 const invCell  = _mm_set1_ps(lk.invCell);
+    __m128 const originX  = _mm_set1_ps(hf.originX);
+    __m128 const originZ  = _mm_set1_ps(hf.originZ);
+    __m128 const maxU     = _mm_set1_ps(lk.maxU);
+    __m128 const maxV     = _mm_set1_ps(lk.maxV);
+    __m128 const stride   = _mm_set1_ps(lk.rowStride);
+
+    float const* h = hf.heights.data();
+    int const row = hf.width;
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 u = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(x + i), originX), invCell);
+        __m128 v = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(z + i), originZ), invCell);
+        u = _mm_min_ps(_mm_max_ps(u, zero), maxU);
+        v = _mm_min_ps(_mm_max_ps(v, zero), maxV);
+
+        __m128 iu = _mm_cvtepi32_ps(_mm_cvttps_epi32(u));
+        __m128 iv = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+        __m128 fx = _mm_sub_ps(u, iu);
+        __m128 fz = _mm_sub_ps(v, iv);
+        __m128i idx = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(iv, stride), iu));
+
+        __m128 h00 = gather4(h, idx);
+        __m128 h10 = gather4(h + 1, idx);
+        __m128 h01 = gather4(h + row, idx);
+        __m128 h11 = gather4(h + row + 1, idx);
+
+        __m128 dx0 = _mm_sub_ps(h10, h00);
+        __m128 dx1 = _mm_sub_ps(h11, h01);
+        __m128 h0 = _mm_add_ps(h00, _mm_mul_ps(dx0, fx));
+        __m128 h1 = _mm_add_ps(h01, _mm_mul_ps(dx1, fx));
+        __m128 dz = _mm_sub_ps(h1, h0);
+
+        _mm_storeu_ps(height + i, _mm_add_ps(h0, _mm_mul_ps(dz, fz)));
+        _mm_storeu_ps(slopeX + i, _mm_mul_ps(_mm_add_ps(dx0, _mm_mul_ps(_mm_sub_ps(dx1, dx0), fz)), invCell));
+        _mm_storeu_ps(slopeZ + i, _mm_mul_ps(dz, invCell));
+    }
+    return i;
+}
+#endif
+
+Heightfield bakeHeightfield(std::span<Vec3f const> triangles, int resolution)
+{
+    Heightfield hf;
+    std::size_t const triangleCount = triangles.size() / 3;
+    if (0 == triangleCount)
+        return hf;
+
+    resolution = std::clamp(resolution, 2, kMaxResolution);
+
+    float minX = triangles[0].x, maxX = minX;
+    float minZ = triangles[0].z, maxZ = minZ;
+    float minY = triangles[0].y;
+    for (std::size_t i = 0; i < triangleCount * 3; ++i)
+    {
+        minX = std::min(minX, triangles[i].x);
+        maxX = std::max(maxX, triangles[i].x);
+        minZ = std::min(minZ, triangles[i].z);
+        maxZ = std::max(maxZ, triangles[i].z);
+        minY = std::min(minY, triangles[i].y);
+    }
+
+    float const extent = std::max(maxX - minX, maxZ - minZ);
+    hf.originX = minX;
+    hf.originZ = minZ;
+    hf.cellSize = extent > 0.0f ? extent / float(resolution - 1) : 1.0f;
+
+    // The longer side gets exactly resolution samples; the other one enough
+    // to cover the mesh
+    auto samples = [&] (float size) {
+        int n = int(std::ceil(double(size) / hf.cellSize - 1e-3)) + 1;
+        return std::clamp(n, 2, resolution);
+    };
+    hf.width = samples(maxX - minX);
+    hf.depth = samples(maxZ - minZ);
+
+    float const kUncovered = -std::numeric_limits<float>::infinity();
+    hf.heights.assign(std::size_t(hf.width) * hf.depth, kUncovered);
+
+    // Rasterize each triangle at the sample points, in grid coordinates
+    double const invCell = 1.0 / hf.cellSize;
+    for (std::size_t t = 0; t < triangleCount; ++t)
+    {
+        Vec3f const* p = triangles.data() + 3 * t;
+
+        double u[3], v[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            u[k] = (double(p[k].x) - hf.originX) * invCell;
+            v[k] = (double(p[k].z) - hf.originZ) * invCell;
+        }
+
+        // Vertical triangles cover no samples
+        double area = (u[1] - u[0]) * (v[2] - v[0]) - (u[2] - u[0]) * (v[1] - v[0]);
+        if (std::abs(area) < 1e-12)
+            continue;
+
+        int i0 = std::max(0, int(std::ceil(std::min({ u[0], u[1], u[2] }))));
+        int i1 = std::min(hf.width - 1, int(std::floor(std::max({ u[0], u[1], u[2] }))));
+        int j0 = std::max(0, int(std::ceil(std::min({ v[0], v[1], v[2] }))));
+        int j1 = std::min(hf.depth - 1, int(std::floor(std::max({ v[0], v[1], v[2] }))));
+
+        // Samples on a shared edge belong to both triangles
+        double const eps = -1e-9;
+        for (int j = j0; j <= j1; ++j)
+        {
+            for (int i = i0; i <= i1; ++i)
+            {
+                double w0 = ((u[1] - i) * (v[2] - j) - (u[2] - i) * (v[1] - j)) / area;
+                double w1 = ((u[2] - i) * (v[0] - j) - (u[0] - i) * (v[2] - j)) / area;
+                double w2 = 1.0 - w0 - w1;
+                if (w0 < eps || w1 < eps || w2 < eps)
+                    continue;
+
+                float y = float(w0 * p[0].y + w1 * p[1].y + w2 * p[2].y);
+                float& out = hf.heights[std::size_t(j) * hf.width + i];
+                out = std::max(out, y);
+            }
+        }
+    }
+
+    for (float& h : hf.heights)
+    {
+        if (h == kUncovered)
+            h = minY;
+    }
+
+    auto [lo, hi] = std::minmax_element(hf.heights.begin(), hf.heights.end());
+    hf.minHeight = *lo;
+    hf.maxHeight = *hi;
+    return hf;
+}
+
+bool writeHeightfield(char const* path, Heightfield const& hf)
+{
+    std::size_t const sampleBytes = hf.heights.size() * sizeof(float);
+    std::vector<std::uint8_t> out(kHeaderBytes + sampleBytes);
+
+    std::memcpy(out.data(), kMagic, sizeof(kMagic));
+    put(out, 4, kVersion);
+    put(out, 8, std::uint32_t(std::max(hf.width, hf.depth))); // resolution
+    put(out, 12, std::uint32_t(hf.width));
+    put(out, 16, std::uint32_t(hf.depth));
+    put(out, 20, hf.originX);
+    put(out, 24, hf.originZ);
+    put(out, 28, hf.cellSize);
+    put(out, 32, hf.minHeight);
+    put(out, 36, hf.maxHeight);
+    if (sampleBytes)
+        std::memcpy(out.data() + kHeaderBytes, hf.heights.data(), sampleBytes);
+
+    std::filesystem::path const target(path);
+    std::filesystem::path tmp = target;
+    tmp += ".tmp";
+
+    {
+        std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+        if (!ofs.write(reinterpret_cast<char const*>(out.data()), std::streamsize(out.size())))
+            return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, target, ec);
+    return !ec;
+}
+
+std::optional<Heightfield> readHeightfield(char const* path, int resolution)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs)
+        return std::nullopt;
+
+    std::vector<std::uint8_t> const in((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    if (in.size() < kHeaderBytes || 0 != std::memcmp(in.data(), kMagic, sizeof(kMagic)))
+        return std::nullopt;
+
+    resolution = std::clamp(resolution, 2, kMaxResolution);
+    if (kVersion != get<std::uint32_t>(in, 4) || std::uint32_t(resolution) != get<std::uint32_t>(in, 8))
+        return std::nullopt;
+
+    std::uint32_t const width = get<std::uint32_t>(in, 12);
+    std::uint32_t const depth = get<std::uint32_t>(in, 16);
+    if (width < 2 || depth < 2 || width > std::uint32_t(resolution) || depth > std::uint32_t(resolution))
+        return std::nullopt;
+
+    std::size_t const count = std::size_t(width) * depth;
+    if (in.size() != kHeaderBytes + count * sizeof(float))
+        return std::nullopt;
+
+    Heightfield hf;
+    hf.width = int(width);
+    hf.depth = int(depth);
+    hf.originX = get<float>(in, 20);
+    hf.originZ = get<float>(in, 24);
+    hf.cellSize = get<float>(in, 28);
+    hf.minHeight = get<float>(in, 32);
+    hf.maxHeight = get<float>(in, 36);
+    if (!(hf.cellSize > 0.0f) || !std::isfinite(hf.cellSize))
+        return std::nullopt;
+
+    hf.heights.resize(count);
+    std::memcpy(hf.heights.data(), in.data() + kHeaderBytes, count * sizeof(float));
+    return hf;
+}
+
+float sampleHeight(Heightfield const& hf, float x, float z)
+{
+    float height, slopeX, slopeZ;
+    sampleRangeScalar(hf, makeLookup(hf), &x, &z, 0, 1, &height, &slopeX, &slopeZ);
+    return height;
+}
+
+void sampleHeights(
+    Heightfield const& hf,
+    float const* x, float const* z, int count,
+    float* height, float* slopeX, float* slopeZ
+)
+{
+    Lookup const lk = makeLookup(hf);
+
+    int done = 0;
+#if HEIGHTFIELD_AVX_ || HEIGHTFIELD_SSE2_
+    done = sampleSimd(hf, lk, x, z, count, height, slopeX, slopeZ);
+#endif
+    sampleRangeScalar(hf, lk, x, z, done, count, height, slopeX, slopeZ);
+}
+
+void sampleHeightsScalar(
+    Heightfield const& hf,
+    float const* x, float const* z, int count,
+    float* height, float* slopeX, float* slopeZ
+)
+{
+    sampleRangeScalar(hf, makeLookup(hf), x, z, 0, count, height, slopeX, slopeZ);
+}
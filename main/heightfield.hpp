@@ -0,0 +1,74 @@
+#ifndef HEIGHTFIELD_HPP
+#define HEIGHTFIELD_HPP
+
+#include <span>
+#include <vector>
+#include <optional>
+
+#include "../vmlib/vec3.hpp"
+
+// Regular grid of terrain heights, for collisions that don't need the full
+// mesh (particles, see particle_sim.hpp).
+//
+// bakeHeightfield() rasterizes the terrain's triangles from above: each grid
+// sample gets the height of the highest triangle over it. Samples that no
+// triangle covers (outside a non-rectangular mesh) get the lowest height of
+// the mesh. Baking takes a while for a large mesh, so the result is cached on
+// disk (writeHeightfield() / readHeightfield()).
+//
+// Lookups interpolate bilinearly between the four samples around a point.
+// Points outside the grid use the nearest edge. sampleHeights() processes 8
+// (AVX) or 4 (SSE) points per instruction and also returns the slope, from
+// which collision normals are computed; sampleHeightsScalar() gives
+// bit-identical results.
+//
+// This file does not depend on OpenGL (it's tested in main-test).
+
+// Default number of samples along the longer side
+constexpr int kHeightfieldResolution = 1024;
+
+struct Heightfield
+{
+    float originX = 0.0f, originZ = 0.0f;  // position of sample (0,0)
+    float cellSize = 1.0f;                  // distance between samples
+
+    // Samples along x and z. At least 2 each, unless empty.
+    int width = 0, depth = 0;
+
+    // depth rows of width samples, x varies fastest
+    std::vector<float> heights;
+
+    float minHeight = 0.0f, maxHeight = 0.0f;
+};
+
+// From a triangle soup (three positions per triangle, in world space). The
+// longer side of the mesh's bounds gets resolution samples. Empty if there
+// are no triangles.
+Heightfield bakeHeightfield(std::span<Vec3f const> triangles, int resolution = kHeightfieldResolution);
+
+// Writes to a temporary file first, so that an interrupted write never leaves
+// a truncated file at path. Returns false on failure.
+bool writeHeightfield(char const* path, Heightfield const& hf);
+
+// Returns std::nullopt if the file does not exist, is not a heightfield that
+// writeHeightfield() could have produced, or was baked at a different
+// resolution.
+std::optional<Heightfield> readHeightfield(char const* path, int resolution = kHeightfieldResolution);
+
+// Bilinear height at (x, z). The heightfield must not be empty.
+float sampleHeight(Heightfield const& hf, float x, float z);
+
+// Heights and slopes (dh/dx, dh/dz) at count points. The outputs need no
+// alignment. The heightfield must not be empty.
+void sampleHeights(
+    Heightfield const& hf,
+    float const* x, float const* z, int count,
+    float* height, float* slopeX, float* slopeZ
+);
+void sampleHeightsScalar(
+    Heightfield const& hf,
+    float const* x, float const* z, int count,
+    float* height, float* slopeX, float* slopeZ
+);
+
+#endif // HEIGHTFIELD_HPP
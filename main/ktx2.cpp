@@ -0,0 +1,257 @@
+#include "ktx2.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+#include <cstring>
+
+namespace
+{
+    constexpr std::uint8_t kIdentifier[12] = {
+        0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+    };
+
+    // VkFormat values
+    constexpr std::uint32_t kVkFormatBc1RgbSrgb = 132;
+    constexpr std::uint32_t kVkFormatBc7Srgb = 146;
+
+    // Data Format Descriptor constants (Khronos Data Format spec 1.3)
+    constexpr std::uint32_t kDfModelBc1a = 128;
+    constexpr std::uint32_t kDfModelBc7 = 134;
+    constexpr std::uint32_t kDfPrimariesBt709 = 1;
+    constexpr std::uint32_t kDfTransferSrgb = 2;
+
+    constexpr std::size_t kHeaderBytes = 80;
+    constexpr std::size_t kLevelIndexEntryBytes = 24;
+    constexpr std::size_t kDfdBytes = 4 + 24 + 16; // total size + basic block with one sample
+
+    constexpr char kWriterKey[] = "KTXwriter";
+
+    constexpr std::size_t align_up_( std::size_t aValue, std::size_t aAlign ) noexcept
+    {
+        return (aValue + aAlign - 1) / aAlign * aAlign;
+    }
+
+    void put_u32_( std::vector<std::uint8_t>& aOut, std::size_t aOffset, std::uint32_t aValue )
+    {
+        for( int i = 0; i < 4; ++i )
+            aOut[aOffset+i] = std::uint8_t( aValue >> (8*i) );
+    }
+    void put_u64_( std::vector<std::uint8_t>& aOut, std::size_t aOffset, std::uint64_t aValue )
+    {
+        for( int i = 0; i < 8; ++i )
+            aOut[aOffset+i] = std::uint8_t( aValue >> (8*i) );
+    }
+
+    std::uint32_t get_u32_( std::span<std::uint8_t const> aIn, std::size_t aOffset ) noexcept
+    {
+        std::uint32_t ret = 0;
+        for( int i = 0; i < 4; ++i )
+            ret |= std::uint32_t(aIn[aOffset+i]) << (8*i);
+        return ret;
+    }
+    std::uint64_t get_u64_( std::span<std::uint8_t const> aIn, std::size_t aOffset ) noexcept
+    {
+        std::uint64_t ret = 0;
+        for( int i = 0; i < 8; ++i )
+            ret |= std::uint64_t(aIn[aOffset+i]) << (8*i);
+        return ret;
+    }
+
+    std::uint32_t vk_format_( BlockFormat aFormat ) noexcept
+    {
+        return BlockFormat::bc1 == aFormat ? kVkFormatBc1RgbSrgb : kVkFormatBc7Srgb;
+    }
+}
+
+bool write_ktx2( char const* aPath, CompressedImage const& aImage, std::string_view aWriter )
+{
+    std::uint32_t const levelCount = std::uint32_t(aImage.levels.size());
+    std::size_t const blockBytes = block_bytes( aImage.format );
+
+    // Layout: header, level index, DFD, key/value data, then the levels from
+    // the smallest to the largest (as required by the spec).
+    std::size_t const dfdOffset = kHeaderBytes + levelCount * kLevelIndexEntryBytes;
+    std::size_t const kvdOffset = dfdOffset + kDfdBytes;
+
+    std::size_t const kvLength = sizeof(kWriterKey) + aWriter.size() + 1;
+    std::size_t const kvdBytes = align_up_( 4 + kvLength, 4 );
+
+    std::vector<std::size_t> levelOffsets( levelCount );
+    std::size_t end = kvdOffset + kvdBytes;
+    for( std::size_t i = levelCount; i-- > 0; )
+    {
+        end = align_up_( end, blockBytes );
+        levelOffsets[i] = end;
+        end += aImage.levels[i].size();
+    }
+
+    std::vector<std::uint8_t> out( end, 0 );
+
+    // Header
+    std::memcpy( out.data(), kIdentifier, sizeof(kIdentifier) );
+    put_u32_( out, 12, vk_format_( aImage.format ) );
+    put_u32_( out, 16, 1 ); // typeSize
+    put_u32_( out, 20, aImage.width );
+    put_u32_( out, 24, aImage.height );
+    put_u32_( out, 28, 0 ); // pixelDepth
+    put_u32_( out, 32, 0 ); // layerCount
+    put_u32_( out, 36, 1 ); // faceCount
+    put_u32_( out, 40, levelCount );
+    put_u32_( out, 44, 0 ); // supercompressionScheme
+
+    // Index
+    put_u32_( out, 48, std::uint32_t(dfdOffset) );
+    put_u32_( out, 52, std::uint32_t(kDfdBytes) );
+    put_u32_( out, 56, std::uint32_t(kvdOffset) );
+    put_u32_( out, 60, std::uint32_t(kvdBytes) );
+    put_u64_( out, 64, 0 ); // sgdByteOffset
+    put_u64_( out, 72, 0 ); // sgdByteLength
+
+    for( std::uint32_t i = 0; i < levelCount; ++i )
+    {
+        std::size_t const entry = kHeaderBytes + i * kLevelIndexEntryBytes;
+        put_u64_( out, entry + 0, levelOffsets[i] );
+        put_u64_( out, entry + 8, aImage.levels[i].size() );
+        put_u64_( out, entry + 16, aImage.levels[i].size() );
+    }
+
+    // Data format descriptor: one basic descriptor block with one sample
+    // covering the whole compressed block.
+    std::uint32_t const model = BlockFormat::bc1 == aImage.format ? kDfModelBc1a : kDfModelBc7;
+    put_u32_( out, dfdOffset + 0, std::uint32_t(kDfdBytes) );
+    put_u32_( out, dfdOffset + 4, 0 ); // vendorId = Khronos, descriptorType = basic
+    put_u32_( out, dfdOffset + 8, 2u | ((24u + 16u) << 16) ); // version, block size
+    put_u32_( out, dfdOffset + 12, model | (kDfPrimariesBt709 << 8) | (kDfTransferSrgb << 16) );
+    put_u32_( out, dfdOffset + 16, 3u | (3u << 8) ); // 4x4x1x1 texel block
+    put_u32_( out, dfdOffset + 20, std::uint32_t(blockBytes) ); // bytesPlane0
+    put_u32_( out, dfdOffset + 24, 0 );
+    put_u32_( out, dfdOffset + 28, ((std::uint32_t(blockBytes) * 8 - 1) << 16) ); // bitOffset 0, colour channel
+    put_u32_( out, dfdOffset + 32, 0 ); // sample position
+    put_u32_( out, dfdOffset + 36, 0 ); // sampleLower
+    put_u32_( out, dfdOffset + 40, 0xffffffffu ); // sampleUpper
+
+    // Key/value data
+    put_u32_( out, kvdOffset, std::uint32_t(kvLength) );
+    std::memcpy( out.data() + kvdOffset + 4, kWriterKey, sizeof(kWriterKey) );
+    std::memcpy( out.data() + kvdOffset + 4 + sizeof(kWriterKey), aWriter.data(), aWriter.size() );
+
+    for( std::uint32_t i = 0; i < levelCount; ++i )
+        std::memcpy( out.data() + levelOffsets[i], aImage.levels[i].data(), aImage.levels[i].size() );
+
+    // Write
+    std::filesystem::path const path( aPath );
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+
+    {
+        std::ofstream ofs( tmp, std::ios::binary | std::ios::trunc );
+        if( !ofs.write( reinterpret_cast<char const*>(out.data()), std::streamsize(out.size()) ) )
+            return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename( tmp, path, ec );
+    return !ec;
+}
+
+std::optional<CompressedImageView> parse_ktx2( std::span<std::uint8_t const> aBytes, std::string_view aWriter )
+{
+    auto const& in = aBytes;
+    if( in.size() < kHeaderBytes || 0 != std::memcmp( in.data(), kIdentifier, sizeof(kIdentifier) ) )
+        return std::nullopt;
+
+    CompressedImageView ret;
+
+    std::uint32_t const vkFormat = get_u32_( in, 12 );
+    if( kVkFormatBc1RgbSrgb == vkFormat )
+        ret.format = BlockFormat::bc1;
+    else if( kVkFormatBc7Srgb == vkFormat )
+        ret.format = BlockFormat::bc7;
+    else
+        return std::nullopt;
+
+    ret.width = get_u32_( in, 20 );
+    ret.height = get_u32_( in, 24 );
+
+    std::uint32_t const levelCount = get_u32_( in, 40 );
+    if( 0 == ret.width || 0 == ret.height || get_u32_( in, 28 ) > 1 || get_u32_( in, 32 ) > 1
+        || 1 != get_u32_( in, 36 ) || 0 != get_u32_( in, 44 )
+        || 0 == levelCount || levelCount > mip_level_count( ret.width, ret.height ) )
+    {
+        return std::nullopt;
+    }
+
+    // Check the writer
+    std::size_t const kvdOffset = get_u32_( in, 56 );
+    std::size_t const kvdBytes = get_u32_( in, 60 );
+    if( kvdOffset + kvdBytes > in.size() )
+        return std::nullopt;
+
+    bool writerMatches = false;
+    for( std::size_t pos = kvdOffset; pos + 4 <= kvdOffset + kvdBytes; )
+    {
+        std::size_t const len = get_u32_( in, pos );
+        if( pos + 4 + len > kvdOffset + kvdBytes )
+            return std::nullopt;
+
+        std::string_view const kv( reinterpret_cast<char const*>(in.data() + pos + 4), len );
+        auto const sep = kv.find( '\0' );
+        if( sep != std::string_view::npos && kv.substr( 0, sep ) == kWriterKey )
+        {
+            std::string_view value = kv.substr( sep + 1 );
+            if( !value.empty() && '\0' == value.back() )
+                value.remove_suffix( 1 );
+
+            writerMatches = (value == aWriter);
+        }
+
+        pos = align_up_( pos + 4 + len, 4 );
+    }
+
+    if( !writerMatches )
+        return std::nullopt;
+
+    // Levels
+    if( kHeaderBytes + levelCount * kLevelIndexEntryBytes > in.size() )
+        return std::nullopt;
+
+    ret.levels.resize( levelCount );
+    for( std::uint32_t i = 0; i < levelCount; ++i )
+    {
+        std::size_t const entry = kHeaderBytes + i * kLevelIndexEntryBytes;
+        std::uint64_t const offset = get_u64_( in, entry + 0 );
+        std::uint64_t const size = get_u64_( in, entry + 8 );
+
+        std::uint32_t const w = std::max( ret.width >> i, 1u );
+        std::uint32_t const h = std::max( ret.height >> i, 1u );
+        if( size != compressed_size( ret.format, w, h ) || offset > in.size() || size > in.size() - offset )
+            return std::nullopt;
+
+        ret.levels[i] = in.subspan( std::size_t(offset), std::size_t(size) );
+    }
+
+    return ret;
+}
+
+std::optional<CompressedImage> read_ktx2( char const* aPath, std::string_view aWriter )
+{
+    std::ifstream ifs( aPath, std::ios::binary );
+    if( !ifs )
+        return std::nullopt;
+
+    std::vector<std::uint8_t> const bytes( (std::istreambuf_iterator<char>( ifs )), std::istreambuf_iterator<char>() );
+
+    auto const view = parse_ktx2( bytes, aWriter );
+    if( !view )
+        return std::nullopt;
+
+    CompressedImage ret{ view->format, view->width, view->height, {} };
+    for( auto const level : view->levels )
+        ret.levels.emplace_back( level.begin(), level.end() );
+
+    return ret;
+}
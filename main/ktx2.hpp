@@ -0,0 +1,32 @@
+#ifndef KTX2_HPP_A4C81F36_2D7B_4E95_8F10_C6B93E5D7A28
+#define KTX2_HPP_A4C81F36_2D7B_4E95_8F10_C6B93E5D7A28
+
+#include <span>
+#include <optional>
+#include <string_view>
+
+#include "texture_compress.hpp"
+
+// Minimal KTX 2.0 reader/writer for block compressed 2D textures with a full
+// mip chain (sRGB BC1 or BC7; one layer, one face, no supercompression).
+// This is what the texture cache stores. See
+//   https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+//
+// aWriter is stored in the KTXwriter key. The readers reject files with a
+// different writer string, which allows old cache entries to be invalidated
+// when the encoder changes.
+
+// Writes to a temporary file first, so that an interrupted write never leaves
+// a truncated file at aPath. Returns false on failure.
+bool write_ktx2( char const* aPath, CompressedImage const&, std::string_view aWriter );
+
+// Returns std::nullopt if aBytes are not a KTX2 file that write_ktx2() could
+// have produced, or if the file has a different writer. The levels of the
+// returned view point into aBytes.
+std::optional<CompressedImageView> parse_ktx2( std::span<std::uint8_t const> aBytes, std::string_view aWriter );
+
+// As parse_ktx2(), but reads a copy of the file into memory. Also returns
+// std::nullopt if the file does not exist.
+std::optional<CompressedImage> read_ktx2( char const* aPath, std::string_view aWriter );
+
+#endif // KTX2_HPP_A4C81F36_2D7B_4E95_8F10_C6B93E5D7A28
@@ -2,27 +2,43 @@
 #include <GLFW/glfw3.h>
 
 #include <print>
+#include <chrono>
+#include <memory>
 #include <numbers>
 #include <typeinfo>
 #include <stdexcept>
 
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 
 #include "../support/error.hpp"
 #include "../support/program.hpp"
 #include "../support/checkpoint.hpp"
 #include "../support/debug_output.hpp"
+#include "../support/thread_pool.hpp"
+#include "../support/fixed_timestep.hpp"
 
 #include "../vmlib/vec4.hpp"
 #include "../vmlib/mat33.hpp"
 #include "../vmlib/mat44.hpp"
 #include "texture.hpp"
+#include "texture_atlas.hpp"
+#include "texture_units.hpp"
+#include "texture_registry.hpp"
+#include "virtual_texture.hpp"
+#include "streaming_buffer.hpp"
 
 #include "defaults.hpp"
 #include "spaceship.hpp"
 #include "loadobj.hpp"
 #include "camera.hpp"
 #include "particles.hpp"
+#include "particle_budget.hpp"
+#include "particle_target.hpp"
+#include "heightfield.hpp"
+#include "simulation.hpp"
+#include "frustum.hpp"
 
 #include <rapidobj/rapidobj.hpp>
 #include "../vmlib/vec2.hpp"
@@ -38,6 +54,9 @@ namespace
 {
     constexpr char const* kWindowTitle = "COMP3811 - CW2";
 
+    // Texture memory budget; see TextureRegistry
+    constexpr std::size_t kTextureBudgetBytes = 256u * 1024u * 1024u;
+
     // GLFW callbacks
     void glfw_callback_error_( int, char const* );
     void glfw_callback_key_( GLFWwindow*, int, int, int, int );
@@ -53,25 +72,44 @@ namespace
         ~GLFWWindowDeleter();
         GLFWwindow* window;
     };
+    struct ParticleSystemCleanupHelper
+    {
+        ~ParticleSystemCleanupHelper();
+    };
 
-    // Camera and view modes
-    Camera gCamera; // Primary camera
+    // Camera and view modes (the primary camera is gSim.camera)
     CameraMode gCameraMode = CameraMode::Free; // main view mode
     bool gSplitScreenEnabled = false;
     CameraMode gCameraMode2 = CameraMode::Chase;  // second view mode
 
-    // Task 1.7 Spaceship animation
-    struct VehicleAnim
-    {
-        bool active = false; // Animation has started at least once
-        bool paused = false; // Toggled by F / UI button
-        float time   = 0.f; // Seconds since start
-    };
-    VehicleAnim gUfoAnim;
+    // The simulation (spaceship animation, particles, camera movement; see
+    // simulation.hpp) runs in fixed steps; rendering interpolates between
+    // the last two
+    SimulationState gSim;
+    FixedTimestep gSimClock(1.0 / 60.0, 4);
 
     // Task 1.10 Particle system
     ParticleSystem gParticleSystem;
 
+    // Simulate particles with compute shaders (toggled with P)
+    bool gGpuParticles = false;
+
+    // Sort particles back to front per view (toggled with O)
+    bool gSortParticles = false;
+
+    // Weighted blended transparency for particles (toggled with T); needs
+    // no sorting
+    bool gWeightedParticles = false;
+
+    // Particles are drawn at 1/gParticleDivisor of the resolution, then
+    // upsampled (see particle_target.hpp). Cycled through 1, 2, 4 with H.
+    int gParticleDivisor = 1;
+    constexpr std::uint32_t kGpuMaxParticles = 1u << 21;
+
+    // Views rendered in the previous frame; the particle budget scales
+    // emission for them
+    std::vector<ParticleView> gParticleViews;
+
     // Task 1.12 Performance profiler
     GPUProfiler gProfiler;
 
@@ -92,39 +130,60 @@ namespace
     PointLight gPointLights[3];
     bool gDirectionalLightEnabled = true;
 
-    // Task 1.7 cubic bezier curve
-    Vec3f bezier3(
-        Vec3f const& A,
-        Vec3f const& B,
-        Vec3f const& C,
-        Vec3f const& D,
-        float t
-    )
+    // Terrain heights for particle collisions. Baked from the mesh (which is
+    // in world space, the terrain's model matrix is the identity) and kept
+    // in the texture cache next to the compressed textures.
+    Heightfield loadTerrainHeightfield(char const* objPath, SimpleMeshData const& mesh)
     {
-        float it  = 1.f - t;
-        float it2 = it * it;
-        float t2  = t * t;
-
-        return
-            (it2*it) * A +
-            (3.f* it2*t)* B +
-            (3.f*it* t2) *C +
-            (t2*t)* D;
+        auto const cachePath = texture_cache_path(objPath, ".height");
+        if (texture_cache_fresh(objPath, cachePath))
+        {
+            if (auto cached = readHeightfield(cachePath.string().c_str()))
+                return std::move(*cached);
+        }
+
+        auto const startTime = std::chrono::steady_clock::now();
+        Heightfield hf = bakeHeightfield(mesh.positions);
+
+        std::error_code ec;
+        std::filesystem::create_directories(cachePath.parent_path(), ec);
+        if (ec || !writeHeightfield(cachePath.string().c_str(), hf))
+            std::print(stderr, "Warning: unable to write heightfield cache ’{}’\n", cachePath.string());
+
+        auto const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        std::print("Baked heightfield for ’{}’ ({}x{}) in {:.0f} ms\n", objPath, hf.width, hf.depth, ms);
+        return hf;
     }
 
-    // Scene rendering (terrain, spaceship, pads, particles)
-    void renderScene(
+    // World space bounds of the drawables, for frustum culling
+    struct SceneBounds
+    {
+        Aabb terrain;
+        Aabb ufo;
+        Aabb landingPads[2];
+        Aabb particles;
+        bool particlesBounded = false; // GPU particles have no CPU bounds and are never culled
+    };
+
+    // Point sprites reach beyond the particle positions
+    constexpr float kParticleCullMargin = 1.0f;
+
+    // Scene rendering (terrain, spaceship, pads, particles). Drawables
+    // outside the view frustum are skipped, with their uniforms.
+    CullStats renderScene(
         Mat44f const& viewProj,
         Vec3f const& camPosForLighting,
+        SceneBounds const& bounds,
         GLuint terrainVAO,
         SimpleMeshData const& terrainMeshData,
         GLuint terrainTexture,
+        VirtualTexture& terrainVt,
         ShaderProgram const& terrainProgram,
         Mat44f const& model,
         Vec3f const& lightDir,
         Vec3f const& ambientColor,
         Vec3f const& baseColor,
-        MeshGL const& ufoMesh,
+        UfoMesh const& ufo,
         Mat44f const& ufoModel,
         GLuint landingVao,
         SimpleMeshData const& landingMeshData,
@@ -132,10 +191,42 @@ namespace
         Vec3f const& landingPadPos1,
         Vec3f const& landingPadPos2,
         ShaderProgram const& particleProgram,
+        ParticleTarget& particleTarget,
+        float zNear,
+        float zFar,
+        StreamingBuffer& stream,
+        float projScaleY,
+        float viewportHeight,
         GPUProfiler& profiler,
         bool doProfile = true
     )
     {
+        // Visibility in this view
+        Frustum const frustum = makeFrustum(viewProj);
+        CullStats cull;
+        auto visible = [&] (Aabb const& box)
+        {
+            bool inside = intersects(frustum, box);
+            ++(inside ? cull.drawn : cull.culled);
+            return inside;
+        };
+
+        bool const terrainVisible = visible(bounds.terrain);
+        bool const ufoVisible     = visible(bounds.ufo);
+        bool const padVisible[2]  = { visible(bounds.landingPads[0]), visible(bounds.landingPads[1]) };
+
+        bool particlesVisible = false;
+        if (gParticleSystem.gpu || gParticleSystem.drawCount > 0)
+        {
+            if (bounds.particlesBounded)
+                particlesVisible = visible(bounds.particles);
+            else
+            {
+                particlesVisible = true;
+                ++cull.drawn;
+            }
+        }
+
         Mat44f terrainMvp   = viewProj * model;
         Mat44f ufoMvp       = viewProj * ufoModel;
         Mat33f normalMatrix = mat44_to_mat33(transpose(invert(model)));
@@ -157,94 +248,155 @@ namespace
             gPointLights[2].enabled ? 1 : 0
         };
 
+        // Record which virtual texture pages this view needs
+        if (terrainVisible)
+            terrainVt.draw_feedback(terrainMvp, terrainVAO, (GLsizei)terrainMeshData.positions.size());
+
+        // Terrain and spaceship share the program and its lighting
+        if (terrainVisible || ufoVisible)
+        {
+            glUseProgram(terrainProgram.programId());
+
+            glUniform3fv(2, 1, &lightDir.x);
+            glUniform3fv(4, 1, &ambientColor.x);
+            glUniform3fv(6, 1, &camPosForLighting.x);
+
+            // point lights (positions, colors, enabled)
+            glUniform3fv(7, 3, &pointLightPositions[0].x);
+            glUniform3fv(10, 3, &pointLightColorsArr[0].x);
+            glUniform1iv(13, 3, pointLightEnabledArr);
+            glUniform1i(16, gDirectionalLightEnabled ? 1 : 0); // toggles sunlight
+        }
+
         // Terrain rendering
-        GLuint progId = terrainProgram.programId();
-        glUseProgram(progId);
-
-        glUniform3fv(2, 1, &lightDir.x);
-        glUniform3fv(4, 1, &ambientColor.x);
-        glUniformMatrix3fv(1, 1, GL_TRUE, normalMatrix.v);
-        glUniform3fv(6, 1, &camPosForLighting.x);
-        glUniform1i(17, 1); // uUseTexture = 1
-
-        // point lights (positions, colors, enabled)
-        glUniform3fv(7, 3, &pointLightPositions[0].x);
-        glUniform3fv(10, 3, &pointLightColorsArr[0].x);
-        glUniform1iv(13, 3, pointLightEnabledArr);
-        glUniform1i(16, gDirectionalLightEnabled ? 1 : 0); // toggles sunlight
-
-        glUniformMatrix4fv(0, 1, GL_TRUE, terrainMvp.v); // uViewProj times model
-        glUniformMatrix4fv(18, 1, GL_TRUE, model.v);
-        glUniform3fv(3, 1, &baseColor.x);
-
-        // bind terrain texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, terrainTexture);
-        glUniform1i(5, 0);
-
-        // draw terrain
-        glBindVertexArray(terrainVAO);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)terrainMeshData.positions.size());
-        glBindVertexArray(0);
+        if (terrainVisible)
+        {
+            glUniformMatrix3fv(1, 1, GL_TRUE, normalMatrix.v);
+            glUniform1i(17, 1); // uUseTexture = 1
+
+            glUniformMatrix4fv(0, 1, GL_TRUE, terrainMvp.v); // uViewProj times model
+            glUniformMatrix4fv(18, 1, GL_TRUE, model.v);
+            glUniform3fv(3, 1, &baseColor.x);
+
+            // bind terrain texture (the full texture only until the virtual one is ready)
+            glUniform1i(5, texture_unit_index(TextureUnit::terrain));
+            if (terrainVt.ready())
+            {
+                terrainVt.bind_for_sampling();
+                glUniform1i(19, 1); // uVirtual = 1
+            }
+            else
+            {
+                bind_texture(TextureUnit::terrain, GL_TEXTURE_2D, terrainTexture);
+                glUniform1i(19, 0);
+            }
+
+            // draw terrain
+            glBindVertexArray(terrainVAO);
+            glDrawArrays(GL_TRIANGLES, 0, (GLsizei)terrainMeshData.positions.size());
+            glBindVertexArray(0);
+        }
         gpuStamp(profiler, Stamp::TerrainEnd, doProfile);
 
         // ----- UFO -----
-        glUniformMatrix3fv(1, 1, GL_TRUE, normalMatrix.v);
-        glUniformMatrix4fv(18, 1, GL_TRUE, ufoModel.v);
-        glBindVertexArray(ufoMesh.vao);
-        glUniform1i(17, 0); // uUseTexture = 0
+        if (ufoVisible)
+        {
+            // Detail level from the projected size in this view
+            int ufoLod = select_ufo_lod(ufo, ufoModel, camPosForLighting, projScaleY, viewportHeight);
+
+            glUniformMatrix3fv(1, 1, GL_TRUE, normalMatrix.v);
+            glUniformMatrix4fv(18, 1, GL_TRUE, ufoModel.v);
+            glBindVertexArray(ufo.mesh.vao);
+            glUniform1i(17, 0); // uUseTexture = 0
 
-        // Make diffuse/tint colour neutral so vertex colours are used directly
-        Vec3f ufoTint{ 1.0f, 1.0f, 1.0f };
-        glUniform3fv(3, 1, &ufoTint.x);
+            // Make diffuse/tint colour neutral so vertex colours are used directly
+            Vec3f ufoTint{ 1.0f, 1.0f, 1.0f };
+            glUniform3fv(3, 1, &ufoTint.x);
 
-        // One MVP for all UFO geometry
-        glUniformMatrix4fv(0, 1, GL_TRUE, ufoMvp.v);
+            // One MVP for all UFO geometry
+            glUniformMatrix4fv(0, 1, GL_TRUE, ufoMvp.v);
 
-        glDrawArrays(GL_TRIANGLES, 0, ufoMesh.vertexCount);
+            glDrawArrays(GL_TRIANGLES, ufo.lods[ufoLod].first, ufo.lods[ufoLod].count);
 
-        glBindVertexArray(0);
+            glBindVertexArray(0);
+        }
 
         gpuStamp(profiler, Stamp::UfoEnd, doProfile); 
         // Landing pads rendering
-        GLuint landingProgId = landingProgram.programId();
-        glUseProgram(landingProgId);
-
-        glUniformMatrix3fv(1, 1, GL_TRUE, normalMatrix.v);
-        glUniform3fv(2, 1, &lightDir.x);
-        glUniform3fv(4, 1, &ambientColor.x);
-        glUniform3fv(6, 1, &camPosForLighting.x);
-        glUniform3fv(7, 3, &pointLightPositions[0].x);
-        glUniform3fv(10, 3, &pointLightColorsArr[0].x);
-        glUniform1iv(13, 3, pointLightEnabledArr);
-        glUniform1i(16, gDirectionalLightEnabled ? 1 : 0);
-
-        glBindVertexArray(landingVao);
-
-        // first pad
-        Mat44f lpModel1 = make_translation(landingPadPos1);
-        glUniformMatrix4fv(0, 1, GL_TRUE, viewProj.v);
-        glUniformMatrix4fv(17, 1, GL_TRUE, lpModel1.v);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)landingMeshData.positions.size());
-
-        // second pad
-        Mat44f lpModel2 = make_translation(landingPadPos2);
-        glUniformMatrix4fv(0, 1, GL_TRUE, viewProj.v);
-        glUniformMatrix4fv(17, 1, GL_TRUE, lpModel2.v);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)landingMeshData.positions.size());
-
-        glBindVertexArray(0);
+        if (padVisible[0] || padVisible[1])
+        {
+            GLuint landingProgId = landingProgram.programId();
+            glUseProgram(landingProgId);
+
+            glUniformMatrix3fv(1, 1, GL_TRUE, normalMatrix.v);
+            glUniform3fv(2, 1, &lightDir.x);
+            glUniform3fv(4, 1, &ambientColor.x);
+            glUniform3fv(6, 1, &camPosForLighting.x);
+            glUniform3fv(7, 3, &pointLightPositions[0].x);
+            glUniform3fv(10, 3, &pointLightColorsArr[0].x);
+            glUniform1iv(13, 3, pointLightEnabledArr);
+            glUniform1i(16, gDirectionalLightEnabled ? 1 : 0);
+
+            glBindVertexArray(landingVao);
+
+            // first pad
+            if (padVisible[0])
+            {
+                Mat44f lpModel1 = make_translation(landingPadPos1);
+                glUniformMatrix4fv(0, 1, GL_TRUE, viewProj.v);
+                glUniformMatrix4fv(17, 1, GL_TRUE, lpModel1.v);
+                glDrawArrays(GL_TRIANGLES, 0, (GLsizei)landingMeshData.positions.size());
+            }
+
+            // second pad
+            if (padVisible[1])
+            {
+                Mat44f lpModel2 = make_translation(landingPadPos2);
+                glUniformMatrix4fv(0, 1, GL_TRUE, viewProj.v);
+                glUniformMatrix4fv(17, 1, GL_TRUE, lpModel2.v);
+                glDrawArrays(GL_TRIANGLES, 0, (GLsizei)landingMeshData.positions.size());
+            }
+
+            glBindVertexArray(0);
+        }
 
         gpuStamp(profiler, Stamp::PadsEnd, doProfile);
 
-        // Particle rendering
-        renderParticles(
-            gParticleSystem,
-            particleProgram.programId(),
-            viewProj.v,
-            camPosForLighting
-        );
+        // Particle rendering, optionally sorted back to front for this view.
+        // The budget sees the view either way.
+        gParticleViews.push_back({ viewProj, camPosForLighting, projScaleY, viewportHeight });
+
+        if (particlesVisible)
+        {
+            ParticleDrawOrder particleOrder;
+            if (gSortParticles && !gWeightedParticles)
+            {
+                auto const sortStart = Clock::now();
+                particleOrder = sortParticlesForView(gParticleSystem, viewProj, stream, shared_thread_pool());
+                gpuAddParticleSortTime(profiler, std::chrono::duration<double, std::milli>(Clock::now() - sortStart).count());
+            }
+
+            // Offscreen at a lower resolution and/or order independent
+            bool const offscreen = gParticleDivisor > 1 || gWeightedParticles;
+            if (offscreen)
+                particleTarget.begin(gParticleDivisor, zNear, zFar, gWeightedParticles ? ParticleBlend::weighted : ParticleBlend::over);
+
+            renderParticles(
+                gParticleSystem,
+                particleProgram.programId(),
+                viewProj.v,
+                camPosForLighting,
+                particleOrder,
+                offscreen ? &particleTarget : nullptr
+            );
+
+            if (offscreen)
+                particleTarget.composite();
+        }
+
+        gpuStamp(profiler, Stamp::ParticlesEnd, doProfile);
         // Note: profilerEndFrame is called after renderScene returns
+        return cull;
     }
 
 } // namespace
@@ -318,6 +470,9 @@ int main() try
     // Initialize performance profiler (Task 1.12)
     gpuInit(gProfiler);
 
+    // All textures are loaded through the registry
+    TextureRegistry textures( kTextureBudgetBytes );
+
     OGL_CHECKPOINT_ALWAYS();
 
     // Global GL state
@@ -342,6 +497,9 @@ int main() try
     SimpleMeshData terrainMeshData = load_wavefront_obj("assets/cw2/parlahti.obj");
     GLuint terrainVAO = create_vao(terrainMeshData);
 
+    // Particles collide with the terrain (see gParticleSystem.ground below)
+    Heightfield const terrainHeightfield = loadTerrainHeightfield("assets/cw2/parlahti.obj", terrainMeshData);
+
     ShaderProgram terrainProgram({
         { GL_VERTEX_SHADER,   "assets/cw2/default.vert" },
         { GL_FRAGMENT_SHADER, "assets/cw2/default.frag" }
@@ -361,16 +519,20 @@ int main() try
     // =====================
     UfoMesh ufo = create_ufo_mesh();
 
-    MeshGL ufoMesh          = ufo.mesh;
-
     float bulbRingY         = ufo.bulbRingY;
     float bulbRadius        = ufo.bulbRadius;
     
     // =====================
 
-    // Load terrain texture
-    GLuint terrainTexture =
-        load_texture_2d( (ASSETS + terrainMeshData.texture_filepath).c_str() );
+    // Terrain texture: a virtual texture, so only the visible pages are on the
+    // GPU. The full texture is only loaded while the page file is built (first
+    // run); a placeholder is shown until that is uploaded.
+    VirtualTexture terrainVt( (ASSETS + terrainMeshData.texture_filepath).c_str(), shared_thread_pool() );
+    TextureHandle terrainVtHandle;
+
+    TextureHandle terrainTexture;
+    if (!terrainVt.ready())
+        terrainTexture = textures.load_2d_async( (ASSETS + terrainMeshData.texture_filepath).c_str() );
 
     // Landing pad shaders
     ShaderProgram landingProgram({
@@ -386,13 +548,37 @@ int main() try
     load_wavefront_obj("assets/cw2/landingpad.obj");
     GLuint landingVao = create_vao(landingMeshData);
 
+    // World space bounds for frustum culling. The spaceship's and the
+    // particles' are updated every frame.
+    SceneBounds sceneBounds;
+    sceneBounds.terrain = transformBounds(boundsOf(terrainMeshData.positions), model);
+    Aabb const landingBounds = boundsOf(landingMeshData.positions);
+    sceneBounds.landingPads[0] = transformBounds(landingBounds, make_translation(landingPadPos1));
+    sceneBounds.landingPads[1] = transformBounds(landingBounds, make_translation(landingPadPos2));
+
+    Vec3f const ufoRadius{ ufo.boundsRadius, ufo.boundsRadius, ufo.boundsRadius };
+    Aabb const ufoLocalBounds{ ufo.boundsCenter - ufoRadius, ufo.boundsCenter + ufoRadius };
+
     // UI setup (task 1.11)
     ShaderProgram uiShader({
         {GL_VERTEX_SHADER,"assets/cw2/ui.vert"},
         {GL_FRAGMENT_SHADER,"assets/cw2/ui.frag"}
     });
 
-    UIRenderer uiRenderer(1280, 720, uiShader); // initial size
+    // Particle effects share one pool, sized for their budgets
+    initSimulation(gSim, gParticleSystem, landingPadPos1);
+    gParticleSystem.ground.heightfield = &terrainHeightfield;
+
+    // Per-frame dynamic data (packed particle vertices, sorted indices for
+    // two views and UI vertices). Each frame's region fits a full particle
+    // pool plus 1 MiB for the UI.
+    StreamingBuffer frameStream(
+        std::size_t(gParticleSystem.capacity) * (3 * sizeof(std::uint16_t) + sizeof(std::uint32_t) + 2 * sizeof(std::uint32_t)) + (1u << 20)
+    );
+
+    UIRenderer uiRenderer(1280, 720, uiShader, frameStream); // initial size
+    TextureHandle fontAtlas = textures.track_external("font atlas", uiRenderer.atlasTexture(), uiRenderer.atlasBytes());
+    uiRenderer.takeAtlasChanged(); // tracked as it is now
 
     Button launchButton{"Launch", 0, 0, 120, 40,
                         {0.0f, 0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}};
@@ -415,7 +601,22 @@ int main() try
         {GL_FRAGMENT_SHADER, "assets/cw2/particle.frag"}
     });
 
-    initParticleSystem(gParticleSystem, "assets/cw2/particle.png");
+    // Small textures share one texture array, so they never need separate binds
+    char const* const smallTextures[] = {
+        "assets/cw2/particle.png"
+    };
+    TextureAtlas smallAtlas = build_texture_atlas(smallTextures);
+    TextureHandle smallAtlasHandle = textures.track_external("small texture atlas", smallAtlas.texture, smallAtlas.bytes);
+
+    initParticleSystem(gParticleSystem, smallAtlasHandle, smallAtlas.regions[0]);
+
+    // gParticleSystem is a global; its GL objects (and GPU particles, if
+    // toggled on) must go before the window and the texture registry
+    ParticleSystemCleanupHelper particleCleanupHelper;
+
+    // Offscreen particle pass (when gParticleDivisor > 1 or
+    // gWeightedParticles)
+    ParticleTarget particleTarget;
 
     OGL_CHECKPOINT_ALWAYS();
 
@@ -445,14 +646,15 @@ int main() try
             glViewport( 0, 0, nwidth, nheight );
         }
 
-        // Time step (dt)
+        // Time step: the simulation advances in fixed steps of dt (see
+        // fixed_timestep.hpp), however long the frame took
         static double lastTime = glfwGetTime();
         double currentTime = glfwGetTime();
-        float dt = static_cast<float>(currentTime - lastTime);
+        int simSteps = gSimClock.advance(currentTime - lastTime);
         lastTime = currentTime;
+        gpuSetSimulationStats(gProfiler, gSimClock.stats());
 
-        if (gUfoAnim.active && !gUfoAnim.paused)
-            gUfoAnim.time += dt;
+        float const dt = float(gSimClock.step());
 
         // Task 1.7 Projection 
         float aspect = fbwidth / fbheight;
@@ -462,83 +664,57 @@ int main() try
 
         Mat44f proj = make_perspective_projection(fovRadians, aspect, zNear, zFar);
 
-        // spaceship above first landing pad
-        Vec3f ufoStartPos{
-            landingPadPos1.x,
-            landingPadPos1.y + 1.3f,
-            landingPadPos1.z
-        };
-
-        float lightRadius = bulbRadius;
-
-        Vec3f lightOffset0{  lightRadius, bulbRingY - 0.35f, 0.0f };
-        Vec3f lightOffset1{ -0.5f * lightRadius, bulbRingY - 0.35f,
-                             0.866025f * lightRadius };
-        Vec3f lightOffset2{ -0.5f * lightRadius, bulbRingY - 0.35f,
-                            -0.866025f * lightRadius };
-
-        // inital spaceship before launching (erect on landing pad)
-        Vec3f ufoPos    = ufoStartPos;
-        Vec3f forwardWS{ 0.f, 1.f, 0.f };
-        Vec3f rightWS  { 1.f, 0.f, 0.f };
-        Vec3f upWS     { 0.f, 0.f, 1.f };
-
-        float u = 0.0f;
-
-        if (gUfoAnim.active)
+        // Switch between CPU and GPU simulation; both start out empty
+        if (gGpuParticles != bool(gParticleSystem.gpu))
         {
-            float totalTime = 12.0f; // duration of animation
-            float tAnim = gUfoAnim.time;
-            if (tAnim < 0.f)       tAnim = 0.f;
-            if (tAnim > totalTime) tAnim = totalTime;
-
-            float s = tAnim / totalTime;
-            u = s * s;
-
-            float rangeZ    = 140.0f;
-            float maxHeight = 80.0f;
+            resetParticleSystem(gParticleSystem);
+            if (gGpuParticles)
+                gParticleSystem.gpu = std::make_unique<GpuParticles>(kGpuMaxParticles);
+            else
+                gParticleSystem.gpu.reset();
+        }
 
-            float x0 = ufoStartPos.x;
-            float y0 = ufoStartPos.y;
-            float z0 = ufoStartPos.z;
+        // Emission rates and point sizes for what was on screen last frame.
+        // The fill budget is in full resolution pixels, of which a low
+        // resolution pass draws 1/divisor^2.
+        ParticleBudgetConfig particleBudget;
+        particleBudget.maxFillPixels *= double(gParticleDivisor * gParticleDivisor);
+        gpuAddParticleBudget(gProfiler, applyParticleBudget(gParticleSystem, gParticleViews, particleBudget));
+        gpuSetParticleResolution(gProfiler, gParticleDivisor);
+        gParticleViews.clear();
 
-            // Bezier controls for curved take off path
-            Vec3f A = ufoStartPos;
-            Vec3f B{ x0, y0 + maxHeight * 0.7f,z0 };
-            Vec3f C{ x0, y0 + maxHeight, z0 + rangeZ * 0.55f };
-            Vec3f D{ x0, y0 + maxHeight * 0.2f, z0 + rangeZ };
+        for (int step = 0; step < simSteps; ++step)
+        {
+            SimulationStep const simStep = stepSimulation(gSim, dt, shared_thread_pool(), bool(gParticleSystem.gpu));
 
-            ufoPos = bezier3(A, B, C, D, u); // position on curve
+            if (gParticleSystem.gpu && simStep.advanceParticles)
+            {
+                UfoPose const& stepPose = simStep.pose;
+                gParticleSystem.gpu->simulate(dt, simStep.gpuSpawnCount, simStep.enginePrev, simStep.engineCurr, stepPose.forward, stepPose.right, stepPose.up);
+            }
+        }
 
-            // approximates tangent by sampling slightly ahead on the curve
-            float eps = 0.001f;
-            float u2 = u + eps;
-            if (u2 > 1.0f) u2 = 1.0f;
+        // Rendered state, between the last two steps. Resetting the
+        // animation moves its time back; that is not interpolated.
+        float const alpha = gSimClock.alpha();
+        float renderAnimTime = gSim.ufoAnim.time;
+        if (gSim.ufoAnim.prevTime <= gSim.ufoAnim.time)
+            renderAnimTime = gSim.ufoAnim.prevTime + (gSim.ufoAnim.time - gSim.ufoAnim.prevTime) * alpha;
 
-            Vec3f posAhead = bezier3(A, B, C, D, u2);
-            Vec3f vel = posAhead - ufoPos;
-            float speed = length(vel);
+        Camera renderCamera = gSim.camera;
+        renderCamera.position = gSim.prevCameraPos + (gSim.camera.position - gSim.prevCameraPos) * alpha;
 
-            if (speed > 1e-4f)
-            {
-                forwardWS = vel / speed;
+        UfoPose pose = computeUfoPose(gSim.ufoAnim.active, renderAnimTime, ufoStartPosition(landingPadPos1));
+        Vec3f ufoPos    = pose.position;
+        Vec3f forwardWS = pose.forward;
 
-                Vec3f worldUp{ 0.f, 1.f, 0.f };
-                if (std::fabs(dot(forwardWS, worldUp)) > 0.99f)
-                    worldUp = Vec3f{ 1.f, 0.f, 0.f };
+        float lightRadius = bulbRadius;
 
-                rightWS = normalize(cross(worldUp, forwardWS));
-                upWS    = cross(forwardWS, rightWS);
-            }
-        }
-        else
-        {
-            // space ship pointing upwards on landing pad before launch (idle)
-            ufoPos    = ufoStartPos;
-            forwardWS = Vec3f{ 0.f, 1.f, 0.f };
-            rightWS   = Vec3f{ 1.f, 0.f, 0.f };
-            upWS      = Vec3f{ 0.f, 0.f, 1.f };
-        }
+        Vec3f lightOffset0{  lightRadius, bulbRingY - 0.35f, 0.0f };
+        Vec3f lightOffset1{ -0.5f * lightRadius, bulbRingY - 0.35f,
+                             0.866025f * lightRadius };
+        Vec3f lightOffset2{ -0.5f * lightRadius, bulbRingY - 0.35f,
+                            -0.866025f * lightRadius };
 
         // Orient spaceship to follow path direction
         float fy = std::clamp(forwardWS.y, -1.0f, 1.0f);
@@ -580,49 +756,6 @@ int main() try
         gPointLights[1].position = ufoPos + lightOffset1;
         gPointLights[2].position = ufoPos + lightOffset2;
 
-        // Particle emission and simulation
-// At top of main loop scope (inside while, but before any emission logic)
-static bool  firstEngineFrame = true;
-static Vec3f prevEnginePos{};
-
-// Particle emission and simulation
-if (gUfoAnim.active && !gUfoAnim.paused)
-{
-    Vec3f enginePosCurr = ufoPos - forwardWS * 1.2f;
-
-    if (firstEngineFrame)
-    {
-        // First frame after (re)starting animation: no history yet
-        prevEnginePos   = enginePosCurr;
-        firstEngineFrame = false;
-    }
-
-    emitParticles(
-        gParticleSystem,
-        dt,
-        prevEnginePos,
-        enginePosCurr,
-        forwardWS,
-        rightWS,
-        upWS
-    );
-
-    prevEnginePos = enginePosCurr;
-}
-else
-{
-    // When animation is paused / reset, reset the "first frame" flag
-    firstEngineFrame = true;
-}
-
-        if (!gUfoAnim.paused)
-        {
-            updateParticles(gParticleSystem, dt);
-        }
-
-        // Camera movement
-        updateCameraMovement(gCamera, dt);
-
         // Update button positions
         float buttonY = fbheight - 60.0f;
         launchButton.x = fbwidth / 2.0f - 70.0f;
@@ -630,13 +763,41 @@ else
         resetButton.x  = fbwidth / 2.0f + 70.0f;
         resetButton.y  = buttonY;
 
-        // Upload alive particles to VBO
-        uploadParticleData(gParticleSystem);
+        // Upload alive particles (waits if the GPU still reads this
+        // frame's region of the streaming buffer), moved back to the
+        // rendered time
+        frameStream.begin_frame();
+        float particleTimeOffset = gSim.ufoAnim.paused ? 0.0f : (alpha - 1.0f) * dt;
+        uploadParticleData(gParticleSystem, frameStream, particleTimeOffset);
+
+        // Bounds of the moving drawables, as rendered. Particle bounds come
+        // from the positions that were just uploaded.
+        sceneBounds.ufo = transformBounds(ufoLocalBounds, ufoModel);
+        sceneBounds.particlesBounded = !gParticleSystem.gpu;
+        if (sceneBounds.particlesBounded)
+        {
+            ParticleVertexBounds const& drawn = gParticleSystem.drawBounds;
+            sceneBounds.particles = expandBounds(Aabb{ drawn.min, drawn.min + drawn.extent }, kParticleCullMargin);
+        }
+
+        // Stream in the terrain pages requested by earlier frames
+        terrainVt.update();
+        if (terrainVt.ready())
+        {
+            terrainTexture = TextureHandle{}; // full texture no longer needed
+
+            std::size_t vtBytes = terrainVt.stats().gpuBytes;
+            if (!terrainVtHandle)
+                terrainVtHandle = textures.track_external("terrain virtual texture", terrainVt.physical_texture(), vtBytes);
+            else
+                textures.update_external(terrainVtHandle, terrainVt.physical_texture(), vtBytes);
+        }
 
         // Begin rendering (draw scene)
         OGL_CHECKPOINT_DEBUG();
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        terrainVt.begin_feedback((GLsizei)fbwidth, (GLsizei)fbheight);
 
         // Start GPU and CPU timing
        gpuBegin(gProfiler);
@@ -650,7 +811,7 @@ else
 
             CameraResult camResult = computeCameraView(
                 gCameraMode,
-                gCamera,
+                renderCamera,
                 ufoPos,
                 forwardWS,
                 landingPadPos1
@@ -658,18 +819,20 @@ else
 
             Mat44f viewProj = proj * camResult.view;
 
-            renderScene(
+            CullStats cull = renderScene(
                 viewProj,
                 camResult.position,
+                sceneBounds,
                 terrainVAO,
                 terrainMeshData,
-                terrainTexture,
+                terrainTexture.id(),
+                terrainVt,
                 terrainProgram,
                 model,
                 lightDir,
                 ambientColor,
                 baseColor,
-                ufoMesh,
+                ufo,
                 ufoModel,
                 landingVao,
                 landingMeshData,
@@ -677,8 +840,15 @@ else
                 landingPadPos1,
                 landingPadPos2,
                 particleProgram,
+                particleTarget,
+                zNear,
+                zFar,
+                frameStream,
+                proj[1,1],
+                fbheight,
                 gProfiler
             );
+            gpuAddCullStats(gProfiler, 0, cull);
         }
         else
         {
@@ -696,7 +866,7 @@ else
 
             CameraResult camResult1 = computeCameraView(
                 gCameraMode,
-                gCamera,
+                renderCamera,
                 ufoPos,
                 forwardWS,
                 landingPadPos1
@@ -704,18 +874,20 @@ else
 
             Mat44f viewProj1 = projLeft * camResult1.view;
 
-            renderScene(
+            CullStats cull1 = renderScene(
                 viewProj1,
                 camResult1.position,
+                sceneBounds,
                 terrainVAO,
                 terrainMeshData,
-                terrainTexture,
+                terrainTexture.id(),
+                terrainVt,
                 terrainProgram,
                 model,
                 lightDir,
                 ambientColor,
                 baseColor,
-                ufoMesh,
+                ufo,
                 ufoModel,
                 landingVao,
                 landingMeshData,
@@ -723,8 +895,15 @@ else
                 landingPadPos1,
                 landingPadPos2,
                 particleProgram,
+                particleTarget,
+                zNear,
+                zFar,
+                frameStream,
+                projLeft[1,1],
+                float(fullHeight),
                 gProfiler, true
             );
+            gpuAddCullStats(gProfiler, 0, cull1);
 
             // Right view (secondary camera mode)
             glViewport(leftWidth, 0, rightWidth, fullHeight);
@@ -734,7 +913,7 @@ else
 
             CameraResult camResult2 = computeCameraView(
                 gCameraMode2,
-                gCamera,
+                renderCamera,
                 ufoPos,
                 forwardWS,
                 landingPadPos1
@@ -742,18 +921,20 @@ else
 
             Mat44f viewProj2 = projRight * camResult2.view;
 
-            renderScene(
+            CullStats cull2 = renderScene(
                 viewProj2,
                 camResult2.position,
+                sceneBounds,
                 terrainVAO,
                 terrainMeshData,
-                terrainTexture,
+                terrainTexture.id(),
+                terrainVt,
                 terrainProgram,
                 model,
                 lightDir,
                 ambientColor,
                 baseColor,
-                ufoMesh,
+                ufo,
                 ufoModel,
                 landingVao,
                 landingMeshData,
@@ -761,13 +942,22 @@ else
                 landingPadPos1,
                 landingPadPos2,
                 particleProgram,
+                particleTarget,
+                zNear,
+                zFar,
+                frameStream,
+                projRight[1,1],
+                float(fullHeight),
                 gProfiler, false
             );
+            gpuAddCullStats(gProfiler, 1, cull2);
 
             // Restore full viewport
             glViewport(0, 0, (int)fbwidth, (int)fbheight);
         }
 
+        terrainVt.end_feedback(); // read back asynchronously
+
         // End GPU and CPU timing
         cpuSubmitEnd(gProfiler);
         gpuStamp(gProfiler, Stamp::FrameEnd);   // after ALL scene rendering (including particles)
@@ -791,35 +981,48 @@ else
         // Launch button (start/pause animation)
         if (uiRenderer.renderButton(launchButton, gMouseX, gMouseY, gMouseLeftDown))
         {
-            if (!gUfoAnim.active)
+            if (!gSim.ufoAnim.active)
             {
-                gUfoAnim.active = true;
-                gUfoAnim.paused = false;
-                gUfoAnim.time = 0.f;
+                gSim.ufoAnim.active = true;
+                gSim.ufoAnim.paused = false;
+                gSim.ufoAnim.time = 0.f;
             }
             else
             {
-                gUfoAnim.paused = !gUfoAnim.paused;
+                gSim.ufoAnim.paused = !gSim.ufoAnim.paused;
             }
         }
 
         // Reset button (stops animation and clears particles)
         if (uiRenderer.renderButton(resetButton, gMouseX, gMouseY, gMouseLeftDown))
         {
-            gUfoAnim.active = false;
-            gUfoAnim.paused = false;
-            gUfoAnim.time = 0.f;
+            gSim.ufoAnim.active = false;
+            gSim.ufoAnim.paused = false;
+            gSim.ufoAnim.time = 0.f;
 
-            resetParticles(gParticleSystem);
+            resetParticleSystem(gParticleSystem);
         }
 
         uiRenderer.endFrame(); // flush the UI
+        frameStream.end_frame();
+
+        // The font atlas grows when new glyphs don't fit
+        if (uiRenderer.takeAtlasChanged())
+            textures.update_external(fontAtlas, uiRenderer.atlasTexture(), uiRenderer.atlasBytes());
+
+        // Finish async texture uploads and enforce the texture budget
+        textures.end_frame();
+        gpuSetTextureStats(gProfiler, textures.stats());
+        gpuAddTextureBinds(gProfiler, take_texture_bind_stats());
+        gpuSetVirtualTextureStats(gProfiler, terrainVt.stats());
+        gpuSetStreamingStats(gProfiler, frameStream.stats());
 
 
         glfwSwapBuffers( window );
     }
 
     // Cleanup
+    glDeleteTextures(1, &smallAtlas.texture);
     gpuDestroy(gProfiler);
 
     return 0;
@@ -853,17 +1056,17 @@ namespace
 
         // Movement controls
         if (aKey == GLFW_KEY_W)
-            gCamera.moveForward = pressed || (aAction == GLFW_REPEAT);
+            gSim.camera.moveForward = pressed || (aAction == GLFW_REPEAT);
         else if (aKey == GLFW_KEY_S)
-            gCamera.moveBackward = pressed || (aAction == GLFW_REPEAT);
+            gSim.camera.moveBackward = pressed || (aAction == GLFW_REPEAT);
         else if (aKey == GLFW_KEY_A)
-            gCamera.moveLeft = pressed || (aAction == GLFW_REPEAT);
+            gSim.camera.moveLeft = pressed || (aAction == GLFW_REPEAT);
         else if (aKey == GLFW_KEY_D)
-            gCamera.moveRight = pressed || (aAction == GLFW_REPEAT);
+            gSim.camera.moveRight = pressed || (aAction == GLFW_REPEAT);
         else if (aKey == GLFW_KEY_E)
-            gCamera.moveUp = pressed || (aAction == GLFW_REPEAT);
+            gSim.camera.moveUp = pressed || (aAction == GLFW_REPEAT);
         else if (aKey == GLFW_KEY_Q)
-            gCamera.moveDown = pressed || (aAction == GLFW_REPEAT);
+            gSim.camera.moveDown = pressed || (aAction == GLFW_REPEAT);
 
         // Light toggles
         if (aAction == GLFW_PRESS)
@@ -880,37 +1083,53 @@ namespace
 
         // Speed modifiers
         if (aKey == GLFW_KEY_LEFT_SHIFT || aKey == GLFW_KEY_RIGHT_SHIFT)
-            gCamera.fast = pressed || (aAction == GLFW_REPEAT);
+            gSim.camera.fast = pressed || (aAction == GLFW_REPEAT);
         if (aKey == GLFW_KEY_LEFT_CONTROL || aKey == GLFW_KEY_RIGHT_CONTROL)
-            gCamera.slow = pressed || (aAction == GLFW_REPEAT);
+            gSim.camera.slow = pressed || (aAction == GLFW_REPEAT);
 
         // Spaceship animation controls (keyboard)
         if (aKey == GLFW_KEY_F && aAction == GLFW_PRESS)
         {
-            if (!gUfoAnim.active)
+            if (!gSim.ufoAnim.active)
             {
-                gUfoAnim.active = true;
-                gUfoAnim.paused = false;
-                gUfoAnim.time   = 0.f;
+                gSim.ufoAnim.active = true;
+                gSim.ufoAnim.paused = false;
+                gSim.ufoAnim.time   = 0.f;
             }
             else
             {
-                gUfoAnim.paused = !gUfoAnim.paused;
+                gSim.ufoAnim.paused = !gSim.ufoAnim.paused;
             }
         }
 
         if (aKey == GLFW_KEY_R && aAction == GLFW_PRESS)
         {
-            gUfoAnim.active = false;
-            gUfoAnim.paused = false;
-            gUfoAnim.time   = 0.f;
-            resetParticles(gParticleSystem);
+            gSim.ufoAnim.active = false;
+            gSim.ufoAnim.paused = false;
+            gSim.ufoAnim.time   = 0.f;
+            resetParticleSystem(gParticleSystem);
         }
 
         // Toggles splitscreen with V
         if (aKey == GLFW_KEY_V && aAction == GLFW_PRESS)
             gSplitScreenEnabled = !gSplitScreenEnabled;
 
+        // Toggles GPU particle simulation with P
+        if (aKey == GLFW_KEY_P && aAction == GLFW_PRESS)
+            gGpuParticles = !gGpuParticles;
+
+        // Toggles particle depth sorting with O
+        if (aKey == GLFW_KEY_O && aAction == GLFW_PRESS)
+            gSortParticles = !gSortParticles;
+
+        // Toggles weighted blended particle transparency with T
+        if (aKey == GLFW_KEY_T && aAction == GLFW_PRESS)
+            gWeightedParticles = !gWeightedParticles;
+
+        // Cycles the particle resolution (full, half, quarter) with H
+        if (aKey == GLFW_KEY_H && aAction == GLFW_PRESS)
+            gParticleDivisor = gParticleDivisor >= 4 ? 1 : gParticleDivisor * 2;
+
         // Camera mode cycling (C for left, Shift+C for right)
         if (aKey == GLFW_KEY_C && aAction == GLFW_PRESS)
         {
@@ -949,12 +1168,12 @@ namespace
         // Right mouse button toggles mouse capture for camera look
         if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
         {
-            gCamera.mouseCaptured = !gCamera.mouseCaptured;
+            gSim.camera.mouseCaptured = !gSim.camera.mouseCaptured;
 
-            if (gCamera.mouseCaptured)
+            if (gSim.camera.mouseCaptured)
             {
                 glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-                gCamera.firstMouse = true;
+                gSim.camera.firstMouse = true;
             }
             else
             {
@@ -968,7 +1187,7 @@ namespace
         gMouseX = xpos;
         gMouseY = ypos;
 
-        handleCameraMouseMovement(gCamera, xpos, ypos);
+        handleCameraMouseMovement(gSim.camera, xpos, ypos);
     }
 
     GLFWCleanupHelper::~GLFWCleanupHelper()
@@ -981,4 +1200,9 @@ namespace
         if( window )
             glfwDestroyWindow( window );
     }
+
+    ParticleSystemCleanupHelper::~ParticleSystemCleanupHelper()
+    {
+        releaseParticleSystem( gParticleSystem );
+    }
 }
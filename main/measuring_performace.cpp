@@ -18,7 +18,7 @@ void gpuInit(GPUProfiler& p)
     p.frame = 0;
     p.samples = 0;
 
-    p.accTerrain = p.accUfo = p.accPads = p.accTotal = 0.0;
+    p.accTerrain = p.accUfo = p.accPads = p.accParticles = p.accTotal = 0.0;
     p.accCpuFrame = p.accCpuSubmit = 0.0;
 
     p.lastFrame = Clock::now();
@@ -73,6 +73,63 @@ void cpuSubmitEnd(GPUProfiler& p)
     p.accCpuSubmit += dt.count() * 1000.0;
 }
 
+void gpuSetTextureStats(GPUProfiler& p, TextureStats const& stats)
+{
+    p.textures = stats;
+}
+
+void gpuAddTextureBinds(GPUProfiler& p, TextureBindStats const& binds)
+{
+    p.accBindsRequested += double(binds.requested);
+    p.accBindsIssued    += double(binds.issued);
+    p.bindFrames++;
+}
+
+void gpuSetVirtualTextureStats(GPUProfiler& p, VirtualTextureStats const& stats)
+{
+    p.virtualTexture = stats;
+}
+
+void gpuSetStreamingStats(GPUProfiler& p, StreamingBufferStats const& stats)
+{
+    p.streaming = stats;
+}
+
+void gpuAddParticleSortTime(GPUProfiler& p, double ms)
+{
+    p.accParticleSort += ms;
+    p.particleSorts++;
+}
+
+void gpuSetSimulationStats(GPUProfiler& p, FixedTimestepStats const& stats)
+{
+    p.simulation = stats;
+}
+
+void gpuSetParticleResolution(GPUProfiler& p, int divisor)
+{
+    p.particleDivisor = divisor;
+}
+
+void gpuAddCullStats(GPUProfiler& p, int view, CullStats const& stats)
+{
+    if (view < 0 || view >= kCullViews)
+        return;
+
+    p.accDrawn[view]  += double(stats.drawn);
+    p.accCulled[view] += double(stats.culled);
+    p.cullFrames[view]++;
+}
+
+void gpuAddParticleBudget(GPUProfiler& p, ParticleBudgetStats const& stats)
+{
+    p.accParticleFill += stats.fill;
+    p.accParticleFillRequested += stats.requestedFill;
+    p.particleBudgetFrames++;
+    if (stats.limited > 0)
+        p.particleLimitedFrames++;
+}
+
 void gpuEndAndCollect(GPUProfiler& p)
 {
     if (!p.initialised) return;
@@ -99,11 +156,13 @@ void gpuEndAndCollect(GPUProfiler& p)
             double terrain = ns_to_ms(t[(int)Stamp::TerrainEnd] - t[(int)Stamp::FrameStart]);
             double ufo     = ns_to_ms(t[(int)Stamp::UfoEnd]     - t[(int)Stamp::TerrainEnd]);
             double pads    = ns_to_ms(t[(int)Stamp::PadsEnd]    - t[(int)Stamp::UfoEnd]);
+            double particles = ns_to_ms(t[(int)Stamp::ParticlesEnd] - t[(int)Stamp::PadsEnd]);
             double total   = ns_to_ms(t[(int)Stamp::FrameEnd]   - t[(int)Stamp::FrameStart]);
 
             p.accTerrain += terrain;
             p.accUfo     += ufo;
             p.accPads    += pads;
+            p.accParticles += particles;
             p.accTotal   += total;
 
             p.samples++;
@@ -121,6 +180,7 @@ void gpuEndAndCollect(GPUProfiler& p)
         double avgTerrain = p.accTerrain * inv;
         double avgUfo     = p.accUfo * inv;
         double avgPads    = p.accPads * inv;
+        double avgParticles = p.accParticles * inv;
         double avgTotal   = p.accTotal * inv;
         double avgCpuF    = p.accCpuFrame * inv;
         double avgCpuSub  = p.accCpuSubmit * inv;
@@ -130,15 +190,92 @@ void gpuEndAndCollect(GPUProfiler& p)
         std::print("  Terrain:       {:7.3f} ms\n", avgTerrain);
         std::print("  Spaceship:     {:7.3f} ms\n", avgUfo);
         std::print("  Landing Pads:  {:7.3f} ms\n", avgPads);
+        if (p.particleDivisor > 1)
+            std::print("  Particles:     {:7.3f} ms (1/{} resolution)\n", avgParticles, p.particleDivisor);
+        else
+            std::print("  Particles:     {:7.3f} ms\n", avgParticles);
         std::print("  Total GPU:     {:7.3f} ms ({:.1f} FPS potential)\n", avgTotal, 1000.0 / avgTotal);
 
         std::print("CPU Timing (std::chrono):\n");
         std::print("  Frame-to-Frame:{:7.3f} ms ({:.1f} FPS actual)\n", avgCpuF, 1000.0 / avgCpuF);
         std::print("  Submit Time:   {:7.3f} ms\n", avgCpuSub);
+        if (p.particleSorts > 0)
+            std::print("  Particle Sort: {:7.3f} ms ({} views sorted)\n", p.accParticleSort * inv, p.particleSorts);
+        if (p.particleBudgetFrames > 0)
+        {
+            double invBudget = 1e-6 / double(p.particleBudgetFrames);
+            std::print("  Particle Fill: {:7.2f} Mpx/frame est. ({:.2f} requested, limited in {} frames)\n",
+                p.accParticleFill * invBudget, p.accParticleFillRequested * invBudget, p.particleLimitedFrames);
+        }
+
+        // Frustum culling, per view
+        for (int view = 0; view < kCullViews; ++view)
+        {
+            if (p.cullFrames[view] == 0)
+                continue;
+
+            if (view == 0)
+                std::print("Culling (per frame):\n");
+            double invCull = 1.0 / double(p.cullFrames[view]);
+            std::print("  View {}:        {:7.2f} drawn, {:.2f} culled\n", view + 1,
+                p.accDrawn[view] * invCull, p.accCulled[view] * invCull);
+
+            p.accDrawn[view] = p.accCulled[view] = 0.0;
+            p.cullFrames[view] = 0;
+        }
+
+        // Steps and hitches since the previous print
+        auto const& sim = p.simulation;
+        auto const& simPrev = p.simulationPrev;
+        std::size_t simFrames = sim.frames - simPrev.frames;
+        if (simFrames > 0)
+        {
+            std::print("Simulation (fixed steps):\n");
+            std::print("  Steps/frame:   {:7.2f} ({} clamped frames, {:.1f} ms dropped)\n",
+                double(sim.steps - simPrev.steps) / double(simFrames), sim.clampedFrames - simPrev.clampedFrames,
+                (sim.droppedSeconds - simPrev.droppedSeconds) * 1000.0);
+        }
+        p.simulationPrev = sim;
+
+        auto const& t = p.textures;
+        constexpr double kMiB = 1024.0 * 1024.0;
+        std::print("Textures:\n");
+        std::print("  Resident:      {:7.2f} / {:.2f} MiB ({} textures, {} referenced, {} downscaled)\n",
+            t.residentBytes / kMiB, t.budgetBytes / kMiB, t.textures, t.referenced, t.downscaled);
+        std::print("  Loads:         {:7} ({} deduplicated, {} pending)\n", t.loads, t.dedupHits, t.pending);
+        std::print("  Evictions:     {:7} ({} downscales, {} restores)\n", t.evictions, t.downscales, t.restores);
+        double invBind = p.bindFrames > 0 ? 1.0 / double(p.bindFrames) : 0.0;
+        std::print("  Binds/frame:   {:7.2f} ({:.2f} requested)\n", p.accBindsIssued * invBind, p.accBindsRequested * invBind);
+
+        auto const& vt = p.virtualTexture;
+        if (vt.ready)
+        {
+            std::print("Virtual texture:\n");
+            std::print("  Pages:         {:7} / {} resident ({} slots, {:.2f} MiB)\n",
+                vt.residentPages, vt.pages, vt.cacheSlots, vt.gpuBytes / kMiB);
+            std::print("  Visible pages: {:7} ({} loads pending)\n", vt.visiblePages, vt.pendingLoads);
+            std::print("  Uploads:       {:7} ({} evictions)\n", vt.uploads, vt.evictions);
+        }
+
+        // Stalls and overflows since the previous print
+        auto const& sb = p.streaming;
+        auto const& sbPrev = p.streamingPrev;
+        std::print("Streaming buffer ({}):\n", sb.persistent ? "persistent" : "glBufferSubData");
+        std::print("  Used:          {:7.2f} / {:.2f} MiB per frame ({} regions)\n",
+            sb.usedBytes / kMiB, sb.regionBytes / kMiB, sb.regionBytes > 0 ? sb.bytes / sb.regionBytes : 0);
+        std::print("  Stalls:        {:7} in {} frames ({:.3f} ms waiting, {} overflows)\n",
+            sb.stalls - sbPrev.stalls, sb.frames - sbPrev.frames, sb.stallMs - sbPrev.stallMs, sb.overflows - sbPrev.overflows);
+        p.streamingPrev = sb;
 
         // reset
-        p.accTerrain = p.accUfo = p.accPads = p.accTotal = 0.0;
+        p.accTerrain = p.accUfo = p.accPads = p.accParticles = p.accTotal = 0.0;
         p.accCpuFrame = p.accCpuSubmit = 0.0;
+        p.accParticleSort = 0.0;
+        p.particleSorts = 0;
+        p.accParticleFill = p.accParticleFillRequested = 0.0;
+        p.particleBudgetFrames = p.particleLimitedFrames = 0;
+        p.accBindsRequested = p.accBindsIssued = 0.0;
+        p.bindFrames = 0;
         p.samples = 0;
     }
 }
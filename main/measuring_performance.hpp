@@ -3,6 +3,13 @@
 
 #include <glad/glad.h>
 #include "defaults.hpp"
+#include "texture_units.hpp"
+#include "texture_registry.hpp"
+#include "virtual_texture.hpp"
+#include "streaming_buffer.hpp"
+#include "particle_budget.hpp"
+#include "frustum.hpp"
+#include "../support/fixed_timestep.hpp"
 
 // Recommended: enable via build flags -DENABLE_GPU_PROFILING
 // If you want it always-on, uncomment the next line.
@@ -15,14 +22,16 @@ enum class Stamp : int
     TerrainEnd  = 1,
     UfoEnd      = 2,
     PadsEnd     = 3,
-    FrameEnd    = 4
+    ParticlesEnd = 4,
+    FrameEnd    = 5
 };
 
 #ifdef ENABLE_GPU_PROFILING
 
-constexpr int kNumTimestamps     = 5;
+constexpr int kNumTimestamps     = 6;
 constexpr int kQueryBufferCount  = 3;
 constexpr int kSampleFrames      = 200;
+constexpr int kCullViews         = 2;   // split screen
 
 struct GPUProfiler
 {
@@ -35,11 +44,39 @@ struct GPUProfiler
     double accTerrain = 0.0;
     double accUfo     = 0.0;
     double accPads    = 0.0;
+    double accParticles = 0.0;
     double accTotal   = 0.0;
 
+    int particleDivisor = 1; // resolution of the particle pass, see gpuSetParticleResolution()
+
     double accCpuFrame  = 0.0;
     double accCpuSubmit = 0.0;
 
+    TextureStats textures{}; // latest snapshot, see gpuSetTextureStats()
+    double accBindsRequested = 0.0;
+    double accBindsIssued    = 0.0;
+    int bindFrames = 0;
+
+    VirtualTextureStats virtualTexture{}; // latest snapshot
+
+    double accParticleSort = 0.0; // ms, CPU
+    int particleSorts = 0;
+
+    double accParticleFill = 0.0;          // estimated pixels
+    double accParticleFillRequested = 0.0;
+    int particleBudgetFrames = 0;
+    int particleLimitedFrames = 0;         // fill budget was exceeded
+
+    StreamingBufferStats streaming{};     // latest snapshot
+    StreamingBufferStats streamingPrev{}; // at the previous print
+
+    double accDrawn[kCullViews]{};        // per view, see gpuAddCullStats()
+    double accCulled[kCullViews]{};
+    int cullFrames[kCullViews]{};
+
+    FixedTimestepStats simulation{};      // latest snapshot
+    FixedTimestepStats simulationPrev{};  // at the previous print
+
     Clock::time_point lastFrame{};
     Clock::time_point submitStart{};
 
@@ -57,6 +94,17 @@ void cpuSubmitEnd(GPUProfiler& p);
 
 void gpuEndAndCollect(GPUProfiler& p);
 
+// Texture memory is reported alongside the timings
+void gpuSetTextureStats(GPUProfiler& p, TextureStats const& stats);
+void gpuAddTextureBinds(GPUProfiler& p, TextureBindStats const& binds); // once per frame
+void gpuSetVirtualTextureStats(GPUProfiler& p, VirtualTextureStats const& stats);
+void gpuSetStreamingStats(GPUProfiler& p, StreamingBufferStats const& stats);
+void gpuAddParticleSortTime(GPUProfiler& p, double ms); // once per sorted view
+void gpuAddParticleBudget(GPUProfiler& p, ParticleBudgetStats const& stats); // once per frame
+void gpuSetSimulationStats(GPUProfiler& p, FixedTimestepStats const& stats);
+void gpuSetParticleResolution(GPUProfiler& p, int divisor); // 1: full, 2: half, ...
+void gpuAddCullStats(GPUProfiler& p, int view, CullStats const& stats); // once per view and frame
+
 #else
 
 struct GPUProfiler {};
@@ -68,6 +116,15 @@ inline void gpuStamp(GPUProfiler&, Stamp, bool = true) {}
 inline void cpuSubmitBegin(GPUProfiler&) {}
 inline void cpuSubmitEnd(GPUProfiler&) {}
 inline void gpuEndAndCollect(GPUProfiler&) {}
+inline void gpuSetTextureStats(GPUProfiler&, TextureStats const&) {}
+inline void gpuAddTextureBinds(GPUProfiler&, TextureBindStats const&) {}
+inline void gpuSetVirtualTextureStats(GPUProfiler&, VirtualTextureStats const&) {}
+inline void gpuSetStreamingStats(GPUProfiler&, StreamingBufferStats const&) {}
+inline void gpuAddParticleSortTime(GPUProfiler&, double) {}
+inline void gpuAddParticleBudget(GPUProfiler&, ParticleBudgetStats const&) {}
+inline void gpuSetSimulationStats(GPUProfiler&, FixedTimestepStats const&) {}
+inline void gpuSetParticleResolution(GPUProfiler&, int) {}
+inline void gpuAddCullStats(GPUProfiler&, int, CullStats const&) {}
 
 #endif
 
@@ -0,0 +1,240 @@
+#include "mipmap.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+#include <cstddef>
+
+#include "../support/thread_pool.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#	define MIPMAP_SSE2_ 1
+#	include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Linear values are quantized to this many steps for the conversion back
+    // to sRGB. The steepest part of the sRGB curve (slope 12.92) then moves
+    // by at most ~0.1 steps per table entry, which keeps sRGB->linear->sRGB
+    // exact.
+    constexpr std::size_t kToSrgbEntries = std::size_t(1) << 14;
+
+    struct Tables_
+    {
+        float toLinear[256];
+        std::uint8_t toSrgb[kToSrgbEntries];
+
+        Tables_()
+        {
+            for( int i = 0; i < 256; ++i )
+            {
+                double const s = i / 255.0;
+                toLinear[i] = float( s <= 0.04045 ? s / 12.92 : std::pow( (s + 0.055) / 1.055, 2.4 ) );
+            }
+
+            for( std::size_t i = 0; i < kToSrgbEntries; ++i )
+            {
+                double const l = (double(i) + 0.5) / kToSrgbEntries;
+                double const s = l <= 0.0031308 ? 12.92 * l : 1.055 * std::pow( l, 1.0 / 2.4 ) - 0.055;
+                toSrgb[i] = std::uint8_t( std::lround( std::clamp( s, 0.0, 1.0 ) * 255.0 ) );
+            }
+        }
+    };
+
+    Tables_ const& tables_()
+    {
+        static Tables_ const tables;
+        return tables;
+    }
+
+    // Straight (not premultiplied) linear RGBA
+    struct LinearImage_
+    {
+        std::uint32_t width = 0, height = 0;
+        std::vector<float> texels;
+    };
+
+    std::size_t rows_per_task_( std::uint32_t aWidth ) noexcept
+    {
+        return std::max<std::size_t>( 1, (std::size_t(1) << 16) / std::max( aWidth, 1u ) );
+    }
+
+    void to_linear_( RgbaImage const& aIn, LinearImage_& aOut, std::size_t aRowBegin, std::size_t aRowEnd )
+    {
+        auto const& lut = tables_().toLinear;
+
+        std::size_t const begin = aRowBegin * aIn.width, end = aRowEnd * aIn.width;
+        for( std::size_t i = begin; i < end; ++i )
+        {
+            auto const* t = aIn.texels.data() + 4*i;
+            float* out = aOut.texels.data() + 4*i;
+
+            out[0] = lut[t[0]];
+            out[1] = lut[t[1]];
+            out[2] = lut[t[2]];
+            out[3] = t[3] * (1.f / 255.f);
+        }
+    }
+
+    void to_srgb_( LinearImage_ const& aIn, RgbaImage& aOut, std::size_t aRowBegin, std::size_t aRowEnd )
+    {
+        auto const& lut = tables_().toSrgb;
+
+        std::size_t const begin = aRowBegin * aIn.width, end = aRowEnd * aIn.width;
+
+#       if MIPMAP_SSE2_
+        constexpr float kMaxIndex = float(kToSrgbEntries - 1);
+        __m128 const scale = _mm_setr_ps( float(kToSrgbEntries), float(kToSrgbEntries), float(kToSrgbEntries), 255.f );
+        __m128 const bias  = _mm_setr_ps( 0.f, 0.f, 0.f, 0.5f );
+        __m128 const upper = _mm_setr_ps( kMaxIndex, kMaxIndex, kMaxIndex, 255.f );
+        __m128 const zero  = _mm_setzero_ps();
+
+        alignas(16) std::int32_t idx[4];
+        for( std::size_t i = begin; i < end; ++i )
+        {
+            // max(x,0) also maps NaN to zero
+            __m128 v = _mm_max_ps( _mm_loadu_ps( aIn.texels.data() + 4*i ), zero );
+            v = _mm_min_ps( _mm_add_ps( _mm_mul_ps( v, scale ), bias ), upper );
+            _mm_store_si128( reinterpret_cast<__m128i*>(idx), _mm_cvttps_epi32( v ) );
+
+            auto* out = aOut.texels.data() + 4*i;
+            out[0] = lut[idx[0]];
+            out[1] = lut[idx[1]];
+            out[2] = lut[idx[2]];
+            out[3] = std::uint8_t(idx[3]);
+        }
+#       else // !SSE2
+        for( std::size_t i = begin; i < end; ++i )
+        {
+            float const* t = aIn.texels.data() + 4*i;
+            auto* out = aOut.texels.data() + 4*i;
+
+            out[0] = linear_to_srgb8( t[0] );
+            out[1] = linear_to_srgb8( t[1] );
+            out[2] = linear_to_srgb8( t[2] );
+            out[3] = std::uint8_t( t[3] > 0.f ? (t[3] < 1.f ? t[3] * 255.f + 0.5f : 255.f) : 0.f );
+        }
+#       endif // ~ SSE2
+    }
+
+    // 2x2 box filter. Colours are weighted by alpha, so that invisible texels
+    // don't contribute; if all four are invisible, their plain average is
+    // kept (it still matters for bilinear filtering at the edges).
+    void downsample_( LinearImage_ const& aIn, LinearImage_& aOut, std::size_t aRowBegin, std::size_t aRowEnd )
+    {
+        auto const at = [&] ( std::uint32_t aX, std::uint32_t aY ) {
+            aX = std::min( aX, aIn.width - 1 );
+            aY = std::min( aY, aIn.height - 1 );
+            return aIn.texels.data() + 4*(std::size_t(aY)*aIn.width + aX);
+        };
+
+#       if MIPMAP_SSE2_
+        __m128 const quarter = _mm_set1_ps( 0.25f );
+        __m128 const zero = _mm_setzero_ps();
+        __m128 const alphaLane = _mm_castsi128_ps( _mm_setr_epi32( 0, 0, 0, -1 ) );
+#       endif // ~ SSE2
+
+        for( std::size_t y = aRowBegin; y < aRowEnd; ++y )
+        {
+            std::uint32_t const sy = std::uint32_t(2*y);
+            for( std::uint32_t x = 0; x < aOut.width; ++x )
+            {
+                float const* t[4] = { at( 2*x, sy ), at( 2*x+1, sy ), at( 2*x, sy+1 ), at( 2*x+1, sy+1 ) };
+                float* out = aOut.texels.data() + 4*(y*aOut.width + x);
+
+#               if MIPMAP_SSE2_
+                __m128 sum = zero, weighted = zero, alpha = zero;
+                for( auto const* texel : t )
+                {
+                    __m128 const c = _mm_loadu_ps( texel );
+                    __m128 const a = _mm_shuffle_ps( c, c, _MM_SHUFFLE(3,3,3,3) );
+                    sum = _mm_add_ps( sum, c );
+                    weighted = _mm_add_ps( weighted, _mm_mul_ps( c, a ) );
+                    alpha = _mm_add_ps( alpha, a );
+                }
+
+                __m128 const visible = _mm_cmpgt_ps( alpha, zero );
+                __m128 const colour = _mm_or_ps(
+                    _mm_and_ps( visible, _mm_div_ps( weighted, _mm_max_ps( alpha, _mm_set1_ps( 1e-30f ) ) ) ),
+                    _mm_andnot_ps( visible, _mm_mul_ps( sum, quarter ) )
+                );
+                __m128 const result = _mm_or_ps(
+                    _mm_andnot_ps( alphaLane, colour ),
+                    _mm_and_ps( alphaLane, _mm_mul_ps( alpha, quarter ) )
+                );
+                _mm_storeu_ps( out, result );
+#               else // !SSE2
+                float sum[3] = {}, weighted[3] = {}, alpha = 0.f;
+                for( auto const* texel : t )
+                {
+                    for( int c = 0; c < 3; ++c )
+                    {
+                        sum[c] += texel[c];
+                        weighted[c] += texel[c] * texel[3];
+                    }
+                    alpha += texel[3];
+                }
+
+                for( int c = 0; c < 3; ++c )
+                    out[c] = alpha > 0.f ? weighted[c] / alpha : sum[c] * 0.25f;
+                out[3] = alpha * 0.25f;
+#               endif // ~ SSE2
+            }
+        }
+    }
+}
+
+float srgb8_to_linear( std::uint8_t aValue ) noexcept
+{
+    return tables_().toLinear[aValue];
+}
+
+std::uint8_t linear_to_srgb8( float aValue ) noexcept
+{
+    float const clamped = aValue > 0.f ? (aValue < 1.f ? aValue : 1.f) : 0.f;
+    auto const idx = std::min( std::size_t(clamped * kToSrgbEntries), kToSrgbEntries - 1 );
+    return tables_().toSrgb[idx];
+}
+
+std::vector<RgbaImage> build_srgb_mip_chain( RgbaImage const& aBase, ThreadPool& aPool )
+{
+    assert( aBase.texels.size() == std::size_t(aBase.width) * aBase.height * 4 );
+
+    std::vector<RgbaImage> ret;
+    ret.reserve( mip_level_count( aBase.width, aBase.height ) );
+    ret.emplace_back( aBase );
+
+    if( 0 == aBase.width || 0 == aBase.height )
+        return ret;
+
+    LinearImage_ current{ aBase.width, aBase.height, std::vector<float>( std::size_t(aBase.width) * aBase.height * 4 ) };
+    aPool.parallel_for( current.height, rows_per_task_( current.width ), [&] ( std::size_t aBegin, std::size_t aEnd ) {
+        to_linear_( aBase, current, aBegin, aEnd );
+    } );
+
+    // Each level depends on the previous one; the rows of a level are
+    // independent.
+    while( current.width > 1 || current.height > 1 )
+    {
+        LinearImage_ next;
+        next.width = std::max( current.width / 2, 1u );
+        next.height = std::max( current.height / 2, 1u );
+        next.texels.resize( std::size_t(next.width) * next.height * 4 );
+
+        RgbaImage& level = ret.emplace_back();
+        level.width = next.width;
+        level.height = next.height;
+        level.texels.resize( std::size_t(next.width) * next.height * 4 );
+
+        aPool.parallel_for( next.height, rows_per_task_( next.width ), [&] ( std::size_t aBegin, std::size_t aEnd ) {
+            downsample_( current, next, aBegin, aEnd );
+            to_srgb_( next, level, aBegin, aEnd );
+        } );
+
+        current = std::move(next);
+    }
+
+    return ret;
+}
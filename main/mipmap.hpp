@@ -0,0 +1,32 @@
+#ifndef MIPMAP_HPP_E93B07C5_4A2D_41F8_8C61_3D5A0F9E27B4
+#define MIPMAP_HPP_E93B07C5_4A2D_41F8_8C61_3D5A0F9E27B4
+
+#include <vector>
+#include <cstdint>
+
+#include "texture_compress.hpp"
+
+class ThreadPool;
+
+// CPU mip chain generation for sRGB textures.
+//
+// Averaging sRGB encoded values directly darkens the smaller levels (and
+// makes e.g. thin bright lines fade out too quickly). Instead, texels are
+// converted to linear RGB, premultiplied by alpha, box filtered and converted
+// back. Premultiplying prevents the colour of fully transparent texels from
+// bleeding into visible ones.
+//
+// Conversions use lookup tables. The arithmetic around them (clamping,
+// scaling, the filter itself) uses SSE2 where available.
+
+float srgb8_to_linear( std::uint8_t ) noexcept;
+
+// Max. error is one step compared to the exact conversion; converting any
+// sRGB value to linear and back returns the original value.
+std::uint8_t linear_to_srgb8( float ) noexcept;
+
+// Returns all levels down to 1x1, level 0 (a copy of aBase) first. Rows of
+// each level are processed in parallel on aPool.
+std::vector<RgbaImage> build_srgb_mip_chain( RgbaImage const& aBase, ThreadPool& aPool );
+
+#endif // MIPMAP_HPP_E93B07C5_4A2D_41F8_8C61_3D5A0F9E27B4
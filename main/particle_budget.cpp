@@ -0,0 +1,182 @@
+#include "particle_budget.hpp"
+
+#include <limits>
+#include <numeric>
+#include <algorithm>
+
+#include <cmath>
+
+// Matches particle.vert
+static constexpr float kMaxPointSize = 400.0f;
+
+// Expected number of alive particles, from the emission rate and the mean
+// lifetime
+static float expectedAlive(ParticleEmitter const& em, float lod)
+{
+    float meanLife = 0.5f * (em.lifeMin + em.lifeMax);
+    return std::min(float(em.budget), em.rate * lod * meanLife);
+}
+
+// Pixels covered by the emitter's particles in all views, at its current
+// lod and sizeScale
+static double emitterFill(ParticleEmitter const& em, std::span<ParticleView const> views, ParticleBudgetConfig const& config)
+{
+    ParticleBounds bounds = emitterBounds(em);
+
+    double perParticle = 0.0;
+    for (ParticleView const& view : views)
+    {
+        if (projectedRadiusPx(view, bounds) <= 0.0f)
+            continue;
+
+        // Inside the bounds, particles are around the camera rather than at
+        // the center
+        float dist = std::max(length(bounds.center - view.cameraPos), 0.5f * bounds.radius);
+        perParticle += particleFillPx(config.baseSize * em.sizeScale, dist);
+    }
+
+    return double(expectedAlive(em, em.lod)) * perParticle;
+}
+
+ParticleBounds emitterBounds(ParticleEmitter const& emitter)
+{
+    // Particles start on the path from prevPos to pos and move in a straight
+    // line for at most lifeMax
+    Vec3f path = emitter.pos - emitter.prevPos;
+    Vec3f drift = emitter.velocity * (0.5f * emitter.lifeMax);
+
+    float spread = length(emitter.jitter) * 0.5f + emitter.radialSpeed;
+
+    ParticleBounds ret;
+    ret.center = emitter.prevPos + path * 0.5f + drift;
+    ret.radius = 0.5f * length(path)
+        + emitter.radius
+        + 0.5f * emitter.verticalSpread
+        + length(drift)
+        + spread * emitter.lifeMax;
+    return ret;
+}
+
+float projectedRadiusPx(ParticleView const& view, ParticleBounds const& bounds)
+{
+    float dist = length(bounds.center - view.cameraPos);
+    if (dist <= bounds.radius)
+        return std::numeric_limits<float>::infinity();
+
+    // Frustum planes from the rows of the view-projection matrix: w + x >= 0,
+    // w - x >= 0, and so on (Gribb & Hartmann)
+    Mat44f const& m = view.viewProj;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (float sign : { 1.0f, -1.0f })
+        {
+            Vec3f n{
+                m[3, 0] + sign * m[axis, 0],
+                m[3, 1] + sign * m[axis, 1],
+                m[3, 2] + sign * m[axis, 2]
+            };
+            float d = m[3, 3] + sign * m[axis, 3];
+
+            float len = length(n);
+            if (len > 0.0f && (dot(n, bounds.center) + d) / len < -bounds.radius)
+                return 0.0f;
+        }
+    }
+
+    // Perspective: r * cot(fov/2) / d, NDC -> px (like select_ufo_lod())
+    return bounds.radius * view.projScaleY / dist * (0.5f * view.viewportHeight);
+}
+
+float particleFillPx(float baseSize, float dist)
+{
+    float size = std::clamp(10.0f * baseSize / std::max(dist, 0.001f), 0.0f, kMaxPointSize);
+    return size * size;
+}
+
+ParticleBudgetStats applyParticleBudget(
+    ParticleSim& ps,
+    std::span<ParticleView const> views,
+    ParticleBudgetConfig const& config
+)
+{
+    ParticleBudgetStats stats;
+
+    // 1) Level of detail from the largest projected size in any view
+    for (ParticleEmitter& em : ps.emitters)
+    {
+        em.lod = 1.0f;
+        em.sizeScale = 1.0f;
+        if (views.empty() || !em.active)
+            continue;
+
+        ParticleBounds bounds = emitterBounds(em);
+
+        float radiusPx = 0.0f;
+        for (ParticleView const& view : views)
+            radiusPx = std::max(radiusPx, projectedRadiusPx(view, bounds));
+
+        em.lod = std::clamp(radiusPx / config.fullDetailRadiusPx, config.minLod, 1.0f);
+        em.sizeScale = std::min(config.maxSizeScale, 1.0f / std::sqrt(em.lod));
+    }
+
+    if (views.empty())
+        return stats;
+
+    int emitterCount = int(ps.emitters.size());
+    double fill[kMaxEmitters] = {};
+    for (int i = 0; i < emitterCount; ++i)
+    {
+        if (ps.emitters[i].active)
+            fill[i] = emitterFill(ps.emitters[i], views, config);
+        stats.requestedFill += fill[i];
+    }
+
+    // 2) Over budget: fewer particles, lowest priority first
+    double total = stats.requestedFill;
+    if (total > config.maxFillPixels)
+    {
+        int order[kMaxEmitters];
+        std::iota(order, order + emitterCount, 0);
+        std::stable_sort(order, order + emitterCount, [&ps] (int a, int b) {
+            return ps.emitters[a].priority < ps.emitters[b].priority;
+        });
+
+        for (int n = 0; n < emitterCount && total > config.maxFillPixels; ++n)
+        {
+            ParticleEmitter& em = ps.emitters[order[n]];
+            float alive = expectedAlive(em, em.lod);
+            if (fill[order[n]] <= 0.0 || alive <= 0.0f)
+                continue;
+
+            // Fill is proportional to the number of particles
+            float minAlive = expectedAlive(em, config.minLod);
+            double minFill = fill[order[n]] * minAlive / alive;
+            double cut = std::min(total - config.maxFillPixels, fill[order[n]] - minFill);
+            if (cut <= 0.0)
+                continue;
+
+            float targetAlive = float(double(alive) * (fill[order[n]] - cut) / fill[order[n]]);
+            float meanLife = 0.5f * (em.lifeMin + em.lifeMax);
+            em.lod = std::clamp(targetAlive / (em.rate * meanLife), config.minLod, em.lod);
+
+            total -= cut;
+            ++stats.limited;
+        }
+
+        // 3) Still over budget: smaller points (fill goes with size squared)
+        if (total > config.maxFillPixels)
+        {
+            float scale = float(std::sqrt(config.maxFillPixels / total));
+            for (ParticleEmitter& em : ps.emitters)
+                em.sizeScale *= scale;
+        }
+    }
+
+    for (int i = 0; i < emitterCount; ++i)
+    {
+        if (ps.emitters[i].active)
+            stats.fill += emitterFill(ps.emitters[i], views, config);
+    }
+
+    return stats;
+}
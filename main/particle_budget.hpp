@@ -0,0 +1,88 @@
+#ifndef PARTICLE_BUDGET_HPP
+#define PARTICLE_BUDGET_HPP
+
+#include <span>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+#include "particle_sim.hpp"
+
+// Emission level of detail and fill budget for the particle pool (see
+// particle_sim.hpp).
+//
+// Once per frame, applyParticleBudget() projects each active emitter's
+// bounds (a sphere around everything its particles can reach) into the
+// views that were rendered, and sets two scales on the emitter:
+//
+//  - lod scales the emission rate. Emitters that are at least
+//    fullDetailRadiusPx pixels in radius in some view emit at their full
+//    rate, smaller ones proportionally less, down to minLod. Emitters that
+//    are outside all views emit at minLod, so that they are not empty when
+//    they come back into view.
+//  - sizeScale scales the point size in particle.vert. With fewer particles,
+//    each is drawn larger (by 1/sqrt(lod), up to maxSizeScale), so that the
+//    effect covers about the same area.
+//
+// The fill cost of an emitter is estimated from its expected number of
+// alive particles and their point size at the distance of its bounds, with
+// the same formula as particle.vert. If all emitters in all views come to
+// more than maxFillPixels, emitters are scaled down further in order of
+// increasing priority until the estimate fits. If they are all at minLod
+// and it still does not fit, the point sizes shrink.
+//
+// This file does not depend on OpenGL (it's tested in main-test).
+
+// uBaseSize in particle.vert
+constexpr float kParticleBaseSize = 6.0f;
+
+// A view that particles are drawn in
+struct ParticleView
+{
+    Mat44f viewProj;
+    Vec3f cameraPos;
+    float projScaleY;       // [1,1] element of the projection (cot(fov/2))
+    float viewportHeight;   // pixels
+};
+
+struct ParticleBudgetConfig
+{
+    float baseSize = kParticleBaseSize;
+    float fullDetailRadiusPx = 120.0f;
+    float minLod = 0.1f;
+    float maxSizeScale = 2.0f;
+    double maxFillPixels = 8e6;     // per frame, all views
+};
+
+struct ParticleBudgetStats
+{
+    double requestedFill = 0.0;     // estimated pixels with the screen size LOD only
+    double fill = 0.0;              // estimated pixels after the fill budget
+    int limited = 0;                // emitters scaled down by the fill budget
+};
+
+struct ParticleBounds
+{
+    Vec3f center;
+    float radius;
+};
+
+// Sphere containing the particles of an emitter (its path, disk, and the
+// distance the fastest particle moves in its lifetime)
+ParticleBounds emitterBounds(ParticleEmitter const& emitter);
+
+// Radius in pixels of a sphere in a view. 0 if it is outside the view
+// frustum, infinity if the camera is inside it.
+float projectedRadiusPx(ParticleView const& view, ParticleBounds const& bounds);
+
+// Pixels covered by one point sprite at the given distance from the camera
+float particleFillPx(float baseSize, float dist);
+
+// Set the emitters' lod and sizeScale for the given views. Without views,
+// both are reset to 1.
+ParticleBudgetStats applyParticleBudget(
+    ParticleSim& ps,
+    std::span<ParticleView const> views,
+    ParticleBudgetConfig const& config = {}
+);
+
+#endif // PARTICLE_BUDGET_HPP
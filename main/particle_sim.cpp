@@ -0,0 +1,967 @@
+#include "particle_sim.hpp"
+
+#include <cmath>
+#include <span>
+#include <limits>
+#include <numbers>
+#include <bit>
+#include <numeric>
+#include <utility>
+#include <algorithm>
+
+#include "heightfield.hpp"
+
+#include "../support/radix_sort.hpp"
+#include "../support/thread_pool.hpp"
+
+#if defined(__AVX__)
+#   define PARTICLES_AVX_ 1
+#   include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#   define PARTICLES_SSE2_ 1
+#   include <emmintrin.h>
+#endif
+
+// Ground plane without a heightfield
+static constexpr float kGroundY = -0.98f;
+static constexpr float kNoGround = -std::numeric_limits<float>::infinity();
+
+// Particles per block of height lookups, see stepOnGround()
+static constexpr int kGroundBlock = 256;
+
+// All per-particle float arrays, and their counterparts for updateParticlesParallel()
+static constexpr ParticleArray ParticleSim::* kArrays[] = {
+    &ParticleSim::px, &ParticleSim::py, &ParticleSim::pz,
+    &ParticleSim::vx, &ParticleSim::vy, &ParticleSim::vz,
+    &ParticleSim::life
+};
+static constexpr ParticleArray ParticleSim::* kNextArrays[] = {
+    &ParticleSim::nextPx, &ParticleSim::nextPy, &ParticleSim::nextPz,
+    &ParticleSim::nextVx, &ParticleSim::nextVy, &ParticleSim::nextVz,
+    &ParticleSim::nextLife
+};
+
+// Integrates and ages particles [begin, end). Particles die when their life
+// runs out or when they are below groundY. Writes the indices of those that
+// died to dead (in ascending order) and returns how many there are.
+static int integrateScalar(ParticleSim& ps, int begin, int end, float dt, float groundY, int* dead)
+{
+    int deadCount = 0;
+    for (int i = begin; i < end; ++i)
+    {
+        ps.life[i] -= dt;
+        ps.px[i] = ps.px[i] + ps.vx[i] * dt;
+        ps.py[i] = ps.py[i] + ps.vy[i] * dt;
+        ps.pz[i] = ps.pz[i] + ps.vz[i] * dt;
+
+        // Out of time, or ground collision
+        if (ps.life[i] <= 0.0f || ps.py[i] < groundY)
+            dead[deadCount++] = i;
+    }
+    return deadCount;
+}
+
+#if PARTICLES_AVX_
+static int integrateSimd(ParticleSim& ps, int begin, int end, float dt, float groundY, int* dead)
+{
+    __m256 const step   = _mm256_set1_ps(dt);
+    __m256 const zero   = _mm256_setzero_ps();
+    __m256 const ground = _mm256_set1_ps(groundY);
+
+    int deadCount = 0;
+    int i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 life = _mm256_sub_ps(_mm256_load_ps(ps.life.data() + i), step);
+        __m256 x = _mm256_add_ps(_mm256_load_ps(ps.px.data() + i), _mm256_mul_ps(_mm256_load_ps(ps.vx.data() + i), step));
+        __m256 y = _mm256_add_ps(_mm256_load_ps(ps.py.data() + i), _mm256_mul_ps(_mm256_load_ps(ps.vy.data() + i), step));
+        __m256 z = _mm256_add_ps(_mm256_load_ps(ps.pz.data() + i), _mm256_mul_ps(_mm256_load_ps(ps.vz.data() + i), step));
+
+        _mm256_store_ps(ps.life.data() + i, life);
+        _mm256_store_ps(ps.px.data() + i, x);
+        _mm256_store_ps(ps.py.data() + i, y);
+        _mm256_store_ps(ps.pz.data() + i, z);
+
+        __m256 deadMask = _mm256_or_ps(
+            _mm256_cmp_ps(life, zero, _CMP_LE_OQ),
+            _mm256_cmp_ps(y, ground, _CMP_LT_OQ)
+        );
+
+        // Usually none
+        for (unsigned bits = unsigned(_mm256_movemask_ps(deadMask)); bits; bits &= bits - 1)
+            dead[deadCount++] = i + std::countr_zero(bits);
+    }
+
+    return deadCount + integrateScalar(ps, i, end, dt, groundY, dead + deadCount);
+}
+#elif PARTICLES_SSE2_
+static int integrateSimd(ParticleSim& ps, int begin, int end, float dt, float groundY, int* dead)
+{
+    __m128 const step   = _mm_set1_ps(dt);
+    __m128 const zero   = _mm_setzero_ps();
+    __m128 const ground = _mm_set1_ps(groundY);
+
+    int deadCount = 0;
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 life = _mm_sub_ps(_mm_load_ps(ps.life.data() + i), step);
+        __m128 x = _mm_add_ps(_mm_load_ps(ps.px.data() + i), _mm_mul_ps(_mm_load_ps(ps.vx.data() + i), step));
+        __m128 y = _mm_add_ps(_mm_load_ps(ps.py.data() + i), _mm_mul_ps(_mm_load_ps(ps.vy.data() + i), step));
+        __m128 z = _mm_add_ps(_mm_load_ps(ps.pz.data() + i), _mm_mul_ps(_mm_load_ps(ps.vz.data() + i), step));
+
+        _mm_store_ps(ps.life.data() + i, life);
+        _mm_store_ps(ps.px.data() + i, x);
+        _mm_store_ps(ps.py.data() + i, y);
+        _mm_store_ps(ps.pz.data() + i, z);
+
+        __m128 deadMask = _mm_or_ps(_mm_cmple_ps(life, zero), _mm_cmplt_ps(y, ground));
+
+        for (unsigned bits = unsigned(_mm_movemask_ps(deadMask)); bits; bits &= bits - 1)
+            dead[deadCount++] = i + std::countr_zero(bits);
+    }
+
+    return deadCount + integrateScalar(ps, i, end, dt, groundY, dead + deadCount);
+}
+#endif
+
+// Integrates with SIMD where available. begin must be a multiple of 8.
+static int integrate(ParticleSim& ps, int begin, int end, float dt, float groundY, int* dead)
+{
+#if PARTICLES_AVX_ || PARTICLES_SSE2_
+    return integrateSimd(ps, begin, end, dt, groundY, dead);
+#else
+    return integrateScalar(ps, begin, end, dt, groundY, dead);
+#endif
+}
+
+// Collision response for particles [begin, end) that are below the ground.
+// height, slopeX and slopeZ are from sampleHeights() at their positions
+// (indexed from begin). The velocity is split along the ground's normal:
+// the normal part is reflected and scaled by the restitution if it points
+// into the ground, and the tangential part is scaled by the friction, so
+// that particles bounce off steep hills and slide along flat ground. The
+// particle is moved up onto the ground.
+static void collideScalar(ParticleSim& ps, int begin, int end, float const* height, float const* slopeX, float const* slopeZ)
+{
+    float const restitution = ps.ground.restitution;
+    float const friction = ps.ground.friction;
+
+    for (int i = begin; i < end; ++i)
+    {
+        int k = i - begin;
+        if (!(ps.py[i] < height[k]))
+            continue;
+
+        // Normal (-dh/dx, 1, -dh/dz), normalized
+        float nx = -slopeX[k];
+        float nz = -slopeZ[k];
+        float inv = 1.0f / std::sqrt(nx * nx + nz * nz + 1.0f);
+        nx = nx * inv;
+        nz = nz * inv;
+        float ny = inv;
+
+        float vn = ps.vx[i] * nx + ps.vy[i] * ny + ps.vz[i] * nz;
+        float out = vn < 0.0f ? vn * -restitution : vn;
+
+        ps.vx[i] = (ps.vx[i] - vn * nx) * friction + out * nx;
+        ps.vy[i] = (ps.vy[i] - vn * ny) * friction + out * ny;
+        ps.vz[i] = (ps.vz[i] - vn * nz) * friction + out * nz;
+        ps.py[i] = height[k];
+    }
+}
+
+#if PARTICLES_AVX_
+// Same as collideScalar(). Groups of 8 with no particle below the ground
+// are skipped after the comparison, which is most of them while particles
+// are in the air. A group with any particle below computes the response for
+// all 8 lanes and blends it in; that is the worst case, the same cost
+// whether one lane or all of them are below.
+static int collideSimd(ParticleSim& ps, int begin, int end, float const* height, float const* slopeX, float const* slopeZ)
+{
+    __m256 const zero = _mm256_setzero_ps();
+    __m256 const one  = _mm256_set1_ps(1.0f);
+    __m256 const sign = _mm256_set1_ps(-0.0f);
+    __m256 const bounce   = _mm256_set1_ps(-ps.ground.restitution);
+    __m256 const friction = _mm256_set1_ps(ps.ground.friction);
+
+    int i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        int k = i - begin;
+        __m256 h = _mm256_load_ps(height + k);
+        __m256 y = _mm256_load_ps(ps.py.data() + i);
+        __m256 below = _mm256_cmp_ps(y, h, _CMP_LT_OQ);
+        if (0 == _mm256_movemask_ps(below))
+            continue;
+
+        __m256 nx = _mm256_xor_ps(_mm256_load_ps(slopeX + k), sign);
+        __m256 nz = _mm256_xor_ps(_mm256_load_ps(slopeZ + k), sign);
+        __m256 inv = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(nz, nz)), one)));
+        nx = _mm256_mul_ps(nx, inv);
+        nz = _mm256_mul_ps(nz, inv);
+        __m256 ny = inv;
+
+        __m256 vx = _mm256_load_ps(ps.vx.data() + i);
+        __m256 vy = _mm256_load_ps(ps.vy.data() + i);
+        __m256 vz = _mm256_load_ps(ps.vz.data() + i);
+
+        __m256 vn = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, nx), _mm256_mul_ps(vy, ny)), _mm256_mul_ps(vz, nz));
+        __m256 out = _mm256_blendv_ps(vn, _mm256_mul_ps(vn, bounce), _mm256_cmp_ps(vn, zero, _CMP_LT_OQ));
+
+        __m256 newVx = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(vx, _mm256_mul_ps(vn, nx)), friction), _mm256_mul_ps(out, nx));
+        __m256 newVy = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(vy, _mm256_mul_ps(vn, ny)), friction), _mm256_mul_ps(out, ny));
+        __m256 newVz = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(vz, _mm256_mul_ps(vn, nz)), friction), _mm256_mul_ps(out, nz));
+
+        _mm256_store_ps(ps.vx.data() + i, _mm256_blendv_ps(vx, newVx, below));
+        _mm256_store_ps(ps.vy.data() + i, _mm256_blendv_ps(vy, newVy, below));
+        _mm256_store_ps(ps.vz.data() + i, _mm256_blendv_ps(vz, newVz, below));
+        _mm256_store_ps(ps.py.data() + i, _mm256_blendv_ps(y, h, below));
+    }
+    return i;
+}
+#elif PARTICLES_SSE2_
+static __m128 blend(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Same as the AVX version, in groups of 4
+static int collideSimd(ParticleSim& ps, int begin, int end, float const* height, float const* slopeX, float const* slopeZ)
+{
+    __m128 const zero = _mm_setzero_ps();
+    __m128 const one  = _mm_set1_ps(1.0f);
+    __m128 const sign = _mm_set1_ps(-0.0f);
+    __m128 const bounce   = _mm_set1_ps(-ps.ground.restitution);
+    __m128 const friction = _mm_set1_ps(ps.ground.friction);
+
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        int k = i - begin;
+        __m128 h = _mm_load_ps(height + k);
+        __m128 y = _mm_load_ps(ps.py.data() + i);
+        __m128 below = _mm_cmplt_ps(y, h);
+        if (0 == _mm_movemask_ps(below))
+            continue;
+
+        __m128 nx = _mm_xor_ps(_mm_load_ps(slopeX + k), sign);
+        __m128 nz = _mm_xor_ps(_mm_load_ps(slopeZ + k), sign);
+        __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(nz, nz)), one)));
+        nx = _mm_mul_ps(nx, inv);
+        nz = _mm_mul_ps(nz, inv);
+        __m128 ny = inv;
+
+        __m128 vx = _mm_load_ps(ps.vx.data() + i);
+        __m128 vy = _mm_load_ps(ps.vy.data() + i);
+        __m128 vz = _mm_load_ps(ps.vz.data() + i);
+
+        __m128 vn = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, nx), _mm_mul_ps(vy, ny)), _mm_mul_ps(vz, nz));
+        __m128 out = blend(_mm_cmplt_ps(vn, zero), _mm_mul_ps(vn, bounce), vn);
+
+        __m128 newVx = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(vx, _mm_mul_ps(vn, nx)), friction), _mm_mul_ps(out, nx));
+        __m128 newVy = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(vy, _mm_mul_ps(vn, ny)), friction), _mm_mul_ps(out, ny));
+        __m128 newVz = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(vz, _mm_mul_ps(vn, nz)), friction), _mm_mul_ps(out, nz));
+
+        _mm_store_ps(ps.vx.data() + i, blend(below, newVx, vx));
+        _mm_store_ps(ps.vy.data() + i, blend(below, newVy, vy));
+        _mm_store_ps(ps.vz.data() + i, blend(below, newVz, vz));
+        _mm_store_ps(ps.py.data() + i, blend(below, h, y));
+    }
+    return i;
+}
+#endif
+
+static bool hasGround(ParticleSim const& ps)
+{
+    return ps.ground.heightfield && !ps.ground.heightfield->heights.empty();
+}
+
+// Integration and collisions with the heightfield, in blocks of
+// kGroundBlock particles so that the heights stay in L1. begin must be a
+// multiple of 8.
+template< bool tSimd >
+static int stepOnGround(ParticleSim& ps, int begin, int end, float dt, int* dead)
+{
+    Heightfield const& hf = *ps.ground.heightfield;
+
+    alignas(32) float height[kGroundBlock];
+    alignas(32) float slopeX[kGroundBlock];
+    alignas(32) float slopeZ[kGroundBlock];
+
+    int deadCount = 0;
+    for (int first = begin; first < end; first += kGroundBlock)
+    {
+        int last = std::min(first + kGroundBlock, end);
+        int count = last - first;
+
+        // Particles that died of age are removed later; updating them here
+        // does no harm
+        if constexpr (tSimd)
+        {
+            deadCount += integrate(ps, first, last, dt, kNoGround, dead + deadCount);
+            sampleHeights(hf, ps.px.data() + first, ps.pz.data() + first, count, height, slopeX, slopeZ);
+
+            int done = first;
+#if PARTICLES_AVX_ || PARTICLES_SSE2_
+            done = collideSimd(ps, first, last, height, slopeX, slopeZ);
+#endif
+            collideScalar(ps, done, last, height + (done - first), slopeX + (done - first), slopeZ + (done - first));
+        }
+        else
+        {
+            deadCount += integrateScalar(ps, first, last, dt, kNoGround, dead + deadCount);
+            sampleHeightsScalar(hf, ps.px.data() + first, ps.pz.data() + first, count, height, slopeX, slopeZ);
+            collideScalar(ps, first, last, height, slopeX, slopeZ);
+        }
+    }
+    return deadCount;
+}
+
+// One update of particles [begin, end), see integrate()
+static int step(ParticleSim& ps, int begin, int end, float dt, int* dead)
+{
+    if (hasGround(ps))
+        return stepOnGround<true>(ps, begin, end, dt, dead);
+    return integrate(ps, begin, end, dt, kGroundY, dead);
+}
+
+static int stepScalar(ParticleSim& ps, int begin, int end, float dt, int* dead)
+{
+    if (hasGround(ps))
+        return stepOnGround<false>(ps, begin, end, dt, dead);
+    return integrateScalar(ps, begin, end, dt, kGroundY, dead);
+}
+
+// Removes the particles at the given (ascending) indices. Going from the
+// back, everything after the current index is alive, so the last particle
+// can be moved into its slot.
+static void removeDead(ParticleSim& ps, int const* dead, int deadCount)
+{
+    for (int n = deadCount; n-- > 0; )
+    {
+        int idx  = dead[n];
+        int last = --ps.aliveCount;
+        --ps.emitters[ps.emitterOf[idx]].alive;
+        if (idx == last)
+            continue;
+
+        ps.px[idx]   = ps.px[last];
+        ps.py[idx]   = ps.py[last];
+        ps.pz[idx]   = ps.pz[last];
+        ps.vx[idx]   = ps.vx[last];
+        ps.vy[idx]   = ps.vy[last];
+        ps.vz[idx]   = ps.vz[last];
+        ps.life[idx] = ps.life[last];
+        ps.emitterOf[idx] = ps.emitterOf[last];
+    }
+}
+
+// Removes the particles at the given (ascending) indices from [begin, end),
+// moving the others to the front of the range without changing their order.
+// Returns how many are left.
+static int compactChunk(ParticleSim& ps, int begin, int end, int const* dead, int deadCount)
+{
+    if (0 == deadCount)
+        return end - begin;
+
+    int write = dead[0];
+    for (int n = 0; n < deadCount; ++n)
+    {
+        int from = dead[n] + 1;
+        int to   = n + 1 < deadCount ? dead[n + 1] : end;
+        if (from == to)
+            continue;
+
+        for (auto array : kArrays)
+        {
+            float* data = (ps.*array).data();
+            std::copy(data + from, data + to, data + write);
+        }
+        std::uint8_t* ids = ps.emitterOf.data();
+        std::copy(ids + from, ids + to, ids + write);
+        write += to - from;
+    }
+    return write - begin;
+}
+
+ParticleSim::ParticleSim(int capacity)
+    : capacity(capacity)
+    , px(capacity), py(capacity), pz(capacity)
+    , vx(capacity), vy(capacity), vz(capacity)
+    , life(capacity)
+    , emitterOf(capacity)
+    , dead(capacity)
+{}
+
+int addEmitter(ParticleSim& ps, ParticleEmitter const& emitter)
+{
+    if (ps.emitters.size() >= kMaxEmitters)
+        return -1;
+
+    ps.emitters.push_back(emitter);
+    ps.emitters.back().accumulator = 0.0f;
+    ps.emitters.back().alive = 0;
+    return int(ps.emitters.size()) - 1;
+}
+
+int particleCapacityFor(ParticleSim const& ps)
+{
+    int capacity = 0;
+    for (auto const& emitter : ps.emitters)
+        capacity += emitter.budget;
+    return capacity;
+}
+
+void resizeParticles(ParticleSim& ps, int capacity)
+{
+    ps.capacity = capacity;
+    for (auto array : kArrays)
+        (ps.*array).resize(capacity);
+    ps.emitterOf.resize(capacity);
+    ps.dead.resize(capacity);
+
+    // Reallocated on demand by updateParticlesParallel()
+    for (auto array : kNextArrays)
+        (ps.*array) = ParticleArray();
+    ps.nextEmitterOf = std::vector<std::uint8_t>();
+
+    if (ps.aliveCount > capacity)
+    {
+        ps.aliveCount = capacity;
+        for (auto& emitter : ps.emitters)
+            emitter.alive = 0;
+        for (int i = 0; i < ps.aliveCount; ++i)
+            ++ps.emitters[ps.emitterOf[i]].alive;
+    }
+}
+
+void seedParticles(ParticleSim& ps, std::uint64_t seed, std::uint32_t stream)
+{
+    ps.rng = RandomStream(seed, stream);
+}
+
+void resetParticles(ParticleSim& ps)
+{
+    ps.aliveCount = 0;
+    for (auto& emitter : ps.emitters)
+    {
+        emitter.accumulator = 0.0f;
+        emitter.alive = 0;
+    }
+}
+
+int takeEmissionCount(ParticleEmitter& emitter, float dt)
+{
+    emitter.accumulator += emitter.rate * emitter.lod * dt;
+    int toSpawn = (int)emitter.accumulator;
+    if (toSpawn > 0)
+        emitter.accumulator -= (float)toSpawn;
+    return toSpawn;
+}
+
+// Appends count particles from the given emitter
+static void emitFrom(ParticleSim& ps, int id, int count, float dt)
+{
+    ParticleEmitter& em = ps.emitters[id];
+
+    int first = ps.aliveCount;
+    ps.aliveCount += count;
+    em.alive += count;
+
+    // Random numbers are generated in batches, 9 per particle
+    constexpr int kBatch = 256;
+    constexpr int kRandomPerParticle = 9;
+    float random[kBatch * kRandomPerParticle];
+
+    for (int n = 0; n < count; ++n)
+    {
+        int idx = first + n;
+
+        int k = n % kBatch;
+        if (0 == k)
+        {
+            int batch = std::min(kBatch, count - n) * kRandomPerParticle;
+            ps.rng.uniform(std::span<float>(random, batch));
+        }
+        float const* u = random + k * kRandomPerParticle;   // all in [0,1)
+
+        // 1) Pick a random point along the emitter's path this frame
+        Vec3f start = em.prevPos + (em.pos - em.prevPos) * u[0];
+
+        // 2) Random offset in a disk around it
+        float r     = em.radius * std::sqrt(u[1]);
+        float theta = 2.0f * std::numbers::pi_v<float> * u[2];
+
+        float c = std::cos(theta);
+        float s = std::sin(theta);
+        float dy = (u[3] - 0.5f) * em.verticalSpread;
+
+        Vec3f offset = em.right * (r * c) + em.up * (r * s) + Vec3f{0.f, dy, 0.f};
+
+        // 3) Velocity with jitter, and away from the center
+        Vec3f jitter{
+            (u[4] - 0.5f) * em.jitter.x,
+            (u[5] - 0.5f) * em.jitter.y,
+            (u[6] - 0.5f) * em.jitter.z
+        };
+        Vec3f vel = em.velocity + jitter + (em.right * c + em.up * s) * em.radialSpeed;
+
+        // 4) Sub-frame "age" so particles of this batch are not all the same age
+        Vec3f substepOffset = -vel * (u[7] * dt);     // negative: as if they already moved a bit
+
+        Vec3f pos = start + offset + substepOffset;
+        ps.px[idx] = pos.x;
+        ps.py[idx] = pos.y;
+        ps.pz[idx] = pos.z;
+        ps.vx[idx] = vel.x;
+        ps.vy[idx] = vel.y;
+        ps.vz[idx] = vel.z;
+
+        ps.life[idx] = em.lifeMin + (em.lifeMax - em.lifeMin) * u[8];
+        ps.emitterOf[idx] = std::uint8_t(id);
+    }
+}
+
+void emitParticles(ParticleSim& ps, float dt)
+{
+    // Highest priority first; equal priorities in the order they were added
+    int order[kMaxEmitters];
+    int emitterCount = int(ps.emitters.size());
+    std::iota(order, order + emitterCount, 0);
+    std::stable_sort(order, order + emitterCount, [&ps] (int a, int b) {
+        return ps.emitters[a].priority > ps.emitters[b].priority;
+    });
+
+    int freeSlots = ps.capacity - ps.aliveCount;
+    for (int n = 0; n < emitterCount; ++n)
+    {
+        ParticleEmitter& em = ps.emitters[order[n]];
+        if (!em.active)
+        {
+            em.accumulator = 0.0f;
+            continue;
+        }
+
+        // Particles that don't fit are dropped
+        int requested = takeEmissionCount(em, dt);
+        int allowed   = std::min(requested, std::max(0, em.budget - em.alive));
+        int count     = std::min(allowed, freeSlots);
+        em.throttled += std::size_t(requested - count);
+
+        emitFrom(ps, order[n], count, dt);
+        freeSlots -= count;
+    }
+}
+
+
+void updateParticles(ParticleSim& ps, float dt)
+{
+    int deadCount = step(ps, 0, ps.aliveCount, dt, ps.dead.data());
+    removeDead(ps, ps.dead.data(), deadCount);
+}
+
+void updateParticlesScalar(ParticleSim& ps, float dt)
+{
+    int deadCount = stepScalar(ps, 0, ps.aliveCount, dt, ps.dead.data());
+    removeDead(ps, ps.dead.data(), deadCount);
+}
+
+void updateParticlesParallel(ParticleSim& ps, float dt, ThreadPool& pool)
+{
+    int const chunks = (ps.aliveCount + kParticleChunk - 1) / kParticleChunk;
+    if (chunks <= 1)
+    {
+        updateParticles(ps, dt);
+        return;
+    }
+
+    if (ps.nextPx.size() != ps.px.size())
+    {
+        for (auto array : kNextArrays)
+            (ps.*array).resize(ps.capacity);
+        ps.nextEmitterOf.resize(ps.capacity);
+    }
+
+    // 1) Integrate each chunk and compact its survivors in place. Each chunk
+    //    writes its dead indices to its own range of ps.dead, its count of
+    //    survivors to chunkAlive[c+1] and its deaths per emitter to
+    //    chunkDeaths.
+    ps.chunkAlive.assign(chunks + 1, 0);
+    ps.chunkDeaths.assign(std::size_t(chunks) * kMaxEmitters, 0);
+    pool.parallel_for(chunks, 1, [&ps, dt] (std::size_t first, std::size_t last) {
+        for (std::size_t c = first; c < last; ++c)
+        {
+            int begin = int(c) * kParticleChunk;
+            int end   = std::min(begin + kParticleChunk, ps.aliveCount);
+
+            int* dead = ps.dead.data() + begin;
+            int deadCount = step(ps, begin, end, dt, dead);
+
+            int* deaths = ps.chunkDeaths.data() + c * kMaxEmitters;
+            for (int n = 0; n < deadCount; ++n)
+                ++deaths[ps.emitterOf[dead[n]]];
+
+            ps.chunkAlive[c + 1] = compactChunk(ps, begin, end, dead, deadCount);
+        }
+    });
+
+    for (int c = 0; c < chunks; ++c)
+    {
+        for (std::size_t e = 0; e < ps.emitters.size(); ++e)
+            ps.emitters[e].alive -= ps.chunkDeaths[c * kMaxEmitters + e];
+    }
+
+    // 2) Prefix sum: chunkAlive[c] is where the survivors of chunk c go
+    std::partial_sum(ps.chunkAlive.begin(), ps.chunkAlive.end(), ps.chunkAlive.begin());
+
+    // 3) Gather them into the other set of arrays, and swap
+    pool.parallel_for(chunks, 1, [&ps] (std::size_t first, std::size_t last) {
+        for (std::size_t c = first; c < last; ++c)
+        {
+            int begin = int(c) * kParticleChunk;
+            int count = ps.chunkAlive[c + 1] - ps.chunkAlive[c];
+            for (std::size_t a = 0; a < std::size(kArrays); ++a)
+            {
+                float const* src = (ps.*kArrays[a]).data() + begin;
+                std::copy(src, src + count, (ps.*kNextArrays[a]).data() + ps.chunkAlive[c]);
+            }
+
+            std::uint8_t const* ids = ps.emitterOf.data() + begin;
+            std::copy(ids, ids + count, ps.nextEmitterOf.data() + ps.chunkAlive[c]);
+        }
+    });
+
+    for (std::size_t a = 0; a < std::size(kArrays); ++a)
+        std::swap(ps.*kArrays[a], ps.*kNextArrays[a]);
+    std::swap(ps.emitterOf, ps.nextEmitterOf);
+
+    ps.aliveCount = ps.chunkAlive[chunks];
+}
+
+std::span<std::uint32_t const> sortParticlesBackToFront(ParticleSim& ps, int count, Vec4f const& depthRow, ThreadPool& pool, float timeOffset)
+{
+    std::size_t n = std::size_t(std::max(count, 0));
+    ps.sortKeys.resize(n);
+    ps.sortOrder.resize(n);
+    ps.sortKeysScratch.resize(n);
+    ps.sortOrderScratch.resize(n);
+
+    // Keys sort ascending, so farthest (largest w) must give the smallest key
+    pool.parallel_for(n, kParticleChunk, [&] (std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i)
+        {
+            float x = ps.px[i] + ps.vx[i] * timeOffset;
+            float y = ps.py[i] + ps.vy[i] * timeOffset;
+            float z = ps.pz[i] + ps.vz[i] * timeOffset;
+            float w = depthRow.x * x + depthRow.y * y + depthRow.z * z + depthRow.w;
+            ps.sortKeys[i]  = ~radix_key_from_float(std::bit_cast<std::uint32_t>(w));
+            ps.sortOrder[i] = std::uint32_t(i);
+        }
+    });
+
+    radix_sort(ps.sortKeys, ps.sortOrder, ps.sortKeysScratch, ps.sortOrderScratch, pool);
+    return ps.sortOrder;
+}
+
+ParticleVertexBounds particleVertexBounds(ParticleSim const& ps, int count, float timeOffset)
+{
+    ParticleVertexBounds ret;
+    if (count <= 0)
+        return ret;
+
+    float const* arrays[3] = { ps.px.data(), ps.py.data(), ps.pz.data() };
+    float const* velocities[3] = { ps.vx.data(), ps.vy.data(), ps.vz.data() };
+    float lo[3], hi[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float const* data = arrays[axis];
+        float const* vel = velocities[axis];
+        auto position = [&] (int i) { return data[i] + vel[i] * timeOffset; };
+
+        int i = 0;
+        float mn = position(0), mx = mn;
+#if PARTICLES_AVX_
+        __m256 const offset = _mm256_set1_ps(timeOffset);
+        auto load = [&] (int i) {
+            return _mm256_add_ps(_mm256_load_ps(data + i), _mm256_mul_ps(_mm256_load_ps(vel + i), offset));
+        };
+        if (count >= 8)
+        {
+            __m256 vmin = load(0), vmax = vmin;
+            for (i = 8; i + 8 <= count; i += 8)
+            {
+                __m256 v = load(i);
+                vmin = _mm256_min_ps(vmin, v);
+                vmax = _mm256_max_ps(vmax, v);
+            }
+            alignas(32) float mins[8], maxs[8];
+            _mm256_store_ps(mins, vmin);
+            _mm256_store_ps(maxs, vmax);
+            mn = *std::min_element(mins, mins + 8);
+            mx = *std::max_element(maxs, maxs + 8);
+        }
+#elif PARTICLES_SSE2_
+        __m128 const offset = _mm_set1_ps(timeOffset);
+        auto load = [&] (int i) {
+            return _mm_add_ps(_mm_load_ps(data + i), _mm_mul_ps(_mm_load_ps(vel + i), offset));
+        };
+        if (count >= 4)
+        {
+            __m128 vmin = load(0), vmax = vmin;
+            for (i = 4; i + 4 <= count; i += 4)
+            {
+                __m128 v = load(i);
+                vmin = _mm_min_ps(vmin, v);
+                vmax = _mm_max_ps(vmax, v);
+            }
+            alignas(16) float mins[4], maxs[4];
+            _mm_store_ps(mins, vmin);
+            _mm_store_ps(maxs, vmax);
+            mn = *std::min_element(mins, mins + 4);
+            mx = *std::max_element(maxs, maxs + 4);
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            mn = std::min(mn, position(i));
+            mx = std::max(mx, position(i));
+        }
+        lo[axis] = mn;
+        hi[axis] = mx;
+    }
+
+    // Avoid dividing by zero when all particles are in one plane
+    constexpr float kMinExtent = 1e-6f;
+    ret.min    = Vec3f{ lo[0], lo[1], lo[2] };
+    ret.extent = Vec3f{
+        std::max(hi[0] - lo[0], kMinExtent),
+        std::max(hi[1] - lo[1], kMinExtent),
+        std::max(hi[2] - lo[2], kMinExtent)
+    };
+    return ret;
+}
+
+// The part of the packed word that is the same for all particles of an
+// emitter: its id and size scale
+static void emitterWordBits(ParticleSim const& ps, std::uint32_t (&bits)[kMaxEmitters])
+{
+    for (int i = 0; i < kMaxEmitters; ++i)
+        bits[i] = std::uint32_t(i);
+
+    for (std::size_t i = 0; i < ps.emitters.size() && i < kMaxEmitters; ++i)
+    {
+        float size = std::clamp(ps.emitters[i].sizeScale * kPackedSizeScale + 0.5f, 0.0f, 255.0f);
+        bits[i] |= std::uint32_t(size) << 16;
+    }
+}
+
+// Packs particles [begin, end) with plain C++
+static void packRangeScalar(
+    ParticleSim const& ps,
+    int begin, int end,
+    Vec3f const& min, Vec3f const& scale,
+    std::uint32_t const (&emitterBits)[kMaxEmitters],
+    std::uint16_t* x, std::uint16_t* y, std::uint16_t* z,
+    std::uint32_t* words,
+    float timeOffset
+)
+{
+    auto quantize = [] (float p, float lo, float s) {
+        float v = std::min(std::max((p - lo) * s, 0.0f), 65535.0f);
+        return std::uint16_t(v + 0.5f);
+    };
+
+    for (int i = begin; i < end; ++i)
+    {
+        x[i] = quantize(ps.px[i] + ps.vx[i] * timeOffset, min.x, scale.x);
+        y[i] = quantize(ps.py[i] + ps.vy[i] * timeOffset, min.y, scale.y);
+        z[i] = quantize(ps.pz[i] + ps.vz[i] * timeOffset, min.z, scale.z);
+
+        float life = std::min(std::max(ps.life[i], 0.0f), kPackedLifeMax);
+        std::uint32_t lifeCode = std::uint32_t(life * kPackedLifeScale);
+        std::uint32_t rotation = std::uint32_t(life * (256.0f * kParticleSpin)) & 0xff;
+        words[i] = emitterBits[ps.emitterOf[i]] | lifeCode << 4 | rotation << 24;
+    }
+}
+
+#if PARTICLES_AVX_ || PARTICLES_SSE2_
+// Saturated 32 to 16 bit conversion of values in [0, 65535]. SSE2 only has
+// a signed pack, so the values are moved to the signed range and back.
+static __m128i packUnsigned16(__m128i lo, __m128i hi)
+{
+    __m128i const bias = _mm_set1_epi32(32768);
+    __m128i packed = _mm_packs_epi32(_mm_sub_epi32(lo, bias), _mm_sub_epi32(hi, bias));
+    return _mm_xor_si128(packed, _mm_set1_epi16(std::int16_t(0x8000)));
+}
+
+// Life and rotation bits of 4 words
+static __m128i lifeWordBits(__m128i lifeCode, __m128i rotation)
+{
+    return _mm_or_si128(_mm_slli_epi32(lifeCode, 4), _mm_slli_epi32(rotation, 24));
+}
+
+static __m128i emitterWordBits4(std::uint32_t const (&bits)[kMaxEmitters], std::uint8_t const* ids)
+{
+    return _mm_setr_epi32(int(bits[ids[0]]), int(bits[ids[1]]), int(bits[ids[2]]), int(bits[ids[3]]));
+}
+#endif
+
+#if PARTICLES_AVX_
+static int packSimd(
+    ParticleSim const& ps,
+    int count,
+    Vec3f const& min, Vec3f const& scale,
+    std::uint32_t const (&emitterBits)[kMaxEmitters],
+    std::uint16_t* x, std::uint16_t* y, std::uint16_t* z,
+    std::uint32_t* words,
+    float timeOffset
+)
+{
+    __m256 const offset    = _mm256_set1_ps(timeOffset);
+    __m256 const zero      = _mm256_setzero_ps();
+    __m256 const half      = _mm256_set1_ps(0.5f);
+    __m256 const maxCode   = _mm256_set1_ps(65535.0f);
+    __m256 const lifeMax   = _mm256_set1_ps(kPackedLifeMax);
+    __m256 const lifeScale = _mm256_set1_ps(kPackedLifeScale);
+    __m256 const spinScale = _mm256_set1_ps(256.0f * kParticleSpin);
+
+    float const* arrays[3] = { ps.px.data(), ps.py.data(), ps.pz.data() };
+    float const* velocities[3] = { ps.vx.data(), ps.vy.data(), ps.vz.data() };
+    std::uint16_t* outputs[3] = { x, y, z };
+    __m256 const mins[3]   = { _mm256_set1_ps(min.x), _mm256_set1_ps(min.y), _mm256_set1_ps(min.z) };
+    __m256 const scales[3] = { _mm256_set1_ps(scale.x), _mm256_set1_ps(scale.y), _mm256_set1_ps(scale.z) };
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            __m256 p = _mm256_add_ps(_mm256_load_ps(arrays[axis] + i), _mm256_mul_ps(_mm256_load_ps(velocities[axis] + i), offset));
+            __m256 v = _mm256_mul_ps(_mm256_sub_ps(p, mins[axis]), scales[axis]);
+            v = _mm256_min_ps(_mm256_max_ps(v, zero), maxCode);
+            __m256i q = _mm256_cvttps_epi32(_mm256_add_ps(v, half));
+
+            __m128i packed = packUnsigned16(_mm256_castsi256_si128(q), _mm256_extractf128_si256(q, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(outputs[axis] + i), packed);
+        }
+
+        __m256 life = _mm256_min_ps(_mm256_max_ps(_mm256_load_ps(ps.life.data() + i), zero), lifeMax);
+        __m256i lifeCode = _mm256_cvttps_epi32(_mm256_mul_ps(life, lifeScale));
+        __m256i rotation = _mm256_cvttps_epi32(_mm256_mul_ps(life, spinScale));
+
+        // AVX has no 256-bit integer instructions; do each half
+        std::uint8_t const* ids = ps.emitterOf.data() + i;
+        __m128i lo = _mm_or_si128(
+            lifeWordBits(_mm256_castsi256_si128(lifeCode), _mm256_castsi256_si128(rotation)),
+            emitterWordBits4(emitterBits, ids)
+        );
+        __m128i hi = _mm_or_si128(
+            lifeWordBits(_mm256_extractf128_si256(lifeCode, 1), _mm256_extractf128_si256(rotation, 1)),
+            emitterWordBits4(emitterBits, ids + 4)
+        );
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(words + i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(words + i + 4), hi);
+    }
+    return i;
+}
+#elif PARTICLES_SSE2_
+static int packSimd(
+    ParticleSim const& ps,
+    int count,
+    Vec3f const& min, Vec3f const& scale,
+    std::uint32_t const (&emitterBits)[kMaxEmitters],
+    std::uint16_t* x, std::uint16_t* y, std::uint16_t* z,
+    std::uint32_t* words,
+    float timeOffset
+)
+{
+    __m128 const offset    = _mm_set1_ps(timeOffset);
+    __m128 const zero      = _mm_setzero_ps();
+    __m128 const half      = _mm_set1_ps(0.5f);
+    __m128 const maxCode   = _mm_set1_ps(65535.0f);
+    __m128 const lifeMax   = _mm_set1_ps(kPackedLifeMax);
+    __m128 const lifeScale = _mm_set1_ps(kPackedLifeScale);
+    __m128 const spinScale = _mm_set1_ps(256.0f * kParticleSpin);
+
+    float const* arrays[3] = { ps.px.data(), ps.py.data(), ps.pz.data() };
+    float const* velocities[3] = { ps.vx.data(), ps.vy.data(), ps.vz.data() };
+    std::uint16_t* outputs[3] = { x, y, z };
+    __m128 const mins[3]   = { _mm_set1_ps(min.x), _mm_set1_ps(min.y), _mm_set1_ps(min.z) };
+    __m128 const scales[3] = { _mm_set1_ps(scale.x), _mm_set1_ps(scale.y), _mm_set1_ps(scale.z) };
+
+    // Two groups of 4, so that positions are stored 8 at a time
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            __m128i q[2];
+            for (int k = 0; k < 2; ++k)
+            {
+                int j = i + 4 * k;
+                __m128 p = _mm_add_ps(_mm_load_ps(arrays[axis] + j), _mm_mul_ps(_mm_load_ps(velocities[axis] + j), offset));
+                __m128 v = _mm_mul_ps(_mm_sub_ps(p, mins[axis]), scales[axis]);
+                v = _mm_min_ps(_mm_max_ps(v, zero), maxCode);
+                q[k] = _mm_cvttps_epi32(_mm_add_ps(v, half));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(outputs[axis] + i), packUnsigned16(q[0], q[1]));
+        }
+
+        for (int k = 0; k < 2; ++k)
+        {
+            __m128 life = _mm_min_ps(_mm_max_ps(_mm_load_ps(ps.life.data() + i + 4 * k), zero), lifeMax);
+            __m128i lifeCode = _mm_cvttps_epi32(_mm_mul_ps(life, lifeScale));
+            __m128i rotation = _mm_cvttps_epi32(_mm_mul_ps(life, spinScale));
+
+            __m128i word = _mm_or_si128(
+                lifeWordBits(lifeCode, rotation),
+                emitterWordBits4(emitterBits, ps.emitterOf.data() + i + 4 * k)
+            );
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(words + i + 4 * k), word);
+        }
+    }
+    return i;
+}
+#endif
+
+static Vec3f quantizationScale(ParticleVertexBounds const& bounds)
+{
+    return Vec3f{ 65535.0f / bounds.extent.x, 65535.0f / bounds.extent.y, 65535.0f / bounds.extent.z };
+}
+
+void packParticleVertices(
+    ParticleSim const& ps,
+    int count,
+    ParticleVertexBounds const& bounds,
+    std::uint16_t* x, std::uint16_t* y, std::uint16_t* z,
+    std::uint32_t* words,
+    float timeOffset
+)
+{
+    std::uint32_t emitterBits[kMaxEmitters];
+    emitterWordBits(ps, emitterBits);
+
+    Vec3f scale = quantizationScale(bounds);
+
+    int done = 0;
+#if PARTICLES_AVX_ || PARTICLES_SSE2_
+    done = packSimd(ps, count, bounds.min, scale, emitterBits, x, y, z, words, timeOffset);
+#endif
+    packRangeScalar(ps, done, count, bounds.min, scale, emitterBits, x, y, z, words, timeOffset);
+}
+
+void packParticleVerticesScalar(
+    ParticleSim const& ps,
+    int count,
+    ParticleVertexBounds const& bounds,
+    std::uint16_t* x, std::uint16_t* y, std::uint16_t* z,
+    std::uint32_t* words,
+    float timeOffset
+)
+{
+    std::uint32_t emitterBits[kMaxEmitters];
+    emitterWordBits(ps, emitterBits);
+
+    packRangeScalar(ps, 0, count, bounds.min, quantizationScale(bounds), emitterBits, x, y, z, words, timeOffset);
+}
@@ -0,0 +1,264 @@
+#ifndef PARTICLE_SIM_HPP
+#define PARTICLE_SIM_HPP
+
+#include <new>
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "../support/random.hpp"
+
+// CPU side of the particle system (emission and simulation). Rendering is in
+// particles.hpp.
+//
+// One pool serves several emitters (engine exhaust, landing dust, ...), so
+// that all effects share one upload and one draw. The pool's capacity is set
+// at runtime, normally to the sum of the emitters' budgets (see
+// particleCapacityFor()). Each emitter has its own rate, lifetime, budget
+// (maximum alive particles) and priority. When the pool is full, emitters
+// with a higher priority get the free slots first, and lower priority ones
+// are throttled; see emitParticles(). That only happens with a pool smaller
+// than the sum of the budgets.
+//
+// The pool is kept dense: alive particles are at [0, aliveCount). Emission
+// appends, and particles that die are replaced by the last ones. Update and
+// upload only touch alive particles, and positions can be uploaded straight
+// from their arrays.
+//
+// Each component has its own array (structure of arrays), so that
+// updateParticles() can process 8 (AVX) or 4 (SSE) particles per
+// instruction. updateParticlesScalar() is the portable version; both give
+// bit-identical results.
+//
+// updateParticlesParallel() splits the pool into chunks of kParticleChunk
+// particles that are updated on a thread pool. Each chunk compacts its
+// survivors in place; a prefix sum over the chunk counts then gives where
+// they go in the second set of arrays, which are copied in parallel and
+// swapped with the first. Particles keep their relative order, and the
+// result does not depend on the number of threads.
+//
+// Particles collide with the ground. With a heightfield (see heightfield.hpp
+// and ParticleGround), they bounce off it or slide along it; the heights
+// under a block of particles are looked up with SIMD between integration and
+// the collision response, and every particle costs the same whether it hits
+// the ground or not. Without one, particles die below a fixed plane.
+//
+// sortParticlesBackToFront() gives a per-view draw order for alpha blending,
+// using the radix sort from support/radix_sort.hpp.
+//
+// packParticleVertices() writes the alive particles in the compact format
+// that is uploaded for drawing (10 bytes per particle, see particle.vert):
+//
+//  - positions as 16-bit fractions of a box around the particles (from
+//    particleVertexBounds()), one array per axis like px/py/pz;
+//  - one 32-bit word per particle with the emitter id (bits 0-3), the life
+//    left (bits 4-15, in 1/1024 s, up to 4 s), the point size scale (bits
+//    16-23, in 1/64) and the sprite rotation (bits 24-31, in 1/256 turn).
+//    Sprites turn kParticleSpin times per second of life.
+//
+// Packing uses SIMD like the update; packParticleVerticesScalar() gives
+// identical results.
+//
+// This file does not depend on OpenGL (it's tested in main-test).
+
+// Default capacity of the pool
+constexpr int kMaxParticles = 70000;
+
+// Emitter ids are stored per particle in a byte
+constexpr int kMaxEmitters = 16;
+
+// Particles per chunk in updateParticlesParallel(). A multiple of 16, so that
+// chunks of the float arrays start on a cache line.
+constexpr int kParticleChunk = 16 * 1024;
+
+constexpr std::uint64_t kDefaultParticleSeed = 0x5eed'0000'c0ffee;
+
+// Packed vertex word (see packParticleVertices())
+constexpr float kPackedLifeScale = 1024.0f;
+constexpr float kPackedLifeMax = 4095.0f / kPackedLifeScale;
+constexpr float kPackedSizeScale = 64.0f;
+constexpr float kParticleSpin = 0.5f;   // turns per second
+
+class ThreadPool;
+struct Heightfield;
+
+// Cache line aligned storage for the particle arrays
+template< typename tType >
+struct ParticleAllocator
+{
+    using value_type = tType;
+
+    static constexpr std::align_val_t kAlign{ 64 };
+
+    ParticleAllocator() = default;
+    template< typename tOther >
+    ParticleAllocator( ParticleAllocator<tOther> const& ) noexcept {}
+
+    tType* allocate(std::size_t n)
+    {
+        return static_cast<tType*>(::operator new(n * sizeof(tType), kAlign));
+    }
+    void deallocate(tType* p, std::size_t) noexcept
+    {
+        ::operator delete(p, kAlign);
+    }
+
+    template< typename tOther >
+    bool operator==(ParticleAllocator<tOther> const&) const noexcept { return true; }
+};
+
+using ParticleArray = std::vector<float, ParticleAllocator<float>>;
+
+struct ParticleEmitter
+{
+    float rate = 0.0f;          // particles per second
+    float lifeMin = 0.6f;       // seconds
+    float lifeMax = 1.2f;
+    int budget = 0;             // maximum alive particles
+    int priority = 0;           // higher is served first when the pool is full
+    bool active = true;         // inactive emitters don't emit (their particles live on)
+
+    // Shape, typically updated every frame. Particles start at a random
+    // point of the path from prevPos to pos, offset in a disk spanned by
+    // right and up, and move with velocity plus jitter (full range per axis)
+    // plus radialSpeed away from the disk's center.
+    Vec3f prevPos{ 0.f, 0.f, 0.f };
+    Vec3f pos{ 0.f, 0.f, 0.f };
+    Vec3f right{ 1.f, 0.f, 0.f };
+    Vec3f up{ 0.f, 0.f, 1.f };
+    float radius = 0.2f;
+    float verticalSpread = 0.4f;
+    Vec3f velocity{ 0.f, 0.f, 0.f };
+    Vec3f jitter{ 6.f, 3.f, 6.f };
+    float radialSpeed = 0.0f;
+
+    // Level of detail, set by applyParticleBudget() (see particle_budget.hpp)
+    float lod = 1.0f;           // scales rate
+    float sizeScale = 1.0f;     // scales the point size
+
+    // State
+    float accumulator = 0.0f;   // fractional particles carried to the next frame
+    int alive = 0;
+    std::size_t throttled = 0;  // particles not emitted for lack of space (total)
+};
+
+// Ground for particle collisions
+struct ParticleGround
+{
+    Heightfield const* heightfield = nullptr;   // not owned; none: fixed plane
+    float restitution = 0.3f;   // normal speed kept by a bounce
+    float friction = 0.6f;      // tangential speed kept by each contact
+};
+
+struct ParticleSim
+{
+    explicit ParticleSim(int capacity = kMaxParticles);
+
+    int capacity;
+
+    ParticleArray px, py, pz;
+    ParticleArray vx, vy, vz;
+    ParticleArray life;   // seconds left
+    std::vector<std::uint8_t> emitterOf; // index into emitters
+    int aliveCount = 0;
+
+    std::vector<ParticleEmitter> emitters;
+
+    ParticleGround ground;
+
+    // Emission is deterministic for a given seed, see seedParticles()
+    RandomStream rng{ kDefaultParticleSeed };
+
+    // Scratch space for the updates. The second set of arrays is only
+    // allocated by updateParticlesParallel().
+    std::vector<int> dead;
+    std::vector<int> chunkAlive;
+    std::vector<int> chunkDeaths; // per chunk and emitter
+    ParticleArray nextPx, nextPy, nextPz, nextVx, nextVy, nextVz, nextLife;
+    std::vector<std::uint8_t> nextEmitterOf;
+
+    // Scratch space for sortParticlesBackToFront()
+    std::vector<std::uint32_t> sortKeys, sortOrder, sortKeysScratch, sortOrderScratch;
+};
+
+// Returns the emitter's id. At most kMaxEmitters.
+int addEmitter(ParticleSim& ps, ParticleEmitter const& emitter);
+
+// Sum of the emitters' budgets. No emitter is ever throttled in a pool of
+// this size.
+int particleCapacityFor(ParticleSim const& ps);
+
+// Change the capacity. Alive particles beyond it are dropped.
+void resizeParticles(ParticleSim& ps, int capacity);
+
+// Restart the random numbers used by emitParticles(). Systems that are
+// simulated on different threads should use different streams.
+void seedParticles(ParticleSim& ps, std::uint64_t seed, std::uint32_t stream = 0);
+
+// Reset all particles to dead state (the random numbers continue)
+void resetParticles(ParticleSim& ps);
+
+// Advance the emitter's accumulator by dt and return the number of particles
+// it asks for (rate scaled by lod). emitParticles() calls this; the GPU path (gpu_particles.hpp)
+// uses it directly.
+int takeEmissionCount(ParticleEmitter& emitter, float dt);
+
+// Emit new particles from all active emitters. Requests are limited by each
+// emitter's budget, then served in order of priority until the pool is full.
+void emitParticles(ParticleSim& ps, float dt);
+
+// Update particle positions, collide them with the ground, and kill dead
+// particles
+void updateParticles(ParticleSim& ps, float dt);
+void updateParticlesScalar(ParticleSim& ps, float dt);
+void updateParticlesParallel(ParticleSim& ps, float dt, ThreadPool& pool);
+
+// Sort the first count particles back to front by their depth along
+// depthRow (the last row of a view-projection matrix, i.e., clip space w).
+// Returns particle indices, farthest first, valid until the next call.
+// Particles are moved along their velocity by timeOffset seconds first, as
+// in packParticleVertices(), so that the order is that of the drawn ones.
+std::span<std::uint32_t const> sortParticlesBackToFront(
+    ParticleSim& ps,
+    int count,
+    Vec4f const& depthRow,
+    ThreadPool& pool,
+    float timeOffset = 0.0f
+);
+
+// Box around the first count particles, in which packed positions are
+// fractions. The extent is never zero.
+struct ParticleVertexBounds
+{
+    Vec3f min{ 0.f, 0.f, 0.f };
+    Vec3f extent{ 1.f, 1.f, 1.f };
+};
+
+// Packing moves each particle along its velocity by timeOffset seconds
+// (negative: back to a time between the last two updates, for rendering
+// between simulation steps). Use the same offset for the bounds.
+ParticleVertexBounds particleVertexBounds(ParticleSim const& ps, int count, float timeOffset = 0.0f);
+
+// Pack the first count particles: positions (count values each in x, y and
+// z) and words (count values). The outputs need no alignment.
+void packParticleVertices(
+    ParticleSim const& ps,
+    int count,
+    ParticleVertexBounds const& bounds,
+    std::uint16_t* x, std::uint16_t* y, std::uint16_t* z,
+    std::uint32_t* words,
+    float timeOffset = 0.0f
+);
+void packParticleVerticesScalar(
+    ParticleSim const& ps,
+    int count,
+    ParticleVertexBounds const& bounds,
+    std::uint16_t* x, std::uint16_t* y, std::uint16_t* z,
+    std::uint32_t* words,
+    float timeOffset = 0.0f
+);
+
+#endif // PARTICLE_SIM_HPP
@@ -0,0 +1,224 @@
+#include "particle_target.hpp"
+
+#include <algorithm>
+
+#include "../support/error.hpp"
+
+#include "texture_units.hpp"
+
+namespace
+{
+    // Uniform locations of particle_depth.frag
+    constexpr GLint kDownsampleDepthLocation = 0;
+    constexpr GLint kDownsampleDivisorLocation = 1;
+    constexpr GLint kDownsampleMaxLocation = 2;
+
+    // Uniform locations of particle_composite.frag
+    constexpr GLint kCompositeColorLocation = 0;
+    constexpr GLint kCompositeLowDepthLocation = 1;
+    constexpr GLint kCompositeDepthLocation = 2;
+    constexpr GLint kCompositeDivisorLocation = 3;
+    constexpr GLint kCompositeLowMaxLocation = 4;
+    constexpr GLint kCompositeOriginLocation = 5;
+    constexpr GLint kCompositeRangeLocation = 6;
+    constexpr GLint kCompositeWeightedLocation = 7;
+    constexpr GLint kCompositeRevealageLocation = 8;
+
+    // Texelfetched only; no filtering or mipmaps
+    void set_nearest_( GLuint aTexture )
+    {
+        glBindTexture( GL_TEXTURE_2D, aTexture );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    }
+}
+
+ParticleTarget::ParticleTarget()
+    : mDownsample( {
+        { GL_VERTEX_SHADER, "assets/cw2/fullscreen.vert" },
+        { GL_FRAGMENT_SHADER, "assets/cw2/particle_depth.frag" }
+    } )
+    , mComposite( {
+        { GL_VERTEX_SHADER, "assets/cw2/fullscreen.vert" },
+        { GL_FRAGMENT_SHADER, "assets/cw2/particle_composite.frag" }
+    } )
+{
+    glGenVertexArrays( 1, &mVao );
+    glGenFramebuffers( 1, &mFbo );
+}
+
+ParticleTarget::~ParticleTarget()
+{
+    GLuint const textures[] = { mColor, mRevealage, mDepth, mSceneDepth };
+    glDeleteTextures( 4, textures );
+    reset_texture_bindings();
+
+    glDeleteFramebuffers( 1, &mFbo );
+    glDeleteVertexArrays( 1, &mVao );
+}
+
+void ParticleTarget::begin( int aDivisor, float aNear, float aFar, ParticleBlend aBlend )
+{
+    mDivisor = std::max( aDivisor, 1 );
+    mBlend = aBlend;
+    mNear = aNear;
+    mFar = aFar;
+
+    glGetIntegerv( GL_VIEWPORT, mViewport );
+    GLsizei const width = mViewport[2], height = mViewport[3];
+    mPassWidth = (width + mDivisor - 1) / mDivisor;
+    mPassHeight = (height + mDivisor - 1) / mDivisor;
+
+    if( width > mWidth || height > mHeight || mPassWidth > mLowWidth || mPassHeight > mLowHeight )
+    {
+        resize_(
+            std::max( width, mWidth ), std::max( height, mHeight ),
+            std::max( mPassWidth, mLowWidth ), std::max( mPassHeight, mLowHeight )
+        );
+    }
+
+    // 1) Scene depth of the viewport (from the default framebuffer)
+    glBindTexture( GL_TEXTURE_2D, mSceneDepth );
+    glCopyTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, mViewport[0], mViewport[1], width, height );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    glBindFramebuffer( GL_FRAMEBUFFER, mFbo );
+    glViewport( 0, 0, mPassWidth, mPassHeight );
+
+    // Nothing drawn yet: no colour, all of the background shows through
+    if( ParticleBlend::weighted == mBlend )
+    {
+        GLenum const buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers( 2, buffers );
+
+        GLfloat const accumulation[4] = { 0.f, 0.f, 0.f, 0.f };
+        GLfloat const revealage[4] = { 1.f, 0.f, 0.f, 0.f };
+        glClearBufferfv( GL_COLOR, 0, accumulation );
+        glClearBufferfv( GL_COLOR, 1, revealage );
+    }
+    else
+    {
+        GLenum const buffers[] = { GL_COLOR_ATTACHMENT0, GL_NONE };
+        glDrawBuffers( 2, buffers );
+
+        GLfloat const clear[4] = { 0.f, 0.f, 0.f, 1.f };
+        glClearBufferfv( GL_COLOR, 0, clear );
+    }
+
+    // 2) Nearest depth of each block. Only depth is written, and the depth
+    // test must stay on for that.
+    glUseProgram( mDownsample.programId() );
+    bind_texture( TextureUnit::sceneDepth, GL_TEXTURE_2D, mSceneDepth );
+    glUniform1i( kDownsampleDepthLocation, texture_unit_index( TextureUnit::sceneDepth ) );
+    glUniform1i( kDownsampleDivisorLocation, mDivisor );
+    glUniform2i( kDownsampleMaxLocation, width - 1, height - 1 );
+
+    glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+    glDepthFunc( GL_ALWAYS );
+
+    glBindVertexArray( mVao );
+    glDrawArrays( GL_TRIANGLES, 0, 3 );
+    glBindVertexArray( 0 );
+
+    glDepthFunc( GL_LESS );
+    glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+}
+
+void ParticleTarget::composite()
+{
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+    glViewport( mViewport[0], mViewport[1], mViewport[2], mViewport[3] );
+
+    glUseProgram( mComposite.programId() );
+    bind_texture( TextureUnit::particleColor, GL_TEXTURE_2D, mColor );
+    bind_texture( TextureUnit::particleDepth, GL_TEXTURE_2D, mDepth );
+    bind_texture( TextureUnit::sceneDepth, GL_TEXTURE_2D, mSceneDepth );
+    glUniform1i( kCompositeColorLocation, texture_unit_index( TextureUnit::particleColor ) );
+    glUniform1i( kCompositeLowDepthLocation, texture_unit_index( TextureUnit::particleDepth ) );
+    glUniform1i( kCompositeDepthLocation, texture_unit_index( TextureUnit::sceneDepth ) );
+    glUniform1i( kCompositeDivisorLocation, mDivisor );
+    glUniform2i( kCompositeLowMaxLocation, mPassWidth - 1, mPassHeight - 1 );
+    glUniform2i( kCompositeOriginLocation, mViewport[0], mViewport[1] );
+    glUniform2f( kCompositeRangeLocation, mNear, mFar );
+
+    bool const weighted = ParticleBlend::weighted == mBlend;
+    glUniform1i( kCompositeWeightedLocation, weighted ? 1 : 0 );
+    if( weighted )
+    {
+        bind_texture( TextureUnit::particleRevealage, GL_TEXTURE_2D, mRevealage );
+        glUniform1i( kCompositeRevealageLocation, texture_unit_index( TextureUnit::particleRevealage ) );
+    }
+
+    // colour + (fraction that shows through) * background
+    glDisable( GL_DEPTH_TEST );
+    glBlendFunc( GL_ONE, GL_SRC_ALPHA );
+
+    glBindVertexArray( mVao );
+    glDrawArrays( GL_TRIANGLES, 0, 3 );
+    glBindVertexArray( 0 );
+
+    glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+    glEnable( GL_DEPTH_TEST );
+}
+
+float ParticleTarget::resolution_scale() const noexcept
+{
+    return 1.f / float(mDivisor);
+}
+
+ParticleBlend ParticleTarget::blend() const noexcept
+{
+    return mBlend;
+}
+
+void ParticleTarget::set_weighted_blending()
+{
+    // Sum of the accumulation, product of (1 - alpha) for the revealage
+    glBlendFunci( 0, GL_ONE, GL_ONE );
+    glBlendFunci( 1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR );
+}
+
+void ParticleTarget::resize_( GLsizei aWidth, GLsizei aHeight, GLsizei aLowWidth, GLsizei aLowHeight )
+{
+    // Sizes change rarely (the window is resized), so the textures are
+    // simply replaced
+    GLuint const old[] = { mColor, mRevealage, mDepth, mSceneDepth };
+    glDeleteTextures( 4, old );
+    reset_texture_bindings();
+
+    GLuint textures[4];
+    glGenTextures( 4, textures );
+    mColor = textures[0];
+    mRevealage = textures[1];
+    mDepth = textures[2];
+    mSceneDepth = textures[3];
+
+    set_nearest_( mColor );
+    glTexStorage2D( GL_TEXTURE_2D, 1, GL_RGBA16F, aLowWidth, aLowHeight );
+    set_nearest_( mRevealage );
+    glTexStorage2D( GL_TEXTURE_2D, 1, GL_R16F, aLowWidth, aLowHeight );
+    set_nearest_( mDepth );
+    glTexStorage2D( GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, aLowWidth, aLowHeight );
+    set_nearest_( mSceneDepth );
+    glTexStorage2D( GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, aWidth, aHeight );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    glBindFramebuffer( GL_FRAMEBUFFER, mFbo );
+    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mColor, 0 );
+    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, mRevealage, 0 );
+    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mDepth, 0 );
+
+    GLenum const status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+    if( GL_FRAMEBUFFER_COMPLETE != status )
+        throw Error( "Particle framebuffer is incomplete ({:#x})", status );
+
+    mWidth = aWidth;
+    mHeight = aHeight;
+    mLowWidth = aLowWidth;
+    mLowHeight = aLowHeight;
+}
@@ -0,0 +1,102 @@
+#ifndef PARTICLE_TARGET_HPP_6F2D9B41_C8A3_4E17_9B05_2A7E4C1D8F63
+#define PARTICLE_TARGET_HPP_6F2D9B41_C8A3_4E17_9B05_2A7E4C1D8F63
+
+#include <glad/glad.h>
+
+#include "../support/program.hpp"
+
+// Offscreen render target for particles (and other transparent draws).
+//
+// Particles are large, overlapping, alpha-blended point sprites, so they
+// are limited by fill rate. Drawn into a target that is 2 or 4 times
+// smaller in each direction, they cost about 4 or 16 times fewer fragments:
+//
+//  1. begin() copies the scene's depth in the current viewport from the
+//     default framebuffer and reduces it to the nearest depth of each block
+//     of pixels (particle_depth.frag). That is the depth buffer of the low
+//     resolution target, so particles stay hidden behind the scene.
+//  2. The particles are drawn (see renderParticles()) with the blending
+//     set up there. With ParticleBlend::over, the target starts out as
+//     (0, 0, 0, 1), so it ends up with premultiplied colour and, in alpha,
+//     the fraction of the background that shows through.
+//  3. composite() blends that over the viewport with a bilateral, depth
+//     aware upsample (particle_composite.frag), so that particles do not
+//     bleed over the edges of nearer objects.
+//
+// ParticleBlend::weighted is weighted blended order independent
+// transparency (McGuire and Bavoil 2013), at any resolution including full.
+// Draws write two outputs instead of one, both with blending set up by
+// set_weighted_blending():
+//
+//  - location 0, accumulation (RGBA16F): premultiplied colour and alpha,
+//    times a weight that falls off with the distance from the camera;
+//  - location 1, revealage (R16F): alpha, which the blending multiplies
+//    into the product of (1 - alpha).
+//
+// The result does not depend on the order of the draws, so particles need
+// no sorting, in any number of views. composite() resolves the weighted
+// average of the colours over the scene.
+//
+// Both targets grow to the largest viewport they were used with; the two
+// halves of split screen share them.
+//
+// Use from the GL thread only.
+
+enum class ParticleBlend
+{
+    over,       // back to front alpha blending (order dependent)
+    weighted    // weighted blended order independent transparency
+};
+
+class ParticleTarget final
+{
+    public:
+        ParticleTarget();
+        ~ParticleTarget();
+
+        ParticleTarget( ParticleTarget const& ) = delete;
+        ParticleTarget& operator= (ParticleTarget const&) = delete;
+
+    public:
+        // Binds a target aDivisor times smaller than the current viewport,
+        // with the scene's depth. aNear and aFar are those of the view's
+        // projection.
+        void begin( int aDivisor, float aNear, float aFar, ParticleBlend = ParticleBlend::over );
+
+        // Blends the particles over the viewport that was current in begin(),
+        // and binds the default framebuffer again
+        void composite();
+
+        // Point sizes are scaled by this in the low resolution pass
+        float resolution_scale() const noexcept;
+
+        ParticleBlend blend() const noexcept;
+
+        // Blending of the two outputs of ParticleBlend::weighted. Restore
+        // with glBlendFunc().
+        static void set_weighted_blending();
+
+    private:
+        void resize_( GLsizei aWidth, GLsizei aHeight, GLsizei aLowWidth, GLsizei aLowHeight );
+
+    private:
+        ShaderProgram mDownsample, mComposite;
+
+        GLuint mVao = 0;            // empty, for the full screen triangle
+        GLuint mFbo = 0;
+        GLuint mColor = 0;          // RGBA16F, low resolution (accumulation when weighted)
+        GLuint mRevealage = 0;      // R16F, low resolution
+        GLuint mDepth = 0;          // low resolution
+        GLuint mSceneDepth = 0;     // full resolution copy
+
+        GLsizei mWidth = 0, mHeight = 0;        // allocated sizes
+        GLsizei mLowWidth = 0, mLowHeight = 0;
+
+        GLint mViewport[4]{};       // of the current pass
+        GLsizei mPassWidth = 0, mPassHeight = 0; // low resolution
+        int mDivisor = 1;
+        ParticleBlend mBlend = ParticleBlend::over;
+        float mNear = 0.1f, mFar = 1.f;
+};
+
+#endif // PARTICLE_TARGET_HPP_6F2D9B41_C8A3_4E17_9B05_2A7E4C1D8F63
@@ -1,207 +1,193 @@
 #include "particles.hpp"
-#include "texture.hpp"
-#include <cstdlib>
-#include <numbers>
-
-// Static buffer for uploading positions to GPU
-static Vec3f sParticlePositions[kMaxParticles];
-
-// Find a free particle slot (returns -1 if none available)
-static int allocParticle(ParticleSystem& ps)
-{
-    for (int i = 0; i < kMaxParticles; ++i)
-    {
-        if (ps.particles[i].life <= 0.0f)
-            return i;
-    }
-    return -1;
-}
-
-void initParticleSystem(ParticleSystem& ps, const char* texturePath)
+#include "texture_units.hpp"
+#include "streaming_buffer.hpp"
+#include "particle_budget.hpp"
+#include "particle_target.hpp"
+#include <cstring>
+#include <algorithm>
+#include <utility>
+
+void initParticleSystem(ParticleSystem& ps, TextureHandle atlas, AtlasRegion const& sprite)
 {
     // Initialize all particles as dead
-    for (int i = 0; i < kMaxParticles; ++i)
-        ps.particles[i].life = -1.0f;
-
-    ps.aliveCount = 0;
-    ps.emissionAccumulator = 0.0f;
+    resetParticles(ps);
 
-    // Create VAO and VBO
+    // Create the VAO. Packed vertices (see packParticleVertices()) come from
+    // the streaming buffer, with x, y, z and the packed words in separate
+    // ranges; uploadParticleData() binds them each frame. Positions are
+    // normalized to [0,1] and scaled to the bounds in particle.vert.
     glGenVertexArrays(1, &ps.vao);
-    glGenBuffers(1, &ps.vbo);
-
     glBindVertexArray(ps.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, ps.vbo);
 
-    glBufferData(
-        GL_ARRAY_BUFFER,
-        kMaxParticles * sizeof(Vec3f),
-        nullptr,
-        GL_DYNAMIC_DRAW
-    );
+    for (GLuint axis = 0; axis < 3; ++axis)
+    {
+        glEnableVertexAttribArray(axis);
+        glVertexAttribFormat(axis, 1, GL_UNSIGNED_SHORT, GL_TRUE, 0);
+        glVertexAttribBinding(axis, axis);
+    }
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(
-        0, 3, GL_FLOAT, GL_FALSE,
-        sizeof(Vec3f),
-        (void*)0
-    );
+    glEnableVertexAttribArray(3);
+    glVertexAttribIFormat(3, 1, GL_UNSIGNED_INT, 0);
+    glVertexAttribBinding(3, 3);
 
     glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ps.drawCount = 0;
 
-    // Load particle texture
-    ps.texture = load_texture_2d(texturePath, false);
+    // Particle texture lives in the small texture atlas
+    ps.atlas = std::move(atlas);
+    ps.sprite = sprite;
 }
 
-void resetParticles(ParticleSystem& ps)
+void resetParticleSystem(ParticleSystem& ps)
 {
-    for (int i = 0; i < kMaxParticles; ++i)
-        ps.particles[i].life = -1.0f;
-
-    ps.aliveCount = 0;
-    ps.emissionAccumulator = 0.0f;
+    resetParticles(ps);
+    if (ps.gpu)
+        ps.gpu->reset();
 }
 
-void emitParticles(
-    ParticleSystem& ps,
-    float dt,
-    Vec3f const& enginePosPrev,
-    Vec3f const& enginePosCurr,
-    Vec3f const& forwardWS,
-    Vec3f const& rightWS,
-    Vec3f const& upWS
-)
+void releaseParticleSystem(ParticleSystem& ps)
 {
-    ps.emissionAccumulator += ps.emissionRate * dt;
-    int toSpawn = (int)ps.emissionAccumulator;
-    if (toSpawn > 0)
-        ps.emissionAccumulator -= (float)toSpawn;
-
-    Vec3f baseVel = -forwardWS * 7.0f;
+    ps.gpu.reset();
+    glDeleteVertexArrays(1, &ps.vao);
+    ps.vao = 0;
+    ps.drawCount = 0;
+    ps.atlas = TextureHandle{};
+}
 
-    const float spreadRadius   = 0.2f;
-    const float verticalSpread = 0.4f;   // if you want some vertical noise
+void uploadParticleData(ParticleSystem& ps, StreamingBuffer& stream, float timeOffset)
+{
+    ps.drawCount = 0;
+    if (ps.gpu || ps.aliveCount <= 0)
+        return;
 
-    for (int n = 0; n < toSpawn; ++n)
-    {
-        int idx = allocParticle(ps);
-        if (idx < 0)
-            break;
-
-        // 1) Pick a random point along the engine path this frame
-        float uPos = std::rand() / float(RAND_MAX);   // [0,1]
-        Vec3f nozzleBack = -forwardWS * 0.2f;
-        Vec3f enginePos =
-                            enginePosPrev + (enginePosCurr - enginePosPrev) * uPos
-                            + nozzleBack;
-
-        // 2) Random offset in a disk around the nozzle
-        float u1   = std::rand() / float(RAND_MAX);
-        float u2r  = std::rand() / float(RAND_MAX);
-        float r    = spreadRadius * std::sqrt(u1);
-        float theta = 2.0f * std::numbers::pi_v<float> * u2r;
-
-        float dx = r * std::cos(theta);
-        float dz = r * std::sin(theta);
-        float dy = (std::rand() / float(RAND_MAX) - 0.5f) * verticalSpread;
-
-        Vec3f offset = rightWS * dx + upWS * dz + Vec3f{0.f, dy, 0.f};
-
-        // 3) Velocity with jitter
-        Vec3f jitter{
-            (std::rand() / float(RAND_MAX) - 0.5f) * 6.0f,
-            (std::rand() / float(RAND_MAX) - 0.5f) * 3.0f,
-            (std::rand() / float(RAND_MAX) - 0.5f) * 6.0f
-        };
-        Vec3f vel = baseVel + jitter;
-
-        // 4) Sub-frame "age" so particles of this batch are not all the same age
-        float tFrac = std::rand() / float(RAND_MAX);   // [0,1]
-        Vec3f substepOffset = -vel * (tFrac * dt);     // negative: as if they already moved a bit
-
-        ps.particles[idx].pos  = enginePos + offset + substepOffset;
-        ps.particles[idx].vel  = vel;
-
-        float lifeRand = std::rand() / float(RAND_MAX);
-        ps.particles[idx].life = 0.6f + 0.6f * lifeRand;   // [0.6, 1.2] s
-    }
-}
+    // Alive particles are already contiguous. The packed words go after the
+    // positions, aligned to 4 bytes.
+    std::size_t count = std::size_t(ps.aliveCount);
+    std::size_t axisBytes = count * sizeof(std::uint16_t);
+    std::size_t wordOffset = (3 * axisBytes + 3) & ~std::size_t(3);
+    StreamingAllocation alloc = stream.allocate(wordOffset + count * sizeof(std::uint32_t));
+    if (!alloc)
+        return; // counted as an overflow in the stream's stats
+
+    ps.drawBounds = particleVertexBounds(ps, ps.aliveCount, timeOffset);
+    ps.drawTimeOffset = timeOffset;
+    packParticleVertices(
+        ps, ps.aliveCount, ps.drawBounds,
+        reinterpret_cast<std::uint16_t*>(alloc.data + 0 * axisBytes),
+        reinterpret_cast<std::uint16_t*>(alloc.data + 1 * axisBytes),
+        reinterpret_cast<std::uint16_t*>(alloc.data + 2 * axisBytes),
+        reinterpret_cast<std::uint32_t*>(alloc.data + wordOffset),
+        timeOffset
+    );
+    stream.commit(alloc);
 
+    glBindVertexArray(ps.vao);
+    for (GLuint axis = 0; axis < 3; ++axis)
+        glBindVertexBuffer(axis, stream.buffer(), alloc.offset + GLintptr(axis * axisBytes), sizeof(std::uint16_t));
+    glBindVertexBuffer(3, stream.buffer(), alloc.offset + GLintptr(wordOffset), sizeof(std::uint32_t));
+    glBindVertexArray(0);
 
-void updateParticles(ParticleSystem& ps, float dt)
-{
-    for (int i = 0; i < kMaxParticles; ++i)
-    {
-        if (ps.particles[i].life > 0.0f)
-        {
-            ps.particles[i].life -= dt;
-            if (ps.particles[i].life > 0.0f)
-            {
-                ps.particles[i].pos =
-                   ps.particles[i].pos + ps.particles[i].vel * dt;
-
-                // Ground collision
-                if (ps.particles[i].pos.y < -0.98f)
-                    ps.particles[i].life = 0.0f;
-            }
-        }
-    }
+    ps.drawCount = ps.aliveCount;
 }
 
-void uploadParticleData(ParticleSystem& ps)
+ParticleDrawOrder sortParticlesForView(
+    ParticleSystem& ps,
+    Mat44f const& viewProj,
+    StreamingBuffer& stream,
+    ThreadPool& pool
+)
 {
-    int alive = 0;
-    for (int i = 0; i < kMaxParticles; ++i)
-    {
-        if (ps.particles[i].life > 0.0f){
-            sParticlePositions[alive++] = ps.particles[i].pos;
-    }}
-    ps.aliveCount = alive;
-
-    if (ps.aliveCount > 0)
-    {
-        glBindBuffer(GL_ARRAY_BUFFER, ps.vbo);
-        glBufferSubData(
-            GL_ARRAY_BUFFER,
-            0,
-            ps.aliveCount * sizeof(Vec3f),
-            sParticlePositions
-        );
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-    }
+    if (ps.gpu || ps.drawCount <= 0)
+        return {};
+
+    // Clip space w is the view space depth
+    Vec4f depthRow{ viewProj[3, 0], viewProj[3, 1], viewProj[3, 2], viewProj[3, 3] };
+    auto order = sortParticlesBackToFront(ps, ps.drawCount, depthRow, pool, ps.drawTimeOffset);
+
+    std::size_t bytes = order.size() * sizeof(std::uint32_t);
+    StreamingAllocation alloc = stream.allocate(bytes, sizeof(std::uint32_t));
+    if (!alloc)
+        return {};
+
+    std::memcpy(alloc.data, order.data(), bytes);
+    stream.commit(alloc);
+
+    ParticleDrawOrder ret;
+    ret.buffer = stream.buffer();
+    ret.offset = alloc.offset;
+    ret.count  = GLsizei(order.size());
+    return ret;
 }
 
 void renderParticles(
     ParticleSystem const& ps,
     GLuint programId,
     float const* viewProjMatrix,
-    Vec3f const& camPos
+    Vec3f const& camPos,
+    ParticleDrawOrder const& order,
+    ParticleTarget const* target
 )
 {
-    if (ps.aliveCount <= 0)
+    if (!ps.gpu && ps.drawCount <= 0)
         return;
 
     glUseProgram(programId);
 
-    // Enable alpha blending and disable depth writes
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // Enable alpha blending and disable depth writes. Alpha keeps the
+    // fraction of the background that shows through, which the composite
+    // of a target needs (see particle_target.hpp).
+    bool weighted = target && target->blend() == ParticleBlend::weighted;
+    if (weighted)
+        ParticleTarget::set_weighted_blending();
+    else
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
     glDepthMask(GL_FALSE);
 
     glUniformMatrix4fv(0, 1, GL_TRUE, viewProjMatrix);
-    glUniform1f(1, 6.0f); // point size
+    glUniform1f(1, kParticleBaseSize);
+    glUniform1f(9, target ? target->resolution_scale() : 1.0f);
+    glUniform1i(10, weighted ? 1 : 0);
     glUniform3fv(4, 1, &camPos.x);
 
+    // Packed positions are fractions of the bounds; GPU particles are not
+    // packed
+    ParticleVertexBounds bounds = ps.gpu ? ParticleVertexBounds{} : ps.drawBounds;
+    glUniform3fv(7, 1, &bounds.min.x);
+    glUniform3fv(8, 1, &bounds.extent.x);
+
     Vec3f exhaustColor{ 0.9f, 0.9f, 1.0f };
     glUniform3fv(2, 1, &exhaustColor.x);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, ps.texture);
-    glUniform1i(3, 0);
+    bind_texture(TextureUnit::smallTextures, GL_TEXTURE_2D_ARRAY, ps.atlas.id());
+    glUniform1i(3, texture_unit_index(TextureUnit::smallTextures));
+    glUniform4fv(5, 1, &ps.sprite.uvTransform.x);
+    glUniform1f(6, float(ps.sprite.layer));
 
-    glBindVertexArray(ps.vao);
-    glDrawArrays(GL_POINTS, 0, ps.aliveCount);
-    glBindVertexArray(0);
+    if (ps.gpu)
+    {
+        // GPU particles have no packed words; use the same one for all of
+        // them (first emitter, full life, no rotation)
+        float size = ps.emitters.empty() ? 1.0f : ps.emitters[0].sizeScale;
+        GLuint sizeCode = GLuint(std::clamp(size * kPackedSizeScale + 0.5f, 0.0f, 255.0f));
+        GLuint lifeCode = 0xfff;
+        glVertexAttribI4ui(3, lifeCode << 4 | sizeCode << 16, 0, 0, 0);
+        ps.gpu->draw(); // count stays on the GPU
+    }
+    else if (order.count > 0)
+    {
+        // Sorted: indices into the uploaded positions
+        glBindVertexArray(ps.vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, order.buffer);
+        glDrawElements(GL_POINTS, order.count, GL_UNSIGNED_INT, reinterpret_cast<void const*>(order.offset));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+    else
+    {
+        glBindVertexArray(ps.vao);
+        glDrawArrays(GL_POINTS, 0, ps.drawCount);
+        glBindVertexArray(0);
+    }
 
     // Restore depth writes
     glDepthMask(GL_TRUE);
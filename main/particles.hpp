@@ -2,62 +2,82 @@
 #define PARTICLES_HPP
 
 #include <glad/glad.h>
+#include <memory>
 #include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+#include "particle_sim.hpp"
+#include "gpu_particles.hpp"
+#include "texture_atlas.hpp"
+#include "texture_registry.hpp"
 
-// Maximum number of particles
-constexpr int kMaxParticles = 70000;
+class ThreadPool;
+class StreamingBuffer;
+class ParticleTarget;
 
-// Single particle data
-struct Particle
+// Particle system state: simulation (see particle_sim.hpp) plus GL resources
+struct ParticleSystem : ParticleSim
 {
-    Vec3f pos;
-    Vec3f vel;
-    float life;
-};
-
-// Particle system state
-struct ParticleSystem
-{
-    Particle particles[kMaxParticles];
-    int aliveCount = 0;
-    float emissionAccumulator = 0.0f;
-    float emissionRate = 15000.0f; // particles per second
+    // Empty until sized with resizeParticles()
+    ParticleSystem() : ParticleSim(0) {}
 
     GLuint vao = 0;
-    GLuint vbo = 0;
-    GLuint texture = 0;
+    GLsizei drawCount = 0; // particles uploaded this frame
+    ParticleVertexBounds drawBounds; // of the uploaded positions
+    float drawTimeOffset = 0.f;      // by which they were moved
+    TextureHandle atlas;  // small texture atlas (GL_TEXTURE_2D_ARRAY)
+    AtlasRegion sprite;   // particle image in the atlas
+
+    // When set, particles are simulated and drawn by the GPU instead (the
+    // CPU side only provides the emission counts)
+    std::unique_ptr<GpuParticles> gpu;
 };
 
-// Initialize particle system (creates VAO/VBO, loads texture)
-void initParticleSystem(ParticleSystem& ps, const char* texturePath);
+// Initialize particle system (creates the VAO)
+void initParticleSystem(ParticleSystem& ps, TextureHandle atlas, AtlasRegion const& sprite);
 
-// Reset all particles to dead state
-void resetParticles(ParticleSystem& ps);
+// Remove all particles, on the CPU and the GPU
+void resetParticleSystem(ParticleSystem& ps);
 
-// Emit new particles from engine position
-void emitParticles(
-    ParticleSystem& ps,
-    float dt,
-    // Vec3f const& enginePos,
-     Vec3f const& prevEnginePos,
-        Vec3f const& enginePosCurr,
-    Vec3f const& forwardWS,
-    Vec3f const& rightWS,
-    Vec3f const& upWS
-);
+// Delete the GL objects (VAO, GPU particles) and release the atlas. Call
+// while the context is still current; a global ParticleSystem outlives it.
+void releaseParticleSystem(ParticleSystem& ps);
 
-// Update particle positions and kill dead/ground-collision particles
-void updateParticles(ParticleSystem& ps, float dt);
+// Pack the alive particles (see packParticleVertices()) into this frame's
+// region of the streaming buffer, and point the VAO at them (nothing to do
+// for GPU particles). timeOffset moves them along their velocity, to render
+// them between simulation steps.
+void uploadParticleData(ParticleSystem& ps, StreamingBuffer& stream, float timeOffset = 0.0f);
 
-// Upload alive particle positions to GPU
-void uploadParticleData(ParticleSystem& ps);
+// Back to front order of the uploaded particles for one view, as indices in
+// the streaming buffer. Default: unsorted.
+struct ParticleDrawOrder
+{
+    GLuint buffer = 0;
+    GLintptr offset = 0;
+    GLsizei count = 0;
+};
+
+// Sort the uploaded particles for a view (at their drawn positions, moved
+// by the upload's timeOffset) and write the indices to this frame's region
+// of the streaming buffer. Returns an unsorted order for GPU
+// particles, or if the region is full.
+ParticleDrawOrder sortParticlesForView(
+    ParticleSystem& ps,
+    Mat44f const& viewProj,
+    StreamingBuffer& stream,
+    ThreadPool& pool
+);
 
-// Render particles (call between glUseProgram and setting uniforms externally)
+// Render particles (call between glUseProgram and setting uniforms externally).
+// With a target (between its begin() and composite()), the point sprites
+// are scaled to its resolution and blended the way it expects.
 void renderParticles(
     ParticleSystem const& ps,
     GLuint programId,
     float const* viewProjMatrix,
-    Vec3f const& camPos
+    Vec3f const& camPos,
+    ParticleDrawOrder const& order = {},
+    ParticleTarget const* target = nullptr
 );
 
 #endif // PARTICLES_HPP
\ No newline at end of file
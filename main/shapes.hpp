@@ -6,7 +6,7 @@
 #include "simple_mesh.hpp"
 
 
-SimpleMeshData make_cylinder(
+constexpr SimpleMeshData make_cylinder(
 bool aCapped = true,
 std::size_t aSubdivs = 16,
 Vec3f aColor = { 1.f, 1.f, 1.f },
@@ -18,7 +18,7 @@ Vec3f Ke = { 0.f, 0.f, 0.f },
 Vec3f Ks = { 0.5f, 0.5f, 0.5f }
 );
 
-SimpleMeshData make_cone(
+constexpr SimpleMeshData make_cone(
     bool        aCapped      = true,
     std::size_t aSubdivs     = 16,
     Vec3f       aColor       = { 1.f, 1.f, 1.f },
@@ -30,7 +30,7 @@ Vec3f Ke = { 0.f, 0.f, 0.f },
 Vec3f Ks = { 0.5f, 0.5f, 0.5f }
 );
 
-SimpleMeshData make_fin(
+constexpr SimpleMeshData make_fin(
     bool        aCapped      = true,
     std::size_t aSubdivs     = 16,
     Vec3f       aColor      = { 1.f, 1.f, 1.f },
@@ -42,7 +42,7 @@ Vec3f Ke = { 0.f, 0.f, 0.f },
 Vec3f Ks = { 0.5f, 0.5f, 0.5f }
 );
 
-SimpleMeshData make_cube(
+constexpr SimpleMeshData make_cube(
     bool        aCapped      = true,
     std::size_t aSubdivs     = 16,
     Vec3f       aColor      = { 1.f, 1.f, 1.f },
@@ -52,4 +52,6 @@ SimpleMeshData make_cube(
     Vec3f Kd = { 0.8f, 0.8f, 0.8f },
     Vec3f Ke = { 0.f, 0.f, 0.f },
     Vec3f Ks = { 0.5f, 0.5f, 0.5f }
-);
\ No newline at end of file
+);
+
+#include "shapes.inl"
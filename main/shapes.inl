@@ -1,32 +1,33 @@
-// spaceship.cpp
-
-#include "spaceship.hpp"
-#include "shapes.hpp"
+// shapes.inl
+//
+// Included from shapes.hpp. The generators are constexpr so that procedural
+// meshes (see ufo_geometry.hpp) can be built at compile time; they therefore
+// use cx_cos()/cx_sin() (vmlib/cxmath.hpp) instead of std::cos()/std::sin().
 
 #include <vector>
-#include <cmath>
 #include <numbers>
 
 #include "../vmlib/vec3.hpp"
 #include "../vmlib/vec4.hpp"
 #include "../vmlib/mat44.hpp"
+#include "../vmlib/cxmath.hpp"
 // ===================================================================
 // PUBLIC: build a cylinder SimpleMeshData with a pre-transform
 // ===================================================================
-SimpleMeshData make_cylinder(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Mat44f aPreTransform, float Ns, Vec3f Ka, Vec3f Kd, Vec3f Ke, Vec3f Ks)
+constexpr SimpleMeshData make_cylinder(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Mat44f aPreTransform, float Ns, Vec3f Ka, Vec3f Kd, Vec3f Ke, Vec3f Ks)
 {
     std::vector<Vec3f> position;
     std::vector<Vec3f> normal;
 
-    float prevY = std::cos( 0.f );
-    float prevZ = std::sin( 0.f );
+    float prevY = cx_cos( 0.f );
+    float prevZ = cx_sin( 0.f );
     
 
     for( std::size_t i = 0; i < aSubdivs; ++i )
     {
      float const angle = (i+1) / float(aSubdivs) * 2.f * std::numbers::pi_v<float>;
-     float y = std::cos( angle );
-     float z = std::sin( angle );
+     float y = cx_cos( angle );
+     float z = cx_sin( angle );
      Vec3f nAvg{
         0.f,
         0.5f * (prevY + y),
@@ -56,8 +57,8 @@ SimpleMeshData make_cylinder(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Ma
     // --- Caps (optional) ---
     if (aCapped)
     {
-        prevY = std::cos(0.f);
-        prevZ = std::sin(0.f);
+        prevY = cx_cos(0.f);
+        prevZ = cx_sin(0.f);
         Vec3f centerB{ 0.f, 0.f, 0.f };
         Vec3f nB{ -1.f, 0.f, 0.f };
         Vec3f p0{ 0.f, prevY, prevZ };
@@ -66,8 +67,8 @@ SimpleMeshData make_cylinder(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Ma
         for (std::size_t i = 0; i < aSubdivs; ++i)
         {
             float const angle = (i + 1) / float(aSubdivs) * 2.f * std::numbers::pi_v<float>;
-            float y = std::cos(angle);
-            float z = std::sin(angle);
+            float y = cx_cos(angle);
+            float z = cx_sin(angle);
             Vec3f p1{ 0.f, y,z};
 
             // center, p1, p0
@@ -114,14 +115,14 @@ SimpleMeshData make_cylinder(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Ma
 // ===================================================================
 // PUBLIC: build a cone SimpleMeshData with a pre-transform
 // ===================================================================
-SimpleMeshData make_cone(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Mat44f aPreTransform, float Ns, Vec3f Ka, Vec3f Kd, Vec3f Ke, Vec3f Ks)
+constexpr SimpleMeshData make_cone(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Mat44f aPreTransform, float Ns, Vec3f Ka, Vec3f Kd, Vec3f Ke, Vec3f Ks)
 {
 
     std::vector<Vec3f> position;
     std::vector<Vec3f> normal;
 
-    float prevY = std::cos( 0.f );
-    float prevZ = std::sin( 0.f );
+    float prevY = cx_cos( 0.f );
+    float prevZ = cx_sin( 0.f );
 
     Vec3f apex{ 1.f, 0.f, 0.f };
     
@@ -129,8 +130,8 @@ SimpleMeshData make_cone(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Mat44f
     for (std::size_t i = 0; i < aSubdivs; ++i)
     {
         float const angle = (i + 1) / float(aSubdivs) * 2.f * std::numbers::pi_v<float>;
-        float y = std::cos(angle);
-        float z = std::sin(angle);
+        float y = cx_cos(angle);
+        float z = cx_sin(angle);
 
         Vec3f p0{ 0.f, prevY, prevZ };
         Vec3f p1{ 0.f, y,     z     };
@@ -159,8 +160,8 @@ SimpleMeshData make_cone(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Mat44f
     // ========== BOTTOM CAP (optional) ==========
     if (aCapped)
     {
-        prevY = std::cos(0.f);
-        prevZ = std::sin(0.f);
+        prevY = cx_cos(0.f);
+        prevZ = cx_sin(0.f);
 
         Vec3f centerB{ 0.f, 0.f, 0.f };
         Vec3f nB{ -1.f, 0.f, 0.f };
@@ -168,8 +169,8 @@ SimpleMeshData make_cone(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Mat44f
         for (std::size_t i = 0; i < aSubdivs; ++i)
         {
             float const angle = (i + 1) / float(aSubdivs) * 2.f * std::numbers::pi_v<float>;
-            float y = std::cos(angle);
-            float z = std::sin(angle);
+            float y = cx_cos(angle);
+            float z = cx_sin(angle);
 
             Vec3f p0{ 0.f, prevY, prevZ };
             Vec3f p1{ 0.f, y, z };
@@ -214,7 +215,7 @@ SimpleMeshData make_cone(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Mat44f
     return mesh;
 }
 
-SimpleMeshData make_fin(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Mat44f aPreTransform, float Ns, Vec3f Ka, Vec3f Kd, Vec3f Ke, Vec3f Ks)
+constexpr SimpleMeshData make_fin(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Mat44f aPreTransform, float Ns, Vec3f Ka, Vec3f Kd, Vec3f Ke, Vec3f Ks)
 
 {
     std::vector<Vec3f> position;
@@ -368,7 +369,7 @@ SimpleMeshData make_fin(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Mat44f
 
     // Build a unit cube centred at the origin, then pre-transform it.
 // Size = 1 in each axis before scaling.
-SimpleMeshData make_cube(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Mat44f aPreTransform, float Ns, Vec3f Ka, Vec3f Kd, Vec3f Ke, Vec3f Ks)
+constexpr SimpleMeshData make_cube(bool aCapped, std::size_t aSubdivs, Vec3f aColor,Mat44f aPreTransform, float Ns, Vec3f Ka, Vec3f Kd, Vec3f Ke, Vec3f Ks)
 {
     std::vector<Vec3f> position;
     std::vector<Vec3f> normal;
@@ -0,0 +1,270 @@
+#include "simulation.hpp"
+
+#include <chrono>
+#include <cmath>
+
+#include "../support/thread_pool.hpp"
+
+namespace
+{
+    // Adds the time since the previous lap to a stage of timings (if any)
+    class StageTimer
+    {
+        public:
+            explicit StageTimer(SimulationTimings* timings)
+                : mTimings(timings)
+            {
+                if (mTimings)
+                    mLast = std::chrono::steady_clock::now();
+            }
+
+            void lap(double SimulationTimings::* stage)
+            {
+                if (!mTimings)
+                    return;
+
+                auto now = std::chrono::steady_clock::now();
+                mTimings->*stage += std::chrono::duration<double>(now - mLast).count();
+                mLast = now;
+            }
+
+        private:
+            SimulationTimings* mTimings;
+            std::chrono::steady_clock::time_point mLast;
+    };
+
+    // 64-bit FNV-1a
+    class Checksum
+    {
+        public:
+            void add(void const* data, std::size_t bytes)
+            {
+                auto const* p = static_cast<unsigned char const*>(data);
+                for (std::size_t i = 0; i < bytes; ++i)
+                {
+                    mHash ^= p[i];
+                    mHash *= 0x100000001b3ull;
+                }
+            }
+
+            void add(Vec3f const& v)
+            {
+                float const xyz[] = { v.x, v.y, v.z };
+                add(xyz, sizeof(xyz));
+            }
+
+            std::uint64_t value() const noexcept { return mHash; }
+
+        private:
+            std::uint64_t mHash = 0xcbf29ce484222325ull;
+    };
+}
+
+Vec3f bezier3(Vec3f const& A, Vec3f const& B, Vec3f const& C, Vec3f const& D, float t)
+{
+    float it  = 1.f - t;
+    float it2 = it * it;
+    float t2  = t * t;
+
+    return
+        (it2*it) * A +
+        (3.f* it2*t)* B +
+        (3.f*it* t2) *C +
+        (t2*t)* D;
+}
+
+Vec3f ufoStartPosition(Vec3f const& landingPadPos)
+{
+    // spaceship above first landing pad
+    return Vec3f{ landingPadPos.x, landingPadPos.y + 1.3f, landingPadPos.z };
+}
+
+UfoPose computeUfoPose(bool active, float animTime, Vec3f const& ufoStartPos)
+{
+    // space ship pointing upwards on landing pad before launch (idle)
+    UfoPose pose;
+    pose.position = ufoStartPos;
+    if (!active)
+        return pose;
+
+    float totalTime = 12.0f; // duration of animation
+    float tAnim = animTime;
+    if (tAnim < 0.f)       tAnim = 0.f;
+    if (tAnim > totalTime) tAnim = totalTime;
+
+    float s = tAnim / totalTime;
+    float u = s * s;
+
+    float rangeZ    = 140.0f;
+    float maxHeight = 80.0f;
+
+    float x0 = ufoStartPos.x;
+    float y0 = ufoStartPos.y;
+    float z0 = ufoStartPos.z;
+
+    // Bezier controls for curved take off path
+    Vec3f A = ufoStartPos;
+    Vec3f B{ x0, y0 + maxHeight * 0.7f,z0 };
+    Vec3f C{ x0, y0 + maxHeight, z0 + rangeZ * 0.55f };
+    Vec3f D{ x0, y0 + maxHeight * 0.2f, z0 + rangeZ };
+
+    pose.position = bezier3(A, B, C, D, u); // position on curve
+
+    // approximates tangent by sampling slightly ahead on the curve
+    float eps = 0.001f;
+    float u2 = u + eps;
+    if (u2 > 1.0f) u2 = 1.0f;
+
+    Vec3f posAhead = bezier3(A, B, C, D, u2);
+    Vec3f vel = posAhead - pose.position;
+    float speed = length(vel);
+
+    if (speed > 1e-4f)
+    {
+        pose.forward = vel / speed;
+
+        Vec3f worldUp{ 0.f, 1.f, 0.f };
+        if (std::fabs(dot(pose.forward, worldUp)) > 0.99f)
+            worldUp = Vec3f{ 1.f, 0.f, 0.f };
+
+        pose.right = normalize(cross(worldUp, pose.forward));
+        pose.up    = cross(pose.forward, pose.right);
+    }
+    return pose;
+}
+
+void initSimulation(SimulationState& sim, ParticleSim& particles, Vec3f const& landingPadPos, int particleCapacity)
+{
+    sim.landingPadPos = landingPadPos;
+    sim.particles = &particles;
+
+    // Particle effects share one pool, sized for their budgets by default
+    ParticleEmitter exhaust;
+    exhaust.rate     = 15000.0f;
+    exhaust.lifeMin  = 0.6f;
+    exhaust.lifeMax  = 1.2f;
+    exhaust.budget   = 18000;   // rate * lifeMax
+    exhaust.priority = 1;
+    exhaust.active   = false;
+    sim.exhaustEmitter = addEmitter(particles, exhaust);
+
+    ParticleEmitter dust;
+    dust.rate           = 4000.0f;
+    dust.lifeMin        = 0.4f;
+    dust.lifeMax        = 1.0f;
+    dust.budget         = 4000;
+    dust.priority       = 0;    // throttled first
+    dust.active         = false;
+    dust.prevPos        = landingPadPos + Vec3f{ 0.f, 0.05f, 0.f };
+    dust.pos            = dust.prevPos;
+    dust.radius         = 1.2f;
+    dust.verticalSpread = 0.1f;
+    dust.velocity       = Vec3f{ 0.f, 0.6f, 0.f };
+    dust.jitter         = Vec3f{ 1.f, 0.5f, 1.f };
+    dust.radialSpeed    = 3.0f;
+    sim.dustEmitter     = addEmitter(particles, dust);
+
+    resizeParticles(particles, particleCapacity > 0 ? particleCapacity : particleCapacityFor(particles));
+}
+
+SimulationStep stepSimulation(SimulationState& sim, float dt, ThreadPool& pool, bool gpuParticles, SimulationTimings* timings)
+{
+    StageTimer timer(timings);
+    SimulationStep ret;
+
+    // 1) Spaceship along its path
+    VehicleAnim& anim = sim.ufoAnim;
+    anim.prevTime = anim.time;
+    if (anim.active && !anim.paused)
+        anim.time += dt;
+
+    ret.pose = computeUfoPose(anim.active, anim.time, ufoStartPosition(sim.landingPadPos));
+    timer.lap(&SimulationTimings::ufo);
+
+    // 2) Particle emission
+    ParticleSim& ps = *sim.particles;
+    ParticleEmitter& exhaust = ps.emitters[sim.exhaustEmitter];
+    ParticleEmitter& dust    = ps.emitters[sim.dustEmitter];
+
+    exhaust.active = anim.active && !anim.paused;
+    dust.active    = exhaust.active && ret.pose.position.y - sim.landingPadPos.y < kDustHeight;
+
+    if (exhaust.active)
+    {
+        Vec3f enginePosCurr = ret.pose.position - ret.pose.forward * 1.2f;
+
+        if (sim.firstEngineStep)
+        {
+            // First step after (re)starting animation: no history yet
+            sim.prevEnginePos   = enginePosCurr;
+            sim.firstEngineStep = false;
+        }
+
+        // Exhaust leaves the nozzle, slightly behind the engine
+        Vec3f nozzleBack = -ret.pose.forward * 0.2f;
+        exhaust.prevPos  = sim.prevEnginePos + nozzleBack;
+        exhaust.pos      = enginePosCurr + nozzleBack;
+        exhaust.velocity = -ret.pose.forward * 7.0f;
+        exhaust.right    = ret.pose.right;
+        exhaust.up       = ret.pose.up;
+
+        if (gpuParticles)
+        {
+            // Emitted by the GPU (exhaust only)
+            ret.gpuSpawnCount = std::uint32_t(takeEmissionCount(exhaust, dt));
+            ret.enginePrev = sim.prevEnginePos;
+            ret.engineCurr = enginePosCurr;
+        }
+
+        sim.prevEnginePos = enginePosCurr;
+    }
+    else
+    {
+        // When animation is paused / reset, reset the "first frame" flag
+        sim.firstEngineStep = true;
+    }
+
+    if (!gpuParticles)
+        emitParticles(ps, dt);
+    timer.lap(&SimulationTimings::emission);
+
+    // 3) Particle update and compaction
+    ret.advanceParticles = !anim.paused;
+    if (!gpuParticles && ret.advanceParticles)
+        updateParticlesParallel(ps, dt, pool);
+    timer.lap(&SimulationTimings::update);
+
+    // 4) Camera movement
+    sim.prevCameraPos = sim.camera.position;
+    updateCameraMovement(sim.camera, dt);
+    timer.lap(&SimulationTimings::camera);
+
+    if (timings)
+        ++timings->steps;
+
+    return ret;
+}
+
+std::uint64_t simulationChecksum(SimulationState const& sim)
+{
+    Checksum sum;
+
+    VehicleAnim const& anim = sim.ufoAnim;
+    sum.add(&anim.time, sizeof(anim.time));
+    sum.add(sim.camera.position);
+
+    UfoPose const pose = computeUfoPose(anim.active, anim.time, ufoStartPosition(sim.landingPadPos));
+    sum.add(pose.position);
+    sum.add(pose.forward);
+
+    if (ParticleSim const* ps = sim.particles)
+    {
+        std::size_t const count = std::size_t(ps->aliveCount);
+        sum.add(&ps->aliveCount, sizeof(ps->aliveCount));
+        for (ParticleArray const* array : { &ps->px, &ps->py, &ps->pz, &ps->vx, &ps->vy, &ps->vz, &ps->life })
+            sum.add(array->data(), count * sizeof(float));
+        sum.add(ps->emitterOf.data(), count);
+    }
+
+    return sum.value();
+}
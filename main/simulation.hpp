@@ -0,0 +1,114 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../vmlib/vec3.hpp"
+#include "camera.hpp"
+#include "particle_sim.hpp"
+
+// The part of the scene that advances in fixed steps (see
+// support/fixed_timestep.hpp): the spaceship's launch path, the particle
+// effects that follow it, and camera movement. Rendering reads this state
+// and interpolates between the last two steps.
+//
+// Together with camera.hpp, particle_sim.hpp, particle_budget.hpp and
+// heightfield.hpp, this forms the "sim" library, which does not depend on
+// OpenGL. main drives it once per fixed step; sim-bench runs a scripted
+// launch without a window to measure it, and main-test tests it.
+
+class ThreadPool;
+
+// Task 1.7 Spaceship animation
+struct VehicleAnim
+{
+    bool active = false; // Animation has started at least once
+    bool paused = false; // Toggled by F / UI button
+    float time   = 0.f; // Seconds since start
+    float prevTime = 0.f; // Before the latest simulation step
+};
+
+// Spaceship position and orientation along the take off path
+struct UfoPose
+{
+    Vec3f position;
+    Vec3f forward{ 0.f, 1.f, 0.f };
+    Vec3f right  { 1.f, 0.f, 0.f };
+    Vec3f up     { 0.f, 0.f, 1.f };
+};
+
+// Landing dust is kicked up while the spaceship is this close to the pad
+constexpr float kDustHeight = 10.f;
+
+struct SimulationState
+{
+    VehicleAnim ufoAnim;
+    Vec3f landingPadPos{ 0.f, 0.f, 0.f };   // the spaceship starts above it
+
+    Camera camera;
+    Vec3f prevCameraPos{ 0.f, 0.f, 0.f };   // before the latest step
+
+    // Not owned. main's ParticleSystem adds the GL side.
+    ParticleSim* particles = nullptr;
+    int exhaustEmitter = -1;
+    int dustEmitter = -1;
+
+    // Engine position at the previous step; exhaust is emitted along the
+    // path between the two
+    bool firstEngineStep = true;
+    Vec3f prevEnginePos{ 0.f, 0.f, 0.f };
+};
+
+// What one step did, for the GPU particle path
+struct SimulationStep
+{
+    UfoPose pose;
+    bool advanceParticles = false;   // false while paused
+
+    // Exhaust to emit in GpuParticles::simulate(), along the engine path
+    std::uint32_t gpuSpawnCount = 0;
+    Vec3f enginePrev{ 0.f, 0.f, 0.f };
+    Vec3f engineCurr{ 0.f, 0.f, 0.f };
+};
+
+// Time spent in each stage of stepSimulation(), in seconds, summed over
+// steps
+struct SimulationTimings
+{
+    double ufo = 0.0;
+    double emission = 0.0;
+    double update = 0.0;
+    double camera = 0.0;
+    std::size_t steps = 0;
+};
+
+// Cubic Bezier curve (Task 1.7)
+Vec3f bezier3(Vec3f const& A, Vec3f const& B, Vec3f const& C, Vec3f const& D, float t);
+
+// Where the spaceship stands before launch
+Vec3f ufoStartPosition(Vec3f const& landingPadPos);
+
+UfoPose computeUfoPose(bool active, float animTime, Vec3f const& ufoStartPos);
+
+// Adds the exhaust and landing dust emitters to particles and sizes the
+// pool to particleCapacity, or for their budgets with 0 (see
+// particleCapacityFor()). With a smaller pool, the dust is throttled while
+// it overlaps with the growing exhaust, which has the higher priority.
+void initSimulation(SimulationState& sim, ParticleSim& particles, Vec3f const& landingPadPos, int particleCapacity = 0);
+
+// One fixed step of dt. With gpuParticles, CPU particles are neither
+// emitted nor updated; the exhaust's emission count is returned instead.
+SimulationStep stepSimulation(
+    SimulationState& sim,
+    float dt,
+    ThreadPool& pool,
+    bool gpuParticles = false,
+    SimulationTimings* timings = nullptr
+);
+
+// Hash of the spaceship, camera and particle state. Equal for runs with the
+// same inputs, on any number of threads.
+std::uint64_t simulationChecksum(SimulationState const& sim);
+
+#endif // SIMULATION_HPP
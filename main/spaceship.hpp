@@ -6,6 +6,7 @@
 #include "../vmlib/vec3.hpp"
 #include "../vmlib/mat44.hpp"
 #include "simple_mesh.hpp"
+#include "ufo_geometry.hpp"
 
 // Small GL wrapper for a mesh
 struct MeshGL
@@ -14,17 +15,44 @@ struct MeshGL
     GLsizei vertexCount = 0;
 };
 
+// Smallest projected bounding-sphere radius (in pixels) at which a level is
+// still used; anything smaller falls through to the last level.
+constexpr float kUfoLodMinRadiusPx[kUfoLodCount - 1] = { 80.f, 20.f };
+
+// Vertex range of one level inside the shared VAO
+struct UfoLod
+{
+    GLint   first = 0;
+    GLsizei count = 0;
+};
+
 // Data main needs after building the UFO
 struct UfoMesh
 {
-    MeshGL mesh;           // VAO
+    MeshGL mesh;           // VAO (all levels back to back)
+    UfoLod lods[kUfoLodCount];
+
+    // Bounding sphere in local UFO space
+    Vec3f  boundsCenter;
+    float  boundsRadius;
 
     // For lights / engine offsets if you want to reuse them:
     float  bulbRingY;
     float  bulbRadius;
 };
 
-// Build the complete UFO mesh (base + top) and upload to GPU
+// Upload the compile-time UFO mesh (all detail levels, see ufo_geometry.hpp)
+// to the GPU
 UfoMesh create_ufo_mesh();
 
+// Pick a detail level from the projected size of the UFO's bounding sphere.
+// aProjScaleY is the [1,1] element of the projection (cot(fov/2)).
+int select_ufo_lod(
+    UfoMesh const& aUfo,
+    Mat44f const& aUfoModel,
+    Vec3f const& aCamPos,
+    float aProjScaleY,
+    float aViewportHeight
+);
+
 
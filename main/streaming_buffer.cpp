@@ -0,0 +1,146 @@
+#include "streaming_buffer.hpp"
+
+#include <chrono>
+#include <algorithm>
+
+#include <cassert>
+
+#include "../support/error.hpp"
+
+#include "defaults.hpp"
+
+namespace
+{
+    // Waits for the GPU in slices of this length, so that a lost context
+    // does not hang the application forever
+    constexpr GLuint64 kWaitSliceNs = 100'000'000; // 100 ms
+    constexpr int kMaxWaitSlices = 50;
+}
+
+StreamingBuffer::StreamingBuffer( std::size_t aRegionBytes, std::size_t aRegionCount )
+    : mRegionBytes( aRegionBytes )
+    , mFences( std::max<std::size_t>( aRegionCount, 1 ), nullptr )
+{
+    std::size_t const bytes = mRegionBytes * mFences.size();
+
+    glGenBuffers( 1, &mBuffer );
+    glBindBuffer( GL_ARRAY_BUFFER, mBuffer );
+
+    if( GLAD_GL_VERSION_4_4 )
+    {
+        GLbitfield const flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage( GL_ARRAY_BUFFER, GLsizeiptr(bytes), nullptr, flags );
+        mMapped = static_cast<std::byte*>(glMapBufferRange( GL_ARRAY_BUFFER, 0, GLsizeiptr(bytes), flags ));
+        if( !mMapped )
+        {
+            glBindBuffer( GL_ARRAY_BUFFER, 0 );
+            glDeleteBuffers( 1, &mBuffer );
+            throw Error( "Unable to map streaming buffer ({} bytes)", bytes );
+        }
+    }
+    else
+    {
+        glBufferData( GL_ARRAY_BUFFER, GLsizeiptr(bytes), nullptr, GL_STREAM_DRAW );
+        mShadow.resize( bytes );
+    }
+
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+    mStats.persistent = nullptr != mMapped;
+    mStats.bytes = bytes;
+    mStats.regionBytes = mRegionBytes;
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+    for( auto fence : mFences )
+    {
+        if( fence )
+            glDeleteSync( fence );
+    }
+
+    if( mMapped )
+    {
+        glBindBuffer( GL_ARRAY_BUFFER, mBuffer );
+        glUnmapBuffer( GL_ARRAY_BUFFER );
+        glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    }
+
+    glDeleteBuffers( 1, &mBuffer );
+}
+
+void StreamingBuffer::begin_frame()
+{
+    mRegion = (mRegion + 1) % mFences.size();
+    mUsed = 0;
+    ++mStats.frames;
+
+    GLsync& fence = mFences[mRegion];
+    if( !fence )
+        return;
+
+    GLenum status = glClientWaitSync( fence, 0, 0 );
+    if( GL_ALREADY_SIGNALED != status && GL_CONDITION_SATISFIED != status )
+    {
+        // The GPU is still reading this region
+        auto const startTime = Clock::now();
+
+        for( int i = 0; i < kMaxWaitSlices && GL_TIMEOUT_EXPIRED == status; ++i )
+            status = glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, kWaitSliceNs );
+
+        ++mStats.stalls;
+        mStats.stallMs += std::chrono::duration<double,std::milli>( Clock::now() - startTime ).count();
+    }
+
+    glDeleteSync( fence );
+    fence = nullptr;
+}
+
+void StreamingBuffer::end_frame()
+{
+    assert( !mFences[mRegion] );
+    mFences[mRegion] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+    mStats.usedBytes = mUsed;
+}
+
+StreamingAllocation StreamingBuffer::allocate( std::size_t aBytes, std::size_t aAlignment )
+{
+    assert( aAlignment > 0 && 0 == (aAlignment & (aAlignment - 1)) );
+
+    std::size_t const begin = (mUsed + aAlignment - 1) & ~(aAlignment - 1);
+    if( begin + aBytes > mRegionBytes )
+    {
+        ++mStats.overflows;
+        return {};
+    }
+    mUsed = begin + aBytes;
+
+    std::size_t const offset = mRegion * mRegionBytes + begin;
+    std::byte* const base = mMapped ? mMapped : mShadow.data();
+
+    StreamingAllocation ret;
+    ret.data = base + offset;
+    ret.offset = GLintptr(offset);
+    ret.bytes = aBytes;
+    return ret;
+}
+
+void StreamingBuffer::commit( StreamingAllocation const& aAllocation )
+{
+    if( mMapped || !aAllocation || 0 == aAllocation.bytes )
+        return;
+
+    glBindBuffer( GL_ARRAY_BUFFER, mBuffer );
+    glBufferSubData( GL_ARRAY_BUFFER, aAllocation.offset, GLsizeiptr(aAllocation.bytes), aAllocation.data );
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+GLuint StreamingBuffer::buffer() const noexcept
+{
+    return mBuffer;
+}
+
+StreamingBufferStats StreamingBuffer::stats() const noexcept
+{
+    return mStats;
+}
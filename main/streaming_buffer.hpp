@@ -0,0 +1,94 @@
+#ifndef STREAMING_BUFFER_HPP_A4D07E3B_92C6_4F18_8B5E_6D1F3A90C27E
+#define STREAMING_BUFFER_HPP_A4D07E3B_92C6_4F18_8B5E_6D1F3A90C27E
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstddef>
+
+// Ring buffer for data that is written by the CPU every frame (particle
+// positions, UI vertices).
+//
+// The buffer is split into one region per frame in flight. Each frame,
+// producers allocate() ranges from the current region and write to them
+// directly; draws then source the data from buffer() at the returned offset.
+// end_frame() places a fence after the frame's commands, and begin_frame()
+// waits for the fence of the region it is about to reuse. With enough regions
+// that wait is normally already over; when it isn't, it is counted as a stall
+// (see StreamingBufferStats).
+//
+// The storage is created with glBufferStorage() and stays mapped
+// (persistent, coherent), so writes need no further GL calls. Without
+// OpenGL 4.4, a plain buffer is used instead, and commit() copies the data
+// from a CPU-side copy of the region with glBufferSubData(). The region is
+// not in use by the GPU at that point, so this does not stall either.
+//
+// Use from the GL thread only.
+
+struct StreamingAllocation
+{
+    std::byte* data = nullptr;  // nullptr if the region was full
+    GLintptr offset = 0;        // in buffer()
+    std::size_t bytes = 0;
+
+    explicit operator bool() const noexcept { return nullptr != data; }
+};
+
+struct StreamingBufferStats
+{
+    bool persistent = false;    // false: glBufferSubData() fallback
+    std::size_t bytes = 0;      // all regions
+    std::size_t regionBytes = 0;
+    std::size_t usedBytes = 0;  // in the latest frame
+
+    // Totals since creation
+    std::size_t frames = 0;
+    std::size_t stalls = 0;     // begin_frame() had to wait for the GPU
+    double stallMs = 0.0;
+    std::size_t overflows = 0;  // allocations that did not fit
+};
+
+class StreamingBuffer final
+{
+    public:
+        explicit StreamingBuffer( std::size_t aRegionBytes, std::size_t aRegionCount = 3 );
+        ~StreamingBuffer();
+
+        StreamingBuffer( StreamingBuffer const& ) = delete;
+        StreamingBuffer& operator= (StreamingBuffer const&) = delete;
+
+    public:
+        // Selects the next region, waiting until the GPU is done with it
+        void begin_frame();
+
+        // Fences the commands that use the current region. Call after the
+        // last draw of the frame.
+        void end_frame();
+
+        // Returns aBytes in the current region, with the offset aligned to
+        // aAlignment (a power of two). Returns an empty allocation if the
+        // region is full.
+        StreamingAllocation allocate( std::size_t aBytes, std::size_t aAlignment = 16 );
+
+        // Makes the data written to aAllocation visible to GL. Call before
+        // the draws that use it. No-op for persistently mapped storage.
+        void commit( StreamingAllocation const& aAllocation );
+
+        GLuint buffer() const noexcept;
+
+        StreamingBufferStats stats() const noexcept;
+
+    private:
+        GLuint mBuffer = 0;
+        std::byte* mMapped = nullptr;   // persistent mapping
+        std::vector<std::byte> mShadow; // fallback: CPU copy of the buffer
+
+        std::size_t mRegionBytes;
+        std::vector<GLsync> mFences;    // per region
+        std::size_t mRegion = 0;
+        std::size_t mUsed = 0;          // in the current region
+
+        StreamingBufferStats mStats{};
+};
+
+#endif // STREAMING_BUFFER_HPP_A4D07E3B_92C6_4F18_8B5E_6D1F3A90C27E
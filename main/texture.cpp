@@ -1,45 +1,411 @@
 #include "texture.hpp"
 
+#include <mutex>
+#include <print>
+#include <deque>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <optional>
+#include <exception>
+#include <algorithm>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+
 #include <cassert>
+#include <cstring>
 
 #include <stb_image.h>
 
 #include "../support/error.hpp"
 
+#include "../support/mapped_file.hpp"
+#include "../support/thread_pool.hpp"
+
+#include "ktx2.hpp"
+#include "texture_compress.hpp"
+
+namespace
+{
+	// Bump when the encoder output changes; older cache files are then
+	// rebuilt automatically.
+	constexpr char kCacheWriter[] = "COMP3811 texture cache 2";
+	constexpr char kCacheDir[] = "_cache_/textures";
+
+	// From EXT_texture_sRGB (not part of core OpenGL)
+#	ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+	constexpr GLenum GL_COMPRESSED_SRGB_S3TC_DXT1_EXT = 0x8C4C;
+#	endif
+
+	CompressedImage compress_and_cache_( char const* aPath, std::filesystem::path const& aCachePath, bool aAllowBc1 )
+	{
+		auto const startTime = std::chrono::steady_clock::now();
+
+		// This may fail (e.g., image does not exist), so there’s no point in
+		// allocating OpenGL resources ahead of time.
+		RgbaImage const base = load_rgba_image( aPath );
+
+		// BC1 for opaque textures (terrain), BC7 if alpha is needed
+		BlockFormat const format = (!aAllowBc1 || has_alpha( base )) ? BlockFormat::bc7 : BlockFormat::bc1;
+		CompressedImage image = compress_with_mips( format, base, shared_thread_pool() );
+
+		std::error_code ec;
+		std::filesystem::create_directories( aCachePath.parent_path(), ec );
+		if( ec || !write_ktx2( aCachePath.string().c_str(), image, kCacheWriter ) )
+			std::print( stderr, "Warning: unable to write texture cache ’{}’\n", aCachePath.string() );
+
+		std::size_t bytes = 0;
+		for( auto const& level : image.levels )
+			bytes += level.size();
+
+		auto const ms = std::chrono::duration<double,std::milli>( std::chrono::steady_clock::now() - startTime ).count();
+		std::print( "Compressed ’{}’ ({}x{}, {} levels) to {} KiB in {:.0f} ms\n", aPath, base.width, base.height, image.levels.size(), bytes / 1024, ms );
+
+		return image;
+	}
+
+	// CPU side of a load; makes no GL calls. The view points either into the
+	// mapped cache file or into the image. Neither moves when the source is
+	// moved, so the view stays valid.
+	struct TextureSource_
+	{
+		MappedFile file;
+		CompressedImage image;
+		CompressedImageView view;
+	};
+
+	// Compressed textures are cached on disk in KTX2 files. Decoding, mip
+	// generation and compression only happen when the cache is missing or
+	// out of date. Otherwise the levels are uploaded straight from the
+	// memory mapped cache file.
+	TextureSource_ load_source_( char const* aPath, bool aAllowBc1 )
+	{
+		auto const cachePath = texture_cache_path( aPath, ".ktx2" );
+
+		if( texture_cache_fresh( aPath, cachePath ) )
+		{
+			try
+			{
+				TextureSource_ ret;
+				ret.file = MappedFile( cachePath.string().c_str() );
+				auto view = parse_ktx2( ret.file.bytes(), kCacheWriter );
+				if( view && (BlockFormat::bc7 == view->format || aAllowBc1) )
+				{
+					ret.view = std::move(*view);
+					return ret;
+				}
+			}
+			catch( Error const& eErr )
+			{
+				std::print( stderr, "Warning: ignoring texture cache: {}\n", eErr.what() );
+			}
+		}
+
+		TextureSource_ ret;
+		ret.image = compress_and_cache_( aPath, cachePath, aAllowBc1 );
+		ret.view = view_of( ret.image );
+		return ret;
+	}
+
+	// Creates and binds the texture object; the levels are uploaded
+	// separately with upload_level_().
+	LoadedTexture2D begin_texture_( CompressedImageView const& aImage, std::uint32_t aDropLevels )
+	{
+		LoadedTexture2D ret;
+		ret.width = aImage.width;
+		ret.height = aImage.height;
+		ret.levelCount = std::uint32_t(aImage.levels.size());
+		ret.droppedLevels = std::min( aDropLevels, ret.levelCount - 1 );
+
+		glGenTextures( 1, &ret.id );
+		glBindTexture( GL_TEXTURE_2D, ret.id );
+
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0 );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(ret.levelCount - ret.droppedLevels) - 1 );
+		return ret;
+	}
+
+	// aData is a client pointer, or an offset into the bound
+	// GL_PIXEL_UNPACK_BUFFER. Expects the texture to be bound.
+	void upload_level_( CompressedImageView const& aImage, LoadedTexture2D& aTexture, std::uint32_t aLevel, void const* aData )
+	{
+		assert( aLevel >= aTexture.droppedLevels && aLevel < aTexture.levelCount );
+
+		GLsizei const w = GLsizei(std::max( aImage.width >> aLevel, 1u ));
+		GLsizei const h = GLsizei(std::max( aImage.height >> aLevel, 1u ));
+		GLsizei const size = GLsizei(aImage.levels[aLevel].size());
+		glCompressedTexImage2D( GL_TEXTURE_2D, GLint(aLevel - aTexture.droppedLevels), compressed_texture_format( aImage.format ), w, h, 0, size, aData );
+
+		aTexture.bytes += std::size_t(size);
+	}
+
+	void finish_texture_( bool aLinearFilter )
+	{
+		// Configure texture
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, aLinearFilter ? GL_LINEAR : GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, 6.f );
+	}
+}
+
+// BC7 is core since OpenGL 4.2; the sRGB BC1 format needs extensions.
+bool bc1_texture_supported()
+{
+	static bool const supported = [] {
+		bool s3tc = false, srgb = false;
+
+		GLint count = 0;
+		glGetIntegerv( GL_NUM_EXTENSIONS, &count );
+		for( GLint i = 0; i < count; ++i )
+		{
+			std::string_view const ext = reinterpret_cast<char const*>(glGetStringi( GL_EXTENSIONS, GLuint(i) ));
+			if( "GL_EXT_texture_compression_s3tc" == ext )
+				s3tc = true;
+			else if( "GL_EXT_texture_sRGB" == ext || "GL_EXT_texture_compression_s3tc_srgb" == ext )
+				srgb = true;
+		}
+
+		return s3tc && srgb;
+	}();
+
+	return supported;
+}
+
+GLenum compressed_texture_format( BlockFormat aFormat )
+{
+	return BlockFormat::bc1 == aFormat ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+}
+
+std::filesystem::path texture_cache_path( char const* aPath, std::string_view aExtension )
+{
+	std::string name = aPath;
+	for( auto& c : name )
+	{
+		if( '/' == c || '\\' == c || ':' == c )
+			c = '_';
+	}
+
+	return std::filesystem::path( kCacheDir ) / (name + std::string(aExtension));
+}
+
+// The cache is used if it is at least as new as the source image.
+bool texture_cache_fresh( char const* aPath, std::filesystem::path const& aCachePath )
+{
+	std::error_code ec;
+	auto const sourceTime = std::filesystem::last_write_time( aPath, ec );
+	if( ec )
+		return false;
+
+	auto const cacheTime = std::filesystem::last_write_time( aCachePath, ec );
+	return !ec && cacheTime >= sourceTime;
+}
+
+RgbaImage load_rgba_image( char const* aPath )
+{
+	stbi_set_flip_vertically_on_load_thread( true );
+	int w, h, channels;
+	stbi_uc* ptr = stbi_load( aPath, &w, &h, &channels, 4 );
+	if( !ptr )
+		throw Error( "Unable to load image ’{}’\n", aPath );
+
+	RgbaImage ret;
+	ret.width = std::uint32_t(w);
+	ret.height = std::uint32_t(h);
+	ret.texels.assign( ptr, ptr + std::size_t(w) * h * 4 );
+	stbi_image_free( ptr );
+
+	return ret;
+}
+
 GLuint load_texture_2d( char const* aPath, bool linearFilter )
+{
+	return load_texture_2d_levels( aPath, linearFilter, 0 ).id;
+}
+
+LoadedTexture2D load_texture_2d_levels( char const* aPath, bool aLinearFilter, std::uint32_t aDropLevels )
 {
 	assert( aPath );
 
-	//TODO: implement me
-	
+	TextureSource_ const source = load_source_( aPath, bc1_texture_supported() );
+
+	LoadedTexture2D ret = begin_texture_( source.view, aDropLevels );
+	for( std::uint32_t i = ret.droppedLevels; i < ret.levelCount; ++i )
+		upload_level_( source.view, ret, i, source.view.levels[i].data() );
+
+	finish_texture_( aLinearFilter );
+	return ret;
+}
+
+
+// TextureUploader
+struct TextureUploader::Shared
+{
+	struct Result
+	{
+		Ticket ticket = 0;
+		bool linearFilter = true;
+		std::uint32_t dropLevels = 0;
+
+		TextureSource_ source;
+		std::exception_ptr error;
+	};
+
+	std::mutex mutex;
+	std::deque<Result> ready;
+};
+
+struct TextureUploader::Upload
+{
+	Ticket ticket = 0;
+	bool linearFilter = true;
+
+	TextureSource_ source;
+	LoadedTexture2D texture;
+
+	GLuint pbo = 0;
+	std::size_t pboOffset = 0;
+	std::uint32_t nextLevel = 0;
+};
+
+TextureUploader::TextureUploader( ThreadPool& aPool )
+	: mPool( aPool )
+	, mShared( std::make_shared<Shared>() )
+{}
+
+TextureUploader::~TextureUploader()
+{
+	if( mCurrent )
+	{
+		glDeleteBuffers( 1, &mCurrent->pbo );
+		glDeleteTextures( 1, &mCurrent->texture.id );
+	}
+}
+
+TextureUploader::Ticket TextureUploader::request( char const* aPath, bool aLinearFilter, std::uint32_t aDropLevels )
+{
 	assert( aPath );
-// Load image first
-// This may fail (e.g., image does not exist), so there’s no point in
-// allocating OpenGL resources ahead of time.
-stbi_set_flip_vertically_on_load( true );
-int w, h, channels;
-stbi_uc* ptr = stbi_load( aPath, &w, &h, &channels, 4 );
-if( !ptr )
-	 throw Error( "Unable to load image ’{}’\n", aPath );
-	
-GLuint tex = 0;
-glGenTextures( 1, &tex );
-glBindTexture( GL_TEXTURE_2D, tex );
-glTexImage2D( GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptr );
-
-stbi_image_free( ptr );
-
-// Generate mipmap hierarchy
-glGenerateMipmap( GL_TEXTURE_2D );
-
-// Configure texture
-glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, linearFilter ? GL_LINEAR : GL_NEAREST );
-glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
-glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, 6.f );
-return tex;
+
+	Ticket const ticket = mNextTicket++;
+	++mInFlight;
+
+	// The extension query needs GL, so it happens here.
+	bool const allowBc1 = bc1_texture_supported();
+
+	mPool.enqueue( [shared = mShared, path = std::string(aPath), ticket, aLinearFilter, aDropLevels, allowBc1] {
+		Shared::Result result;
+		result.ticket = ticket;
+		result.linearFilter = aLinearFilter;
+		result.dropLevels = aDropLevels;
+
+		try
+		{
+			result.source = load_source_( path.c_str(), allowBc1 );
+		}
+		catch( ... )
+		{
+			result.error = std::current_exception();
+		}
+
+		std::scoped_lock lock( shared->mutex );
+		shared->ready.emplace_back( std::move(result) );
+	} );
+
+	return ticket;
+}
+
+std::vector<std::pair<TextureUploader::Ticket,LoadedTexture2D>> TextureUploader::pump( std::chrono::steady_clock::duration aBudget )
+{
+	auto const deadline = std::chrono::steady_clock::now() + aBudget;
+
+	std::vector<std::pair<Ticket,LoadedTexture2D>> done;
+	do
+	{
+		if( !mCurrent )
+		{
+			Shared::Result result;
+			{
+				std::scoped_lock lock( mShared->mutex );
+				if( mShared->ready.empty() )
+					break;
+
+				result = std::move(mShared->ready.front());
+				mShared->ready.pop_front();
+			}
+
+			if( result.error )
+			{
+				--mInFlight;
+				std::rethrow_exception( result.error );
+			}
+
+			mCurrent = std::make_unique<Upload>();
+			mCurrent->ticket = result.ticket;
+			mCurrent->linearFilter = result.linearFilter;
+			mCurrent->source = std::move(result.source);
+
+			auto& view = mCurrent->source.view;
+			mCurrent->texture = begin_texture_( view, result.dropLevels );
+			mCurrent->nextLevel = mCurrent->texture.droppedLevels;
+
+			// One staging buffer for all levels of the texture
+			std::size_t total = 0;
+			for( std::uint32_t i = mCurrent->nextLevel; i < view.levels.size(); ++i )
+				total += view.levels[i].size();
+
+			glGenBuffers( 1, &mCurrent->pbo );
+			glBindBuffer( GL_PIXEL_UNPACK_BUFFER, mCurrent->pbo );
+			glBufferData( GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(total), nullptr, GL_STREAM_DRAW );
+		}
+
+		// Upload one level
+		auto& upload = *mCurrent;
+		auto const level = upload.source.view.levels[upload.nextLevel];
+
+		glBindTexture( GL_TEXTURE_2D, upload.texture.id );
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, upload.pbo );
+
+		void* dst = glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, GLintptr(upload.pboOffset), GLsizeiptr(level.size()), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT );
+		if( dst )
+			std::memcpy( dst, level.data(), level.size() );
+
+		if( dst && glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER ) )
+		{
+			upload_level_( upload.source.view, upload.texture, upload.nextLevel, reinterpret_cast<void const*>(upload.pboOffset) );
+			glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+		}
+		else
+		{
+			// Mapping failed (or the contents were lost); fall back to a
+			// plain upload from client memory.
+			glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+			upload_level_( upload.source.view, upload.texture, upload.nextLevel, level.data() );
+		}
+
+		upload.pboOffset += level.size();
+		++upload.nextLevel;
+
+		if( upload.texture.levelCount == upload.nextLevel )
+		{
+			finish_texture_( upload.linearFilter );
+			glDeleteBuffers( 1, &upload.pbo );
+
+			done.emplace_back( upload.ticket, upload.texture );
+			mCurrent.reset();
+			--mInFlight;
+		}
+	} while( std::chrono::steady_clock::now() < deadline );
+
+	return done;
+}
+
+std::size_t TextureUploader::in_flight() const noexcept
+{
+	return mInFlight;
 }
+
 	
 	
 	
@@ -3,6 +3,97 @@
 
 #include <glad/glad.h>
 
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <filesystem>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "texture_compress.hpp"
+
+class ThreadPool;
+
+struct LoadedTexture2D
+{
+	GLuint id = 0;
+
+	std::uint32_t width = 0, height = 0; // full resolution (level 0 of the source)
+	std::uint32_t levelCount = 0;        // levels in the source image
+	std::uint32_t droppedLevels = 0;     // levels skipped at the top
+	std::size_t bytes = 0;               // GPU memory of the uploaded levels
+};
+
+// Helpers shared with other texture loaders (e.g., the virtual texture)
+
+// True if the sRGB BC1 format is available (requires a current context)
+bool bc1_texture_supported();
+GLenum compressed_texture_format( BlockFormat );
+
+// Decodes an image to RGBA8, flipped to match OpenGL's texture coordinate
+// convention. Thread safe; throws Error on failure.
+RgbaImage load_rgba_image( char const* aPath );
+
+// Location of cache files derived from aSourcePath in the texture cache
+// directory. A cache file is fresh if it is at least as new as the source.
+std::filesystem::path texture_cache_path( char const* aSourcePath, std::string_view aExtension );
+bool texture_cache_fresh( char const* aSourcePath, std::filesystem::path const& aCachePath );
+
+
 GLuint load_texture_2d( char const* aPath, bool linearFilter = true );
 
+// As load_texture_2d(), but skips the aDropLevels largest mip levels (at
+// least one level is always uploaded). Used by the TextureRegistry to
+// downscale textures when over budget.
+LoadedTexture2D load_texture_2d_levels( char const* aPath, bool aLinearFilter, std::uint32_t aDropLevels );
+
+// Asynchronous version of load_texture_2d_levels().
+//
+// The CPU side (mapping the cache file, or decoding and compressing the image
+// on a cache miss) runs as a task on a thread pool. The GL thread then
+// streams the levels through a pixel buffer object in pump(), which stops
+// once its time budget is used up. Large textures are therefore spread over
+// several frames instead of stalling the first one.
+//
+// All member functions must be called from the GL thread.
+class TextureUploader final
+{
+	public:
+		using Ticket = std::uint64_t;
+
+		explicit TextureUploader( ThreadPool& );
+
+		// Textures that are partially uploaded are deleted. Tasks that are
+		// still running finish in the background; their results are dropped.
+		~TextureUploader();
+
+		TextureUploader( TextureUploader const& ) = delete;
+		TextureUploader& operator= (TextureUploader const&) = delete;
+
+	public:
+		Ticket request( char const* aPath, bool aLinearFilter, std::uint32_t aDropLevels = 0 );
+
+		// Uploads ready levels until aBudget has passed (at least one level
+		// is uploaded per call if any is ready) and returns the textures
+		// that were completed. Rethrows Error if a request failed.
+		std::vector<std::pair<Ticket,LoadedTexture2D>> pump( std::chrono::steady_clock::duration aBudget );
+
+		// Requests that have not been returned by pump() yet
+		std::size_t in_flight() const noexcept;
+
+	private:
+		struct Shared;
+		struct Upload;
+
+		ThreadPool& mPool;
+		std::shared_ptr<Shared> mShared;
+		std::unique_ptr<Upload> mCurrent; // texture being uploaded
+
+		Ticket mNextTicket = 1;
+		std::size_t mInFlight = 0;
+};
+
 #endif // TEXTURE_HPP_D0746DED_C9C6_40CD_B6E0_C6FEF665DD31
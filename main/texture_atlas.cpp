@@ -0,0 +1,112 @@
+#include "texture_atlas.hpp"
+
+#include <bit>
+#include <algorithm>
+
+#include <cassert>
+
+#include "../support/error.hpp"
+#include "../support/thread_pool.hpp"
+
+#include "mipmap.hpp"
+#include "texture.hpp"
+#include "atlas_packer.hpp"
+#include "texture_compress.hpp"
+
+namespace
+{
+    // Texels of edge padding around each image. Each mip level halves the
+    // padding, so there are log2(kPadding) + 1 levels.
+    constexpr std::uint32_t kPadding = 4;
+    constexpr std::uint32_t kMaxLevels = std::bit_width( kPadding );
+
+    // Copies aImage to its placement and repeats its edge texels over the
+    // rest of the cell (kPadding texels, more on the right and bottom where
+    // the cell was rounded up to the alignment)
+    void blit_padded_( RgbaImage& aLayer, RgbaImage const& aImage, AtlasPlacement const& aPlacement )
+    {
+        assert( aPlacement.x >= kPadding && aPlacement.y >= kPadding );
+
+        std::int64_t const w = aImage.width, h = aImage.height;
+        std::int64_t const pad = kPadding;
+        std::int64_t const right = std::int64_t(aPlacement.cellWidth) - pad;
+        std::int64_t const bottom = std::int64_t(aPlacement.cellHeight) - pad;
+        for( std::int64_t y = -pad; y < bottom; ++y )
+        {
+            std::int64_t const sy = std::clamp( y, std::int64_t(0), h - 1 );
+            for( std::int64_t x = -pad; x < right; ++x )
+            {
+                std::int64_t const sx = std::clamp( x, std::int64_t(0), w - 1 );
+
+                auto const* src = aImage.texels.data() + (sy * w + sx) * 4;
+                auto* dst = aLayer.texels.data() + ((aPlacement.y + y) * aLayer.width + (aPlacement.x + x)) * 4;
+                std::copy_n( src, 4, dst );
+            }
+        }
+    }
+}
+
+TextureAtlas build_texture_atlas( std::span<char const* const> aPaths, std::uint32_t aLayerSize )
+{
+    std::vector<RgbaImage> images;
+    std::vector<AtlasItemSize> sizes;
+    for( auto const* path : aPaths )
+    {
+        assert( path );
+        images.emplace_back( load_rgba_image( path ) );
+        sizes.push_back( { images.back().width, images.back().height } );
+    }
+
+    TextureAtlas ret;
+    ret.layerSize = aLayerSize;
+    ret.levelCount = std::min( kMaxLevels, mip_level_count( aLayerSize, aLayerSize ) );
+
+    // Cells aligned to the texels of the last level (see atlas_packer.hpp)
+    auto const placements = pack_shelves( sizes, aLayerSize, kPadding, 1u << (ret.levelCount - 1) );
+    for( auto const& placement : placements )
+        ret.layerCount = std::max( ret.layerCount, placement.layer + 1 );
+
+    if( 0 == ret.layerCount )
+        return ret;
+
+    // Fill the layers (transparent black outside of the images)
+    RgbaImage const empty{ aLayerSize, aLayerSize, std::vector<std::uint8_t>( std::size_t(aLayerSize) * aLayerSize * 4, 0 ) };
+    std::vector<RgbaImage> layers( ret.layerCount, empty );
+
+    float const texel = 1.f / float(aLayerSize);
+    for( std::size_t i = 0; i < images.size(); ++i )
+    {
+        auto const& placement = placements[i];
+        blit_padded_( layers[placement.layer], images[i], placement );
+
+        ret.regions.push_back( AtlasRegion{
+            placement.layer,
+            Vec4f{ images[i].width * texel, images[i].height * texel, placement.x * texel, placement.y * texel }
+        } );
+    }
+
+    // Upload
+    glGenTextures( 1, &ret.texture );
+    glBindTexture( GL_TEXTURE_2D_ARRAY, ret.texture );
+    glTexStorage3D( GL_TEXTURE_2D_ARRAY, GLsizei(ret.levelCount), GL_SRGB8_ALPHA8, GLsizei(aLayerSize), GLsizei(aLayerSize), GLsizei(ret.layerCount) );
+
+    for( std::uint32_t layer = 0; layer < ret.layerCount; ++layer )
+    {
+        auto const mips = build_srgb_mip_chain( layers[layer], shared_thread_pool() );
+        for( std::uint32_t level = 0; level < ret.levelCount; ++level )
+        {
+            auto const& mip = mips[level];
+            glTexSubImage3D( GL_TEXTURE_2D_ARRAY, GLint(level), 0, 0, GLint(layer), GLsizei(mip.width), GLsizei(mip.height), 1, GL_RGBA, GL_UNSIGNED_BYTE, mip.texels.data() );
+            ret.bytes += mip.texels.size();
+        }
+    }
+
+    glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, GLint(ret.levelCount) - 1 );
+    glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    glBindTexture( GL_TEXTURE_2D_ARRAY, 0 );
+
+    return ret;
+}
@@ -0,0 +1,51 @@
+#ifndef TEXTURE_ATLAS_HPP_C5D18E07_3F6A_4B92_9E4C_7A20D86B1F53
+#define TEXTURE_ATLAS_HPP_C5D18E07_3F6A_4B92_9E4C_7A20D86B1F53
+
+#include <glad/glad.h>
+
+#include <span>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../vmlib/vec4.hpp"
+
+// Texture atlas for small RGBA textures (sprites, decals, icons).
+//
+// The images are packed into the layers of a single GL_TEXTURE_2D_ARRAY at
+// load time (see atlas_packer.hpp), so that all of them can be sampled from
+// one texture unit without switching binds between draws. Each image is
+// surrounded by a few texels of padding that repeat its edge texels, so
+// linear filtering and the (few) mip levels don't bleed neighbours in.
+//
+// Shaders map the image's own UVs into the atlas with
+//   atlasUV = uv * uvTransform.xy + uvTransform.zw
+// and sample layer `layer` of the sampler2DArray.
+//
+// The font atlas is not included: it is single channel and updated on the
+// fly by fontstash.
+
+struct AtlasRegion
+{
+    std::uint32_t layer = 0;
+    Vec4f uvTransform{ 1.f, 1.f, 0.f, 0.f }; // scale (xy), offset (zw)
+};
+
+struct TextureAtlas
+{
+    GLuint texture = 0; // GL_TEXTURE_2D_ARRAY, GL_SRGB8_ALPHA8
+    std::uint32_t layerSize = 0;
+    std::uint32_t layerCount = 0;
+    std::uint32_t levelCount = 0;
+    std::size_t bytes = 0;
+
+    std::vector<AtlasRegion> regions; // same order as the input images
+};
+
+// Loads and packs the images. Throws Error if an image cannot be loaded or is
+// too large for a layer. Sampling uses trilinear filtering (sRGB correct mip
+// levels, see mipmap.hpp).
+TextureAtlas build_texture_atlas( std::span<char const* const> aPaths, std::uint32_t aLayerSize = 256 );
+
+#endif // TEXTURE_ATLAS_HPP_C5D18E07_3F6A_4B92_9E4C_7A20D86B1F53
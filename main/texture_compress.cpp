@@ -0,0 +1,532 @@
+#include "texture_compress.hpp"
+
+#include <array>
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+#include <bit>
+#include <cmath>
+#include <cassert>
+#include <cstring>
+
+#include "mipmap.hpp"
+
+#include "../support/thread_pool.hpp"
+
+namespace
+{
+    constexpr int kBlockTexels = 16;
+
+    template< std::size_t tDim >
+    using Point_ = std::array<float,tDim>;
+
+    // Mean and principal axis (unit length) of the block's texels, found by
+    // power iteration on the covariance matrix. Returns false if all texels
+    // are identical.
+    template< std::size_t tDim >
+    bool principal_axis_( Point_<tDim> const (&aPts)[kBlockTexels], Point_<tDim>& aMean, Point_<tDim>& aAxis )
+    {
+        aMean = {};
+        for( auto const& p : aPts )
+        {
+            for( std::size_t i = 0; i < tDim; ++i )
+                aMean[i] += p[i];
+        }
+        for( auto& m : aMean )
+            m *= 1.f / kBlockTexels;
+
+        float cov[tDim][tDim] = {};
+        for( auto const& p : aPts )
+        {
+            for( std::size_t i = 0; i < tDim; ++i )
+            {
+                for( std::size_t j = 0; j < tDim; ++j )
+                    cov[i][j] += (p[i] - aMean[i]) * (p[j] - aMean[j]);
+            }
+        }
+
+        // Start with the column of the channel that varies the most.
+        std::size_t start = 0;
+        for( std::size_t i = 1; i < tDim; ++i )
+        {
+            if( cov[i][i] > cov[start][start] )
+                start = i;
+        }
+        if( cov[start][start] <= 0.f )
+            return false;
+
+        for( std::size_t i = 0; i < tDim; ++i )
+            aAxis[i] = cov[i][start];
+
+        for( int iter = 0; iter < 8; ++iter )
+        {
+            Point_<tDim> next{};
+            float largest = 0.f;
+            for( std::size_t i = 0; i < tDim; ++i )
+            {
+                for( std::size_t j = 0; j < tDim; ++j )
+                    next[i] += cov[i][j] * aAxis[j];
+                largest = std::max( largest, std::abs( next[i] ) );
+            }
+            if( largest <= 0.f )
+                return false;
+
+            for( std::size_t i = 0; i < tDim; ++i )
+                aAxis[i] = next[i] / largest;
+        }
+
+        float len2 = 0.f;
+        for( auto const a : aAxis )
+            len2 += a * a;
+        for( auto& a : aAxis )
+            a /= std::sqrt( len2 );
+
+        return true;
+    }
+
+    // End points of the texels' extent along aAxis
+    template< std::size_t tDim >
+    void axis_extent_( Point_<tDim> const (&aPts)[kBlockTexels], Point_<tDim> const& aMean, Point_<tDim> const& aAxis, Point_<tDim>& aHi, Point_<tDim>& aLo )
+    {
+        float tmin = std::numeric_limits<float>::max(), tmax = -tmin;
+        for( auto const& p : aPts )
+        {
+            float t = 0.f;
+            for( std::size_t i = 0; i < tDim; ++i )
+                t += (p[i] - aMean[i]) * aAxis[i];
+
+            tmin = std::min( tmin, t );
+            tmax = std::max( tmax, t );
+        }
+
+        for( std::size_t i = 0; i < tDim; ++i )
+        {
+            aHi[i] = aMean[i] + tmax * aAxis[i];
+            aLo[i] = aMean[i] + tmin * aAxis[i];
+        }
+    }
+
+    // Least squares end points for fixed per-texel interpolation weights
+    // (aWeights[i] is the weight of aB for texel i). Returns false if the
+    // system is singular (e.g., all texels use the same index).
+    template< std::size_t tDim >
+    bool least_squares_( Point_<tDim> const (&aPts)[kBlockTexels], float const (&aWeights)[kBlockTexels], Point_<tDim>& aA, Point_<tDim>& aB )
+    {
+        float aa = 0.f, ab = 0.f, bb = 0.f;
+        Point_<tDim> ax{}, bx{};
+        for( int i = 0; i < kBlockTexels; ++i )
+        {
+            float const wb = aWeights[i];
+            float const wa = 1.f - wb;
+
+            aa += wa * wa;
+            ab += wa * wb;
+            bb += wb * wb;
+            for( std::size_t c = 0; c < tDim; ++c )
+            {
+                ax[c] += wa * aPts[i][c];
+                bx[c] += wb * aPts[i][c];
+            }
+        }
+
+        float const det = aa * bb - ab * ab;
+        if( std::abs( det ) < 1e-6f )
+            return false;
+
+        float const inv = 1.f / det;
+        for( std::size_t c = 0; c < tDim; ++c )
+        {
+            aA[c] = (bb * ax[c] - ab * bx[c]) * inv;
+            aB[c] = (aa * bx[c] - ab * ax[c]) * inv;
+        }
+        return true;
+    }
+
+    int quantize_( float aValue, int aMax ) noexcept
+    {
+        return std::clamp( int(std::lround( aValue )), 0, aMax );
+    }
+
+
+    // BC1
+    std::uint16_t to_rgb565_( Point_<3> const& aColor ) noexcept
+    {
+        int const r = quantize_( aColor[0] * (31.f / 255.f), 31 );
+        int const g = quantize_( aColor[1] * (63.f / 255.f), 63 );
+        int const b = quantize_( aColor[2] * (31.f / 255.f), 31 );
+        return std::uint16_t( (r << 11) | (g << 5) | b );
+    }
+
+    void bc1_palette_( std::uint16_t aC0, std::uint16_t aC1, int (&aPalette)[4][3] ) noexcept
+    {
+        auto const expand = [] ( std::uint16_t aC, int (&aOut)[3] ) {
+            int const r = (aC >> 11) & 31, g = (aC >> 5) & 63, b = aC & 31;
+            aOut[0] = (r << 3) | (r >> 2);
+            aOut[1] = (g << 2) | (g >> 4);
+            aOut[2] = (b << 3) | (b >> 2);
+        };
+
+        expand( aC0, aPalette[0] );
+        expand( aC1, aPalette[1] );
+        for( int c = 0; c < 3; ++c )
+        {
+            aPalette[2][c] = (2*aPalette[0][c] + aPalette[1][c]) / 3;
+            aPalette[3][c] = (aPalette[0][c] + 2*aPalette[1][c]) / 3;
+        }
+    }
+
+    // Picks the nearest palette entry for each texel. Returns the total
+    // squared error.
+    int bc1_select_( Point_<3> const (&aPts)[kBlockTexels], std::uint16_t aC0, std::uint16_t aC1, std::uint8_t (&aIndices)[kBlockTexels] ) noexcept
+    {
+        int palette[4][3];
+        bc1_palette_( aC0, aC1, palette );
+
+        int total = 0;
+        for( int i = 0; i < kBlockTexels; ++i )
+        {
+            int best = std::numeric_limits<int>::max();
+            for( std::uint8_t k = 0; k < 4; ++k )
+            {
+                int err = 0;
+                for( int c = 0; c < 3; ++c )
+                {
+                    int const d = int(aPts[i][c]) - palette[k][c];
+                    err += d * d;
+                }
+                if( err < best )
+                {
+                    best = err;
+                    aIndices[i] = k;
+                }
+            }
+            total += best;
+        }
+        return total;
+    }
+
+    struct Bc1Candidate_
+    {
+        std::uint16_t c0, c1;
+        std::uint8_t indices[kBlockTexels];
+        int error;
+    };
+
+    Bc1Candidate_ bc1_try_( Point_<3> const (&aPts)[kBlockTexels], Point_<3> const& aHi, Point_<3> const& aLo ) noexcept
+    {
+        Bc1Candidate_ ret{ to_rgb565_( aHi ), to_rgb565_( aLo ), {}, 0 };
+
+        // c0 > c1 selects the four-colour mode. (c0 == c1 decodes in
+        // three-colour mode, but then all texels use index 0 anyway.)
+        if( ret.c0 < ret.c1 )
+            std::swap( ret.c0, ret.c1 );
+
+        ret.error = bc1_select_( aPts, ret.c0, ret.c1, ret.indices );
+        return ret;
+    }
+
+
+    // BC7 (mode 6 only)
+    constexpr int kBc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    struct Bc7Endpoint_
+    {
+        int c7[4]; // 7 bit RGBA
+        int p;     // shared p-bit
+
+        int value( int aChannel ) const noexcept
+        {
+            return (c7[aChannel] << 1) | p;
+        }
+    };
+
+    Bc7Endpoint_ bc7_quantize_( Point_<4> const& aColor ) noexcept
+    {
+        Bc7Endpoint_ best{};
+        float bestErr = std::numeric_limits<float>::max();
+        for( int p = 0; p < 2; ++p )
+        {
+            Bc7Endpoint_ ep{ {}, p };
+            float err = 0.f;
+            for( int c = 0; c < 4; ++c )
+            {
+                ep.c7[c] = quantize_( (aColor[c] - float(p)) * 0.5f, 127 );
+                float const d = float(ep.value( c )) - aColor[c];
+                err += d * d;
+            }
+            if( err < bestErr )
+            {
+                bestErr = err;
+                best = ep;
+            }
+        }
+        return best;
+    }
+
+    int bc7_select_( Point_<4> const (&aPts)[kBlockTexels], Bc7Endpoint_ const& aE0, Bc7Endpoint_ const& aE1, std::uint8_t (&aIndices)[kBlockTexels] ) noexcept
+    {
+        int palette[16][4];
+        for( int k = 0; k < 16; ++k )
+        {
+            for( int c = 0; c < 4; ++c )
+                palette[k][c] = ((64 - kBc7Weights[k]) * aE0.value( c ) + kBc7Weights[k] * aE1.value( c ) + 32) >> 6;
+        }
+
+        int total = 0;
+        for( int i = 0; i < kBlockTexels; ++i )
+        {
+            int best = std::numeric_limits<int>::max();
+            for( std::uint8_t k = 0; k < 16; ++k )
+            {
+                int err = 0;
+                for( int c = 0; c < 4; ++c )
+                {
+                    int const d = int(aPts[i][c]) - palette[k][c];
+                    err += d * d;
+                }
+                if( err < best )
+                {
+                    best = err;
+                    aIndices[i] = k;
+                }
+            }
+            total += best;
+        }
+        return total;
+    }
+
+    struct Bc7Candidate_
+    {
+        Bc7Endpoint_ e0, e1;
+        std::uint8_t indices[kBlockTexels];
+        int error;
+    };
+
+    Bc7Candidate_ bc7_try_( Point_<4> const (&aPts)[kBlockTexels], Point_<4> const& aA, Point_<4> const& aB ) noexcept
+    {
+        Bc7Candidate_ ret{ bc7_quantize_( aA ), bc7_quantize_( aB ), {}, 0 };
+        ret.error = bc7_select_( aPts, ret.e0, ret.e1, ret.indices );
+        return ret;
+    }
+
+    void put_bits_( std::uint8_t* aOut, unsigned& aPos, unsigned aValue, unsigned aCount ) noexcept
+    {
+        for( unsigned i = 0; i < aCount; ++i, ++aPos )
+        {
+            if( (aValue >> i) & 1u )
+                aOut[aPos >> 3] |= std::uint8_t( 1u << (aPos & 7) );
+        }
+    }
+
+    // Compresses block rows [aFirst, aEnd) into aOut, which points to the
+    // start of the whole compressed image.
+    void compress_block_rows_( BlockFormat aFormat, RgbaImage const& aImage, std::uint32_t aFirst, std::uint32_t aEnd, std::uint8_t* aOut )
+    {
+        assert( aImage.texels.size() == std::size_t(aImage.width) * aImage.height * 4 );
+
+        auto const encode = BlockFormat::bc1 == aFormat ? &encode_bc1_block : &encode_bc7_block;
+        std::size_t const blockBytes = block_bytes( aFormat );
+        std::uint32_t const blocksPerRow = (aImage.width + kBlockDim - 1) / kBlockDim;
+
+        std::uint8_t texels[kBlockTexels*4];
+        std::uint8_t* out = aOut + std::size_t(aFirst) * blocksPerRow * blockBytes;
+        for( std::uint32_t by = aFirst * kBlockDim; by < aEnd * kBlockDim; by += kBlockDim )
+        {
+            for( std::uint32_t bx = 0; bx < aImage.width; bx += kBlockDim )
+            {
+                for( std::uint32_t y = 0; y < kBlockDim; ++y )
+                {
+                    std::uint32_t const sy = std::min( by + y, aImage.height - 1 );
+                    for( std::uint32_t x = 0; x < kBlockDim; ++x )
+                    {
+                        std::uint32_t const sx = std::min( bx + x, aImage.width - 1 );
+                        std::memcpy( texels + 4*(y*kBlockDim + x), aImage.texels.data() + 4*(std::size_t(sy)*aImage.width + sx), 4 );
+                    }
+                }
+
+                encode( texels, out );
+                out += blockBytes;
+            }
+        }
+    }
+}
+
+void encode_bc1_block( std::uint8_t const* aTexels, std::uint8_t* aBlock )
+{
+    assert( aTexels && aBlock );
+
+    Point_<3> pts[kBlockTexels];
+    for( int i = 0; i < kBlockTexels; ++i )
+        pts[i] = { float(aTexels[4*i+0]), float(aTexels[4*i+1]), float(aTexels[4*i+2]) };
+
+    Point_<3> mean, axis, hi, lo;
+    if( principal_axis_( pts, mean, axis ) )
+        axis_extent_( pts, mean, axis, hi, lo );
+    else
+        hi = lo = mean;
+
+    Bc1Candidate_ best = bc1_try_( pts, hi, lo );
+
+    // Refit the end points to the chosen indices. Index 2 is 1/3 of the way
+    // from c0 to c1, index 3 is 2/3 of the way.
+    constexpr float kWeights[4] = { 0.f, 1.f, 1.f/3.f, 2.f/3.f };
+    for( int iter = 0; iter < 2 && best.error > 0; ++iter )
+    {
+        float weights[kBlockTexels];
+        for( int i = 0; i < kBlockTexels; ++i )
+            weights[i] = kWeights[best.indices[i]];
+
+        if( !least_squares_( pts, weights, hi, lo ) )
+            break;
+
+        Bc1Candidate_ const next = bc1_try_( pts, hi, lo );
+        if( next.error >= best.error )
+            break;
+
+        best = next;
+    }
+
+    std::uint32_t indices = 0;
+    for( int i = 0; i < kBlockTexels; ++i )
+        indices |= std::uint32_t(best.indices[i]) << (2*i);
+
+    aBlock[0] = std::uint8_t( best.c0 & 0xff );
+    aBlock[1] = std::uint8_t( best.c0 >> 8 );
+    aBlock[2] = std::uint8_t( best.c1 & 0xff );
+    aBlock[3] = std::uint8_t( best.c1 >> 8 );
+    for( int i = 0; i < 4; ++i )
+        aBlock[4+i] = std::uint8_t( indices >> (8*i) );
+}
+
+void encode_bc7_block( std::uint8_t const* aTexels, std::uint8_t* aBlock )
+{
+    assert( aTexels && aBlock );
+
+    Point_<4> pts[kBlockTexels];
+    for( int i = 0; i < kBlockTexels; ++i )
+        pts[i] = { float(aTexels[4*i+0]), float(aTexels[4*i+1]), float(aTexels[4*i+2]), float(aTexels[4*i+3]) };
+
+    Point_<4> mean, axis, hi, lo;
+    if( principal_axis_( pts, mean, axis ) )
+        axis_extent_( pts, mean, axis, hi, lo );
+    else
+        hi = lo = mean;
+
+    Bc7Candidate_ best = bc7_try_( pts, lo, hi );
+
+    for( int iter = 0; iter < 2 && best.error > 0; ++iter )
+    {
+        float weights[kBlockTexels];
+        for( int i = 0; i < kBlockTexels; ++i )
+            weights[i] = kBc7Weights[best.indices[i]] / 64.f;
+
+        if( !least_squares_( pts, weights, lo, hi ) )
+            break;
+
+        Bc7Candidate_ const next = bc7_try_( pts, lo, hi );
+        if( next.error >= best.error )
+            break;
+
+        best = next;
+    }
+
+    // The MSB of the first index is implicit (zero). The weights are
+    // symmetric, so swapping the end points and flipping the indices decodes
+    // to exactly the same texels.
+    if( best.indices[0] & 8 )
+    {
+        std::swap( best.e0, best.e1 );
+        for( auto& idx : best.indices )
+            idx = std::uint8_t( 15 - idx );
+    }
+
+    std::memset( aBlock, 0, 16 );
+
+    unsigned pos = 0;
+    put_bits_( aBlock, pos, 1u << 6, 7 ); // mode 6
+    for( int c = 0; c < 4; ++c )
+    {
+        put_bits_( aBlock, pos, unsigned(best.e0.c7[c]), 7 );
+        put_bits_( aBlock, pos, unsigned(best.e1.c7[c]), 7 );
+    }
+    put_bits_( aBlock, pos, unsigned(best.e0.p), 1 );
+    put_bits_( aBlock, pos, unsigned(best.e1.p), 1 );
+
+    put_bits_( aBlock, pos, best.indices[0], 3 );
+    for( int i = 1; i < kBlockTexels; ++i )
+        put_bits_( aBlock, pos, best.indices[i], 4 );
+
+    assert( 128 == pos );
+}
+
+std::vector<std::uint8_t> compress_image( BlockFormat aFormat, RgbaImage const& aImage )
+{
+    std::vector<std::uint8_t> ret( compressed_size( aFormat, aImage.width, aImage.height ) );
+    if( !ret.empty() )
+        compress_block_rows_( aFormat, aImage, 0, (aImage.height + kBlockDim - 1) / kBlockDim, ret.data() );
+
+    return ret;
+}
+
+bool has_alpha( RgbaImage const& aImage ) noexcept
+{
+    for( std::size_t i = 3; i < aImage.texels.size(); i += 4 )
+    {
+        if( aImage.texels[i] != 255 )
+            return true;
+    }
+    return false;
+}
+
+std::uint32_t mip_level_count( std::uint32_t aWidth, std::uint32_t aHeight ) noexcept
+{
+    return std::uint32_t(std::bit_width( std::max( { aWidth, aHeight, 1u } ) ));
+}
+
+CompressedImageView view_of( CompressedImage const& aImage )
+{
+    CompressedImageView ret{ aImage.format, aImage.width, aImage.height, {} };
+    ret.levels.assign( aImage.levels.begin(), aImage.levels.end() );
+    return ret;
+}
+
+CompressedImage compress_with_mips( BlockFormat aFormat, RgbaImage const& aBase, ThreadPool& aPool )
+{
+    std::vector<RgbaImage> const mips = build_srgb_mip_chain( aBase, aPool );
+
+    CompressedImage ret;
+    ret.format = aFormat;
+    ret.width = aBase.width;
+    ret.height = aBase.height;
+
+    // Work items are bands of block rows from any level, so the small levels
+    // don't end up serialized behind level 0.
+    struct Band_
+    {
+        std::size_t level;
+        std::uint32_t firstRow, rowCount;
+    };
+
+    std::vector<Band_> bands;
+    for( std::size_t i = 0; i < mips.size(); ++i )
+    {
+        ret.levels.emplace_back( compressed_size( aFormat, mips[i].width, mips[i].height ) );
+
+        std::uint32_t const blockRows = (mips[i].height + kBlockDim - 1) / kBlockDim;
+        std::uint32_t const blocksPerRow = (mips[i].width + kBlockDim - 1) / kBlockDim;
+        std::uint32_t const rowsPerBand = std::max( 1u, 1024u / std::max( blocksPerRow, 1u ) );
+        for( std::uint32_t row = 0; row < blockRows; row += rowsPerBand )
+            bands.emplace_back( Band_{ i, row, std::min( rowsPerBand, blockRows - row ) } );
+    }
+
+    aPool.parallel_for( bands.size(), 1, [&] ( std::size_t aBegin, std::size_t aEnd ) {
+        for( std::size_t i = aBegin; i < aEnd; ++i )
+        {
+            auto const& band = bands[i];
+            compress_block_rows_( aFormat, mips[band.level], band.firstRow, band.firstRow + band.rowCount, ret.levels[band.level].data() );
+        }
+    } );
+
+    return ret;
+}
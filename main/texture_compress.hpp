@@ -0,0 +1,88 @@
+#ifndef TEXTURE_COMPRESS_HPP_5E0C2A7B_91D4_4F3B_A6E8_0B7D3C41F295
+#define TEXTURE_COMPRESS_HPP_5E0C2A7B_91D4_4F3B_A6E8_0B7D3C41F295
+
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class ThreadPool;
+
+// CPU block compression for textures.
+//
+// Both formats encode 4x4 texel blocks and are decoded by the GPU on the fly,
+// so they save VRAM and memory bandwidth compared to GL_SRGB8_ALPHA8:
+//  - BC1 stores opaque RGB in 8 bytes per block (0.5 bytes per texel)
+//  - BC7 stores RGBA in 16 bytes per block (1 byte per texel)
+//
+// The encoders favour speed over the last bit of quality. They only run when
+// the on-disk cache (see ktx2.hpp) is missing or out of date. The BC7 encoder
+// only emits mode 6 blocks (one subset, RGBA endpoints, 4 bit indices).
+//
+// This file does not depend on OpenGL (it's tested in main-test).
+
+enum class BlockFormat : std::uint8_t
+{
+    bc1,
+    bc7
+};
+
+constexpr std::uint32_t kBlockDim = 4;
+
+constexpr
+std::size_t block_bytes( BlockFormat aFormat ) noexcept
+{
+    return BlockFormat::bc1 == aFormat ? 8 : 16;
+}
+
+constexpr
+std::size_t compressed_size( BlockFormat aFormat, std::uint32_t aWidth, std::uint32_t aHeight ) noexcept
+{
+    std::size_t const bx = (aWidth + kBlockDim - 1) / kBlockDim;
+    std::size_t const by = (aHeight + kBlockDim - 1) / kBlockDim;
+    return bx * by * block_bytes( aFormat );
+}
+
+struct RgbaImage
+{
+    std::uint32_t width = 0, height = 0;
+    std::vector<std::uint8_t> texels; // RGBA8, row by row
+};
+
+struct CompressedImage
+{
+    BlockFormat format = BlockFormat::bc7;
+    std::uint32_t width = 0, height = 0; // size of level 0
+    std::vector<std::vector<std::uint8_t>> levels; // level 0 first
+};
+
+// Non-owning version of CompressedImage, e.g. pointing into a memory mapped
+// KTX2 file
+struct CompressedImageView
+{
+    BlockFormat format = BlockFormat::bc7;
+    std::uint32_t width = 0, height = 0;
+    std::vector<std::span<std::uint8_t const>> levels;
+};
+
+CompressedImageView view_of( CompressedImage const& );
+
+// Encode a single block. aTexels points to 16 RGBA8 texels (4 rows of 4).
+// BC1 ignores alpha.
+void encode_bc1_block( std::uint8_t const* aTexels, std::uint8_t* aBlock );
+void encode_bc7_block( std::uint8_t const* aTexels, std::uint8_t* aBlock );
+
+// Compress a whole image. Partial blocks at the right and bottom edges are
+// padded by repeating the last column/row.
+std::vector<std::uint8_t> compress_image( BlockFormat, RgbaImage const& );
+
+// True if any texel has alpha < 255
+bool has_alpha( RgbaImage const& ) noexcept;
+
+std::uint32_t mip_level_count( std::uint32_t aWidth, std::uint32_t aHeight ) noexcept;
+
+// Build the full mip chain of aBase (see mipmap.hpp) and compress each level.
+// All levels are compressed in parallel on aPool.
+CompressedImage compress_with_mips( BlockFormat, RgbaImage const& aBase, ThreadPool& aPool );
+
+#endif // TEXTURE_COMPRESS_HPP_5E0C2A7B_91D4_4F3B_A6E8_0B7D3C41F295
@@ -0,0 +1,422 @@
+#include "texture_registry.hpp"
+
+#include <limits>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+
+#include <cassert>
+
+#include "../support/thread_pool.hpp"
+
+#include "texture.hpp"
+#include "texture_units.hpp"
+
+namespace
+{
+    // Downscaling stops once the smaller side would drop below this size.
+    constexpr std::uint32_t kMinDownscaledSize = 64;
+
+    constexpr std::size_t kNoSlot = std::numeric_limits<std::size_t>::max();
+
+    // Time per frame spent on copying texture data for async loads
+    constexpr auto kDefaultUploadBudget = std::chrono::milliseconds( 2 );
+}
+
+namespace detail
+{
+    struct TextureTable
+    {
+        struct Entry
+        {
+            std::string key; // empty for free slots
+            std::string path;
+            bool linearFilter = true;
+            bool external = false;
+
+            GLuint id = 0;
+            TextureUploader::Ticket ticket = 0; // non-zero while loading async
+            std::uint32_t refs = 0;
+            std::uint64_t lastUsed = 0;
+
+            std::uint32_t droppedLevels = 0;
+            std::uint32_t maxDroppedLevels = 0;
+            std::size_t bytes = 0;
+        };
+
+        std::vector<Entry> entries;
+        std::vector<std::size_t> freeSlots;
+        std::unordered_map<std::string, std::size_t> byKey;
+
+        std::uint64_t frame = 1;
+        std::size_t residentBytes = 0;
+        bool alive = true;
+
+        TextureStats counters;
+
+        void set_loaded( Entry& aEntry, LoadedTexture2D const& aLoaded )
+        {
+            aEntry.id = aLoaded.id;
+            aEntry.bytes = aLoaded.bytes;
+            aEntry.droppedLevels = aLoaded.droppedLevels;
+
+            std::uint32_t const minSide = std::min( aLoaded.width, aLoaded.height );
+            aEntry.maxDroppedLevels = 0;
+            while( aEntry.maxDroppedLevels + 1 < aLoaded.levelCount && (minSide >> (aEntry.maxDroppedLevels + 1)) >= kMinDownscaledSize )
+                ++aEntry.maxDroppedLevels;
+
+            residentBytes += aLoaded.bytes;
+            ++counters.loads;
+        }
+
+        std::size_t allocate()
+        {
+            if( !freeSlots.empty() )
+            {
+                std::size_t const slot = freeSlots.back();
+                freeSlots.pop_back();
+                return slot;
+            }
+
+            entries.emplace_back();
+            return entries.size() - 1;
+        }
+
+        void remove( std::size_t aSlot )
+        {
+            auto& entry = entries[aSlot];
+            assert( 0 == entry.refs );
+
+            residentBytes -= entry.bytes;
+            byKey.erase( entry.key );
+
+            entry = Entry{};
+            freeSlots.push_back( aSlot );
+        }
+    };
+}
+
+// TextureHandle
+TextureHandle::TextureHandle( std::shared_ptr<detail::TextureTable> aTable, std::size_t aSlot ) noexcept
+    : mTable( std::move(aTable) )
+    , mSlot( aSlot )
+{
+    ++mTable->entries[mSlot].refs;
+}
+
+TextureHandle::~TextureHandle()
+{
+    release_();
+}
+
+TextureHandle::TextureHandle( TextureHandle const& aOther ) noexcept
+    : mTable( aOther.mTable )
+    , mSlot( aOther.mSlot )
+{
+    if( mTable )
+        ++mTable->entries[mSlot].refs;
+}
+TextureHandle& TextureHandle::operator= (TextureHandle const& aOther) noexcept
+{
+    TextureHandle copy( aOther );
+    std::swap( mTable, copy.mTable );
+    std::swap( mSlot, copy.mSlot );
+    return *this;
+}
+
+TextureHandle::TextureHandle( TextureHandle&& aOther ) noexcept
+    : mTable( std::move(aOther.mTable) )
+    , mSlot( std::exchange( aOther.mSlot, 0 ) )
+{}
+TextureHandle& TextureHandle::operator= (TextureHandle&& aOther) noexcept
+{
+    std::swap( mTable, aOther.mTable );
+    std::swap( mSlot, aOther.mSlot );
+    return *this;
+}
+
+GLuint TextureHandle::id() const noexcept
+{
+    if( !mTable || !mTable->alive )
+        return 0;
+
+    auto& entry = mTable->entries[mSlot];
+    entry.lastUsed = mTable->frame;
+    return entry.id;
+}
+
+TextureHandle::operator bool() const noexcept
+{
+    return mTable && mTable->alive;
+}
+
+void TextureHandle::release_() noexcept
+{
+    if( !mTable )
+        return;
+
+    auto& entry = mTable->entries[mSlot];
+    assert( entry.refs > 0 );
+
+    // Owned textures stay resident for reuse; external ones are simply no
+    // longer tracked.
+    if( 0 == --entry.refs && entry.external && mTable->alive )
+        mTable->remove( mSlot );
+
+    mTable.reset();
+}
+
+
+// TextureRegistry
+TextureRegistry::TextureRegistry( std::size_t aBudgetBytes )
+    : mTable( std::make_shared<detail::TextureTable>() )
+    , mUploader( std::make_unique<TextureUploader>( shared_thread_pool() ) )
+    , mUploadBudget( kDefaultUploadBudget )
+{
+    mTable->counters.budgetBytes = aBudgetBytes;
+
+    // Neutral grey, shown while async loads are in progress
+    std::uint8_t const grey[4] = { 128, 128, 128, 255 };
+
+    glGenTextures( 1, &mPlaceholder );
+    glBindTexture( GL_TEXTURE_2D, mPlaceholder );
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+}
+
+TextureRegistry::~TextureRegistry()
+{
+    for( auto& entry : mTable->entries )
+    {
+        if( !entry.key.empty() && !entry.external && 0 == entry.ticket && 0 != entry.id )
+            glDeleteTextures( 1, &entry.id );
+    }
+
+    glDeleteTextures( 1, &mPlaceholder );
+    reset_texture_bindings();
+
+    mTable->alive = false;
+}
+
+TextureHandle TextureRegistry::load_2d( char const* aPath, bool aLinearFilter )
+{
+    assert( aPath );
+    auto& table = *mTable;
+
+    std::string key = std::string(aPath) + (aLinearFilter ? "|linear" : "|nearest");
+    if( auto const it = table.byKey.find( key ); table.byKey.end() != it )
+    {
+        ++table.counters.dedupHits;
+        table.entries[it->second].lastUsed = table.frame;
+        return TextureHandle( mTable, it->second );
+    }
+
+    LoadedTexture2D const loaded = load_texture_2d_levels( aPath, aLinearFilter, 0 );
+
+    std::size_t const slot = table.allocate();
+    auto& entry = table.entries[slot];
+    entry.key = key;
+    entry.path = aPath;
+    entry.linearFilter = aLinearFilter;
+    entry.lastUsed = table.frame;
+    table.set_loaded( entry, loaded );
+
+    table.byKey.emplace( std::move(key), slot );
+    return TextureHandle( mTable, slot );
+}
+
+TextureHandle TextureRegistry::load_2d_async( char const* aPath, bool aLinearFilter )
+{
+    assert( aPath );
+    auto& table = *mTable;
+
+    // Shares the key with load_2d(), so a synchronous load of the same path
+    // also gets the placeholder until the upload is done.
+    std::string key = std::string(aPath) + (aLinearFilter ? "|linear" : "|nearest");
+    if( auto const it = table.byKey.find( key ); table.byKey.end() != it )
+    {
+        ++table.counters.dedupHits;
+        table.entries[it->second].lastUsed = table.frame;
+        return TextureHandle( mTable, it->second );
+    }
+
+    std::size_t const slot = table.allocate();
+    auto& entry = table.entries[slot];
+    entry.key = key;
+    entry.path = aPath;
+    entry.linearFilter = aLinearFilter;
+    entry.id = mPlaceholder;
+    entry.ticket = mUploader->request( aPath, aLinearFilter );
+    entry.lastUsed = table.frame;
+
+    table.byKey.emplace( std::move(key), slot );
+    return TextureHandle( mTable, slot );
+}
+
+TextureHandle TextureRegistry::track_external( char const* aName, GLuint aTexture, std::size_t aBytes )
+{
+    assert( aName );
+    auto& table = *mTable;
+
+    // Keys of external textures can't collide with loaded ones (no '|').
+    std::string key = std::string("external:") + aName;
+    assert( !table.byKey.contains( key ) );
+
+    std::size_t const slot = table.allocate();
+    auto& entry = table.entries[slot];
+    entry.key = key;
+    entry.path = aName;
+    entry.external = true;
+    entry.id = aTexture;
+    entry.lastUsed = table.frame;
+    entry.bytes = aBytes;
+
+    table.byKey.emplace( std::move(key), slot );
+    table.residentBytes += aBytes;
+
+    return TextureHandle( mTable, slot );
+}
+
+void TextureRegistry::update_external( TextureHandle const& aHandle, GLuint aTexture, std::size_t aBytes )
+{
+    assert( aHandle.mTable == mTable );
+
+    auto& entry = mTable->entries[aHandle.mSlot];
+    assert( entry.external );
+
+    mTable->residentBytes = mTable->residentBytes - entry.bytes + aBytes;
+    entry.id = aTexture;
+    entry.bytes = aBytes;
+}
+
+void TextureRegistry::set_budget( std::size_t aBytes ) noexcept
+{
+    mTable->counters.budgetBytes = aBytes;
+}
+void TextureRegistry::set_upload_budget( std::chrono::steady_clock::duration aBudget ) noexcept
+{
+    mUploadBudget = aBudget;
+}
+
+void TextureRegistry::end_frame()
+{
+    auto& table = *mTable;
+    std::size_t const budget = table.counters.budgetBytes;
+
+    // Swap in async loads that have finished. Pending entries are never
+    // removed, so each ticket has a matching entry.
+    if( mUploader->in_flight() > 0 )
+    {
+        for( auto const& [ticket, loaded] : mUploader->pump( mUploadBudget ) )
+        {
+            auto const it = std::find_if( table.entries.begin(), table.entries.end(), [ticket] ( auto const& aEntry ) {
+                return aEntry.ticket == ticket;
+            } );
+            assert( table.entries.end() != it );
+
+            it->ticket = 0;
+            table.set_loaded( *it, loaded );
+        }
+    }
+
+    auto const reload = [&] ( detail::TextureTable::Entry& aEntry, std::uint32_t aDropLevels ) {
+        LoadedTexture2D const loaded = load_texture_2d_levels( aEntry.path.c_str(), aEntry.linearFilter, aDropLevels );
+        glDeleteTextures( 1, &aEntry.id );
+        reset_texture_bindings();
+
+        table.residentBytes = table.residentBytes - aEntry.bytes + loaded.bytes;
+        aEntry.id = loaded.id;
+        aEntry.bytes = loaded.bytes;
+        aEntry.droppedLevels = loaded.droppedLevels;
+    };
+
+    // Returns the least recently used entry that satisfies aPred
+    auto const find_lru = [&] ( auto&& aPred ) {
+        std::size_t best = kNoSlot;
+        for( std::size_t i = 0; i < table.entries.size(); ++i )
+        {
+            auto const& entry = table.entries[i];
+            if( entry.key.empty() || entry.external || 0 != entry.ticket || !aPred( entry ) )
+                continue;
+
+            if( kNoSlot == best || entry.lastUsed < table.entries[best].lastUsed )
+                best = i;
+        }
+        return best;
+    };
+
+    while( table.residentBytes > budget )
+    {
+        // Unused textures go first
+        std::size_t const unused = find_lru( [] ( auto const& aEntry ) { return 0 == aEntry.refs; } );
+        if( kNoSlot != unused )
+        {
+            glDeleteTextures( 1, &table.entries[unused].id );
+            reset_texture_bindings();
+            table.remove( unused );
+            ++table.counters.evictions;
+            continue;
+        }
+
+        std::size_t const victim = find_lru( [] ( auto const& aEntry ) { return aEntry.droppedLevels < aEntry.maxDroppedLevels; } );
+        if( kNoSlot == victim )
+            break; // nothing left to do
+
+        auto& entry = table.entries[victim];
+        reload( entry, entry.droppedLevels + 1 );
+        ++table.counters.downscales;
+    }
+
+    // Restore one level of the most recently used downscaled texture, if it
+    // was used in this frame and fits. Re-adding a level roughly quadruples
+    // the size, so that's the estimate.
+    std::size_t restore = kNoSlot;
+    for( std::size_t i = 0; i < table.entries.size(); ++i )
+    {
+        auto const& entry = table.entries[i];
+        if( entry.key.empty() || entry.external || 0 == entry.droppedLevels || entry.lastUsed != table.frame )
+            continue;
+
+        if( kNoSlot == restore || entry.lastUsed > table.entries[restore].lastUsed )
+            restore = i;
+    }
+
+    if( kNoSlot != restore )
+    {
+        auto& entry = table.entries[restore];
+        if( table.residentBytes + 3 * entry.bytes <= budget )
+        {
+            reload( entry, entry.droppedLevels - 1 );
+            ++table.counters.restores;
+        }
+    }
+
+    ++table.frame;
+}
+
+TextureStats TextureRegistry::stats() const noexcept
+{
+    auto const& table = *mTable;
+
+    TextureStats ret = table.counters;
+    ret.residentBytes = table.residentBytes;
+    for( auto const& entry : table.entries )
+    {
+        if( entry.key.empty() )
+            continue;
+
+        ++ret.textures;
+        if( entry.refs > 0 )
+            ++ret.referenced;
+        if( entry.droppedLevels > 0 )
+            ++ret.downscaled;
+        if( 0 != entry.ticket )
+            ++ret.pending;
+    }
+
+    return ret;
+}
@@ -0,0 +1,134 @@
+#ifndef TEXTURE_REGISTRY_HPP_1D8F3A6E_C472_4B95_A0E3_5B29C7D0F814
+#define TEXTURE_REGISTRY_HPP_1D8F3A6E_C472_4B95_A0E3_5B29C7D0F814
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <memory>
+
+#include <cstddef>
+#include <cstdint>
+
+// Central owner of GL textures.
+//
+// Loads are deduplicated by path and sampling parameters; callers receive
+// reference counted TextureHandles. Textures whose last handle went away stay
+// resident for reuse until the memory budget forces them out.
+//
+// When the resident bytes exceed the budget, end_frame() first evicts the
+// least recently used unreferenced textures. If that is not enough, it
+// downscales the least recently used referenced textures by dropping their
+// largest mip level (re-uploaded from the texture cache, see texture.hpp).
+// Downscaled textures are restored once they fit into the budget again.
+//
+// load_2d_async() returns immediately. The handle refers to a small
+// placeholder texture until the image has been decoded on a worker thread and
+// uploaded by end_frame(), which spends at most the upload budget per frame on
+// this (see TextureUploader in texture.hpp).
+//
+// Textures created elsewhere (e.g., the font atlas) can be tracked so that
+// they show up in the statistics and count towards the budget. They are
+// never evicted or downscaled, and not deleted by the registry.
+//
+// Not thread-safe; use from the GL thread only.
+
+struct TextureStats
+{
+    std::size_t textures = 0;      // resident textures (including unreferenced ones)
+    std::size_t referenced = 0;    // textures with at least one handle
+    std::size_t downscaled = 0;    // textures currently missing mip levels
+    std::size_t pending = 0;       // async loads that are not uploaded yet
+    std::size_t residentBytes = 0;
+    std::size_t budgetBytes = 0;
+
+    // Totals since the registry was created
+    std::size_t loads = 0;         // loads that created a new texture
+    std::size_t dedupHits = 0;     // loads served by an already resident texture
+    std::size_t evictions = 0;
+    std::size_t downscales = 0;
+    std::size_t restores = 0;
+};
+
+class TextureUploader;
+
+namespace detail
+{
+    struct TextureTable;
+}
+
+class TextureHandle final
+{
+    public:
+        TextureHandle() noexcept = default;
+        ~TextureHandle();
+
+        TextureHandle( TextureHandle const& ) noexcept;
+        TextureHandle& operator= (TextureHandle const&) noexcept;
+
+        TextureHandle( TextureHandle&& ) noexcept;
+        TextureHandle& operator= (TextureHandle&&) noexcept;
+
+    public:
+        // Current GL texture name; also marks the texture as used in this
+        // frame. The name changes when the texture is downscaled or
+        // restored, so look it up every frame rather than storing it.
+        // Returns 0 for empty handles or once the registry is gone.
+        GLuint id() const noexcept;
+
+        explicit operator bool() const noexcept;
+
+    private:
+        friend class TextureRegistry;
+        TextureHandle( std::shared_ptr<detail::TextureTable>, std::size_t aSlot ) noexcept;
+
+        void release_() noexcept;
+
+    private:
+        std::shared_ptr<detail::TextureTable> mTable;
+        std::size_t mSlot = 0;
+};
+
+class TextureRegistry final
+{
+    public:
+        explicit TextureRegistry( std::size_t aBudgetBytes );
+
+        // Deletes all owned textures. Outstanding handles remain safe to
+        // destroy, but return 0 from id().
+        ~TextureRegistry();
+
+        TextureRegistry( TextureRegistry const& ) = delete;
+        TextureRegistry& operator= (TextureRegistry const&) = delete;
+
+    public:
+        // See load_texture_2d(). Throws Error if the image cannot be loaded.
+        TextureHandle load_2d( char const* aPath, bool aLinearFilter = true );
+
+        // As load_2d(), but the image is loaded in the background. Errors
+        // are reported (thrown) by end_frame().
+        TextureHandle load_2d_async( char const* aPath, bool aLinearFilter = true );
+
+        // Track a texture that is owned by someone else. The caller keeps
+        // the size up to date with update_external().
+        TextureHandle track_external( char const* aName, GLuint aTexture, std::size_t aBytes );
+        void update_external( TextureHandle const&, GLuint aTexture, std::size_t aBytes );
+
+        void set_budget( std::size_t aBytes ) noexcept;
+        void set_upload_budget( std::chrono::steady_clock::duration ) noexcept;
+
+        // Call once per frame, after rendering. Finishes pending uploads
+        // (within the upload budget), advances the LRU clock and enforces
+        // the memory budget.
+        void end_frame();
+
+        TextureStats stats() const noexcept;
+
+    private:
+        std::shared_ptr<detail::TextureTable> mTable;
+
+        std::unique_ptr<TextureUploader> mUploader;
+        std::chrono::steady_clock::duration mUploadBudget;
+        GLuint mPlaceholder = 0;
+};
+
+#endif // TEXTURE_REGISTRY_HPP_1D8F3A6E_C472_4B95_A0E3_5B29C7D0F814
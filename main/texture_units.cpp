@@ -0,0 +1,45 @@
+#include "texture_units.hpp"
+
+#include <utility>
+
+#include <cassert>
+
+namespace
+{
+    struct Binding_
+    {
+        GLenum target = 0;
+        GLuint texture = 0;
+    };
+
+    Binding_ gBound_[std::size_t(TextureUnit::count)];
+    TextureBindStats gStats_;
+}
+
+void bind_texture( TextureUnit aUnit, GLenum aTarget, GLuint aTexture )
+{
+    assert( aUnit < TextureUnit::count );
+    ++gStats_.requested;
+
+    auto& bound = gBound_[std::size_t(aUnit)];
+    if( bound.target == aTarget && bound.texture == aTexture )
+        return;
+
+    glActiveTexture( GL_TEXTURE0 + GLenum(aUnit) );
+    glBindTexture( aTarget, aTexture );
+    glActiveTexture( GL_TEXTURE0 );
+
+    bound = Binding_{ aTarget, aTexture };
+    ++gStats_.issued;
+}
+
+void reset_texture_bindings() noexcept
+{
+    for( auto& bound : gBound_ )
+        bound = Binding_{};
+}
+
+TextureBindStats take_texture_bind_stats() noexcept
+{
+    return std::exchange( gStats_, TextureBindStats{} );
+}
@@ -0,0 +1,55 @@
+#ifndef TEXTURE_UNITS_HPP_3A7C0E25_9D14_4B6F_8E52_C1F0A4D7B936
+#define TEXTURE_UNITS_HPP_3A7C0E25_9D14_4B6F_8E52_C1F0A4D7B936
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Fixed texture units for rendering.
+//
+// Each kind of texture that is sampled while drawing gets its own unit, and
+// binds go through bind_texture(), which skips the call if the texture is
+// already bound there. Since the units aren't shared between passes, the
+// textures normally stay bound from one frame to the next.
+//
+// Unit 0 is not part of this: code that creates or updates textures binds to
+// unit 0 (the default active unit), so it never disturbs the units below.
+// bind_texture() leaves unit 0 active.
+
+enum class TextureUnit : GLuint
+{
+    terrain = 1,
+    smallTextures = 2, // texture atlas, see texture_atlas.hpp
+    font = 3,
+    vtPageTable = 4, // see virtual_texture.hpp
+    vtPhysical = 5,
+    sceneDepth = 6, // see particle_target.hpp
+    particleColor = 7,
+    particleDepth = 8,
+    particleRevealage = 9,
+
+    count
+};
+
+// Value for sampler uniforms
+constexpr GLint texture_unit_index( TextureUnit aUnit ) noexcept
+{
+    return GLint(aUnit);
+}
+
+void bind_texture( TextureUnit, GLenum aTarget, GLuint aTexture );
+
+// Forget what is bound. Must be called after deleting a texture that may be
+// bound to one of the units (GL might reuse the name).
+void reset_texture_bindings() noexcept;
+
+struct TextureBindStats
+{
+    std::size_t requested = 0; // calls to bind_texture()
+    std::size_t issued = 0;    // binds that actually reached GL
+};
+
+// Returns the counts since the last call and resets them
+TextureBindStats take_texture_bind_stats() noexcept;
+
+#endif // TEXTURE_UNITS_HPP_3A7C0E25_9D14_4B6F_8E52_C1F0A4D7B936
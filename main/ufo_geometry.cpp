@@ -0,0 +1,50 @@
+#include "ufo_geometry.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    constexpr
+    std::array<UfoVertex, kUfoVertexCount> make_ufo_vertices_()
+    {
+        std::array<UfoVertex, kUfoVertexCount> vertices{};
+
+        for( int lod = 0; lod < kUfoLodCount; ++lod )
+        {
+            SimpleMeshData const mesh = build_ufo_mesh_data( kUfoLodDetail[lod] );
+
+            // Fails compilation if ufo_vertex_count() no longer matches the
+            // generators in shapes.inl.
+            if( mesh.positions.size() != kUfoLodRanges[lod].count )
+                throw "ufo_vertex_count() is out of date";
+
+            interleave_ufo_vertices( mesh, vertices.data() + kUfoLodRanges[lod].first );
+        }
+
+        return vertices;
+    }
+
+    constexpr
+    UfoBounds make_ufo_bounds_()
+    {
+        auto const& lod0 = kUfoLodRanges[0];
+
+        Vec3f bmin = kUfoVertices[lod0.first].position;
+        Vec3f bmax = bmin;
+        for( std::size_t i = lod0.first; i < lod0.first + lod0.count; ++i )
+        {
+            Vec3f const& p = kUfoVertices[i].position;
+            bmin = Vec3f{ std::min( bmin.x, p.x ), std::min( bmin.y, p.y ), std::min( bmin.z, p.z ) };
+            bmax = Vec3f{ std::max( bmax.x, p.x ), std::max( bmax.y, p.y ), std::max( bmax.z, p.z ) };
+        }
+
+        UfoBounds bounds{ 0.5f * (bmin + bmax), 0.f };
+        for( std::size_t i = lod0.first; i < lod0.first + lod0.count; ++i )
+            bounds.radius = std::max( bounds.radius, length( kUfoVertices[i].position - bounds.center ) );
+
+        return bounds;
+    }
+}
+
+constexpr std::array<UfoVertex, kUfoVertexCount> kUfoVertices = make_ufo_vertices_();
+constexpr UfoBounds kUfoBounds = make_ufo_bounds_();
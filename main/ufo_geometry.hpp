@@ -0,0 +1,440 @@
+#ifndef UFO_GEOMETRY_HPP_61C2B5E4_0F7A_4D59_8E33_9A4B7D1E2C80
+#define UFO_GEOMETRY_HPP_61C2B5E4_0F7A_4D59_8E33_9A4B7D1E2C80
+
+// Procedural UFO geometry. Everything here is defined by constants, so the
+// complete vertex stream (all detail levels) is generated at compile time and
+// embedded in the binary as kUfoVertices. spaceship.cpp uploads it directly.
+
+#include <array>
+#include <cstddef>
+#include <numbers>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+#include "simple_mesh.hpp"
+#include "shapes.hpp"
+
+// Level of detail: subdivisions used for the round parts of the UFO
+struct UfoDetail
+{
+    std::size_t bodySubdivs;  // main body cylinder
+    std::size_t coneSubdivs;  // exhaust, neck and nose cone
+    std::size_t trimSubdivs;  // antenna and tip
+};
+
+constexpr int kUfoLodCount = 3;
+
+// LOD 0 is the full-detail ship
+constexpr UfoDetail kUfoLodDetail[kUfoLodCount] = {
+    { 60, 48, 16 },
+    { 24, 20,  8 },
+    {  8,  8,  6 }
+};
+
+// Shared with create_ufo_mesh() (point lights sit on the bulb ring)
+constexpr float kUfoBodyRadius = 0.4f;
+constexpr float kUfoBulbRingY  = 0.7f;
+
+// Interleaved vertex; attribute locations as in create_vao() / default.vert
+struct UfoVertex
+{
+    Vec3f position;  // location 0
+    Vec3f normal;    // location 1
+    Vec3f color;     // location 3
+    float Ns;        // location 4
+    Vec3f Ka;        // location 5
+    Vec3f Kd;        // location 6
+    Vec3f Ke;        // location 7
+    Vec3f Ks;        // location 8
+};
+
+// Vertex count of one level: capped cylinders emit 9 vertices per
+// subdivision, capped cones 6, cubes 36 and fins 24 (see shapes.inl).
+constexpr
+std::size_t ufo_vertex_count( UfoDetail const& aDetail ) noexcept
+{
+    return 9 * aDetail.bodySubdivs     // body
+        + 6 * aDetail.coneSubdivs      // exhaust
+        + 3 * 36                       // bulbs
+        + 3 * 24                       // fins
+        + 9 * aDetail.coneSubdivs      // neck
+        + 6 * aDetail.coneSubdivs      // nose cone
+        + 9 * aDetail.trimSubdivs      // antenna
+        + 6 * aDetail.trimSubdivs;     // tip
+}
+
+// Vertex range of each level inside kUfoVertices
+struct UfoLodRange
+{
+    std::size_t first;
+    std::size_t count;
+};
+
+constexpr std::array<UfoLodRange, kUfoLodCount> kUfoLodRanges = [] {
+    std::array<UfoLodRange, kUfoLodCount> ranges{};
+    std::size_t first = 0;
+    for( int lod = 0; lod < kUfoLodCount; ++lod )
+    {
+        ranges[lod] = { first, ufo_vertex_count( kUfoLodDetail[lod] ) };
+        first += ranges[lod].count;
+    }
+    return ranges;
+}();
+
+constexpr std::size_t kUfoVertexCount =
+    kUfoLodRanges[kUfoLodCount-1].first + kUfoLodRanges[kUfoLodCount-1].count;
+
+// Builds one detail level of the UFO (all parts, already pre-transformed).
+// Evaluated at compile time for kUfoVertices; can also be called at runtime.
+constexpr
+SimpleMeshData build_ufo_mesh_data( UfoDetail const& aDetail )
+{
+    // =====================
+    // Build UFO using SimpleMeshData + pre-transform matrices
+    // =====================
+
+    // Common material values
+    Vec3f KaBody{0.1f, 0.1f, 0.1f};
+    Vec3f KdBody{0.9f, 0.9f, 0.9f};
+    Vec3f KeBody{0.0f, 0.0f, 0.0f};
+    Vec3f KsBody{0.8f, 0.8f, 0.8f};
+    float NsBody = 64.0f;   // shininess in x
+
+    Vec3f KaPink{0.05f, 0.0f, 0.02f};
+    Vec3f KdPink{1.0f, 0.0f, 0.8f};
+    Vec3f KePink{0.0f, 0.0f, 0.0f};
+    Vec3f KsPink{0.9f, 0.6f, 0.9f};
+    float NsPink = 32.f;
+
+    Vec3f KaEngine{0.05f, 0.05f, 0.06f};      // subtle cool metal tint
+    Vec3f KdEngine{0.77f, 0.77f, 0.77f};      // ALMOST no diffuse
+    Vec3f KeEngine{0.0f, 0.0f, 0.0f};
+    Vec3f KsEngine{1.0f, 1.0f, 1.0f};         // perfect mirror specular
+    float NsEngine = 256.0f;            // very shiny
+
+    Vec3f white{1.f, 1.f, 1.f};
+
+    // ----- Dimensions in local UFO space -----
+    float bodyHeight   = 5.0f;
+    float bodyRadius   = kUfoBodyRadius;
+    float engineHeight = 0.8f;
+    float engineRadius = bodyRadius * 1.5f;
+
+    float bodyBottomY = -bodyHeight * 0.5f; // -3
+    float bodyTopY    =  bodyHeight * 0.5f; // +3
+
+    // =====================
+    // BASE MESH (body + exhaust cone + bulbs)
+    // =====================
+
+    // Body: cylinder along local Y, scaled to height 6 and radius 0.4
+   float const halfBodyHeight = bodyHeight * 0.5f;
+
+Mat44f bodyPre =
+    // move from [0, bodyHeight] to [-bodyHeight/2, +bodyHeight/2]
+    make_translation(Vec3f{0.f, -halfBodyHeight, 0.f}) *
+    // rotate axis from X to Y (90 degrees about Z)
+    make_rotation_z(0.5f * std::numbers::pi_v<float>) *
+    // scale: length along X, radius in YZ
+    make_scaling(bodyHeight, bodyRadius, bodyRadius);
+
+    SimpleMeshData bodyMesh = make_cylinder(
+        true,          // capped
+        aDetail.bodySubdivs, // subdivisions
+        white,         // vertex color
+        bodyPre,
+        NsBody, KaBody, KdBody, KeBody, KsBody
+    );
+
+    // Exhaust: cone at bottom, flared out
+    float engineCenterY = bodyBottomY + engineHeight * 0.5f;
+    float const halfEngineHeight = engineHeight * 0.5f;
+
+    Mat44f enginePre =
+        make_translation(Vec3f{0.f, engineCenterY - halfEngineHeight, 0.f}) *
+        make_rotation_z(0.5f * std::numbers::pi_v<float>) *
+        make_scaling(engineHeight, engineRadius, engineRadius);
+
+    SimpleMeshData engineMesh = make_cone(
+        true,
+        aDetail.coneSubdivs,
+        white,
+        enginePre,
+        NsEngine, KaEngine, KdEngine, KeEngine, KsEngine
+    );
+
+    // Bulbs: three tiny cylinders around a ring
+    // Common scale for the “bulb” cubes
+
+float bulbRingY   = kUfoBulbRingY;        // somewhere around mid-body
+float bulbRadius  = bodyRadius;    // just outside the hull
+
+Mat44f lightScale = make_scaling(0.1f, 0.1f, 0.1f);
+
+// Angles for 3 bulbs (0°, 120°, 240°)
+float angle0 = 0.0f;
+float angle4 = 4.0f * std::numbers::pi_v<float> / 3.0f;
+float angle12 = 2.0f * std::numbers::pi_v<float> / 3.0f;
+
+// Red light cube
+Mat44f redPre =
+    make_rotation_y(angle0) *
+    make_translation(Vec3f{ bulbRadius, bulbRingY, 0.0f }) *
+    lightScale;
+
+SimpleMeshData redLightCube = make_cube(
+    true,
+    1,
+    Vec3f{1.f, 0.f, 0.f},
+    redPre,
+    NsEngine,
+    KaEngine,
+    Vec3f {1.f, 0.f, 0.f},
+    KeEngine,
+    KsEngine
+);
+
+// Green light cube
+Mat44f greenPre =
+ make_rotation_y(angle4) *
+    make_translation(Vec3f{ bulbRadius, bulbRingY, 0.0f }) *
+    lightScale;
+
+SimpleMeshData greenLightCube = make_cube(
+    true,
+    1,
+    Vec3f{0.f, 1.f, 0.f},
+    greenPre,
+    NsEngine,
+    KaEngine,
+    Vec3f {0.f, 1.f, 0.f},
+    KeEngine,
+    KsEngine
+);
+
+// Blue light cube
+Mat44f bluePre =
+    make_rotation_y(angle12) *
+    make_translation(Vec3f{ bulbRadius, bulbRingY, 0.0f }) *
+    lightScale;
+
+SimpleMeshData blueLightCube = make_cube(
+    true,
+    1,
+    Vec3f{0.f, 0.f, 1.f},
+    bluePre,
+    NsEngine,
+    KaEngine,
+    Vec3f {0.f, 0.65f, 1.f},
+    KeEngine,
+    KsEngine
+);
+
+
+    // =====================
+    // FINS (3 right triangles evenly spaced around body)
+    // =====================
+
+    float finHeight   = 1.2f;     // vertical size
+    float finLength   = 1.0f;     // how far it sticks out
+    float finThickness = .3f;
+    float finBaseY    = bodyBottomY + 0.4f; // vertical position of the base
+
+    float finRadius = 0.4f;            // distance from centre (you requested 0.4f)
+    float twoPi = 2.0f * std::numbers::pi_v<float>;
+
+    // Angle step for 3 fins
+    float angleStep = twoPi / 3.0f;
+
+    // Fin 0
+    Mat44f finPre0 =
+        make_rotation_y(0.0f) *
+        make_translation(Vec3f{finRadius, finBaseY, 0.0f}) *
+        make_scaling(finLength, finHeight, finThickness);
+
+    SimpleMeshData finMesh0 = make_fin(
+        true,
+        16,
+        white,
+        finPre0,
+        NsPink, KaPink, KdPink, KePink, KsPink
+    );
+
+    // Fin 1 (rotated 120 degrees)
+    float angle1 = angleStep;
+    Mat44f finPre1 =
+        make_rotation_y(angle1) *
+        make_translation(Vec3f{finRadius, finBaseY, 0.0f}) *
+        make_scaling(finLength, finHeight, finThickness);
+
+    SimpleMeshData finMesh1 = make_fin(
+        true,
+        16,
+        white,
+        finPre1,
+        NsPink, KaPink, KdPink, KePink, KsPink
+    );
+
+    // Fin 2 (rotated 240 degrees)
+    float angle2 = 2.0f * angleStep;
+    Mat44f finPre2 =
+        make_rotation_y(angle2) *
+        make_translation(Vec3f{finRadius, finBaseY, 0.0f}) *
+        make_scaling(finLength, finHeight, finThickness);
+
+    SimpleMeshData finMesh2 = make_fin(
+        true,
+        16,
+        white,
+        finPre2,
+        NsPink, KaPink, KdPink, KePink, KsPink
+    );
+
+
+    // Append all base parts (in place, no intermediate copies)
+    SimpleMeshData ufoMeshData;
+    append(ufoMeshData, bodyMesh);
+    append(ufoMeshData, engineMesh);
+    append(ufoMeshData, redLightCube);
+    append(ufoMeshData, greenLightCube);
+    append(ufoMeshData, blueLightCube);
+
+
+     // Add fins
+    append(ufoMeshData, finMesh0);
+    append(ufoMeshData, finMesh1);
+    append(ufoMeshData, finMesh2);
+
+    // =====================
+    // TOP MESH (neck + big pink cone + antenna + tip)
+    // =====================
+
+    float neckHeight = 0.5f;
+    float neckRadius = bodyRadius;
+    float neckCenterY = bodyTopY + neckHeight * 0.5f;
+
+    float const halfNeckHeight = neckHeight * 0.5f;
+
+Mat44f neckPre =
+    // move bottom of neck to correct world Y
+    make_translation(Vec3f{0.f, neckCenterY - halfNeckHeight, 0.f}) *
+    // rotate axis from X to Y
+    make_rotation_z(0.5f * std::numbers::pi_v<float>) *
+    // scale: length along X, radius in YZ
+    make_scaling(neckHeight, neckRadius, neckRadius);
+
+
+    SimpleMeshData neckMesh = make_cylinder(
+        true,
+        aDetail.coneSubdivs,
+        Vec3f{1.f, 0.75f, 0.8f},  // hot pink
+        neckPre,
+        NsPink, KaPink, KdPink, KePink, KsPink
+    );
+
+    // Big pink cone under antenna
+    float coneHeight = 2.f;
+    float coneRadius = bodyRadius;
+    float coneCenterY = bodyTopY + neckHeight + coneHeight * 0.5f;
+    float const halfConeHeight = coneHeight * 0.5f;
+
+    Mat44f conePre =
+        make_translation(Vec3f{0.f, coneCenterY - halfConeHeight, 0.f}) *
+        make_rotation_z(0.5f * std::numbers::pi_v<float>) *
+        make_scaling(coneHeight, coneRadius, coneRadius);
+
+
+    SimpleMeshData coneMesh = make_cone(
+        true,
+        aDetail.coneSubdivs,
+        Vec3f{1.0f,0.75f, 0.8f},  // pink colour
+        conePre,
+        NsPink, KaPink, KdPink, KePink, KsPink
+    );
+
+    // Thin antenna cylinder on top
+    float antennaHeight = 0.5f;
+    float antennaRadius = 0.05f;
+    float antennaCenterY =
+        bodyTopY + neckHeight + coneHeight - antennaHeight * 0.5f;
+
+    float const halfAntennaHeight = antennaHeight * 0.5f;
+
+    Mat44f antennaPre =
+        make_translation(Vec3f{0.f, antennaCenterY - halfAntennaHeight, 0.f}) *
+        make_rotation_z(0.5f * std::numbers::pi_v<float>) *
+        make_scaling(antennaHeight, antennaRadius, antennaRadius);
+
+
+    SimpleMeshData antennaMesh = make_cylinder(
+        true,
+        aDetail.trimSubdivs,
+        Vec3f{1.0f,0.75f, 0.8f},
+        antennaPre,
+        NsPink, KaPink, KdPink, KePink, KsPink
+    );
+
+    // Tiny tip cone at very top
+    float tipHeight = 0.3f;
+    float tipRadius = antennaRadius;
+    float tipCenterY = antennaCenterY + 0.5f * (antennaHeight + tipHeight);
+    float const halfTipHeight = tipHeight * 0.5f;
+
+    Mat44f tipPre =
+        make_translation(Vec3f{0.f, tipCenterY - halfTipHeight, 0.f}) *
+        make_rotation_z(0.5f * std::numbers::pi_v<float>) *
+        make_scaling(tipHeight, tipRadius, tipRadius);
+
+    SimpleMeshData tipMesh = make_cone(
+        true,
+        aDetail.trimSubdivs,
+        Vec3f{1.f, 0.75f, 0.8f}, 
+        tipPre,
+        NsPink, KaPink, KdPink, KePink, KsPink
+    );
+
+    append(ufoMeshData, neckMesh);
+    append(ufoMeshData, coneMesh);
+    append(ufoMeshData, antennaMesh);
+    append(ufoMeshData, tipMesh);
+
+
+    // =====================
+    // FINAL UFO MESH
+    // =====================
+
+    return ufoMeshData;
+}
+
+// Interleaves aMesh into aOut (aMesh.positions.size() vertices)
+constexpr
+void interleave_ufo_vertices( SimpleMeshData const& aMesh, UfoVertex* aOut )
+{
+    for( std::size_t i = 0; i < aMesh.positions.size(); ++i )
+    {
+        aOut[i] = UfoVertex{
+            aMesh.positions[i],
+            aMesh.normals[i],
+            aMesh.colors[i],
+            aMesh.Ns[i],
+            aMesh.Ka[i],
+            aMesh.Kd[i],
+            aMesh.Ke[i],
+            aMesh.Ks[i]
+        };
+    }
+}
+
+// Local-space bounding sphere around the finest level
+struct UfoBounds
+{
+    Vec3f center;
+    float radius;
+};
+
+// Compile-time data (ufo_geometry.cpp)
+extern std::array<UfoVertex, kUfoVertexCount> const kUfoVertices;
+extern UfoBounds const kUfoBounds;
+
+#endif // UFO_GEOMETRY_HPP_61C2B5E4_0F7A_4D59_8E33_9A4B7D1E2C80
@@ -1,19 +1,31 @@
 #include "ui.hpp"
+#include "texture_units.hpp"
+#include "streaming_buffer.hpp"
 #include <cmath>
+#include <cstring>
 #include <stdexcept>
 
 
+// Fontstash's atlas texture
+struct UIFONSc
+{
+    GLuint texture = 0; // atlas texture ID
+    int width = 0, height = 0;
+    bool changed = false; // created or resized since takeAtlasChanged()
+};
+
 // Helper to create fontstash texture and update it
 namespace
 {
-    struct UIFONSc
-    {
-        GLuint texture; // atlas texture ID
-    };
-    
+    // Atlas growth stops here; glyphs that don't fit are not drawn
+    constexpr int kMaxAtlasSize = 2048;
+
     // Create font texture
     int UIFCtexture(void* userPtr, int width, int height){
         auto* atlas = static_cast<UIFONSc*>(userPtr);
+        atlas->width = width;
+        atlas->height = height;
+        atlas->changed = true;
         glGenTextures(1, &atlas->texture);
         glBindTexture(GL_TEXTURE_2D, atlas->texture);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
@@ -27,11 +39,36 @@ namespace
     int UIFRtexture(void* userPtr, int width, int height)
     {
         auto* atlas = static_cast<UIFONSc*>(userPtr);
+        atlas->width = width;
+        atlas->height = height;
+        atlas->changed = true;
         glBindTexture(GL_TEXTURE_2D, atlas->texture);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
         glBindTexture(GL_TEXTURE_2D, 0);
         return 1;
     }
+
+    // Grow the atlas when it is full. Fontstash re-uploads the glyphs it
+    // already has and retries.
+    void UIFerror(void* userPtr, int error, int)
+    {
+        if (error != FONS_ATLAS_FULL)
+            return;
+
+        auto* context = static_cast<FONScontext*>(userPtr);
+        int width = 0, height = 0;
+        fonsGetAtlasSize(context, &width, &height);
+
+        // Double the shorter side
+        if (width <= height && width < kMaxAtlasSize)
+            width *= 2;
+        else if (height < kMaxAtlasSize)
+            height *= 2;
+        else
+            return;
+
+        fonsExpandAtlas(context, width, height);
+    }
     
     // Update a region of  atlas
     void UIFUregion(void* userPtr, int* rect, const unsigned char* data){
@@ -50,11 +87,11 @@ namespace
     glBindTexture(GL_TEXTURE_2D, atlas->texture);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // set alignment to 1 byte
     
-    // Set row length to 512 (the full width of atlas)
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 512);
+    // Set row length to the full width of atlas
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, atlas->width);
     
     // Offset into the data for the updated region
-    const unsigned char* subData = data + x + (y * 512);
+    const unsigned char* subData = data + x + (y * atlas->width);
     
     glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RED, GL_UNSIGNED_BYTE, subData);
     
@@ -77,16 +114,16 @@ namespace
 }
 
 // UIRenderer implementation
-UIRenderer::UIRenderer(int windowWidth, int screenHeight, ShaderProgram& shader)
-    :screenWidth(windowWidth), screenHeight(screenHeight), uiShader(shader),fontTexture(0)
+UIRenderer::UIRenderer(int windowWidth, int screenHeight, ShaderProgram& shader, StreamingBuffer& stream)
+    :screenWidth(windowWidth), screenHeight(screenHeight), uiShader(shader), stream(stream)
 {
 
     // Create fontstash context
     FONSparams config{};
     auto* atlas = new UIFONSc{}; // context for atlas texture
     
-    config.width = 512;
-    config.height = 512;
+    config.width = kAtlasSize;
+    config.height = kAtlasSize;
     config.flags = FONS_ZERO_TOPLEFT; // origin at top left
     config.renderCreate = UIFCtexture;
     config.renderResize = UIFRtexture;
@@ -100,6 +137,7 @@ UIRenderer::UIRenderer(int windowWidth, int screenHeight, ShaderProgram& shader)
         delete atlas; // avoid leak if failed
         throw std::runtime_error("Font context failed to create");
     }
+    fonsSetErrorCallback(fontContext, UIFerror, fontContext);
 
     
     // Load the font
@@ -108,40 +146,56 @@ UIRenderer::UIRenderer(int windowWidth, int screenHeight, ShaderProgram& shader)
         throw std::runtime_error("Failed to load font");
     }
 
-    // keep atlas texture ID
-    fontTexture = atlas->texture;
+    // keep the atlas; its texture changes when it grows
+    fontAtlas = atlas;
     setupGL();
 }
 
+GLuint UIRenderer::atlasTexture() const
+{
+    return fontAtlas->texture;
+}
+
+std::size_t UIRenderer::atlasBytes() const
+{
+    return std::size_t(fontAtlas->width) * std::size_t(fontAtlas->height);
+}
+
+bool UIRenderer::takeAtlasChanged()
+{
+    bool changed = fontAtlas->changed;
+    fontAtlas->changed = false;
+    return changed;
+}
+
 UIRenderer::~UIRenderer()
 {
     // cleanup fontstash
     if (fontContext) fonsDeleteInternal(fontContext);
     glDeleteVertexArrays(1, &vao);
-    glDeleteBuffers(1, &vbo);
 }
 
-// Setup VAO and VBO 
+// Setup VAO (the vertex buffer is bound in drawVertices())
 void UIRenderer::setupGL()
 {
     glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
     glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
     
     // The vertex layout = position(2) + texcoord(2) + color(4) = 8 floats per vertex
-    constexpr int V = 8 * sizeof(float);
 
     // position
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, V, (void*)0);
+    glVertexAttribFormat(0, 2, GL_FLOAT, GL_FALSE, 0);
+    glVertexAttribBinding(0, 0);
     glEnableVertexAttribArray(0);
     
     // texture coordinates
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, V, (void*)(2 * sizeof(float)));
+    glVertexAttribFormat(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float));
+    glVertexAttribBinding(1, 0);
     glEnableVertexAttribArray(1);
     
     // color
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, V, (void*)(4 * sizeof(float)));
+    glVertexAttribFormat(2, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float));
+    glVertexAttribBinding(2, 0);
     glEnableVertexAttribArray(2);
     
     glBindVertexArray(0);
@@ -313,6 +367,20 @@ void UIRenderer::pushGlyphQuad(FONSquad const& quad, Vec4f color)
     textVertices.insert(textVertices.end(), std::begin(verts), std::end(verts));
 }
 
+// Copy vertices to the streaming buffer and draw them (VAO bound)
+void UIRenderer::drawVertices(std::vector<float> const& vertices)
+{
+    std::size_t bytes = vertices.size() * sizeof(float);
+    StreamingAllocation alloc = stream.allocate(bytes);
+    if (!alloc)
+        return; // counted as an overflow in the stream's stats
+
+    std::memcpy(alloc.data, vertices.data(), bytes);
+    stream.commit(alloc);
+
+    glBindVertexBuffer(0, stream.buffer(), alloc.offset, 8 * sizeof(float));
+    glDrawArrays(GL_TRIANGLES, 0, GLsizei(vertices.size() / 8));
+}
 
 // Finish frame and render everything
 void UIRenderer::endFrame()
@@ -347,25 +415,16 @@ void UIRenderer::endFrame()
 if (!quadVertices.empty())
     {
         glUniform1i(2, 0);  // disables texture sampling
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, quadVertices.size() * sizeof(float), quadVertices.data(), GL_STREAM_DRAW);
-        
-        int quadVertexCount = quadVertices.size() / 8;
-        glDrawArrays(GL_TRIANGLES, 0, quadVertexCount);
+        drawVertices(quadVertices);
     }  
 
     // Render textured quads
      if (!textVertices.empty())
     {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, fontTexture);
-        glUniform1i(1, 0);  // texture unit 0
+        bind_texture(TextureUnit::font, GL_TEXTURE_2D, fontAtlas->texture);
+        glUniform1i(1, texture_unit_index(TextureUnit::font));
         glUniform1i(2, 1);  // texture sampler
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, textVertices.size() * sizeof(float), textVertices.data(), GL_STREAM_DRAW);
-        
-        int textVertexCount = textVertices.size() / 8;
-        glDrawArrays(GL_TRIANGLES, 0, textVertexCount);
+        drawVertices(textVertices);
     }
     
     glBindVertexArray(0);
@@ -4,6 +4,7 @@
 #include <glad/glad.h>
 #include <string>
 #include <vector>
+#include <cstddef>
 #include <fontstash.h>
 
 #include "../vmlib/vec2.hpp"
@@ -11,6 +12,9 @@
 #include "../vmlib/mat44.hpp"
 #include "../support/program.hpp"
 
+class StreamingBuffer;
+struct UIFONSc;
+
 // Button state
 enum class ButtonState
 {
@@ -35,7 +39,8 @@ struct Button
 class UIRenderer
 {
 public:
-    UIRenderer(int windowWidth, int windowHeight, ShaderProgram& shader);
+    // Vertices are written to the streaming buffer each frame
+    UIRenderer(int windowWidth, int windowHeight, ShaderProgram& shader, StreamingBuffer& stream);
     ~UIRenderer();
     
     void setWindowSize(int width, int height);
@@ -44,10 +49,21 @@ public:
     bool renderButton(Button& button, double mouseX, double mouseY, bool mouseDown);
     void endFrame();
 
+    // Font atlas (single channel); for memory accounting. It starts at
+    // kAtlasSize and grows when fontstash runs out of space.
+    GLuint atlasTexture() const;
+    std::size_t atlasBytes() const;
+
+    // True once after the atlas texture was created or resized
+    bool takeAtlasChanged();
+
 private:
+    static constexpr int kAtlasSize = 512;
+
     void setupGL();
     void PQuad(float x, float y, float w, float h, Vec4f color); // colored quad
     void pushGlyphQuad(FONSquad const& quad, Vec4f color);
+    void drawVertices(std::vector<float> const& vertices); // GL_TRIANGLES
     int screenWidth = 0;
     int screenHeight = 0;
     
@@ -55,9 +71,9 @@ private:
     int font =-1; // Font handle
     
     ShaderProgram& uiShader;
+    StreamingBuffer& stream;
     GLuint vao=0;
-    GLuint vbo=0;
-    GLuint fontTexture=0;
+    UIFONSc* fontAtlas = nullptr; // owned by the fontstash context
     
     std::vector<float> quadVertices;  // Solid quads (backgrounds, outlines)
     std::vector<float> textVertices;  // Text quads
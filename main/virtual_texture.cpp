@@ -0,0 +1,546 @@
+#include "virtual_texture.hpp"
+
+#include <cmath>
+#include <mutex>
+#include <print>
+#include <deque>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <system_error>
+
+#include <cassert>
+
+#include "../support/error.hpp"
+#include "../support/mapped_file.hpp"
+#include "../support/thread_pool.hpp"
+
+#include "mipmap.hpp"
+#include "texture.hpp"
+#include "texture_units.hpp"
+#include "texture_compress.hpp"
+
+namespace
+{
+    // Bump when the page file contents change
+    constexpr char kPageFileWriter[] = "COMP3811 virtual texture 1";
+
+    // Stored pages are 136x136 texels, a multiple of the block size
+    constexpr std::uint32_t kPageSize = 128;
+    constexpr std::uint32_t kBorder = 4;
+
+    // Up to 32x32 pages in the physical cache (4352x4352 texels; 9 MiB with
+    // BC1, 18 MiB with BC7)
+    constexpr std::uint32_t kMaxSlotsPerSide = 32;
+
+    // The feedback buffer has 1/8th of the framebuffer's width and height
+    constexpr GLsizei kFeedbackDivisor = 8;
+    constexpr std::size_t kReadbackCount = 3;
+
+    // Limits per frame, to keep the GL thread responsive
+    constexpr std::size_t kMaxLoadsInFlight = 32;
+    constexpr std::size_t kMaxUploadsPerFrame = 16;
+
+    // Shader limits: uVtRows has 16 entries, feedback stores 12 bits per
+    // page coordinate.
+    constexpr std::uint32_t kMaxLevels = 16;
+    constexpr std::uint32_t kMaxPagesPerSide = 4096;
+
+    // Feedback value for texels without terrain
+    constexpr std::uint32_t kNoPage = ~std::uint32_t(0);
+
+    // Uniform locations (see default.frag and vt_feedback.frag)
+    constexpr GLint kPageTableLocation = 20;
+    constexpr GLint kPhysicalLocation = 21;
+    constexpr GLint kSizeLocation = 22;
+    constexpr GLint kCacheLocation = 23;
+    constexpr GLint kRowsLocation = 24;
+
+    struct LoadedPage_
+    {
+        std::size_t page;
+        std::vector<std::uint8_t> data;
+    };
+}
+
+struct VirtualTexture::Shared
+{
+    std::filesystem::path path;
+    MappedFile file; // set by open_() before any load is started
+
+    std::mutex mutex;
+    bool built = false; // page file written, not opened yet
+    std::exception_ptr error;
+    std::deque<LoadedPage_> loaded;
+};
+
+VirtualTexture::VirtualTexture( char const* aSourcePath, ThreadPool& aPool )
+    : mPool( aPool )
+    , mShared( std::make_shared<Shared>() )
+    , mFeedbackProgram( {
+        { GL_VERTEX_SHADER, "assets/cw2/vt_feedback.vert" },
+        { GL_FRAGMENT_SHADER, "assets/cw2/vt_feedback.frag" }
+    } )
+{
+    mShared->path = texture_cache_path( aSourcePath, ".vtpages" );
+
+    if( texture_cache_fresh( aSourcePath, mShared->path ) )
+    {
+        try
+        {
+            if( open_() )
+                return;
+        }
+        catch( Error const& eErr )
+        {
+            std::print( stderr, "Warning: ignoring page file: {}\n", eErr.what() );
+        }
+    }
+
+    // Build the page file in the background. The image and its mip chain
+    // are held in memory while doing so.
+    bool const allowBc1 = bc1_texture_supported();
+    aPool.enqueue( [shared = mShared, source = std::string(aSourcePath), allowBc1, &pool = aPool] {
+        try
+        {
+            auto const startTime = std::chrono::steady_clock::now();
+
+            auto const base = load_rgba_image( source.c_str() );
+            BlockFormat const format = (!allowBc1 || has_alpha( base )) ? BlockFormat::bc7 : BlockFormat::bc1;
+            auto const layout = make_vt_layout( base.width, base.height, kPageSize, kBorder, format );
+            if( layout.levelCount > kMaxLevels || layout.pages_x( 0 ) > kMaxPagesPerSide || layout.pages_y( 0 ) > kMaxPagesPerSide )
+                throw Error( "Image ’{}’ is too large for a virtual texture ({}x{})", source, base.width, base.height );
+
+            auto const mips = build_srgb_mip_chain( base, pool );
+
+            std::error_code ec;
+            std::filesystem::create_directories( shared->path.parent_path(), ec );
+            if( ec || !write_vt_pagefile( shared->path.string().c_str(), layout, mips, pool, kPageFileWriter ) )
+                throw Error( "Unable to write page file ’{}’", shared->path.string() );
+
+            auto const ms = std::chrono::duration<double,std::milli>( std::chrono::steady_clock::now() - startTime ).count();
+            std::print( "Built virtual texture ’{}’ ({}x{}, {} pages) in {:.0f} ms\n", source, base.width, base.height, layout.page_count(), ms );
+
+            std::lock_guard lock( shared->mutex );
+            shared->built = true;
+        }
+        catch( ... )
+        {
+            std::lock_guard lock( shared->mutex );
+            shared->error = std::current_exception();
+        }
+    } );
+}
+
+VirtualTexture::~VirtualTexture()
+{
+    for( auto& readback : mReadbacks )
+    {
+        if( readback.fence )
+            glDeleteSync( readback.fence );
+        glDeleteBuffers( 1, &readback.buffer );
+    }
+
+    if( mFeedbackFbo )
+    {
+        glDeleteFramebuffers( 1, &mFeedbackFbo );
+        glDeleteRenderbuffers( 1, &mFeedbackColor );
+        glDeleteRenderbuffers( 1, &mFeedbackDepth );
+    }
+
+    if( mPhysical )
+    {
+        glDeleteTextures( 1, &mPhysical );
+        glDeleteTextures( 1, &mPageTable );
+        reset_texture_bindings();
+    }
+}
+
+bool VirtualTexture::ready() const noexcept
+{
+    return nullptr != mCache;
+}
+
+void VirtualTexture::update()
+{
+    if( !ready() )
+    {
+        {
+            std::lock_guard lock( mShared->mutex );
+            if( auto error = std::exchange( mShared->error, nullptr ) )
+                std::rethrow_exception( error );
+
+            if( !std::exchange( mShared->built, false ) )
+                return;
+        }
+
+        if( !open_() )
+            throw Error( "Unable to open page file ’{}’", mShared->path.string() );
+    }
+
+    // Completed feedback, oldest first. Readbacks that are not done yet are
+    // left for a later frame.
+    for( std::size_t i = 0; i < mReadbacks.size(); ++i )
+    {
+        auto& readback = mReadbacks[(mNextReadback + i) % mReadbacks.size()];
+        if( !readback.fence )
+            continue;
+
+        GLenum const status = glClientWaitSync( readback.fence, 0, 0 );
+        if( GL_ALREADY_SIGNALED != status && GL_CONDITION_SATISFIED != status )
+            continue;
+
+        glDeleteSync( readback.fence );
+        readback.fence = nullptr;
+
+        std::size_t const count = std::size_t(readback.width) * readback.height;
+        std::vector<std::uint32_t> values;
+
+        glBindBuffer( GL_PIXEL_PACK_BUFFER, readback.buffer );
+        if( auto const* ptr = static_cast<std::uint32_t const*>(glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(count * sizeof(std::uint32_t)), GL_MAP_READ_BIT )) )
+        {
+            values.assign( ptr, ptr + count );
+            glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+        }
+        glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+        consume_feedback_( values );
+    }
+
+    // Upload pages loaded by the workers
+    std::vector<LoadedPage_> loaded;
+    {
+        std::lock_guard lock( mShared->mutex );
+        while( !mShared->loaded.empty() && loaded.size() < kMaxUploadsPerFrame )
+        {
+            loaded.emplace_back( std::move(mShared->loaded.front()) );
+            mShared->loaded.pop_front();
+        }
+    }
+
+    for( auto const& page : loaded )
+    {
+        assert( mRequested[page.page] && mPendingLoads > 0 );
+        mRequested[page.page] = false;
+        --mPendingLoads;
+
+        // Dropped if all slots are in use; it's requested again if it is
+        // still visible.
+        upload_page_( page.page, page.data.data(), false );
+    }
+
+    update_page_table_();
+    ++mFrame;
+}
+
+void VirtualTexture::begin_feedback( GLsizei aFramebufferWidth, GLsizei aFramebufferHeight )
+{
+    if( !ready() )
+        return;
+
+    mFramebufferWidth = aFramebufferWidth;
+    mFramebufferHeight = aFramebufferHeight;
+
+    GLsizei const width = std::max( aFramebufferWidth / kFeedbackDivisor, 1 );
+    GLsizei const height = std::max( aFramebufferHeight / kFeedbackDivisor, 1 );
+    if( width != mFeedbackWidth || height != mFeedbackHeight )
+        resize_feedback_( width, height );
+
+    GLuint const noPage[4] = { kNoPage, kNoPage, kNoPage, kNoPage };
+    GLfloat const farDepth = 1.f;
+
+    glBindFramebuffer( GL_FRAMEBUFFER, mFeedbackFbo );
+    glClearBufferuiv( GL_COLOR, 0, noPage );
+    glClearBufferfv( GL_DEPTH, 0, &farDepth );
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+}
+
+void VirtualTexture::draw_feedback( Mat44f const& aMvp, GLuint aVao, GLsizei aVertexCount )
+{
+    if( !ready() || 0 == mFeedbackWidth )
+        return;
+
+    GLint viewport[4];
+    glGetIntegerv( GL_VIEWPORT, viewport );
+
+    // Same part of the feedback buffer as of the framebuffer
+    auto const scaleX = [&] ( GLint aX ) { return GLint(std::int64_t(aX) * mFeedbackWidth / mFramebufferWidth); };
+    auto const scaleY = [&] ( GLint aY ) { return GLint(std::int64_t(aY) * mFeedbackHeight / mFramebufferHeight); };
+
+    GLint const x0 = scaleX( viewport[0] ), x1 = scaleX( viewport[0] + viewport[2] );
+    GLint const y0 = scaleY( viewport[1] ), y1 = scaleY( viewport[1] + viewport[3] );
+
+    glBindFramebuffer( GL_FRAMEBUFFER, mFeedbackFbo );
+    glViewport( x0, y0, std::max( x1 - x0, 1 ), std::max( y1 - y0, 1 ) );
+
+    glUseProgram( mFeedbackProgram.programId() );
+    glUniformMatrix4fv( 0, 1, GL_TRUE, aMvp.v );
+
+    // Derivatives are kFeedbackDivisor times larger than at full resolution
+    set_uniforms_( std::log2( float(mFeedbackWidth) / float(mFramebufferWidth) ) );
+
+    glBindVertexArray( aVao );
+    glDrawArrays( GL_TRIANGLES, 0, aVertexCount );
+    glBindVertexArray( 0 );
+
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+    glViewport( viewport[0], viewport[1], viewport[2], viewport[3] );
+}
+
+void VirtualTexture::end_feedback()
+{
+    if( !ready() || 0 == mFeedbackWidth )
+        return;
+
+    // If the oldest readback is still in flight, this frame's feedback is
+    // skipped rather than waiting for it.
+    auto& readback = mReadbacks[mNextReadback];
+    if( readback.fence )
+        return;
+
+    std::size_t const bytes = std::size_t(mFeedbackWidth) * mFeedbackHeight * sizeof(std::uint32_t);
+
+    glBindBuffer( GL_PIXEL_PACK_BUFFER, readback.buffer );
+    if( readback.capacity < bytes )
+    {
+        glBufferData( GL_PIXEL_PACK_BUFFER, GLsizeiptr(bytes), nullptr, GL_STREAM_READ );
+        readback.capacity = bytes;
+    }
+
+    glBindFramebuffer( GL_READ_FRAMEBUFFER, mFeedbackFbo );
+    glReadPixels( 0, 0, mFeedbackWidth, mFeedbackHeight, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr );
+    glBindFramebuffer( GL_READ_FRAMEBUFFER, 0 );
+    glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+    readback.fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+    readback.width = mFeedbackWidth;
+    readback.height = mFeedbackHeight;
+
+    mNextReadback = (mNextReadback + 1) % mReadbacks.size();
+}
+
+void VirtualTexture::bind_for_sampling() const
+{
+    assert( ready() );
+
+    bind_texture( TextureUnit::vtPageTable, GL_TEXTURE_2D, mPageTable );
+    bind_texture( TextureUnit::vtPhysical, GL_TEXTURE_2D, mPhysical );
+
+    glUniform1i( kPageTableLocation, texture_unit_index( TextureUnit::vtPageTable ) );
+    glUniform1i( kPhysicalLocation, texture_unit_index( TextureUnit::vtPhysical ) );
+    set_uniforms_( 0.f );
+    glUniform1iv( kRowsLocation, GLsizei(mRowOffsets.size()), mRowOffsets.data() );
+}
+
+GLuint VirtualTexture::physical_texture() const noexcept
+{
+    return mPhysical;
+}
+
+VirtualTextureStats VirtualTexture::stats() const noexcept
+{
+    VirtualTextureStats ret;
+    if( !ready() )
+        return ret;
+
+    ret.ready = true;
+    ret.pages = mLayout.page_count();
+    ret.residentPages = mCache->resident_count();
+    ret.cacheSlots = std::size_t(mCache->slots_x()) * mCache->slots_y();
+    ret.visiblePages = mVisiblePages;
+    ret.pendingLoads = mPendingLoads;
+    ret.uploads = mUploads;
+    ret.evictions = mCache->eviction_count();
+
+    std::uint32_t const stored = mLayout.stored_page_size();
+    ret.gpuBytes = compressed_size( mLayout.format, mCache->slots_x() * stored, mCache->slots_y() * stored );
+    ret.gpuBytes += mCache->page_table().size() * sizeof(VtPageTableEntry);
+    ret.gpuBytes += std::size_t(mFeedbackWidth) * mFeedbackHeight * 8; // R32UI + depth
+    for( auto const& readback : mReadbacks )
+        ret.gpuBytes += readback.capacity;
+
+    return ret;
+}
+
+bool VirtualTexture::open_()
+{
+    MappedFile file( mShared->path.string().c_str() );
+    auto const layout = parse_vt_pagefile( file.bytes(), kPageFileWriter );
+    if( !layout || layout->levelCount > kMaxLevels || layout->pages_x( 0 ) > kMaxPagesPerSide || layout->pages_y( 0 ) > kMaxPagesPerSide )
+        return false;
+    if( BlockFormat::bc1 == layout->format && !bc1_texture_supported() )
+        return false;
+
+    mLayout = *layout;
+    mShared->file = std::move(file);
+
+    // Small textures get a smaller cache
+    auto const side = std::min( kMaxSlotsPerSide, std::uint32_t(std::ceil( std::sqrt( double(mLayout.page_count()) ) )) );
+    mCache = std::make_unique<VtCache>( mLayout, side, side );
+    mRequested.assign( mLayout.page_count(), false );
+
+    mRowOffsets.clear();
+    for( std::uint32_t level = 0; level < mLayout.levelCount; ++level )
+        mRowOffsets.push_back( GLint(mCache->row_offset( level )) );
+
+    // Physical cache: one level, filtering stays inside the page borders
+    GLsizei const physicalSize = GLsizei(side * mLayout.stored_page_size());
+
+    glGenTextures( 1, &mPhysical );
+    glBindTexture( GL_TEXTURE_2D, mPhysical );
+    glTexStorage2D( GL_TEXTURE_2D, 1, compressed_texture_format( mLayout.format ), physicalSize, physicalSize );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+    // Page table, read with texelFetch()
+    glGenTextures( 1, &mPageTable );
+    glBindTexture( GL_TEXTURE_2D, mPageTable );
+    glTexStorage2D( GL_TEXTURE_2D, 1, GL_RGBA8UI, GLsizei(mCache->page_table_columns()), GLsizei(mCache->page_table_rows()) );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+
+    mReadbacks.resize( kReadbackCount );
+    for( auto& readback : mReadbacks )
+        glGenBuffers( 1, &readback.buffer );
+
+    // The coarsest level is a single page; it stays resident
+    std::size_t const root = mLayout.page_count() - 1;
+    bool const uploaded = upload_page_( root, vt_page_data( mShared->file.bytes(), mLayout, root ).data(), true );
+    assert( uploaded );
+    (void)uploaded;
+
+    update_page_table_();
+    return true;
+}
+
+void VirtualTexture::resize_feedback_( GLsizei aWidth, GLsizei aHeight )
+{
+    if( !mFeedbackFbo )
+    {
+        glGenFramebuffers( 1, &mFeedbackFbo );
+        glGenRenderbuffers( 1, &mFeedbackColor );
+        glGenRenderbuffers( 1, &mFeedbackDepth );
+    }
+
+    glBindRenderbuffer( GL_RENDERBUFFER, mFeedbackColor );
+    glRenderbufferStorage( GL_RENDERBUFFER, GL_R32UI, aWidth, aHeight );
+    glBindRenderbuffer( GL_RENDERBUFFER, mFeedbackDepth );
+    glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, aWidth, aHeight );
+    glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+
+    glBindFramebuffer( GL_FRAMEBUFFER, mFeedbackFbo );
+    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mFeedbackColor );
+    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mFeedbackDepth );
+
+    GLenum const status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+    if( GL_FRAMEBUFFER_COMPLETE != status )
+        throw Error( "Virtual texture feedback framebuffer is incomplete ({:#x})", status );
+
+    mFeedbackWidth = aWidth;
+    mFeedbackHeight = aHeight;
+}
+
+void VirtualTexture::consume_feedback_( std::vector<std::uint32_t>& aValues )
+{
+    std::sort( aValues.begin(), aValues.end() );
+    aValues.erase( std::unique( aValues.begin(), aValues.end() ), aValues.end() );
+
+    // Missing pages and their missing ancestors, as (level, page)
+    std::vector<std::pair<std::uint32_t,std::size_t>> missing;
+
+    mVisiblePages = 0;
+    for( auto const value : aValues )
+    {
+        if( kNoPage == value )
+            continue;
+
+        std::uint32_t const level = value >> 24;
+        std::uint32_t x = value & 0xfff;
+        std::uint32_t y = (value >> 12) & 0xfff;
+        if( level >= mLayout.levelCount || x >= mLayout.pages_x( level ) || y >= mLayout.pages_y( level ) )
+            continue;
+
+        ++mVisiblePages;
+        mCache->touch( level, x, y, mFrame );
+
+        for( std::uint32_t l = level; l < mLayout.levelCount; ++l )
+        {
+            std::size_t const page = mLayout.page_index( l, x, y );
+            if( !mCache->resident( page ) && !mRequested[page] )
+                missing.emplace_back( l, page );
+
+            if( l + 1 < mLayout.levelCount )
+            {
+                x = std::min( x / 2, mLayout.pages_x( l + 1 ) - 1 );
+                y = std::min( y / 2, mLayout.pages_y( l + 1 ) - 1 );
+            }
+        }
+    }
+
+    // Coarse pages first: they cover more of the screen, and finer pages
+    // fall back to them until loaded.
+    std::sort( missing.begin(), missing.end(), [] ( auto const& aA, auto const& aB ) {
+        return aA.first != aB.first ? aA.first > aB.first : aA.second < aB.second;
+    } );
+    missing.erase( std::unique( missing.begin(), missing.end() ), missing.end() );
+
+    for( auto const& [level, page] : missing )
+    {
+        if( mPendingLoads >= kMaxLoadsInFlight )
+            break;
+
+        mRequested[page] = true;
+        ++mPendingLoads;
+
+        // Reading the page may fault it in from disk, so this happens on a
+        // worker rather than the GL thread.
+        mPool.enqueue( [shared = mShared, layout = mLayout, page] {
+            auto const data = vt_page_data( shared->file.bytes(), layout, page );
+            LoadedPage_ loaded{ page, std::vector<std::uint8_t>( data.begin(), data.end() ) };
+
+            std::lock_guard lock( shared->mutex );
+            shared->loaded.emplace_back( std::move(loaded) );
+        } );
+    }
+}
+
+bool VirtualTexture::upload_page_( std::size_t aPage, std::uint8_t const* aData, bool aPinned )
+{
+    auto const slot = mCache->insert( aPage, mFrame, aPinned );
+    if( !slot )
+        return false;
+
+    std::uint32_t const stored = mLayout.stored_page_size();
+    GLint const x = GLint(*slot % mCache->slots_x() * stored);
+    GLint const y = GLint(*slot / mCache->slots_x() * stored);
+
+    glBindTexture( GL_TEXTURE_2D, mPhysical );
+    glCompressedTexSubImage2D( GL_TEXTURE_2D, 0, x, y, GLsizei(stored), GLsizei(stored), compressed_texture_format( mLayout.format ), GLsizei(mLayout.page_bytes()), aData );
+
+    ++mUploads;
+    return true;
+}
+
+void VirtualTexture::update_page_table_()
+{
+    if( !mCache->update_page_table() )
+        return;
+
+    glBindTexture( GL_TEXTURE_2D, mPageTable );
+    glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, GLsizei(mCache->page_table_columns()), GLsizei(mCache->page_table_rows()), GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, mCache->page_table().data() );
+}
+
+void VirtualTexture::set_uniforms_( float aLodBias ) const
+{
+    float const physicalSize = float(mCache->slots_x() * mLayout.stored_page_size());
+
+    glUniform4f( kSizeLocation, float(mLayout.width), float(mLayout.height), float(mLayout.pageSize), float(mLayout.border) );
+    glUniform4f( kCacheLocation, physicalSize, float(mLayout.stored_page_size()), float(mLayout.levelCount - 1), aLodBias );
+}
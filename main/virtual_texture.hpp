@@ -0,0 +1,146 @@
+#ifndef VIRTUAL_TEXTURE_HPP_5B2E8F14_7C39_4A60_9D8E_0F6A3C15B7D2
+#define VIRTUAL_TEXTURE_HPP_5B2E8F14_7C39_4A60_9D8E_0F6A3C15B7D2
+
+#include <glad/glad.h>
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "../vmlib/mat44.hpp"
+#include "../support/program.hpp"
+
+#include "vt_cache.hpp"
+#include "vt_pagefile.hpp"
+
+class ThreadPool;
+
+// Virtual texture for large terrain images.
+//
+// The source image is split into pages once and stored in a page file next to
+// the other texture caches (see vt_pagefile.hpp). Only the pages that are
+// visible are kept on the GPU, in a fixed-size physical cache texture; a page
+// table tells the terrain shader where each page is (see vt_cache.hpp and
+// sampleVirtual() in default.frag). GPU memory is therefore bounded by the
+// cache size, independently of the size of the source image.
+//
+// Visible pages are found with a feedback pass: the terrain is drawn at a
+// reduced resolution with a shader that writes the page it would sample.
+// The result is read back through a ring of pixel buffers and only consumed
+// once its fence has signalled, so the GL thread never waits for it. Missing
+// pages are read from the memory mapped page file by tasks on a thread pool
+// and uploaded by update(), a limited number per frame, replacing the least
+// recently used pages. The coarsest level is always resident, so there is
+// always something to sample.
+//
+// If the page file is missing or older than the source image, it is built in
+// the background; ready() returns false until then.
+//
+// Use from the GL thread only.
+
+struct VirtualTextureStats
+{
+    bool ready = false;
+    std::size_t pages = 0;          // pages in the page file
+    std::size_t residentPages = 0;
+    std::size_t cacheSlots = 0;
+    std::size_t visiblePages = 0;   // in the latest feedback
+    std::size_t pendingLoads = 0;
+    std::size_t gpuBytes = 0;       // physical cache, page table and feedback
+
+    // Totals since creation
+    std::size_t uploads = 0;
+    std::size_t evictions = 0;
+};
+
+class VirtualTexture final
+{
+    public:
+        VirtualTexture( char const* aSourcePath, ThreadPool& );
+
+        // Loads that are still running finish in the background; their
+        // results are dropped.
+        ~VirtualTexture();
+
+        VirtualTexture( VirtualTexture const& ) = delete;
+        VirtualTexture& operator= (VirtualTexture const&) = delete;
+
+    public:
+        bool ready() const noexcept;
+
+        // Call once per frame. Consumes completed feedback, starts loads for
+        // missing pages, uploads loaded pages and updates the page table.
+        // Rethrows Error if building the page file failed.
+        void update();
+
+        // Feedback pass. begin_feedback() clears the feedback buffer for a
+        // framebuffer of the given size; draw_feedback() draws geometry with
+        // the terrain's texture coordinates into it, using the current
+        // viewport (so split screen views end up side by side);
+        // end_feedback() starts the readback. They leave the default
+        // framebuffer and the viewport bound, but not the program. No-ops
+        // unless ready().
+        void begin_feedback( GLsizei aFramebufferWidth, GLsizei aFramebufferHeight );
+        void draw_feedback( Mat44f const& aMvp, GLuint aVao, GLsizei aVertexCount );
+        void end_feedback();
+
+        // Binds the textures and sets the virtual texture uniforms of
+        // default.frag, which must be the current program. Requires ready().
+        void bind_for_sampling() const;
+
+        // For tracking in the TextureRegistry (0 unless ready())
+        GLuint physical_texture() const noexcept;
+
+        VirtualTextureStats stats() const noexcept;
+
+    private:
+        struct Shared;
+        struct Readback
+        {
+            GLuint buffer = 0;
+            GLsync fence = nullptr;
+            GLsizei width = 0, height = 0;
+            std::size_t capacity = 0; // bytes allocated in buffer
+        };
+
+        // Returns false if the page file is outdated or unusable
+        bool open_();
+
+        void resize_feedback_( GLsizei aWidth, GLsizei aHeight );
+        void consume_feedback_( std::vector<std::uint32_t>& aValues );
+
+        // Returns false if no slot is available
+        bool upload_page_( std::size_t aPage, std::uint8_t const* aData, bool aPinned );
+        void update_page_table_();
+
+        // uVtSize and uVtCache
+        void set_uniforms_( float aLodBias ) const;
+
+    private:
+        ThreadPool& mPool;
+        std::shared_ptr<Shared> mShared;
+
+        VtLayout mLayout{};
+        std::unique_ptr<VtCache> mCache;
+        std::vector<bool> mRequested; // per page: load started, not uploaded yet
+        std::uint64_t mFrame = 1;
+
+        ShaderProgram mFeedbackProgram;
+
+        GLuint mPhysical = 0, mPageTable = 0;
+        GLuint mFeedbackFbo = 0, mFeedbackColor = 0, mFeedbackDepth = 0;
+        GLsizei mFeedbackWidth = 0, mFeedbackHeight = 0;
+        GLsizei mFramebufferWidth = 0, mFramebufferHeight = 0;
+
+        std::vector<Readback> mReadbacks;
+        std::size_t mNextReadback = 0;
+
+        std::vector<GLint> mRowOffsets; // per level, for uVtRows
+
+        std::size_t mPendingLoads = 0;
+        std::size_t mVisiblePages = 0;
+        std::size_t mUploads = 0;
+};
+
+#endif // VIRTUAL_TEXTURE_HPP_5B2E8F14_7C39_4A60_9D8E_0F6A3C15B7D2
@@ -0,0 +1,179 @@
+#include "vt_cache.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+VtCache::VtCache( VtLayout const& aLayout, std::uint32_t aSlotsX, std::uint32_t aSlotsY )
+    : mLayout( aLayout )
+    , mSlotsX( aSlotsX )
+    , mSlotsY( aSlotsY )
+    , mPageSlot( aLayout.page_count(), kNoSlot )
+    , mPageLastUsed( aLayout.page_count(), 0 )
+{
+    assert( aSlotsX > 0 && aSlotsX <= 256 );
+    assert( aSlotsY > 0 && aSlotsY <= 256 );
+    mSlots.reserve( std::size_t(aSlotsX) * aSlotsY );
+
+    std::uint32_t rows = 0;
+    for( std::uint32_t level = 0; level < aLayout.levelCount; ++level )
+    {
+        mRowOffsets.push_back( rows );
+        rows += aLayout.pages_y( level );
+    }
+
+    mTable.resize( std::size_t(page_table_columns()) * rows );
+}
+
+void VtCache::touch( std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aY, std::uint64_t aFrame )
+{
+    for( std::uint32_t level = aLevel; level < mLayout.levelCount; ++level )
+    {
+        auto& lastUsed = mPageLastUsed[mLayout.page_index( level, aX, aY )];
+        lastUsed = std::max( lastUsed, aFrame );
+
+        if( level + 1 < mLayout.levelCount )
+        {
+            aX = std::min( aX / 2, mLayout.pages_x( level + 1 ) - 1 );
+            aY = std::min( aY / 2, mLayout.pages_y( level + 1 ) - 1 );
+        }
+    }
+}
+
+bool VtCache::resident( std::size_t aPage ) const noexcept
+{
+    assert( aPage < mPageSlot.size() );
+    return kNoSlot != mPageSlot[aPage];
+}
+
+std::uint64_t VtCache::last_used( std::size_t aPage ) const noexcept
+{
+    assert( aPage < mPageLastUsed.size() );
+    return mPageLastUsed[aPage];
+}
+
+std::optional<std::uint32_t> VtCache::insert( std::size_t aPage, std::uint64_t aFrame, bool aPinned )
+{
+    assert( !resident( aPage ) );
+
+    std::uint32_t slot = kNoSlot;
+    if( mSlots.size() < std::size_t(mSlotsX) * mSlotsY )
+    {
+        slot = std::uint32_t(mSlots.size());
+        mSlots.push_back( Slot_{ aPage, aPinned } );
+    }
+    else
+    {
+        // Replace the least recently used page
+        std::uint64_t oldest = aFrame;
+        for( std::uint32_t i = 0; i < mSlots.size(); ++i )
+        {
+            if( mSlots[i].pinned )
+                continue;
+
+            std::uint64_t const lastUsed = mPageLastUsed[mSlots[i].page];
+            if( lastUsed < oldest )
+            {
+                oldest = lastUsed;
+                slot = i;
+            }
+        }
+
+        if( kNoSlot == slot )
+            return std::nullopt;
+
+        mPageSlot[mSlots[slot].page] = kNoSlot;
+        mSlots[slot] = Slot_{ aPage, aPinned };
+        ++mEvictions;
+    }
+
+    mPageSlot[aPage] = slot;
+    mPageLastUsed[aPage] = std::max( mPageLastUsed[aPage], aFrame );
+    mDirty = true;
+
+    return slot;
+}
+
+std::uint32_t VtCache::slots_x() const noexcept
+{
+    return mSlotsX;
+}
+std::uint32_t VtCache::slots_y() const noexcept
+{
+    return mSlotsY;
+}
+
+std::size_t VtCache::resident_count() const noexcept
+{
+    return mSlots.size();
+}
+std::size_t VtCache::eviction_count() const noexcept
+{
+    return mEvictions;
+}
+
+bool VtCache::update_page_table()
+{
+    if( !mDirty )
+        return false;
+
+    std::uint32_t const columns = page_table_columns();
+
+    // Coarsest level first, so that each level can copy the entries of the
+    // parents of its missing pages.
+    for( std::uint32_t level = mLayout.levelCount; level-- > 0; )
+    {
+        std::uint32_t const px = mLayout.pages_x( level );
+        std::uint32_t const py = mLayout.pages_y( level );
+        bool const hasParent = level + 1 < mLayout.levelCount;
+        std::size_t const firstPage = mLayout.page_index( level, 0, 0 );
+
+        for( std::uint32_t y = 0; y < py; ++y )
+        {
+            for( std::uint32_t x = 0; x < px; ++x )
+            {
+                auto& entry = mTable[std::size_t(mRowOffsets[level] + y) * columns + x];
+
+                std::uint32_t const slot = mPageSlot[firstPage + std::size_t(y) * px + x];
+                if( kNoSlot != slot )
+                {
+                    entry = VtPageTableEntry{ std::uint8_t(slot % mSlotsX), std::uint8_t(slot / mSlotsX), std::uint8_t(level), 0 };
+                }
+                else if( hasParent )
+                {
+                    std::uint32_t const parentX = std::min( x / 2, mLayout.pages_x( level + 1 ) - 1 );
+                    std::uint32_t const parentY = std::min( y / 2, mLayout.pages_y( level + 1 ) - 1 );
+                    entry = mTable[std::size_t(mRowOffsets[level+1] + parentY) * columns + parentX];
+                }
+                else
+                {
+                    // Nothing resident yet (the coarsest level should be pinned)
+                    entry = VtPageTableEntry{ 0, 0, std::uint8_t(level), 0 };
+                }
+            }
+        }
+    }
+
+    mDirty = false;
+    return true;
+}
+
+std::span<VtPageTableEntry const> VtCache::page_table() const noexcept
+{
+    return mTable;
+}
+
+std::uint32_t VtCache::page_table_columns() const noexcept
+{
+    return mLayout.pages_x( 0 );
+}
+std::uint32_t VtCache::page_table_rows() const noexcept
+{
+    return std::uint32_t(mTable.size() / page_table_columns());
+}
+
+std::uint32_t VtCache::row_offset( std::uint32_t aLevel ) const noexcept
+{
+    assert( aLevel < mRowOffsets.size() );
+    return mRowOffsets[aLevel];
+}
@@ -0,0 +1,89 @@
+#ifndef VT_CACHE_HPP_4E91B3D7_2A06_4F8C_95E1_C8B07D2A6F43
+#define VT_CACHE_HPP_4E91B3D7_2A06_4F8C_95E1_C8B07D2A6F43
+
+#include <span>
+#include <vector>
+#include <optional>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "vt_pagefile.hpp"
+
+// Bookkeeping for the physical page cache of a virtual texture.
+//
+// The cache has a fixed number of slots (each holds one page). Pages are
+// marked as used by the feedback pass; when a new page needs a slot and none
+// is free, the least recently used page is replaced. Pages used in the
+// current frame and pinned pages (the coarsest level, which is the fallback
+// for everything else) are never replaced.
+//
+// The page table maps every virtual page to a slot. Pages that are not
+// resident map to the slot of their nearest resident ancestor, so sampling
+// always finds data, just at a lower resolution. All levels are packed into
+// one table with pages_x(0) columns; level l starts at row row_offset(l).
+//
+// This file does not depend on OpenGL (it's tested in main-test).
+
+struct VtPageTableEntry
+{
+    std::uint8_t slotX = 0, slotY = 0;
+    std::uint8_t level = 0; // level of the page in the slot
+    std::uint8_t padding = 0;
+};
+
+class VtCache final
+{
+    public:
+        static constexpr std::uint32_t kNoSlot = ~std::uint32_t(0);
+
+        // At most 256x256 slots (slot coordinates are stored in 8 bits)
+        VtCache( VtLayout const&, std::uint32_t aSlotsX, std::uint32_t aSlotsY );
+
+    public:
+        // Marks the page and all its ancestors as used in aFrame
+        void touch( std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aY, std::uint64_t aFrame );
+
+        bool resident( std::size_t aPage ) const noexcept;
+        std::uint64_t last_used( std::size_t aPage ) const noexcept;
+
+        // Assigns a slot to aPage, which must not be resident. Returns
+        // std::nullopt if every slot is pinned or used in aFrame.
+        std::optional<std::uint32_t> insert( std::size_t aPage, std::uint64_t aFrame, bool aPinned = false );
+
+        std::uint32_t slots_x() const noexcept;
+        std::uint32_t slots_y() const noexcept;
+        std::size_t resident_count() const noexcept;
+        std::size_t eviction_count() const noexcept;
+
+    public:
+        // Rebuilds the table if pages were inserted since the last call.
+        // Returns true if it was rebuilt.
+        bool update_page_table();
+
+        std::span<VtPageTableEntry const> page_table() const noexcept;
+        std::uint32_t page_table_columns() const noexcept;
+        std::uint32_t page_table_rows() const noexcept;
+        std::uint32_t row_offset( std::uint32_t aLevel ) const noexcept;
+
+    private:
+        struct Slot_
+        {
+            std::size_t page;
+            bool pinned;
+        };
+
+        VtLayout mLayout;
+        std::uint32_t mSlotsX, mSlotsY;
+
+        std::vector<std::uint32_t> mPageSlot;      // per page; kNoSlot if not resident
+        std::vector<std::uint64_t> mPageLastUsed;  // per page
+        std::vector<Slot_> mSlots;                 // occupied slots, by slot index
+        std::size_t mEvictions = 0;
+
+        std::vector<std::uint32_t> mRowOffsets;
+        std::vector<VtPageTableEntry> mTable;
+        bool mDirty = true;
+};
+
+#endif // VT_CACHE_HPP_4E91B3D7_2A06_4F8C_95E1_C8B07D2A6F43
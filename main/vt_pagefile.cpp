@@ -0,0 +1,241 @@
+#include "vt_pagefile.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+#include <cassert>
+#include <cstring>
+
+#include "../support/thread_pool.hpp"
+
+namespace
+{
+    constexpr char kMagic[8] = { 'C', 'W', 'V', 'T', 'P', 'G', 'S', '1' };
+
+    // Header: magic, width, height, pageSize, border, levelCount, format,
+    // dataOffset, writer length, writer (padded)
+    constexpr std::size_t kWriterOffset = 40;
+    constexpr std::size_t kDataAlign = 16;
+
+    void put_u32_( std::vector<std::uint8_t>& aOut, std::size_t aOffset, std::uint32_t aValue )
+    {
+        for( int i = 0; i < 4; ++i )
+            aOut[aOffset+i] = std::uint8_t( aValue >> (8*i) );
+    }
+
+    std::uint32_t get_u32_( std::span<std::uint8_t const> aIn, std::size_t aOffset ) noexcept
+    {
+        std::uint32_t ret = 0;
+        for( int i = 0; i < 4; ++i )
+            ret |= std::uint32_t(aIn[aOffset+i]) << (8*i);
+        return ret;
+    }
+
+    std::size_t data_offset_( std::size_t aWriterLength ) noexcept
+    {
+        return (kWriterOffset + aWriterLength + kDataAlign - 1) / kDataAlign * kDataAlign;
+    }
+}
+
+std::uint32_t VtLayout::level_width( std::uint32_t aLevel ) const noexcept
+{
+    return std::max( width >> aLevel, 1u );
+}
+std::uint32_t VtLayout::level_height( std::uint32_t aLevel ) const noexcept
+{
+    return std::max( height >> aLevel, 1u );
+}
+
+std::uint32_t VtLayout::pages_x( std::uint32_t aLevel ) const noexcept
+{
+    return (level_width( aLevel ) + pageSize - 1) / pageSize;
+}
+std::uint32_t VtLayout::pages_y( std::uint32_t aLevel ) const noexcept
+{
+    return (level_height( aLevel ) + pageSize - 1) / pageSize;
+}
+
+std::uint32_t VtLayout::stored_page_size() const noexcept
+{
+    return pageSize + 2 * border;
+}
+std::size_t VtLayout::page_bytes() const noexcept
+{
+    return compressed_size( format, stored_page_size(), stored_page_size() );
+}
+
+std::size_t VtLayout::page_count() const noexcept
+{
+    std::size_t ret = 0;
+    for( std::uint32_t level = 0; level < levelCount; ++level )
+        ret += std::size_t(pages_x( level )) * pages_y( level );
+    return ret;
+}
+
+std::size_t VtLayout::page_index( std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aY ) const noexcept
+{
+    assert( aLevel < levelCount && aX < pages_x( aLevel ) && aY < pages_y( aLevel ) );
+
+    std::size_t ret = 0;
+    for( std::uint32_t level = 0; level < aLevel; ++level )
+        ret += std::size_t(pages_x( level )) * pages_y( level );
+    return ret + std::size_t(aY) * pages_x( aLevel ) + aX;
+}
+
+
+VtLayout make_vt_layout( std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aPageSize, std::uint32_t aBorder, BlockFormat aFormat )
+{
+    assert( aWidth > 0 && aHeight > 0 && aPageSize > 0 );
+    assert( 0 == (aPageSize + 2 * aBorder) % kBlockDim );
+
+    VtLayout ret;
+    ret.width = aWidth;
+    ret.height = aHeight;
+    ret.pageSize = aPageSize;
+    ret.border = aBorder;
+    ret.format = aFormat;
+
+    ret.levelCount = 1;
+    while( ret.pages_x( ret.levelCount - 1 ) > 1 || ret.pages_y( ret.levelCount - 1 ) > 1 )
+        ++ret.levelCount;
+
+    return ret;
+}
+
+RgbaImage extract_vt_page( VtLayout const& aLayout, RgbaImage const& aLevelImage, std::uint32_t aX, std::uint32_t aY )
+{
+    std::uint32_t const size = aLayout.stored_page_size();
+
+    RgbaImage ret;
+    ret.width = size;
+    ret.height = size;
+    ret.texels.resize( std::size_t(size) * size * 4 );
+
+    std::int64_t const x0 = std::int64_t(aX) * aLayout.pageSize - aLayout.border;
+    std::int64_t const y0 = std::int64_t(aY) * aLayout.pageSize - aLayout.border;
+    std::int64_t const maxX = std::int64_t(aLevelImage.width) - 1;
+    std::int64_t const maxY = std::int64_t(aLevelImage.height) - 1;
+
+    for( std::uint32_t y = 0; y < size; ++y )
+    {
+        std::int64_t const sy = std::clamp( y0 + y, std::int64_t(0), maxY );
+        for( std::uint32_t x = 0; x < size; ++x )
+        {
+            std::int64_t const sx = std::clamp( x0 + x, std::int64_t(0), maxX );
+            auto const* src = aLevelImage.texels.data() + (sy * aLevelImage.width + sx) * 4;
+            std::copy_n( src, 4, ret.texels.data() + (std::size_t(y) * size + x) * 4 );
+        }
+    }
+
+    return ret;
+}
+
+bool write_vt_pagefile( char const* aPath, VtLayout const& aLayout, std::vector<RgbaImage> const& aMips, ThreadPool& aPool, std::string_view aWriter )
+{
+    assert( aMips.size() >= aLayout.levelCount );
+
+    std::size_t const dataOffset = data_offset_( aWriter.size() );
+    std::size_t const pageBytes = aLayout.page_bytes();
+    std::size_t const pageCount = aLayout.page_count();
+
+    std::vector<std::uint8_t> out( dataOffset + pageCount * pageBytes, 0 );
+
+    std::memcpy( out.data(), kMagic, sizeof(kMagic) );
+    put_u32_( out, 8, aLayout.width );
+    put_u32_( out, 12, aLayout.height );
+    put_u32_( out, 16, aLayout.pageSize );
+    put_u32_( out, 20, aLayout.border );
+    put_u32_( out, 24, aLayout.levelCount );
+    put_u32_( out, 28, std::uint32_t(aLayout.format) );
+    put_u32_( out, 32, std::uint32_t(dataOffset) );
+    put_u32_( out, 36, std::uint32_t(aWriter.size()) );
+    std::memcpy( out.data() + kWriterOffset, aWriter.data(), aWriter.size() );
+
+    // Flat list of all pages, so that the work is balanced across levels
+    struct PageRef_
+    {
+        std::uint32_t level, x, y;
+    };
+
+    std::vector<PageRef_> pages;
+    pages.reserve( pageCount );
+    for( std::uint32_t level = 0; level < aLayout.levelCount; ++level )
+    {
+        for( std::uint32_t y = 0; y < aLayout.pages_y( level ); ++y )
+        {
+            for( std::uint32_t x = 0; x < aLayout.pages_x( level ); ++x )
+                pages.push_back( { level, x, y } );
+        }
+    }
+
+    aPool.parallel_for( pages.size(), 16, [&] ( std::size_t aBegin, std::size_t aEnd ) {
+        for( std::size_t i = aBegin; i < aEnd; ++i )
+        {
+            auto const& ref = pages[i];
+            auto const page = extract_vt_page( aLayout, aMips[ref.level], ref.x, ref.y );
+            auto const blocks = compress_image( aLayout.format, page );
+
+            assert( blocks.size() == pageBytes );
+            std::memcpy( out.data() + dataOffset + i * pageBytes, blocks.data(), pageBytes );
+        }
+    } );
+
+    // Write
+    std::filesystem::path const path( aPath );
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+
+    {
+        std::ofstream ofs( tmp, std::ios::binary | std::ios::trunc );
+        if( !ofs.write( reinterpret_cast<char const*>(out.data()), std::streamsize(out.size()) ) )
+            return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename( tmp, path, ec );
+    return !ec;
+}
+
+std::optional<VtLayout> parse_vt_pagefile( std::span<std::uint8_t const> aBytes, std::string_view aWriter )
+{
+    auto const& in = aBytes;
+    if( in.size() < kWriterOffset || 0 != std::memcmp( in.data(), kMagic, sizeof(kMagic) ) )
+        return std::nullopt;
+
+    std::size_t const writerLength = get_u32_( in, 36 );
+    std::size_t const dataOffset = get_u32_( in, 32 );
+    if( writerLength != aWriter.size() || dataOffset != data_offset_( writerLength ) || in.size() < dataOffset )
+        return std::nullopt;
+    if( 0 != std::memcmp( in.data() + kWriterOffset, aWriter.data(), writerLength ) )
+        return std::nullopt;
+
+    std::uint32_t const width = get_u32_( in, 8 );
+    std::uint32_t const height = get_u32_( in, 12 );
+    std::uint32_t const pageSize = get_u32_( in, 16 );
+    std::uint32_t const border = get_u32_( in, 20 );
+    std::uint32_t const format = get_u32_( in, 28 );
+    if( 0 == width || 0 == height || 0 == pageSize || 0 != (pageSize + 2 * border) % kBlockDim )
+        return std::nullopt;
+    if( format > std::uint32_t(BlockFormat::bc7) )
+        return std::nullopt;
+
+    // The level count is implied by the other parameters
+    VtLayout const ret = make_vt_layout( width, height, pageSize, border, BlockFormat(format) );
+    if( ret.levelCount != get_u32_( in, 24 ) )
+        return std::nullopt;
+
+    if( in.size() != dataOffset + ret.page_count() * ret.page_bytes() )
+        return std::nullopt;
+
+    return ret;
+}
+
+std::span<std::uint8_t const> vt_page_data( std::span<std::uint8_t const> aBytes, VtLayout const& aLayout, std::size_t aPageIndex )
+{
+    assert( aPageIndex < aLayout.page_count() );
+
+    std::size_t const dataOffset = get_u32_( aBytes, 32 );
+    return aBytes.subspan( dataOffset + aPageIndex * aLayout.page_bytes(), aLayout.page_bytes() );
+}
@@ -0,0 +1,77 @@
+#ifndef VT_PAGEFILE_HPP_82F4C1A9_0E5B_4D7A_B3C6_19D7E05A4F28
+#define VT_PAGEFILE_HPP_82F4C1A9_0E5B_4D7A_B3C6_19D7E05A4F28
+
+#include <span>
+#include <vector>
+#include <optional>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "texture_compress.hpp"
+
+class ThreadPool;
+
+// Page files for virtual texturing (see virtual_texture.hpp).
+//
+// The virtual texture is split into square pages of pageSize texels on each
+// mip level, down to the level that fits into a single page. Each page is
+// stored with a border of extra texels taken from its neighbours (or
+// repeated at the edges of the image), so that bilinear filtering inside the
+// physical cache texture never reads from unrelated pages. Pages are block
+// compressed and all have the same size on disk, so a page's location
+// follows from its index and the file can be memory mapped and read page by
+// page.
+//
+// Page (x, y) on level l covers the texels [x, x+1) * pageSize horizontally
+// (and [y, y+1) * pageSize vertically) of that level. Its parent on level l+1
+// is (x/2, y/2), clamped to the pages of that level.
+//
+// This file does not depend on OpenGL (it's tested in main-test).
+
+struct VtLayout
+{
+    std::uint32_t width = 0, height = 0; // level 0, in texels
+    std::uint32_t pageSize = 0;          // without border
+    std::uint32_t border = 0;
+    std::uint32_t levelCount = 0;
+    BlockFormat format = BlockFormat::bc1;
+
+    std::uint32_t level_width( std::uint32_t aLevel ) const noexcept;
+    std::uint32_t level_height( std::uint32_t aLevel ) const noexcept;
+
+    std::uint32_t pages_x( std::uint32_t aLevel ) const noexcept;
+    std::uint32_t pages_y( std::uint32_t aLevel ) const noexcept;
+
+    // Size of a stored page, including the border on both sides
+    std::uint32_t stored_page_size() const noexcept;
+    std::size_t page_bytes() const noexcept;
+
+    // Pages are numbered level by level (level 0 first), row by row
+    std::size_t page_count() const noexcept;
+    std::size_t page_index( std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aY ) const noexcept;
+};
+
+// aPageSize + 2 * aBorder must be a multiple of the block size (4)
+VtLayout make_vt_layout( std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aPageSize, std::uint32_t aBorder, BlockFormat );
+
+// Copy page (aX, aY) including its border out of aLevelImage, which must be
+// the mip level the page belongs to.
+RgbaImage extract_vt_page( VtLayout const&, RgbaImage const& aLevelImage, std::uint32_t aX, std::uint32_t aY );
+
+// aMips are the levels of the source image (level 0 first), e.g., from
+// build_srgb_mip_chain(); only the first aLayout.levelCount are used. Pages
+// are extracted and compressed in parallel on aPool. Writes to a temporary
+// file first (see write_ktx2()). Returns false on failure.
+bool write_vt_pagefile( char const* aPath, VtLayout const& aLayout, std::vector<RgbaImage> const& aMips, ThreadPool& aPool, std::string_view aWriter );
+
+// Returns std::nullopt if aBytes are not a complete page file with writer
+// aWriter.
+std::optional<VtLayout> parse_vt_pagefile( std::span<std::uint8_t const> aBytes, std::string_view aWriter );
+
+// Compressed data of a page; aBytes must have been accepted by
+// parse_vt_pagefile().
+std::span<std::uint8_t const> vt_page_data( std::span<std::uint8_t const> aBytes, VtLayout const&, std::size_t aPageIndex );
+
+#endif // VT_PAGEFILE_HPP_82F4C1A9_0E5B_4D7A_B3C6_19D7E05A4F28
@@ -24,9 +24,24 @@ workspace "COMP3811-glcode"
 		-- (MSVC will not compile code with VLAs.)
 		buildoptions { "-Werror=vla" }
 
+	-- Don't fuse a*b+c into FMAs (GCC does so by default with -march=native)
+	-- where results must match another code path bit for bit: the runtime
+	-- build of the UFO mesh against the compile-time one (constant evaluation
+	-- never fuses), and the SIMD particle update against the scalar one.
+	filter { "toolset:gcc or toolset:clang", "files:main/particle_sim.cpp or main-test/particles.cpp or main-test/ufo_geometry.cpp" }
+		buildoptions { "-ffp-contract=off" }
+
 	filter "toolset:gcc" 
 		links { "stdc++exp" }
 
+	-- The compile-time UFO mesh needs more than the default budget. C++
+	-- only; gcc warns about the option for the third-party C sources.
+	filter { "toolset:gcc", "files:**.cpp" }
+		buildoptions { "-fconstexpr-ops-limit=268435456" }
+
+	filter { "toolset:clang", "files:**.cpp" }
+		buildoptions { "-fconstexpr-steps=268435456" }
+
 	filter "toolset:msc-*"
 		warnings "extra" -- this enables /W4; default is /W3
 		--buildoptions { "/W4" }
@@ -39,6 +54,9 @@ workspace "COMP3811-glcode"
 			"/wd4456", -- declaration of 'foo' hides previous local declaration
 		}
 
+		-- The compile-time UFO mesh needs more than the default budget.
+		buildoptions { "/constexpr:steps268435456" }
+
 	filter "*"
 
 	-- default libraries
@@ -79,6 +97,17 @@ defines( "SOLUTION_CODE=1" )
 include "third_party" 
 
 -- Projects
+
+-- GL-free simulation (see main/simulation.hpp). Built as the "sim" library,
+-- which main, main-test and sim-bench link.
+sim_sources = {
+	"main/simulation.cpp",
+	"main/camera.cpp",
+	"main/particle_sim.cpp",
+	"main/particle_budget.cpp",
+	"main/heightfield.cpp"
+}
+
 project "main"
 	local sources = { 
 		"main/**.cpp",
@@ -91,10 +120,12 @@ project "main"
 	location "main"
 
 	files( sources )
+	removefiles( sim_sources )
 
 	dependson "main-shaders"
 	dependson "x-rapidobj"
 
+	links "sim"
 	links "vmlib"
 	links "support"
 
@@ -135,6 +166,58 @@ project "vmlib-test"
 
 	links "x-catch2"
 
+project "main-test"
+	local sources = { 
+		"main-test/**.cpp",
+		"main-test/**.hpp",
+		"main-test/**.hxx",
+		"main-test/**.inl"
+	}
+
+	kind "ConsoleApp"
+	location "main-test"
+
+	files( sources )
+
+	-- GL-free parts of main under test
+	files {
+		"main/ufo_geometry.cpp",
+		"main/texture_compress.cpp",
+		"main/mipmap.cpp",
+		"main/ktx2.cpp",
+		"main/atlas_packer.cpp",
+		"main/vt_pagefile.cpp",
+		"main/vt_cache.cpp",
+		"main/frustum.cpp"
+	}
+
+	links "sim"
+	links "vmlib"
+	links "support"
+
+	links "x-catch2"
+
+project "sim-bench"
+	local sources = { 
+		"sim-bench/**.cpp",
+		"sim-bench/**.hpp"
+	}
+
+	kind "ConsoleApp"
+	location "sim-bench"
+
+	files( sources )
+
+	links "sim"
+	links "vmlib"
+	links "support"
+
+project "sim"
+	kind "StaticLib"
+	location "sim"
+
+	files( sim_sources )
+
 project "support"
 	local sources = { 
 		"support/**.cpp",
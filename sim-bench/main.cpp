@@ -0,0 +1,212 @@
+// Headless benchmark of the simulation (see main/simulation.hpp).
+//
+// Runs a scripted launch for a number of simulated seconds at a fixed time
+// step, without a window or an OpenGL context, and prints the time spent in
+// each stage and a checksum of the final state. The checksum only depends
+// on the arguments (not on the number of threads), so it also catches
+// changes to the simulation's results.
+//
+// Usage: sim-bench [seconds] [step in seconds] [threads] [particle pool]
+#include <span>
+#include <print>
+#include <memory>
+#include <chrono>
+#include <numbers>
+#include <charconv>
+#include <optional>
+#include <algorithm>
+#include <typeinfo>
+#include <exception>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "../vmlib/mat44.hpp"
+#include "../support/thread_pool.hpp"
+
+#include "../main/camera.hpp"
+#include "../main/simulation.hpp"
+#include "../main/particle_sim.hpp"
+#include "../main/particle_budget.hpp"
+
+namespace
+{
+    // As in main.cpp
+    constexpr Vec3f kLandingPadPos{ -11.50f, -0.96f, -54.f };
+    constexpr float kFov = 60.0f * std::numbers::pi_v<float> / 180.0f;
+    constexpr float kViewportWidth = 1280.f, kViewportHeight = 720.f;
+
+    struct Options
+    {
+        double seconds = 20.0;
+        double step = 1.0 / 60.0;
+        std::size_t threads = 0; // 0: default
+        int particleCapacity = 0; // 0: sized for the emitters' budgets
+    };
+
+    template< typename tValue >
+    std::optional<tValue> parse_( std::string_view aArg )
+    {
+        tValue value{};
+        auto const [end, ec] = std::from_chars( aArg.data(), aArg.data() + aArg.size(), value );
+        if( ec != std::errc() || end != aArg.data() + aArg.size() )
+            return std::nullopt;
+        return value;
+    }
+
+    std::optional<Options> parse_options_( int aArgc, char* aArgv[] )
+    {
+        Options ret;
+        if( aArgc > 5 )
+            return std::nullopt;
+
+        if( aArgc > 1 )
+        {
+            auto const seconds = parse_<double>( aArgv[1] );
+            if( !seconds || !(*seconds > 0.0) )
+                return std::nullopt;
+            ret.seconds = *seconds;
+        }
+        if( aArgc > 2 )
+        {
+            auto const step = parse_<double>( aArgv[2] );
+            if( !step || !(*step > 0.0) )
+                return std::nullopt;
+            ret.step = *step;
+        }
+        if( aArgc > 3 )
+        {
+            auto const threads = parse_<std::size_t>( aArgv[3] );
+            if( !threads || 0 == *threads )
+                return std::nullopt;
+            ret.threads = *threads;
+        }
+        if( aArgc > 4 )
+        {
+            auto const capacity = parse_<int>( aArgv[4] );
+            if( !capacity || *capacity <= 0 )
+                return std::nullopt;
+            ret.particleCapacity = *capacity;
+        }
+        return ret;
+    }
+
+    // Camera input over time: fly towards the pad, then sideways, then
+    // hover while the spaceship leaves
+    void script_camera_( Camera& aCamera, double aTime )
+    {
+        aCamera.moveForward = aTime >= 2.0 && aTime < 6.0;
+        aCamera.fast        = aTime >= 2.0 && aTime < 4.0;
+        aCamera.moveLeft    = aTime >= 6.0 && aTime < 8.0;
+        aCamera.moveUp      = aTime >= 8.0 && aTime < 9.0;
+    }
+
+    struct Stage
+    {
+        char const* name;
+        double seconds;
+    };
+}
+
+int main( int aArgc, char* aArgv[] ) try
+{
+    auto const options = parse_options_( aArgc, aArgv );
+    if( !options )
+    {
+        std::print( stderr, "Usage: {} [seconds > 0] [step in seconds > 0] [threads > 0] [particle pool > 0]\n", aArgv[0] );
+        return 2;
+    }
+
+    std::unique_ptr<ThreadPool> ownPool;
+    if( options->threads )
+        ownPool = std::make_unique<ThreadPool>( options->threads );
+    ThreadPool& pool = ownPool ? *ownPool : shared_thread_pool();
+
+    ParticleSim particles( 0 );
+    SimulationState sim;
+    initSimulation( sim, particles, kLandingPadPos, options->particleCapacity );
+
+    sim.ufoAnim.active = true; // launch right away
+
+    float const dt = float(options->step);
+    std::size_t const steps = std::size_t(options->seconds / options->step + 0.5);
+
+    Mat44f const proj = make_perspective_projection( kFov, kViewportWidth / kViewportHeight, 0.1f, 250.f );
+
+    SimulationTimings timings;
+    double viewSeconds = 0.0, budgetSeconds = 0.0;
+    int peakParticles = 0;
+
+    using Clock = std::chrono::steady_clock;
+    auto const startTime = Clock::now();
+
+    for( std::size_t i = 0; i < steps; ++i )
+    {
+        script_camera_( sim.camera, double(i) * options->step );
+
+        SimulationStep const step = stepSimulation( sim, dt, pool, false, &timings );
+
+        // View matrices for all camera modes (main renders one or two)
+        auto const viewStart = Clock::now();
+        ParticleView particleView{};
+        for( CameraMode mode : { CameraMode::Free, CameraMode::Chase, CameraMode::Ground } )
+        {
+            CameraResult const cam = computeCameraView( mode, sim.camera, step.pose.position, step.pose.forward, kLandingPadPos );
+            if( CameraMode::Chase == mode )
+            {
+                particleView.viewProj = proj * cam.view;
+                particleView.cameraPos = cam.position;
+                particleView.projScaleY = proj[1,1];
+                particleView.viewportHeight = kViewportHeight;
+            }
+        }
+        auto const budgetStart = Clock::now();
+        viewSeconds += std::chrono::duration<double>( budgetStart - viewStart ).count();
+
+        // Emission level of detail for the next step, as seen from the
+        // chase camera
+        applyParticleBudget( particles, std::span( &particleView, 1 ) );
+        budgetSeconds += std::chrono::duration<double>( Clock::now() - budgetStart ).count();
+
+        peakParticles = std::max( peakParticles, particles.aliveCount );
+    }
+
+    double const totalSeconds = std::chrono::duration<double>( Clock::now() - startTime ).count();
+
+    // Report
+    std::print( "sim-bench: {:g} s simulated in {} steps of {:.3f} ms, {} threads\n",
+        double(steps) * options->step, steps, options->step * 1e3, pool.thread_count() );
+
+    Stage const stages[] = {
+        { "ufo path", timings.ufo },
+        { "emission", timings.emission },
+        { "update", timings.update },
+        { "camera movement", timings.camera },
+        { "camera views", viewSeconds },
+        { "particle budget", budgetSeconds },
+        { "total", totalSeconds }
+    };
+
+    std::print( "{:<18}{:>12}{:>14}\n", "stage", "total ms", "per step us" );
+    for( auto const& stage : stages )
+    {
+        double const perStep = steps ? stage.seconds / double(steps) : 0.0;
+        std::print( "{:<18}{:>12.3f}{:>14.3f}\n", stage.name, stage.seconds * 1e3, perStep * 1e6 );
+    }
+
+    std::print( "particles: {} alive at the end, {} at most (pool of {})\n", particles.aliveCount, peakParticles, particles.capacity );
+    std::print( "throttled: {} exhaust, {} dust\n",
+        particles.emitters[sim.exhaustEmitter].throttled, particles.emitters[sim.dustEmitter].throttled );
+    std::print( "checksum: {:016x}\n", simulationChecksum( sim ) );
+
+    return 0;
+}
+catch( std::exception const& eErr )
+{
+    std::print( stderr, "Top-level Exception ({}):\n", typeid(eErr).name() );
+    std::print( stderr, "{}\n", eErr.what() );
+    std::print( stderr, "Bye.\n" );
+    return 1;
+}
@@ -0,0 +1,69 @@
+#include "fixed_timestep.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+FixedTimestep::FixedTimestep( double aStep, int aMaxSteps ) noexcept
+	: mStep( aStep )
+	, mMaxSteps( std::max( aMaxSteps, 1 ) )
+{
+	assert( aStep > 0.0 );
+}
+
+int FixedTimestep::advance( double aElapsed ) noexcept
+{
+	++mStats.frames;
+
+	// Written this way so that NaN counts as 0 too
+	if( !(aElapsed > 0.0) )
+		aElapsed = 0.0;
+	mAccumulator += aElapsed;
+
+	double const due = std::floor( mAccumulator / mStep );
+	mAccumulator -= due * mStep;
+
+	// Rounding may leave slightly less than 0 or a full step
+	if( mAccumulator < 0.0 )
+		mAccumulator = 0.0;
+
+	int steps = mMaxSteps;
+	if( due > double(mMaxSteps) )
+	{
+		++mStats.clampedFrames;
+		mStats.droppedSeconds += (due - double(mMaxSteps)) * mStep;
+	}
+	else
+	{
+		steps = int(due);
+	}
+
+	mStats.steps += std::size_t(steps);
+	return steps;
+}
+
+float FixedTimestep::alpha() const noexcept
+{
+	return float(std::clamp( mAccumulator / mStep, 0.0, 1.0 ));
+}
+
+double FixedTimestep::step() const noexcept
+{
+	return mStep;
+}
+
+int FixedTimestep::max_steps() const noexcept
+{
+	return mMaxSteps;
+}
+
+void FixedTimestep::reset() noexcept
+{
+	mAccumulator = 0.0;
+}
+
+FixedTimestepStats FixedTimestep::stats() const noexcept
+{
+	return mStats;
+}
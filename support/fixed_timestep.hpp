@@ -0,0 +1,60 @@
+#ifndef FIXED_TIMESTEP_HPP_A17FD2CF_AB2B_4E88_9DBA_B378B4FC1C4A
+#define FIXED_TIMESTEP_HPP_A17FD2CF_AB2B_4E88_9DBA_B378B4FC1C4A
+
+#include <cstddef>
+
+// Fixed-step scheduler for the simulation.
+//
+// Each frame, advance() adds the real time that passed to an accumulator
+// and returns how many steps of step() seconds to run. The remainder stays
+// in the accumulator for the next frame. Rendering interpolates between
+// the states of the last two steps with alpha(), so that motion is smooth
+// even when the frame rate and the step rate differ.
+//
+// The simulation then only depends on the number of steps, not on the
+// frame rate, and it costs the same at any refresh rate. Frames that come
+// faster than the step rate run no steps at all.
+//
+// After a hitch, at most max_steps() steps are run. The time beyond that is
+// dropped, and the simulation falls behind real time. Otherwise, each slow
+// frame would need more steps than the one before it.
+struct FixedTimestepStats
+{
+	// Totals since creation
+	std::size_t frames = 0;
+	std::size_t steps = 0;
+	std::size_t clampedFrames = 0;	// needed more than max_steps()
+	double droppedSeconds = 0.0;
+};
+
+class FixedTimestep final
+{
+	public:
+		explicit FixedTimestep( double aStep = 1.0 / 60.0, int aMaxSteps = 4 ) noexcept;
+
+	public:
+		// Adds aElapsed seconds (negative values count as 0) and returns the
+		// number of steps to run now
+		int advance( double aElapsed ) noexcept;
+
+		// Where to render between the last two steps, in [0, 1]. 0 is the
+		// state before the last step, 1 is the state after it.
+		float alpha() const noexcept;
+
+		double step() const noexcept;
+		int max_steps() const noexcept;
+
+		// Empties the accumulator
+		void reset() noexcept;
+
+		FixedTimestepStats stats() const noexcept;
+
+	private:
+		double mStep;
+		int mMaxSteps;
+		double mAccumulator = 0.0;
+
+		FixedTimestepStats mStats{};
+};
+
+#endif // FIXED_TIMESTEP_HPP_A17FD2CF_AB2B_4E88_9DBA_B378B4FC1C4A
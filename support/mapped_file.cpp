@@ -0,0 +1,131 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#include "error.hpp"
+
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
+#if defined(_WIN32)
+MappedFile::MappedFile( char const* aPath )
+{
+	HANDLE file = CreateFileA( aPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( INVALID_HANDLE_VALUE == file )
+		throw Error( "Unable to open '{}': error {}", aPath, GetLastError() );
+
+	LARGE_INTEGER size{};
+	if( !GetFileSizeEx( file, &size ) )
+	{
+		auto const err = GetLastError();
+		CloseHandle( file );
+		throw Error( "Unable to query size of '{}': error {}", aPath, err );
+	}
+
+	mSize = std::size_t(size.QuadPart);
+	if( 0 == mSize )
+	{
+		CloseHandle( file );
+		return;
+	}
+
+	// The mapping keeps the file open; the handle is no longer needed.
+	mMapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	CloseHandle( file );
+	if( !mMapping )
+		throw Error( "Unable to map '{}': error {}", aPath, GetLastError() );
+
+	mData = MapViewOfFile( mMapping, FILE_MAP_READ, 0, 0, 0 );
+	if( !mData )
+	{
+		auto const err = GetLastError();
+		CloseHandle( mMapping );
+		throw Error( "Unable to map '{}': error {}", aPath, err );
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if( mData )
+		UnmapViewOfFile( mData );
+	if( mMapping )
+		CloseHandle( mMapping );
+}
+
+MappedFile::MappedFile( MappedFile&& aOther ) noexcept
+	: mData( std::exchange( aOther.mData, nullptr ) )
+	, mSize( std::exchange( aOther.mSize, 0 ) )
+	, mMapping( std::exchange( aOther.mMapping, nullptr ) )
+{}
+MappedFile& MappedFile::operator= (MappedFile&& aOther) noexcept
+{
+	std::swap( mData, aOther.mData );
+	std::swap( mSize, aOther.mSize );
+	std::swap( mMapping, aOther.mMapping );
+	return *this;
+}
+
+#else // POSIX
+
+MappedFile::MappedFile( char const* aPath )
+{
+	int const fd = open( aPath, O_RDONLY );
+	if( -1 == fd )
+		throw Error( "Unable to open '{}'", aPath );
+
+	struct stat st{};
+	if( 0 != fstat( fd, &st ) )
+	{
+		close( fd );
+		throw Error( "Unable to stat '{}'", aPath );
+	}
+
+	mSize = std::size_t(st.st_size);
+	if( 0 == mSize )
+	{
+		close( fd );
+		return;
+	}
+
+	// The mapping stays valid after the descriptor is closed.
+	void* data = mmap( nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if( MAP_FAILED == data )
+	{
+		mSize = 0;
+		throw Error( "Unable to mmap '{}'", aPath );
+	}
+
+	mData = data;
+}
+
+MappedFile::~MappedFile()
+{
+	if( mData )
+		munmap( const_cast<void*>(mData), mSize );
+}
+
+MappedFile::MappedFile( MappedFile&& aOther ) noexcept
+	: mData( std::exchange( aOther.mData, nullptr ) )
+	, mSize( std::exchange( aOther.mSize, 0 ) )
+{}
+MappedFile& MappedFile::operator= (MappedFile&& aOther) noexcept
+{
+	std::swap( mData, aOther.mData );
+	std::swap( mSize, aOther.mSize );
+	return *this;
+}
+#endif // ~ _WIN32
+
+std::span<std::uint8_t const> MappedFile::bytes() const noexcept
+{
+	return { static_cast<std::uint8_t const*>(mData), mSize };
+}
@@ -0,0 +1,39 @@
+#ifndef MAPPED_FILE_HPP_0F6B2D94_58A1_4C3E_B7D0_91E4A3C25F68
+#define MAPPED_FILE_HPP_0F6B2D94_58A1_4C3E_B7D0_91E4A3C25F68
+
+#include <span>
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file. The OS pages the data in on
+// demand, so no copy is made when the file is read.
+class MappedFile final
+{
+	public:
+		MappedFile() noexcept = default;
+
+		// Throws Error if the file cannot be opened or mapped
+		explicit MappedFile( char const* aPath );
+
+		~MappedFile();
+
+		MappedFile( MappedFile const& ) = delete;
+		MappedFile& operator= (MappedFile const&) = delete;
+
+		MappedFile( MappedFile&& ) noexcept;
+		MappedFile& operator= (MappedFile&&) noexcept;
+
+	public:
+		std::span<std::uint8_t const> bytes() const noexcept;
+
+	private:
+		void const* mData = nullptr;
+		std::size_t mSize = 0;
+
+#		if defined(_WIN32)
+		void* mMapping = nullptr;
+#		endif
+};
+
+#endif // MAPPED_FILE_HPP_0F6B2D94_58A1_4C3E_B7D0_91E4A3C25F68
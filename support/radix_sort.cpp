@@ -0,0 +1,99 @@
+#include "radix_sort.hpp"
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <cassert>
+#include <cstddef>
+
+#include "thread_pool.hpp"
+
+namespace
+{
+	constexpr unsigned kDigitBits = 8;
+	constexpr std::size_t kBuckets = std::size_t(1) << kDigitBits;
+
+	// Elements per block. Large enough that the histograms are cheap to sum,
+	// small enough to spread a few hundred thousand keys over the workers.
+	constexpr std::size_t kBlockSize = 32 * 1024;
+
+	using Histogram_ = std::array<std::uint32_t, kBuckets>;
+}
+
+void radix_sort( std::span<std::uint32_t> aKeys, std::span<std::uint32_t> aValues, std::span<std::uint32_t> aKeyScratch, std::span<std::uint32_t> aValueScratch, ThreadPool& aPool )
+{
+	std::size_t const count = aKeys.size();
+	assert( aValues.size() == count );
+	assert( aKeyScratch.size() >= count && aValueScratch.size() >= count );
+
+	if( count < 2 )
+		return;
+
+	std::size_t const blocks = (count + kBlockSize - 1) / kBlockSize;
+	std::vector<Histogram_> histograms( blocks );
+
+	std::uint32_t* keys = aKeys.data();
+	std::uint32_t* values = aValues.data();
+	std::uint32_t* keysOut = aKeyScratch.data();
+	std::uint32_t* valuesOut = aValueScratch.data();
+
+	for( unsigned shift = 0; shift < 32; shift += kDigitBits )
+	{
+		// Histogram per block
+		aPool.parallel_for( blocks, 1, [&] (std::size_t aFirst, std::size_t aLast) {
+			for( std::size_t b = aFirst; b < aLast; ++b )
+			{
+				Histogram_& hist = histograms[b];
+				hist.fill( 0 );
+
+				std::size_t const end = std::min( (b+1) * kBlockSize, count );
+				for( std::size_t i = b * kBlockSize; i < end; ++i )
+					++hist[(keys[i] >> shift) & (kBuckets-1)];
+			}
+		} );
+
+		// Nothing to do if all keys have the same digit
+		std::size_t const digit = (keys[0] >> shift) & (kBuckets-1);
+		std::size_t sameDigit = 0;
+		for( auto const& hist : histograms )
+			sameDigit += hist[digit];
+		if( count == sameDigit )
+			continue;
+
+		// Exclusive prefix sum, digit-major: histograms become offsets
+		std::uint32_t offset = 0;
+		for( std::size_t d = 0; d < kBuckets; ++d )
+		{
+			for( auto& hist : histograms )
+				offset += std::exchange( hist[d], offset );
+		}
+
+		// Scatter; each block writes to its own ranges
+		aPool.parallel_for( blocks, 1, [&] (std::size_t aFirst, std::size_t aLast) {
+			for( std::size_t b = aFirst; b < aLast; ++b )
+			{
+				Histogram_& next = histograms[b];
+
+				std::size_t const end = std::min( (b+1) * kBlockSize, count );
+				for( std::size_t i = b * kBlockSize; i < end; ++i )
+				{
+					std::uint32_t const at = next[(keys[i] >> shift) & (kBuckets-1)]++;
+					keysOut[at] = keys[i];
+					valuesOut[at] = values[i];
+				}
+			}
+		} );
+
+		std::swap( keys, keysOut );
+		std::swap( values, valuesOut );
+	}
+
+	// Odd number of passes: the result is in the scratch buffers
+	if( keys != aKeys.data() )
+	{
+		std::copy( keys, keys + count, aKeys.data() );
+		std::copy( values, values + count, aValues.data() );
+	}
+}
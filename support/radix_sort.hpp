@@ -0,0 +1,36 @@
+#ifndef RADIX_SORT_HPP_9D3A6C21_E74B_4F85_A01C_5B8E2D7F4396
+#define RADIX_SORT_HPP_9D3A6C21_E74B_4F85_A01C_5B8E2D7F4396
+
+#include <span>
+
+#include <cstdint>
+
+class ThreadPool;
+
+// Parallel LSD radix sort of 32-bit keys with 32-bit values.
+//
+// Four passes over 8-bit digits. Each pass splits the input into blocks that
+// are histogrammed and scattered on the thread pool; an exclusive prefix sum
+// over (digit, block) gives each block its output ranges, so the sort is
+// stable and its result does not depend on the number of threads. Passes in
+// which all keys have the same digit are skipped.
+//
+// aKeyScratch and aValueScratch must be at least as large as aKeys, and
+// aValues must have the same size as aKeys. The sorted keys and values end up
+// in aKeys and aValues.
+void radix_sort(
+	std::span<std::uint32_t> aKeys,
+	std::span<std::uint32_t> aValues,
+	std::span<std::uint32_t> aKeyScratch,
+	std::span<std::uint32_t> aValueScratch,
+	ThreadPool& aPool
+);
+
+// Maps floats to keys that sort in the same order (negative zero before
+// positive zero; NaNs at the ends)
+inline std::uint32_t radix_key_from_float( std::uint32_t aBits ) noexcept
+{
+	return aBits ^ ((aBits & 0x8000'0000u) ? 0xffff'ffffu : 0x8000'0000u);
+}
+
+#endif // RADIX_SORT_HPP_9D3A6C21_E74B_4F85_A01C_5B8E2D7F4396
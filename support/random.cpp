@@ -0,0 +1,123 @@
+#include "random.hpp"
+
+#include <bit>
+#include <algorithm>
+
+namespace
+{
+	std::uint64_t splitmix64_( std::uint64_t& aState ) noexcept
+	{
+		std::uint64_t z = (aState += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	// 24 random bits to [0, 1)
+	inline float to_float_( std::uint32_t aBits ) noexcept
+	{
+		return float(aBits >> 8) * 0x1.0p-24f;
+	}
+}
+
+Xoshiro128Plus::Xoshiro128Plus( std::uint64_t aSeed ) noexcept
+{
+	std::uint64_t sm = aSeed;
+	std::uint64_t const a = splitmix64_( sm );
+	std::uint64_t const b = splitmix64_( sm );
+
+	mState[0] = std::uint32_t(a);
+	mState[1] = std::uint32_t(a >> 32);
+	mState[2] = std::uint32_t(b);
+	mState[3] = std::uint32_t(b >> 32);
+
+	// The all-zero state is invalid (the generator would only return zeros)
+	if( 0 == (mState[0] | mState[1] | mState[2] | mState[3]) )
+		mState[0] = 1;
+}
+
+std::uint32_t Xoshiro128Plus::next() noexcept
+{
+	std::uint32_t* s = mState;
+	std::uint32_t const result = s[0] + s[3];
+	std::uint32_t const t = s[1] << 9;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = std::rotl( s[3], 11 );
+
+	return result;
+}
+
+float Xoshiro128Plus::uniform() noexcept
+{
+	return to_float_( next() );
+}
+
+void Xoshiro128Plus::jump() noexcept
+{
+	static constexpr std::uint32_t kJump[] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+
+	std::uint32_t s[4] = {};
+	for( auto const word : kJump )
+	{
+		for( int bit = 0; bit < 32; ++bit )
+		{
+			if( word & (std::uint32_t(1) << bit) )
+			{
+				for( int i = 0; i < 4; ++i )
+					s[i] ^= mState[i];
+			}
+			next();
+		}
+	}
+
+	std::copy_n( s, 4, mState );
+}
+
+
+RandomStream::RandomStream( std::uint64_t aSeed, std::uint32_t aStream ) noexcept
+{
+	Xoshiro128Plus gen( aSeed );
+	for( std::uint64_t i = 0; i < std::uint64_t(aStream) * kLanes; ++i )
+		gen.jump();
+
+	for( std::size_t lane = 0; lane < kLanes; ++lane )
+	{
+		mS0[lane] = gen.mState[0];
+		mS1[lane] = gen.mState[1];
+		mS2[lane] = gen.mState[2];
+		mS3[lane] = gen.mState[3];
+		gen.jump();
+	}
+}
+
+void RandomStream::uniform( std::span<float> aOut ) noexcept
+{
+	std::size_t i = 0;
+	while( i < aOut.size() )
+	{
+		alignas(32) float values[kLanes];
+		for( std::size_t lane = 0; lane < kLanes; ++lane )
+		{
+			std::uint32_t const result = mS0[lane] + mS3[lane];
+			std::uint32_t const t = mS1[lane] << 9;
+
+			mS2[lane] ^= mS0[lane];
+			mS3[lane] ^= mS1[lane];
+			mS1[lane] ^= mS2[lane];
+			mS0[lane] ^= mS3[lane];
+			mS2[lane] ^= t;
+			mS3[lane] = (mS3[lane] << 11) | (mS3[lane] >> 21);
+
+			values[lane] = to_float_( result );
+		}
+
+		std::size_t const count = std::min( kLanes, aOut.size() - i );
+		std::copy_n( values, count, aOut.data() + i );
+		i += count;
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef RANDOM_HPP_6E0C4B7A_1F93_4D25_8A6E_2C57D0B9F314
+#define RANDOM_HPP_6E0C4B7A_1F93_4D25_8A6E_2C57D0B9F314
+
+#include <span>
+
+#include <cstddef>
+#include <cstdint>
+
+// Small, fast pseudo random number generators with explicit state.
+//
+// Xoshiro128Plus is xoshiro128+ by Blackman and Vigna: 128 bits of state,
+// period 2^128 - 1, and a jump function that advances it by 2^64 steps.
+// Only the upper bits are used for floats (the lowest bits of xoshiro128+
+// are weak).
+//
+// RandomStream runs kLanes generators side by side and produces kLanes
+// numbers per step; the loops over the lanes are simple enough for the
+// compiler to vectorize. Lane l of stream s is the seeded generator jumped
+// s * kLanes + l times, so lanes and streams never overlap in practice. Use
+// one stream per thread.
+//
+// The same seed always gives the same sequence, on every platform.
+
+class Xoshiro128Plus final
+{
+	public:
+		// The state is derived from the seed with splitmix64
+		explicit Xoshiro128Plus( std::uint64_t aSeed ) noexcept;
+
+	public:
+		std::uint32_t next() noexcept;
+
+		// Uniform in [0, 1)
+		float uniform() noexcept;
+
+		// Equivalent to 2^64 calls to next()
+		void jump() noexcept;
+
+	private:
+		friend class RandomStream;
+		std::uint32_t mState[4];
+};
+
+class RandomStream final
+{
+	public:
+		static constexpr std::size_t kLanes = 8;
+
+		explicit RandomStream( std::uint64_t aSeed, std::uint32_t aStream = 0 ) noexcept;
+
+	public:
+		// Fills aOut with uniform floats in [0, 1). Element i (counting from
+		// the start of the call) comes from lane i % kLanes. If the size is
+		// not a multiple of kLanes, the numbers left over from the last step
+		// are dropped.
+		void uniform( std::span<float> aOut ) noexcept;
+
+	private:
+		alignas(32) std::uint32_t mS0[kLanes];
+		alignas(32) std::uint32_t mS1[kLanes];
+		alignas(32) std::uint32_t mS2[kLanes];
+		alignas(32) std::uint32_t mS3[kLanes];
+};
+
+#endif // RANDOM_HPP_6E0C4B7A_1F93_4D25_8A6E_2C57D0B9F314
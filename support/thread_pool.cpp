@@ -0,0 +1,152 @@
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <exception>
+
+#include <cassert>
+
+namespace
+{
+	// State of one parallel_for() call. Helper tasks hold a reference, since
+	// they may only get to run after the call has returned (in which case
+	// they find no work left and exit immediately).
+	struct ParallelFor_
+	{
+		std::function<void(std::size_t,std::size_t)> const* body;
+		std::size_t count, grain, chunks;
+
+		std::atomic<std::size_t> next{ 0 };
+		std::atomic<std::size_t> done{ 0 };
+
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::exception_ptr error;
+
+		void run()
+		{
+			for( ;; )
+			{
+				std::size_t const chunk = next.fetch_add( 1 );
+				if( chunk >= chunks )
+					return;
+
+				std::size_t const begin = chunk * grain;
+				try
+				{
+					(*body)( begin, std::min( begin + grain, count ) );
+				}
+				catch( ... )
+				{
+					std::lock_guard lock( mutex );
+					if( !error )
+						error = std::current_exception();
+				}
+
+				if( done.fetch_add( 1 ) + 1 == chunks )
+				{
+					std::lock_guard lock( mutex );
+					finished.notify_all();
+				}
+			}
+		}
+	};
+}
+
+ThreadPool::ThreadPool( std::size_t aThreadCount )
+{
+	aThreadCount = std::max<std::size_t>( aThreadCount, 1 );
+
+	mThreads.reserve( aThreadCount );
+	for( std::size_t i = 0; i < aThreadCount; ++i )
+		mThreads.emplace_back( [this] { worker_(); } );
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock( mMutex );
+		mStop = true;
+	}
+	mWakeUp.notify_all();
+
+	for( auto& thread : mThreads )
+		thread.join();
+}
+
+std::size_t ThreadPool::thread_count() const noexcept
+{
+	return mThreads.size();
+}
+
+void ThreadPool::enqueue( std::function<void()> aTask )
+{
+	assert( aTask );
+	{
+		std::lock_guard lock( mMutex );
+		mTasks.emplace_back( std::move(aTask) );
+	}
+	mWakeUp.notify_one();
+}
+
+void ThreadPool::parallel_for( std::size_t aCount, std::size_t aGrain, std::function<void(std::size_t,std::size_t)> const& aBody )
+{
+	if( 0 == aCount )
+		return;
+
+	aGrain = std::max<std::size_t>( aGrain, 1 );
+
+	auto state = std::make_shared<ParallelFor_>();
+	state->body = &aBody;
+	state->count = aCount;
+	state->grain = aGrain;
+	state->chunks = (aCount + aGrain - 1) / aGrain;
+
+	std::size_t const helpers = std::min( mThreads.size(), state->chunks - 1 );
+	for( std::size_t i = 0; i < helpers; ++i )
+		enqueue( [state] { state->run(); } );
+
+	state->run();
+
+	{
+		std::unique_lock lock( state->mutex );
+		state->finished.wait( lock, [&] { return state->done.load() == state->chunks; } );
+	}
+
+	if( state->error )
+		std::rethrow_exception( state->error );
+}
+
+std::size_t ThreadPool::default_thread_count() noexcept
+{
+	unsigned const hw = std::thread::hardware_concurrency();
+	return hw > 1 ? hw - 1 : 1;
+}
+
+void ThreadPool::worker_()
+{
+	for( ;; )
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock lock( mMutex );
+			mWakeUp.wait( lock, [this] { return mStop || !mTasks.empty(); } );
+
+			if( mTasks.empty() )
+				return; // mStop
+
+			task = std::move(mTasks.front());
+			mTasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+ThreadPool& shared_thread_pool()
+{
+	static ThreadPool pool;
+	return pool;
+}
@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_HPP_7C1E9A52_3B48_4D06_9F2A_E85D1B6C0437
+#define THREAD_POOL_HPP_7C1E9A52_3B48_4D06_9F2A_E85D1B6C0437
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include <cstddef>
+
+// Fixed-size pool of worker threads.
+//
+// Tasks are plain std::function<void()>s taken from a single FIFO queue. The
+// pool is meant for coarse-grained CPU work (texture processing, simulation
+// chunks); there is no work stealing.
+class ThreadPool final
+{
+	public:
+		explicit ThreadPool( std::size_t aThreadCount = default_thread_count() );
+		~ThreadPool();
+
+		ThreadPool( ThreadPool const& ) = delete;
+		ThreadPool& operator= (ThreadPool const&) = delete;
+
+	public:
+		std::size_t thread_count() const noexcept;
+
+		// Queues a task. Exceptions escaping aTask terminate the program.
+		void enqueue( std::function<void()> aTask );
+
+		// Calls aBody( begin, end ) for consecutive ranges of at most aGrain
+		// items that together cover [0, aCount). The calling thread takes
+		// part, so this is safe to call from within a task. Returns once all
+		// ranges have finished; the first exception thrown by aBody (if any)
+		// is rethrown.
+		void parallel_for(
+			std::size_t aCount,
+			std::size_t aGrain,
+			std::function<void(std::size_t,std::size_t)> const& aBody
+		);
+
+	public:
+		// One less than the number of hardware threads (the main thread is
+		// busy too), but at least one.
+		static std::size_t default_thread_count() noexcept;
+
+	private:
+		void worker_();
+
+	private:
+		std::vector<std::thread> mThreads;
+
+		std::mutex mMutex;
+		std::condition_variable mWakeUp;
+		std::deque<std::function<void()>> mTasks;
+		bool mStop = false;
+};
+
+// Process-wide pool with default_thread_count() threads, created on first use
+ThreadPool& shared_thread_pool();
+
+#endif // THREAD_POOL_HPP_7C1E9A52_3B48_4D06_9F2A_E85D1B6C0437
@@ -0,0 +1,60 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <bit>
+#include <cmath>
+#include <numbers>
+#include <cstdint>
+
+#include "../vmlib/cxmath.hpp"
+
+// cx_sqrt() must give exactly the same result at compile time and at runtime
+// (where it calls std::sqrt()). The compile-time path is detail::cx_sqrt_exact_,
+// which can also be called at runtime for testing.
+
+static_assert( cx_sqrt( 4.f ) == 2.f );
+static_assert( cx_sqrt( 0.f ) == 0.f );
+static_assert( cx_sin( 0.f ) == 0.f );
+static_assert( cx_cos( 0.f ) == 1.f );
+
+TEST_CASE("cx_sqrt is correctly rounded", "[cxmath]")
+{
+	SECTION("Matches std::sqrt over a wide range")
+	{
+		// Step through the bit patterns of positive floats (every exponent,
+		// many mantissas)
+		for( std::uint32_t bits = 0x00000001u; bits < 0x7f800000u; bits += 0x00001f31u )
+		{
+			float const x = std::bit_cast<float>( bits );
+			REQUIRE( std::bit_cast<std::uint32_t>( detail::cx_sqrt_exact_( x ) )
+				== std::bit_cast<std::uint32_t>( std::sqrt( x ) ) );
+		}
+	}
+
+	SECTION("Matches std::sqrt near perfect squares")
+	{
+		for( int i = 1; i < 4096; ++i )
+		{
+			float const sq = float(i) * float(i);
+			for( float x : { std::nextafter( sq, 0.f ), sq, std::nextafter( sq, 1e30f ) } )
+			{
+				REQUIRE( std::bit_cast<std::uint32_t>( detail::cx_sqrt_exact_( x ) )
+					== std::bit_cast<std::uint32_t>( std::sqrt( x ) ) );
+			}
+		}
+	}
+}
+
+TEST_CASE("cx_sin and cx_cos", "[cxmath]")
+{
+	static constexpr float kEps_ = 1e-6f;
+	using namespace Catch::Matchers;
+
+	float const pi = std::numbers::pi_v<float>;
+
+	for( int i = -720; i <= 720; ++i )
+	{
+		float const angle = float(i) / 180.f * pi;
+		REQUIRE_THAT( cx_sin( angle ), WithinAbs( std::sin( angle ), kEps_ ) );
+		REQUIRE_THAT( cx_cos( angle ), WithinAbs( std::cos( angle ), kEps_ ) );
+	}
+}
@@ -0,0 +1,149 @@
+#ifndef CXMATH_HPP_3B0D54B1_8E52_4F43_9C6A_2E1F7A90C4D2
+#define CXMATH_HPP_3B0D54B1_8E52_4F43_9C6A_2E1F7A90C4D2
+
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+
+/* constexpr versions of a few <cmath> functions
+ *
+ * std::sqrt(), std::sin() and std::cos() are not constexpr (until C++26), so
+ * anything built from them (rotation matrices, normalize(), procedural
+ * meshes) cannot be evaluated at compile time. The functions here can.
+ *
+ * cx_sqrt() is correctly rounded, i.e., it returns exactly what an IEEE
+ * conforming std::sqrt() returns. At runtime it simply calls std::sqrt().
+ *
+ * cx_sin() and cx_cos() evaluate in double precision and round to float once.
+ * They are *not* guaranteed to match the C library bit for bit, so code that
+ * must produce identical results at compile time and at runtime must use
+ * these functions in both cases (they are equally cheap at runtime).
+ */
+
+namespace detail
+{
+	constexpr
+	double cx_sqrt_newton_( double aX ) noexcept
+	{
+		// Initial guess: halve the exponent
+		auto const bits = std::bit_cast<std::uint64_t>( aX );
+		double r = std::bit_cast<double>( (bits >> 1) + (0x3ff0000000000000ull >> 1) );
+
+		// Quadratic convergence; the guess is within a few percent.
+		for( int i = 0; i < 6; ++i )
+			r = 0.5 * (r + aX / r);
+
+		return r;
+	}
+
+	// sin/cos for |aR| <= pi/4 (Taylor series, error well below 1 double ulp)
+	constexpr
+	double cx_sin_poly_( double aR ) noexcept
+	{
+		double const r2 = aR * aR;
+		double term = aR, sum = aR;
+		for( int i = 1; i <= 9; ++i )
+		{
+			term *= -r2 / double( (2*i) * (2*i + 1) );
+			sum += term;
+		}
+		return sum;
+	}
+	constexpr
+	double cx_cos_poly_( double aR ) noexcept
+	{
+		double const r2 = aR * aR;
+		double term = 1.0, sum = 1.0;
+		for( int i = 1; i <= 9; ++i )
+		{
+			term *= -r2 / double( (2*i - 1) * (2*i) );
+			sum += term;
+		}
+		return sum;
+	}
+
+	// Reduce aX to aX - k*pi/2 with |r| <= pi/4. Returns k mod 4.
+	constexpr
+	int cx_reduce_( double aX, double& aR ) noexcept
+	{
+		// pi/2 split into a high and a low part (Cody-Waite)
+		constexpr double kHalfPiHi = 1.5707963267948966;
+		constexpr double kHalfPiLo = 6.123233995736766e-17;
+		constexpr double kTwoOverPi = 0.6366197723675814;
+
+		double const kf = aX * kTwoOverPi;
+		auto const k = static_cast<std::int64_t>( kf < 0.0 ? kf - 0.5 : kf + 0.5 );
+
+		aR = (aX - double(k) * kHalfPiHi) - double(k) * kHalfPiLo;
+		return static_cast<int>( k & 3 );
+	}
+
+	// Correctly rounded square root, usable in constant expressions
+	constexpr
+	float cx_sqrt_exact_( float aX ) noexcept
+	{
+		if( aX != aX || aX <= 0.f || aX == std::numeric_limits<float>::infinity() )
+			return aX < 0.f ? std::numeric_limits<float>::quiet_NaN() : aX;
+
+		double const x = aX;
+		float r = static_cast<float>( cx_sqrt_newton_( x ) );
+
+		// Fix up the last bit. Products of two floats (and of midpoints between
+		// adjacent floats) are exact in double, so these comparisons are exact.
+		auto const rbits = std::bit_cast<std::uint32_t>( r );
+		float const up   = std::bit_cast<float>( rbits + 1 );
+		float const down = std::bit_cast<float>( rbits - 1 );
+
+		double const midUp   = 0.5 * (double(r) + double(up));
+		double const midDown = 0.5 * (double(r) + double(down));
+
+		if( midUp * midUp < x )
+			r = up;
+		else if( midDown * midDown > x )
+			r = down;
+
+		return r;
+	}
+}
+
+constexpr
+float cx_sqrt( float aX ) noexcept
+{
+	if consteval
+	{
+		return detail::cx_sqrt_exact_( aX );
+	}
+	else
+	{
+		return std::sqrt( aX );
+	}
+}
+
+constexpr
+float cx_sin( float aX ) noexcept
+{
+	double r = 0.0;
+	switch( detail::cx_reduce_( aX, r ) )
+	{
+		case 0: return static_cast<float>( detail::cx_sin_poly_( r ) );
+		case 1: return static_cast<float>( detail::cx_cos_poly_( r ) );
+		case 2: return static_cast<float>( -detail::cx_sin_poly_( r ) );
+		default: return static_cast<float>( -detail::cx_cos_poly_( r ) );
+	}
+}
+
+constexpr
+float cx_cos( float aX ) noexcept
+{
+	double r = 0.0;
+	switch( detail::cx_reduce_( aX, r ) )
+	{
+		case 0: return static_cast<float>( detail::cx_cos_poly_( r ) );
+		case 1: return static_cast<float>( -detail::cx_sin_poly_( r ) );
+		case 2: return static_cast<float>( -detail::cx_cos_poly_( r ) );
+		default: return static_cast<float>( detail::cx_sin_poly_( r ) );
+	}
+}
+
+#endif // CXMATH_HPP_3B0D54B1_8E52_4F43_9C6A_2E1F7A90C4D2
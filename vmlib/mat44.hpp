@@ -8,6 +8,7 @@
 
 #include "vec3.hpp"
 #include "vec4.hpp"
+#include "cxmath.hpp"
 
 /** Mat44f: 4x4 matrix with floats
  *
@@ -122,7 +123,7 @@ Mat44f transpose( Mat44f const& aM ) noexcept
 	return ret;
 }
 
-inline
+constexpr
 Mat44f make_rotation_x( float aAngle ) noexcept
 {
 	//TODO: your implementation goes here
@@ -131,8 +132,9 @@ Mat44f make_rotation_x( float aAngle ) noexcept
 	//               // is properly implemented.
 	// return kIdentity44f;
 
-	float ca = std::cos(aAngle);
-    float sa = std::sin(aAngle);
+	// cx_cos()/cx_sin() so rotations can be built at compile time (cxmath.hpp)
+	float ca = cx_cos(aAngle);
+    float sa = cx_sin(aAngle);
 
     Mat44f rx = kIdentity44f;
 
@@ -146,7 +148,7 @@ Mat44f make_rotation_x( float aAngle ) noexcept
 }
 
 
-inline
+constexpr
 Mat44f make_rotation_y( float aAngle ) noexcept
 {
 	//TODO: your implementation goes here
@@ -155,8 +157,8 @@ Mat44f make_rotation_y( float aAngle ) noexcept
 	//               // is properly implemented.
 	// return kIdentity44f;
 
-	float ca = std::cos(aAngle);
-    float sa = std::sin(aAngle);
+	float ca = cx_cos(aAngle);
+    float sa = cx_sin(aAngle);
 
     Mat44f ry = kIdentity44f;
 
@@ -168,7 +170,7 @@ Mat44f make_rotation_y( float aAngle ) noexcept
     return ry;
 }
 
-inline
+constexpr
 Mat44f make_rotation_z( float aAngle ) noexcept
 {
 	//TODO: your implementation goes here
@@ -177,8 +179,8 @@ Mat44f make_rotation_z( float aAngle ) noexcept
 	//               // is properly implemented.
 	// return kIdentity44f;
 
-	float ca = std::cos(aAngle);
-    float sa = std::sin(aAngle);
+	float ca = cx_cos(aAngle);
+    float sa = cx_sin(aAngle);
 
     Mat44f rz = kIdentity44f;
 
@@ -190,7 +192,7 @@ Mat44f make_rotation_z( float aAngle ) noexcept
     return rz;
 }
 
-inline
+constexpr
 Mat44f make_translation( Vec3f aTranslation ) noexcept
 {
 	//TODO: your implementation goes here
@@ -206,7 +208,7 @@ Mat44f make_translation( Vec3f aTranslation ) noexcept
     t[2,3] = aTranslation[2];
     return t;
 }
-inline
+constexpr
 Mat44f make_scaling( float aSX, float aSY, float aSZ ) noexcept
 {
 	//TODO: your implementation goes here
@@ -6,6 +6,8 @@
 #include <cassert>
 #include <cstdlib>
 
+#include "cxmath.hpp"
+
 struct Vec3f
 {
 	float x, y, z;
@@ -14,12 +16,21 @@ struct Vec3f
 	float& operator[] (std::size_t aI) noexcept
 	{
 		assert( aI < 3 );
+		if consteval
+		{
+			// Pointer arithmetic across members isn't a constant expression
+			return aI == 0 ? x : aI == 1 ? y : z;
+		}
 		return aI[&x]; // This is a bit sketchy.
 	}
 	constexpr 
 	float operator[] (std::size_t aI) const noexcept
 	{
 		assert( aI < 3 );
+		if consteval
+		{
+			return aI == 0 ? x : aI == 1 ? y : z;
+		}
 		return aI[&x]; // This is a bit sketchy.
 	}
 };
@@ -138,16 +149,15 @@ Vec3f cross (Vec3f const& a, Vec3f const& b) noexcept{
     };
 }
 
-inline
+constexpr
 float length( Vec3f aVec ) noexcept
 {
-	// The standard function std::sqrt() is not marked as constexpr. length()
-	// calls std::sqrt() unconditionally, so length() cannot be marked
-	// constexpr itself.
-	return std::sqrt( dot( aVec, aVec ) );
+	// The standard function std::sqrt() is not marked as constexpr. cx_sqrt()
+	// is, and calls std::sqrt() at runtime (see cxmath.hpp).
+	return cx_sqrt( dot( aVec, aVec ) );
 }
 
-inline
+constexpr
 Vec3f normalize( Vec3f aVec ) noexcept
 {
 	auto const l = length( aVec );
@@ -6,6 +6,8 @@
 #include <cassert>
 #include <cstdlib>
 
+#include "cxmath.hpp"
+
 struct Vec4f
 {
 	float x, y, z, w;
@@ -14,12 +16,21 @@ struct Vec4f
 	float& operator[] (std::size_t aI) noexcept
 	{
 		assert( aI < 4 );
+		if consteval
+		{
+			// Pointer arithmetic across members isn't a constant expression
+			return aI == 0 ? x : aI == 1 ? y : aI == 2 ? z : w;
+		}
 		return aI[&x]; // This is a bit sketchy.
 	}
 	constexpr 
 	float operator[] (std::size_t aI) const noexcept
 	{
 		assert( aI < 4 );
+		if consteval
+		{
+			return aI == 0 ? x : aI == 1 ? y : aI == 2 ? z : w;
+		}
 		return aI[&x]; // This is a bit sketchy.
 	}
 };
@@ -137,13 +148,12 @@ float dot( Vec4f aLeft, Vec4f aRight ) noexcept
 	;
 }
 
-inline
+constexpr
 float length( Vec4f aVec ) noexcept
 {
-	// The standard function std::sqrt() is not marked as constexpr. length()
-	// calls std::sqrt() unconditionally, so length() cannot be marked
-	// constexpr itself.
-	return std::sqrt( dot( aVec, aVec ) );
+	// The standard function std::sqrt() is not marked as constexpr. cx_sqrt()
+	// is, and calls std::sqrt() at runtime (see cxmath.hpp).
+	return cx_sqrt( dot( aVec, aVec ) );
 }
 
 